@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include "../Layer/Layer.hpp"
 
 namespace NNFS
@@ -33,7 +34,19 @@ namespace NNFS
          */
         Activation(ActivationType activation_type) : Layer(LayerType::ACTIVATION), activation_type(activation_type) {}
 
+        /**
+         * @brief Get the settings version of the activation
+         *
+         * @details The version is increased every time a setting that changes the output, such as fast math, is changed.
+         *
+         * @return uint64_t Settings version
+         */
+        uint64_t version() const
+        {
+            return _version;
+        }
+
     protected:
-        Eigen::MatrixXd _forward_input; // Input data for forward pass
+        uint64_t _version = 0; // Settings version, see version()
     };
 } // namespace NNFS
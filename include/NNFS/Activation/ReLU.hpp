@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
 #include "Activation.hpp"
 
 namespace NNFS
@@ -7,7 +10,8 @@ namespace NNFS
     /**
      * @brief ReLU activation function
      *
-     * @details This class implements the ReLU activation function.
+     * @details This class implements the ReLU activation function. The backward pass only needs to know which inputs were positive,
+     * so the forward pass keeps a bit mask of them (1 bit per element instead of a 64-bit copy of the input).
      */
     class ReLU : public Activation
     {
@@ -21,11 +25,38 @@ namespace NNFS
          * @brief Forward pass of the ReLU activation function
          *
          * @param[out] out Output of the ReLU activation function
-         * @param[in] x Input to the ReLU activation function
+         * @param[in] x Input to the ReLU activation function, may alias out
          */
         void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x) override
         {
-            _forward_input = x;
+            const Eigen::Index size = x.size();
+            _rows = x.rows();
+            _cols = x.cols();
+            _mask.resize((size + 63) / 64);
+
+            // The mask is built first as out may alias x. Every word is built in a register from a block of 64 elements, full blocks
+            // use a constant trip count so the compiler can vectorize the comparisons.
+            const double *in = x.data();
+            const Eigen::Index full = size / 64;
+            for (Eigen::Index word = 0; word < full; ++word)
+            {
+                const double *block = in + (word << 6);
+                uint64_t bits = 0;
+                for (int j = 0; j < 64; ++j)
+                {
+                    bits |= static_cast<uint64_t>(block[j] > 0) << j;
+                }
+                _mask[word] = bits;
+            }
+            if (full < static_cast<Eigen::Index>(_mask.size()))
+            {
+                uint64_t bits = 0;
+                for (Eigen::Index i = full << 6; i < size; ++i)
+                {
+                    bits |= static_cast<uint64_t>(in[i] > 0) << (i & 63);
+                }
+                _mask[full] = bits;
+            }
 
             out = (x.array() < 0.0).select(0.0, x);
         }
@@ -34,11 +65,42 @@ namespace NNFS
          * @brief Backward pass of the ReLU activation function
          *
          * @param[out] out Input gradient
-         * @param[in] dx Output gradient
+         * @param[in] dx Output gradient, may alias out
          */
         void backward(Eigen::MatrixXd &out, const Eigen::MatrixXd &dx) override
         {
-            out = dx.array() * (_forward_input.array() > 0).cast<double>();
+            if (dx.rows() != _rows || dx.cols() != _cols)
+            {
+                LOG_ERROR("Shape of the gradient does not match the shape of the last ReLU input.");
+                throw std::invalid_argument("Shape of the gradient does not match the shape of the last ReLU input.");
+            }
+
+            const Eigen::Index size = dx.size();
+            out.resize(_rows, _cols);
+            const double *gradient = dx.data();
+            double *result = out.data();
+
+            // Full words use a constant trip count so the compiler can vectorize the selection
+            const Eigen::Index full = size / 64;
+            for (Eigen::Index word = 0; word < full; ++word)
+            {
+                const uint64_t bits = _mask[word];
+                const double *block = gradient + (word << 6);
+                double *result_block = result + (word << 6);
+                for (int j = 0; j < 64; ++j)
+                {
+                    result_block[j] = block[j] * static_cast<double>((bits >> j) & 1);
+                }
+            }
+            for (Eigen::Index i = full << 6; i < size; ++i)
+            {
+                result[i] = gradient[i] * static_cast<double>((_mask[full] >> (i & 63)) & 1);
+            }
         }
+
+    private:
+        std::vector<uint64_t> _mask; // Bit i is set if element i (column-major) of the last input was positive
+        Eigen::Index _rows = 0;      // Rows of the last input
+        Eigen::Index _cols = 0;      // Columns of the last input
     };
 } // namespace NNFS
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Activation.hpp"
+#include "../Utilities/FastMath.hpp"
 
 namespace NNFS
 {
@@ -20,14 +21,21 @@ namespace NNFS
         /**
          * @brief Forward pass of the sigmoid activation function
          *
+         * @details Only the output is kept, the derivative is expressed in terms of it.
+         *
          * @param[out] out Output of the sigmoid activation function
          * @param[in] x Input to the sigmoid activation function
          */
         void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x) override
         {
-            _forward_input = x;
-
-            out = 1 / (1 + (-x).array().exp());
+            if (_fast_math)
+            {
+                FastMath::sigmoid(out, x);
+            }
+            else
+            {
+                out = 1 / (1 + (-x).array().exp());
+            }
 
             _forward_output = out;
         }
@@ -43,7 +51,32 @@ namespace NNFS
             out = _forward_output.array() * (1 - _forward_output.array()) * dx.array();
         }
 
+        /**
+         * @brief Selects the approximate kernel of FastMath instead of the exact one
+         *
+         * @param enabled Whether to use fast math (default: false)
+         */
+        void fast_math(bool enabled)
+        {
+            if (_fast_math != enabled)
+            {
+                _fast_math = enabled;
+                _version++;
+            }
+        }
+
+        /**
+         * @brief Whether the approximate kernel of FastMath is used
+         *
+         * @return bool True if fast math is enabled
+         */
+        bool fast_math() const
+        {
+            return _fast_math;
+        }
+
     private:
-        Eigen::MatrixXd _forward_output; // Output data for forward pass
+        Eigen::MatrixXd _forward_output; // Output of the forward pass, s' = s * (1 - s)
+        bool _fast_math = false;         // Whether FastMath::sigmoid() is used
     };
 } // namespace NNFS
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Activation.hpp"
+#include "../Utilities/FastMath.hpp"
 
 namespace NNFS
 {
@@ -28,7 +29,6 @@ namespace NNFS
          */
         void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x) override
         {
-            _forward_input = x;
             equation(out, x);
             _forward_output = out;
         }
@@ -44,19 +44,11 @@ namespace NNFS
             // Create uninitialized array
             out.resizeLike(dx);
 
+            // The Jacobian diag(s) - s * s^T of every row is never formed, its product with the gradient is s * (dx - s . dx)
             for (int i = 0; i < _forward_output.rows(); i++)
             {
-
-                Eigen::MatrixXd single_output = _forward_output.row(i).transpose();
-
-                Eigen::MatrixXd jacobian_matrix = Eigen::MatrixXd::Zero(_forward_output.cols(), _forward_output.cols());
-                for (int j = 0; j < _forward_output.cols(); ++j)
-                {
-                    jacobian_matrix(j, j) = single_output(j, 0);
-                }
-                jacobian_matrix -= single_output * single_output.transpose();
-
-                out.row(i) = jacobian_matrix * dx.row(i).transpose();
+                const double dot = _forward_output.row(i).dot(dx.row(i));
+                out.row(i).array() = _forward_output.row(i).array() * (dx.row(i).array() - dot);
             }
         }
 
@@ -68,19 +60,55 @@ namespace NNFS
          */
         void equation(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
         {
-            Eigen::MatrixXd expX = x;
+            Eigen::MatrixXd &expX = _exp;
+            expX = x;
             for (int i = 0; i < expX.rows(); i++)
             {
                 double max_val = expX.row(i).maxCoeff();
                 expX.row(i) -= Eigen::VectorXd::Constant(expX.cols(), max_val);
             }
 
-            expX = expX.array().exp();
+            if (_fast_math)
+            {
+                FastMath::exp(expX, expX);
+            }
+            else
+            {
+                expX = expX.array().exp();
+            }
             out = x;
             for (int row = 0; row < x.rows(); ++row)
             {
                 out.row(row) = expX.row(row) / expX.row(row).sum();
             }
         }
+
+        /**
+         * @brief Selects the approximate kernel of FastMath instead of the exact one
+         *
+         * @param enabled Whether to use fast math (default: false)
+         */
+        void fast_math(bool enabled)
+        {
+            if (_fast_math != enabled)
+            {
+                _fast_math = enabled;
+                _version++;
+            }
+        }
+
+        /**
+         * @brief Whether the approximate kernel of FastMath is used
+         *
+         * @return bool True if fast math is enabled
+         */
+        bool fast_math() const
+        {
+            return _fast_math;
+        }
+
+    private:
+        bool _fast_math = false; // Whether FastMath::exp() is used
+        Eigen::MatrixXd _exp;    // Exponentials of equation(), kept to reuse the storage
     };
 } // namespace NNFS
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Activation.hpp"
+#include "../Utilities/FastMath.hpp"
 
 namespace NNFS
 {
@@ -11,9 +12,14 @@ namespace NNFS
 
         void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x) override
         {
-            _forward_input = x;
-
-            out = x.array().tanh();
+            if (_fast_math)
+            {
+                FastMath::tanh(out, x);
+            }
+            else
+            {
+                out = x.array().tanh();
+            }
 
             _forward_output = out;
         }
@@ -23,7 +29,32 @@ namespace NNFS
             out = (1.0 - _forward_output.array().square()) * dx.array();
         }
 
+        /**
+         * @brief Selects the approximate kernel of FastMath instead of the exact one
+         *
+         * @param enabled Whether to use fast math (default: false)
+         */
+        void fast_math(bool enabled)
+        {
+            if (_fast_math != enabled)
+            {
+                _fast_math = enabled;
+                _version++;
+            }
+        }
+
+        /**
+         * @brief Whether the approximate kernel of FastMath is used
+         *
+         * @return bool True if fast math is enabled
+         */
+        bool fast_math() const
+        {
+            return _fast_math;
+        }
+
     private:
-        Eigen::MatrixXd _forward_output;
+        Eigen::MatrixXd _forward_output; // Output of the forward pass, tanh' = 1 - tanh^2
+        bool _fast_math = false;         // Whether FastMath::tanh() is used
     };
 } // namespace NNFS
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include "MappedFile.hpp"
+#include "../Utilities/clue.hpp"
+#include "../Utilities/Memory.hpp"
+#include "../Utilities/Threading.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Options of CSV::load
+     */
+    struct CSVOptions
+    {
+        char delimiter = ',';  // Field separator, '\t' for TSV files
+        bool header = false;   // Whether the first line holds column names
+        int label_column = -1; // Column holding the class of every row, -1 if there is none
+        int threads = 0;       // Number of parser threads, 0 uses every thread of Threading::inter_op()
+    };
+
+    /**
+     * @brief Multi-threaded loader for numeric CSV/TSV files
+     *
+     * @details The file is memory-mapped and split on line boundaries into one range per thread. A first pass counts the rows of every
+     * range so the destination matrix can be allocated once, a second pass parses every field with std::from_chars straight into its
+     * row. Fields are plain numbers separated by a single delimiter character, quoting is only understood in the label column.
+     */
+    class CSV
+    {
+    public:
+        using Features = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>; // Default destination, one sample per row
+
+    public:
+        /**
+         * @brief Loads a CSV file with a label column
+         *
+         * @details If every label is a non-negative integer below twice the number of rows it is used as the class id directly, otherwise
+         * the distinct labels are sorted and numbered in that order, which keeps the mapping independent of the row order and the number
+         * of threads. Integer labels are sorted by value.
+         *
+         * @tparam Scalar float or double
+         *
+         * @param[in] path Path to the file
+         * @param[out] features Every column but the label column, one sample per row
+         * @param[out] labels Class id of every sample
+         * @param[out] classes Name of every class id
+         * @param[in] options Parser options, label_column must be set
+         *
+         * @return bool True if the file was loaded, false if it is missing or malformed
+         */
+        template <typename Scalar>
+        static bool load(const std::string &path,
+                         Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> &features,
+                         Eigen::VectorXi &labels,
+                         std::vector<std::string> &classes,
+                         const CSVOptions &options)
+        {
+            if (options.label_column < 0)
+            {
+                LOG_ERROR("CSV::load() needs a label column to produce labels.");
+                return false;
+            }
+
+            MappedFile file;
+            std::vector<std::string_view> label_fields;
+            if (!parse(path, file, options, features, &label_fields))
+            {
+                return false;
+            }
+
+            map_labels(label_fields, labels, classes);
+            return true;
+        }
+
+        /**
+         * @brief Loads a CSV file without a label column
+         *
+         * @tparam Scalar float or double
+         *
+         * @param[in] path Path to the file
+         * @param[out] features Every column, one sample per row
+         * @param[in] options Parser options, label_column is ignored
+         *
+         * @return bool True if the file was loaded, false if it is missing or malformed
+         */
+        template <typename Scalar>
+        static bool load(const std::string &path,
+                         Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> &features,
+                         const CSVOptions &options = CSVOptions())
+        {
+            CSVOptions unlabeled = options;
+            unlabeled.label_column = -1;
+
+            MappedFile file;
+            return parse(path, file, unlabeled, features, nullptr);
+        }
+
+        /**
+         * @brief Parses one number of a text file and skips the blanks around it
+         *
+         * @details Shared by the text loaders. Uses std::from_chars, standard libraries without floating-point support for it fall back
+         * to strtod on a copy of the token. A single leading '+' is accepted. Numbers that do not fit Scalar, e.g. 1e999 or 1e-400 for
+         * double, are rejected rather than rounded to infinity or zero.
+         *
+         * @tparam Scalar float or double
+         *
+         * @param[in, out] p Start of the number, advanced past it and the blanks that follow
+         * @param[in] end End of the text, never read past
+         * @param[out] value Parsed number, only written on success
+         *
+         * @return bool True if a number was found at p
+         */
+        template <typename Scalar>
+        static bool parse_number(const char *&p, const char *end, Scalar &value)
+        {
+            while (p < end && *p == ' ')
+            {
+                p++;
+            }
+            if (p < end && *p == '+')
+            {
+                p++;
+                if (p == end || *p == '+' || *p == '-')
+                {
+                    return false;
+                }
+            }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+            std::from_chars_result result = std::from_chars(p, end, value);
+            if (result.ec != std::errc())
+            {
+                return false;
+            }
+            p = result.ptr;
+#else
+            // Standard libraries without floating-point from_chars, the token is copied so strtod cannot run past the mapping
+            char token[64];
+            size_t length = 0;
+            while (p + length < end && length + 1 < sizeof(token) && std::strchr("0123456789.eE-+infatyINFATY", p[length]))
+            {
+                token[length] = p[length];
+                length++;
+            }
+            token[length] = '\0';
+
+            char *stop;
+            errno = 0;
+            double parsed = std::strtod(token, &stop);
+            if (stop == token || errno == ERANGE || (std::isfinite(parsed) && std::abs(parsed) > std::numeric_limits<Scalar>::max()))
+            {
+                return false;
+            }
+            value = static_cast<Scalar>(parsed);
+            p += stop - token;
+#endif
+            while (p < end && (*p == ' ' || *p == '\r'))
+            {
+                p++;
+            }
+            return true;
+        }
+
+    private:
+        struct Range
+        {
+            const char *begin;       // First byte of the range, always the start of a line
+            const char *end;         // One past the last byte of the range
+            Eigen::Index first_row;  // Index of the first row of the range
+            Eigen::Index rows;       // Number of non-empty lines in the range
+            Eigen::Index error_row;  // Row of the first error, -1 if the range parsed cleanly
+            std::string error;       // Description of the first error
+        };
+
+        template <typename Scalar>
+        static bool parse(const std::string &path,
+                          MappedFile &file,
+                          const CSVOptions &options,
+                          Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> &features,
+                          std::vector<std::string_view> *label_fields)
+        {
+            if (!file.open(path))
+            {
+                LOG_ERROR("Failed to open CSV file " << path << ".");
+                return false;
+            }
+            file.sequential();
+
+            const char *begin = file.data();
+            const char *end = begin + file.size();
+
+            // Skip a UTF-8 byte order mark and the header line
+            if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+            {
+                begin += 3;
+            }
+            if (options.header)
+            {
+                begin = next_line(begin, end);
+            }
+
+            // The first non-empty line fixes the number of columns
+            const char *line = begin;
+            while (line < end && line_empty(line, end))
+            {
+                line = next_line(line, end);
+            }
+            if (line == end)
+            {
+                LOG_ERROR("CSV file " << path << " contains no rows.");
+                return false;
+            }
+
+            Eigen::Index columns = 1 + std::count(line, line_end(line, end), options.delimiter);
+            if (options.label_column >= columns)
+            {
+                LOG_ERROR("Label column " << options.label_column << " does not exist in CSV file " << path << " with " << columns << " columns.");
+                return false;
+            }
+            Eigen::Index feature_columns = columns - (options.label_column >= 0 ? 1 : 0);
+
+            std::vector<Range> ranges = split(begin, end, options.threads);
+
+            // First pass, count the rows of every range so the destination is allocated once
+            run(ranges, [](Range &range)
+                { range.rows = count_rows(range.begin, range.end); });
+
+            Eigen::Index rows = 0;
+            for (Range &range : ranges)
+            {
+                range.first_row = rows;
+                rows += range.rows;
+            }
+
+            Memory::resize(features, rows, feature_columns);
+            if (label_fields)
+            {
+                label_fields->assign(rows, std::string_view());
+            }
+
+            // Second pass, parse every range into its rows
+            run(ranges, [&](Range &range)
+                { parse_range(range, options, columns, features, label_fields); });
+
+            for (const Range &range : ranges)
+            {
+                if (range.error_row >= 0)
+                {
+                    LOG_ERROR("CSV file " << path << ", data row " << range.error_row + 1 << ": " << range.error);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static std::vector<Range> split(const char *begin, const char *end, int threads)
+        {
+            if (threads <= 0)
+            {
+                threads = Threading::inter_op().size();
+            }
+
+            // Ranges below 1 MiB are not worth a thread
+            size_t length = end - begin;
+            size_t count = std::max<size_t>(1, std::min<size_t>(threads, length >> 20));
+
+            std::vector<Range> ranges;
+            const char *start = begin;
+            for (size_t i = 1; i <= count; ++i)
+            {
+                const char *stop = i == count ? end : std::max(start, next_line(begin + length * i / count, end));
+                if (stop > start || ranges.empty())
+                {
+                    ranges.push_back({start, stop, 0, 0, -1, std::string()});
+                }
+                start = stop;
+            }
+            return ranges;
+        }
+
+        template <typename Function>
+        static void run(std::vector<Range> &ranges, Function function)
+        {
+            Threading::inter_op().parallel_for(0, ranges.size(), 1, [&](int64_t begin, int64_t end)
+                                               {
+                                                   for (int64_t i = begin; i < end; ++i)
+                                                   {
+                                                       function(ranges[i]);
+                                                   } });
+        }
+
+        static const char *line_end(const char *p, const char *end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            return newline ? newline : end;
+        }
+
+        static const char *next_line(const char *p, const char *end)
+        {
+            const char *newline = line_end(p, end);
+            return newline == end ? end : newline + 1;
+        }
+
+        static bool line_empty(const char *p, const char *end)
+        {
+            const char *stop = line_end(p, end);
+            return stop == p || (stop - p == 1 && *p == '\r');
+        }
+
+        static Eigen::Index count_rows(const char *p, const char *end)
+        {
+            Eigen::Index rows = 0;
+            while (p < end)
+            {
+                rows += line_empty(p, end) ? 0 : 1;
+                p = next_line(p, end);
+            }
+            return rows;
+        }
+
+        template <typename Scalar>
+        static void parse_range(Range &range,
+                                const CSVOptions &options,
+                                Eigen::Index columns,
+                                Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> &features,
+                                std::vector<std::string_view> *label_fields)
+        {
+            const char *p = range.begin;
+            Eigen::Index row = range.first_row;
+
+            while (p < range.end)
+            {
+                if (line_empty(p, range.end))
+                {
+                    p = next_line(p, range.end);
+                    continue;
+                }
+
+                const char *stop = line_end(p, range.end);
+                Scalar *out = features.data() + row * features.cols();
+
+                for (Eigen::Index column = 0; column < columns; ++column)
+                {
+                    if (column == options.label_column)
+                    {
+                        const char *field_end = static_cast<const char *>(std::memchr(p, options.delimiter, stop - p));
+                        field_end = field_end ? field_end : stop;
+                        (*label_fields)[row] = trim(p, field_end);
+                        p = field_end;
+                    }
+                    else if (!parse_number(p, stop, *out++))
+                    {
+                        range.error_row = row;
+                        range.error = "expected a number in column " + std::to_string(column) + ".";
+                        return;
+                    }
+
+                    bool last = column + 1 == columns;
+                    if (last ? p != stop : (p == stop || *p != options.delimiter))
+                    {
+                        range.error_row = row;
+                        range.error = "expected " + std::to_string(columns) + " columns.";
+                        return;
+                    }
+                    p++;
+                }
+
+                // The loop stepped over the newline already
+                p = std::min(p, range.end);
+                row++;
+            }
+        }
+
+        static std::string_view trim(const char *begin, const char *end)
+        {
+            while (begin < end && (*begin == ' ' || *begin == '\r'))
+            {
+                begin++;
+            }
+            while (end > begin && (end[-1] == ' ' || end[-1] == '\r'))
+            {
+                end--;
+            }
+            if (end - begin >= 2 && *begin == '"' && end[-1] == '"')
+            {
+                begin++;
+                end--;
+            }
+            return std::string_view(begin, end - begin);
+        }
+
+        static void map_labels(const std::vector<std::string_view> &fields, Eigen::VectorXi &labels, std::vector<std::string> &classes)
+        {
+            labels.resize(fields.size());
+
+            // Integer labels are class ids already
+            bool numeric = true;
+            int max_id = -1;
+            for (size_t i = 0; i < fields.size() && numeric; ++i)
+            {
+                int id = -1;
+                std::from_chars_result result = std::from_chars(fields[i].data(), fields[i].data() + fields[i].size(), id);
+                numeric = result.ec == std::errc() && result.ptr == fields[i].data() + fields[i].size() && id >= 0;
+                labels(i) = id;
+                max_id = std::max(max_id, id);
+            }
+
+            classes.clear();
+            if (numeric && static_cast<size_t>(max_id) < 2 * fields.size())
+            {
+                for (int id = 0; id <= max_id; ++id)
+                {
+                    classes.push_back(std::to_string(id));
+                }
+                return;
+            }
+
+            // Sparse ids would need a class for every id up to the largest one, number the distinct ids instead
+            if (numeric)
+            {
+                std::vector<int> ids(labels.data(), labels.data() + labels.size());
+                std::sort(ids.begin(), ids.end());
+                ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+                for (int id : ids)
+                {
+                    classes.push_back(std::to_string(id));
+                }
+                for (Eigen::Index i = 0; i < labels.size(); ++i)
+                {
+                    labels(i) = static_cast<int>(std::lower_bound(ids.begin(), ids.end(), labels(i)) - ids.begin());
+                }
+                return;
+            }
+
+            std::unordered_map<std::string_view, int> ids;
+            for (const std::string_view &field : fields)
+            {
+                ids.emplace(field, 0);
+            }
+
+            std::vector<std::string_view> names;
+            for (const auto &entry : ids)
+            {
+                names.push_back(entry.first);
+            }
+            std::sort(names.begin(), names.end());
+
+            for (size_t id = 0; id < names.size(); ++id)
+            {
+                ids[names[id]] = static_cast<int>(id);
+                classes.emplace_back(names[id]);
+            }
+
+            for (size_t i = 0; i < fields.size(); ++i)
+            {
+                labels(i) = ids[fields[i]];
+            }
+        }
+    };
+} // namespace NNFS
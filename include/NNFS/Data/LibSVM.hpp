@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Sparse>
+#include "CSV.hpp"
+#include "MappedFile.hpp"
+#include "../Utilities/clue.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Options of LibSVM::load
+     */
+    struct LibSVMOptions
+    {
+        int features = 0;        // Number of features, 0 uses the largest index found in the file
+        bool zero_based = false; // Whether feature indices start at 0 instead of 1
+    };
+
+    /**
+     * @brief Loader for sparse datasets in the LibSVM/SVMlight text format
+     *
+     * @details Every line holds a label followed by index:value pairs with increasing indices, e.g. "3 1:0.5 7:1 120:2". Features that
+     * are not listed are zero. The file is memory-mapped and parsed straight into CSR arrays, so datasets with millions of features are
+     * loaded without ever being densified. "qid:" pairs and comments starting with '#' are skipped.
+     */
+    class LibSVM
+    {
+    public:
+        using Features = Eigen::SparseMatrix<double, Eigen::RowMajor>; // Destination, one sample per row
+
+    public:
+        /**
+         * @brief Loads a LibSVM file
+         *
+         * @details If every label is a non-negative integer below twice the number of rows it is used as the class id directly, otherwise
+         * the distinct labels (e.g. -1 and +1) are sorted by value and numbered in that order. Labels that are not finite are rejected.
+         *
+         * @param[in] path Path to the file
+         * @param[out] features Features of every sample, one per row
+         * @param[out] labels Class id of every sample
+         * @param[out] classes Name of every class id
+         * @param[in] options Loader options
+         *
+         * @return bool True if the file was loaded, false if it is missing or malformed
+         */
+        static bool load(const std::string &path,
+                         Features &features,
+                         Eigen::VectorXi &labels,
+                         std::vector<std::string> &classes,
+                         const LibSVMOptions &options = LibSVMOptions())
+        {
+            MappedFile file;
+            if (!file.open(path))
+            {
+                LOG_ERROR("Failed to open LibSVM file " << path << ".");
+                return false;
+            }
+            file.sequential();
+
+            const char *p = file.data();
+            const char *end = p + file.size();
+            const int base = options.zero_based ? 0 : 1;
+
+            std::vector<int> outer(1, 0);
+            std::vector<int> inner;
+            std::vector<double> values;
+            std::vector<double> label_values;
+            int max_index = -1;
+
+            for (long line = 1; p < end; ++line)
+            {
+                const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+                const char *stop = newline ? newline : end;
+                const char *comment = static_cast<const char *>(std::memchr(p, '#', stop - p));
+                const char *content_end = comment ? comment : stop;
+
+                skip_blanks(p, content_end);
+                if (p < content_end)
+                {
+                    double label = 0;
+                    if (!CSV::parse_number(p, content_end, label) || !separated(p, content_end))
+                    {
+                        LOG_ERROR("LibSVM file " << path << ", line " << line << ": expected a label.");
+                        return false;
+                    }
+                    if (!std::isfinite(label))
+                    {
+                        LOG_ERROR("LibSVM file " << path << ", line " << line << ": label is not finite.");
+                        return false;
+                    }
+                    label_values.push_back(label);
+
+                    int previous = -1;
+                    skip_blanks(p, content_end);
+                    while (p < content_end)
+                    {
+                        if (content_end - p > 4 && std::memcmp(p, "qid:", 4) == 0)
+                        {
+                            while (p < content_end && !is_blank(*p))
+                            {
+                                p++;
+                            }
+                            skip_blanks(p, content_end);
+                            continue;
+                        }
+
+                        int index = 0;
+                        double value = 0;
+                        std::from_chars_result result = std::from_chars(p, content_end, index);
+                        p = result.ptr;
+                        if (result.ec != std::errc() || p == content_end || *p++ != ':' || !CSV::parse_number(p, content_end, value) ||
+                            !separated(p, content_end))
+                        {
+                            LOG_ERROR("LibSVM file " << path << ", line " << line << ": expected index:value pairs.");
+                            return false;
+                        }
+
+                        index -= base;
+                        if (index < 0 || index <= previous || (options.features > 0 && index >= options.features))
+                        {
+                            LOG_ERROR("LibSVM file " << path << ", line " << line << ": feature index " << index + base
+                                                     << " is out of range or not increasing.");
+                            return false;
+                        }
+                        previous = index;
+
+                        if (value != 0)
+                        {
+                            inner.push_back(index);
+                            values.push_back(value);
+                        }
+                        max_index = std::max(max_index, index);
+                        skip_blanks(p, content_end);
+                    }
+                    outer.push_back(static_cast<int>(inner.size()));
+                }
+
+                p = newline ? newline + 1 : end;
+            }
+
+            if (label_values.empty())
+            {
+                LOG_ERROR("LibSVM file " << path << " contains no samples.");
+                return false;
+            }
+
+            // The arrays already are in CSR order, they are copied into the matrix without sorting
+            Eigen::Index rows = static_cast<Eigen::Index>(label_values.size());
+            Eigen::Index columns = options.features > 0 ? options.features : max_index + 1;
+            features = Eigen::Map<const Features>(rows, columns, static_cast<Eigen::Index>(values.size()), outer.data(), inner.data(), values.data());
+
+            map_labels(label_values, labels, classes);
+            return true;
+        }
+
+    private:
+        static bool is_blank(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        // A token ends at the end of the line or at a blank, parse_number() may have skipped the blanks already
+        static bool separated(const char *p, const char *end)
+        {
+            return p == end || is_blank(p[-1]) || is_blank(*p);
+        }
+
+        static void skip_blanks(const char *&p, const char *end)
+        {
+            while (p < end && is_blank(*p))
+            {
+                p++;
+            }
+        }
+
+        static void map_labels(const std::vector<double> &values, Eigen::VectorXi &labels, std::vector<std::string> &classes)
+        {
+            labels.resize(values.size());
+            classes.clear();
+
+            // Integer labels are class ids already
+            bool numeric = std::all_of(values.begin(), values.end(), [](double value)
+                                       { return value >= 0 && value <= 1e9 && value == std::floor(value); });
+            double max_value = values.empty() ? 0. : *std::max_element(values.begin(), values.end());
+            if (numeric && max_value < 2. * static_cast<double>(values.size()))
+            {
+                int max_id = static_cast<int>(max_value);
+                for (size_t i = 0; i < values.size(); ++i)
+                {
+                    labels(i) = static_cast<int>(values[i]);
+                }
+                for (int id = 0; id <= max_id; ++id)
+                {
+                    classes.push_back(std::to_string(id));
+                }
+                return;
+            }
+
+            // Sparse integer ids are numbered like any other labels, keeping their integer names
+            std::vector<double> distinct = values;
+            std::sort(distinct.begin(), distinct.end());
+            distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+
+            for (double value : distinct)
+            {
+                if (numeric)
+                {
+                    classes.push_back(std::to_string(static_cast<int>(value)));
+                    continue;
+                }
+                std::ostringstream name;
+                name << value;
+                classes.push_back(name.str());
+            }
+
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                labels(i) = static_cast<int>(std::lower_bound(distinct.begin(), distinct.end(), values[i]) - distinct.begin());
+            }
+        }
+    };
+} // namespace NNFS
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NNFS_MAPPED_FILE_MMAP
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Read-only view of a whole file
+     *
+     * @details The file is memory-mapped where the platform supports it, so opening costs a handful of system calls regardless of its
+     * size and pages are shared with every other process mapping the same file. Elsewhere the file is read into memory.
+     */
+    class MappedFile
+    {
+    public:
+        /**
+         * @brief Construct an empty MappedFile object
+         */
+        MappedFile() = default;
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * @brief Destroy the MappedFile object, unmapping the file
+         */
+        ~MappedFile()
+        {
+            close();
+        }
+
+        /**
+         * @brief Maps a file
+         *
+         * @param path Path to the file
+         *
+         * @return bool True if the file was opened, empty files included
+         */
+        bool open(const std::string &path)
+        {
+            close();
+#ifdef NNFS_MAPPED_FILE_MMAP
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                ::close(fd);
+                return false;
+            }
+
+            _size = static_cast<size_t>(st.st_size);
+            if (_size > 0)
+            {
+                void *mapping = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+                if (mapping == MAP_FAILED)
+                {
+                    ::close(fd);
+                    _size = 0;
+                    return false;
+                }
+                _mapping = mapping;
+                _data = static_cast<const char *>(mapping);
+            }
+            ::close(fd);
+#else
+            std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+            if (!ifs.good())
+            {
+                return false;
+            }
+
+            // uint64_t elements keep the contents aligned for typed access
+            _size = static_cast<size_t>(ifs.tellg());
+            _buffer.resize((_size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            ifs.seekg(0);
+            ifs.read(reinterpret_cast<char *>(_buffer.data()), _size);
+            if (!ifs.good())
+            {
+                close();
+                return false;
+            }
+            _data = reinterpret_cast<const char *>(_buffer.data());
+#endif
+            _open = true;
+            return true;
+        }
+
+        /**
+         * @brief Unmaps the file, pointers handed out before are invalidated
+         */
+        void close()
+        {
+#ifdef NNFS_MAPPED_FILE_MMAP
+            if (_mapping)
+            {
+                munmap(_mapping, _size);
+            }
+#endif
+            _mapping = nullptr;
+            _buffer.clear();
+            _buffer.shrink_to_fit();
+            _data = nullptr;
+            _size = 0;
+            _open = false;
+        }
+
+        /**
+         * @brief Checks whether a file is open
+         *
+         * @return bool True if a file is open
+         */
+        bool is_open() const
+        {
+            return _open;
+        }
+
+        /**
+         * @brief Get the contents of the file
+         *
+         * @return const char* Start of the contents, page aligned when mapped, null for empty files
+         */
+        const char *data() const
+        {
+            return _data;
+        }
+
+        /**
+         * @brief Get the size of the file
+         *
+         * @return size_t Size in bytes
+         */
+        size_t size() const
+        {
+            return _size;
+        }
+
+        /**
+         * @brief Hints the kernel that a byte range is about to be read
+         *
+         * @param offset Offset of the first byte
+         * @param length Number of bytes
+         */
+        void prefetch(size_t offset, size_t length) const
+        {
+#ifdef NNFS_MAPPED_FILE_MMAP
+            if (!_mapping || offset >= _size || length == 0)
+            {
+                return;
+            }
+
+            // madvise needs a page-aligned start
+            size_t begin = offset - offset % static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t end = std::min(_size, offset + length);
+            madvise(static_cast<char *>(_mapping) + begin, end - begin, MADV_WILLNEED);
+#else
+            (void)offset;
+            (void)length;
+#endif
+        }
+
+        /**
+         * @brief Hints the kernel that the whole file is about to be read front to back
+         */
+        void sequential() const
+        {
+#ifdef NNFS_MAPPED_FILE_MMAP
+            if (_mapping)
+            {
+                madvise(_mapping, _size, MADV_SEQUENTIAL);
+            }
+#endif
+        }
+
+    private:
+        const char *_data = nullptr;   // Start of the file contents
+        size_t _size = 0;              // Size of the file in bytes
+        bool _open = false;            // Whether a file is open
+        void *_mapping = nullptr;      // Memory mapping, null when the file was read into _buffer or is empty
+        std::vector<uint64_t> _buffer; // File contents on platforms without mmap
+    };
+} // namespace NNFS
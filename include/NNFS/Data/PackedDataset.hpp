@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <Eigen/Core>
+#include "MappedFile.hpp"
+#include "../Utilities/clue.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Element type of the feature block of a packed dataset
+     */
+    enum class PackedType : uint32_t
+    {
+        UINT8 = 0,  // Raw bytes, scaled by 1/255 when converted to double
+        FLOAT32 = 1 // Stored as is
+    };
+
+    /**
+     * @brief Header at the start of every packed dataset file
+     *
+     * @details All fields are stored in the byte order of the machine that wrote the file, byte_order lets a reader on another
+     * machine detect this and refuse the file instead of misreading it.
+     */
+    struct PackedHeader
+    {
+        char magic[8];            // "NNFSPACK"
+        uint32_t version;         // Format version
+        uint32_t byte_order;      // 0x01020304 in the writer's byte order
+        uint32_t type;            // PackedType of the feature block
+        uint32_t reserved;        // Always zero
+        uint64_t samples;         // Number of samples
+        uint64_t features;        // Features per sample
+        uint64_t classes;         // Number of classes, every label is in [0, classes)
+        uint64_t features_offset; // Offset of the row-major feature block
+        uint64_t labels_offset;   // Offset of the int32 label block
+    };
+
+    static_assert(sizeof(PackedHeader) == 64, "PackedHeader must not contain padding");
+
+    /**
+     * @brief Read-only, memory-mapped dataset in the packed format
+     *
+     * @details The file consists of a PackedHeader, a row-major feature block and an int32 label block, each section starting on
+     * a page boundary. The whole file is mapped read-only through MappedFile, so pages are only read when a batch touches them
+     * and concurrent training jobs share them through the page cache.
+     * Batches are handed out as Eigen::Map views straight into the mapping.
+     */
+    class PackedDataset
+    {
+    public:
+        using FeaturesU8 = Eigen::Map<const Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>; // Feature rows of a uint8 dataset
+        using FeaturesF32 = Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;  // Feature rows of a float32 dataset
+        using Labels = Eigen::Map<const Eigen::Matrix<int32_t, Eigen::Dynamic, 1>>;                                    // Class ids
+
+        static constexpr uint32_t VERSION = 1;        // Current format version
+        static constexpr uint64_t ALIGNMENT = 4096;   // Alignment of every section
+        static constexpr uint32_t ENDIANNESS = 0x01020304; // Written to PackedHeader::byte_order
+
+    public:
+        /**
+         * @brief Construct an empty PackedDataset object
+         */
+        PackedDataset() = default;
+
+        /**
+         * @brief Construct a new PackedDataset object and open a file
+         *
+         * @param path Path to a packed dataset
+         */
+        PackedDataset(const std::string &path)
+        {
+            open(path);
+        }
+
+        PackedDataset(const PackedDataset &) = delete;
+        PackedDataset &operator=(const PackedDataset &) = delete;
+
+        /**
+         * @brief Destroy the PackedDataset object, unmapping the file
+         */
+        ~PackedDataset()
+        {
+            close();
+        }
+
+        /**
+         * @brief Maps a packed dataset and validates its header
+         *
+         * @param path Path to a packed dataset
+         *
+         * @return bool True if the file was opened, false if it is missing or malformed
+         */
+        bool open(const std::string &path)
+        {
+            close();
+
+            if (!_file.open(path) || _file.size() < sizeof(PackedHeader))
+            {
+                _file.close();
+                LOG_ERROR("Failed to open packed dataset " << path << ".");
+                return false;
+            }
+
+            std::memcpy(&_header, _file.data(), sizeof(_header));
+            if (!validate())
+            {
+                LOG_ERROR("File " << path << " is not a valid packed dataset.");
+                close();
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Unmaps the file, views handed out before are invalidated
+         */
+        void close()
+        {
+            _file.close();
+            std::memset(&_header, 0, sizeof(_header));
+        }
+
+        /**
+         * @brief Checks whether a dataset is open
+         *
+         * @return bool True if a dataset is open
+         */
+        bool is_open() const
+        {
+            return _file.is_open();
+        }
+
+        /**
+         * @brief Get the number of samples
+         *
+         * @return Eigen::Index Number of samples
+         */
+        Eigen::Index samples() const
+        {
+            return static_cast<Eigen::Index>(_header.samples);
+        }
+
+        /**
+         * @brief Get the number of features per sample
+         *
+         * @return Eigen::Index Number of features
+         */
+        Eigen::Index features() const
+        {
+            return static_cast<Eigen::Index>(_header.features);
+        }
+
+        /**
+         * @brief Get the number of classes
+         *
+         * @return Eigen::Index Number of classes
+         */
+        Eigen::Index classes() const
+        {
+            return static_cast<Eigen::Index>(_header.classes);
+        }
+
+        /**
+         * @brief Get the element type of the feature block
+         *
+         * @return PackedType Element type
+         */
+        PackedType type() const
+        {
+            return static_cast<PackedType>(_header.type);
+        }
+
+        /**
+         * @brief Zero-copy view of consecutive samples of a uint8 dataset
+         *
+         * @param start Index of the first sample
+         * @param count Number of samples
+         *
+         * @return FeaturesU8 View of the rows, valid until the dataset is closed
+         *
+         * @throws std::invalid_argument if the dataset does not store uint8 features
+         * @throws std::out_of_range if the range exceeds the dataset
+         */
+        FeaturesU8 features_u8(Eigen::Index start, Eigen::Index count) const
+        {
+            check(PackedType::UINT8, start, count);
+            return FeaturesU8(reinterpret_cast<const uint8_t *>(_file.data() + _header.features_offset) + start * features(), count, features());
+        }
+
+        /**
+         * @brief Zero-copy view of consecutive samples of a float32 dataset
+         *
+         * @param start Index of the first sample
+         * @param count Number of samples
+         *
+         * @return FeaturesF32 View of the rows, valid until the dataset is closed
+         *
+         * @throws std::invalid_argument if the dataset does not store float32 features
+         * @throws std::out_of_range if the range exceeds the dataset
+         */
+        FeaturesF32 features_f32(Eigen::Index start, Eigen::Index count) const
+        {
+            check(PackedType::FLOAT32, start, count);
+            return FeaturesF32(reinterpret_cast<const float *>(_file.data() + _header.features_offset) + start * features(), count, features());
+        }
+
+        /**
+         * @brief Zero-copy view of the labels of consecutive samples
+         *
+         * @param start Index of the first sample
+         * @param count Number of samples
+         *
+         * @return Labels View of the class ids, valid until the dataset is closed
+         *
+         * @throws std::out_of_range if the range exceeds the dataset
+         */
+        Labels labels(Eigen::Index start, Eigen::Index count) const
+        {
+            check(type(), start, count);
+            return Labels(reinterpret_cast<const int32_t *>(_file.data() + _header.labels_offset) + start, count);
+        }
+
+        /**
+         * @brief Converts consecutive samples into the double matrices expected by NeuralNetwork
+         *
+         * @details uint8 features are scaled to [0, 1], labels are one-hot encoded.
+         *
+         * @param[in] start Index of the first sample
+         * @param[in] count Number of samples
+         * @param[out] x Features, count x features()
+         * @param[out] y One-hot labels, count x classes()
+         */
+        void batch(Eigen::Index start, Eigen::Index count, Eigen::MatrixXd &x, Eigen::MatrixXd &y) const
+        {
+            if (type() == PackedType::UINT8)
+            {
+                x = features_u8(start, count).cast<double>() / 255.;
+            }
+            else
+            {
+                x = features_f32(start, count).cast<double>();
+            }
+
+            Labels ids = labels(start, count);
+            y = Eigen::MatrixXd::Zero(count, classes());
+            for (Eigen::Index i = 0; i < count; ++i)
+            {
+                y(i, ids(i)) = 1.;
+            }
+        }
+
+        /**
+         * @brief Hints the kernel that a range of samples is about to be read
+         *
+         * @param start Index of the first sample
+         * @param count Number of samples
+         */
+        void prefetch(Eigen::Index start, Eigen::Index count) const
+        {
+            if (is_open() && start >= 0 && count > 0 && start + count <= samples())
+            {
+                size_t row_bytes = static_cast<size_t>(features()) * element_size(type());
+                _file.prefetch(_header.features_offset + start * row_bytes, count * row_bytes);
+            }
+        }
+
+        /**
+         * @brief Writes a dataset in the packed format
+         *
+         * @tparam Scalar uint8_t or float
+         *
+         * @param path Output path, overwritten if it exists
+         * @param features Feature rows, one sample per row
+         * @param labels Class id of every sample
+         * @param classes Number of classes, every label must be in [0, classes)
+         *
+         * @return bool True if the file was written
+         */
+        template <typename Scalar>
+        static bool write(const std::string &path,
+                          const Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> &features,
+                          const Eigen::Ref<const Eigen::Matrix<int32_t, Eigen::Dynamic, 1>> &labels,
+                          int classes)
+        {
+            static_assert(std::is_same<Scalar, uint8_t>::value || std::is_same<Scalar, float>::value, "Packed datasets store uint8_t or float features");
+
+            if (features.rows() != labels.rows() || classes <= 0 ||
+                (labels.size() > 0 && (labels.minCoeff() < 0 || labels.maxCoeff() >= classes)))
+            {
+                LOG_ERROR("Invalid dataset passed to NNFS::PackedDataset::write().");
+                return false;
+            }
+
+            PackedHeader header{};
+            std::memcpy(header.magic, "NNFSPACK", sizeof(header.magic));
+            header.version = VERSION;
+            header.byte_order = ENDIANNESS;
+            header.type = static_cast<uint32_t>(std::is_same<Scalar, uint8_t>::value ? PackedType::UINT8 : PackedType::FLOAT32);
+            header.samples = features.rows();
+            header.features = features.cols();
+            header.classes = classes;
+            header.features_offset = align(sizeof(PackedHeader));
+            header.labels_offset = align(header.features_offset + features.size() * sizeof(Scalar));
+
+            std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+            if (!ofs.good())
+            {
+                LOG_ERROR("Failed to create packed dataset " << path << ".");
+                return false;
+            }
+
+            ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            pad(ofs, header.features_offset);
+            ofs.write(reinterpret_cast<const char *>(features.data()), features.size() * sizeof(Scalar));
+            pad(ofs, header.labels_offset);
+            ofs.write(reinterpret_cast<const char *>(labels.data()), labels.size() * sizeof(int32_t));
+
+            if (!ofs.good())
+            {
+                LOG_ERROR("Failed to write packed dataset " << path << ".");
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        static size_t element_size(PackedType type)
+        {
+            return type == PackedType::UINT8 ? sizeof(uint8_t) : sizeof(float);
+        }
+
+        static uint64_t align(uint64_t offset)
+        {
+            return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        static void pad(std::ofstream &ofs, uint64_t offset)
+        {
+            static const char zeros[ALIGNMENT] = {};
+            uint64_t position = static_cast<uint64_t>(ofs.tellp());
+            ofs.write(zeros, offset - position);
+        }
+
+        void check(PackedType expected, Eigen::Index start, Eigen::Index count) const
+        {
+            if (!is_open() || type() != expected)
+            {
+                throw std::invalid_argument("Packed dataset is not open or stores another feature type.");
+            }
+            if (start < 0 || count < 0 || start + count > samples())
+            {
+                throw std::out_of_range("Sample range exceeds the packed dataset.");
+            }
+        }
+
+        bool validate() const
+        {
+            if (std::memcmp(_header.magic, "NNFSPACK", sizeof(_header.magic)) != 0 || _header.version != VERSION ||
+                _header.byte_order != ENDIANNESS || _header.type > static_cast<uint32_t>(PackedType::FLOAT32))
+            {
+                return false;
+            }
+
+            // Bound the sizes first so the section arithmetic below cannot overflow, dividing as the products themselves could wrap
+            const uint64_t limit = uint64_t(1) << 40;
+            if (_header.samples > limit || _header.features > limit || _header.classes == 0 || _header.classes > limit ||
+                (_header.features != 0 && _header.samples > limit / _header.features / element_size(type())))
+            {
+                return false;
+            }
+
+            if (_header.features_offset > limit || _header.labels_offset > limit)
+            {
+                return false;
+            }
+
+            uint64_t features_end = _header.features_offset + _header.samples * _header.features * element_size(type());
+            uint64_t labels_end = _header.labels_offset + _header.samples * sizeof(int32_t);
+            if (_header.features_offset % ALIGNMENT != 0 || _header.labels_offset % ALIGNMENT != 0 ||
+                _header.features_offset < sizeof(PackedHeader) || _header.labels_offset < features_end || labels_end > _file.size())
+            {
+                return false;
+            }
+
+            // Labels index one-hot columns, reject out of range ids once here instead of on every batch
+            Labels ids(reinterpret_cast<const int32_t *>(_file.data() + _header.labels_offset), samples());
+            return ids.size() == 0 || (ids.minCoeff() >= 0 && ids.maxCoeff() < classes());
+        }
+
+        PackedHeader _header{}; // Header of the open file
+        MappedFile _file;       // Contents of the open file
+    };
+} // namespace NNFS
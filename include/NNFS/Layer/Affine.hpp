@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include "Layer.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Per-feature affine layer, y = x * scale + shift
+     *
+     * @details Covers fixed input normalization (see standardize()) and batch normalization at inference time (see batch_norm()). The
+     * parameters are not trained, the backward pass only scales the gradient. NeuralNetwork::compile() folds affine layers into the
+     * adjacent dense layers of the inference plan, so they cost nothing at prediction time.
+     */
+    class Affine : public Layer
+    {
+    public:
+        /**
+         * @brief Construct a new Affine object
+         *
+         * @param scale Factor of every feature
+         * @param shift Offset of every feature, added after scaling
+         *
+         * @throws std::invalid_argument if scale and shift have different sizes
+         */
+        Affine(const Eigen::RowVectorXd &scale, const Eigen::RowVectorXd &shift) : Layer(LayerType::AFFINE), _scale(scale), _shift(shift)
+        {
+            if (scale.size() != shift.size())
+            {
+                LOG_ERROR("Scale and shift of an affine layer must have the same size.");
+                throw std::invalid_argument("Scale and shift of an affine layer must have the same size.");
+            }
+        }
+
+        /**
+         * @brief Creates the input normalization (x - mean) / stddev
+         *
+         * @param mean Mean of every feature
+         * @param stddev Standard deviation of every feature, must not be zero
+         *
+         * @return std::shared_ptr<Affine> Normalization layer
+         */
+        static std::shared_ptr<Affine> standardize(const Eigen::RowVectorXd &mean, const Eigen::RowVectorXd &stddev)
+        {
+            Eigen::RowVectorXd scale = stddev.cwiseInverse();
+            return std::make_shared<Affine>(scale, -mean.cwiseProduct(scale));
+        }
+
+        /**
+         * @brief Creates the inference-time transform of a batch normalization layer, gamma * (x - mean) / sqrt(variance + epsilon) + beta
+         *
+         * @param gamma Learned scale of every feature
+         * @param beta Learned offset of every feature
+         * @param mean Running mean of every feature
+         * @param variance Running variance of every feature
+         * @param epsilon Added to the variance (default: 1e-5)
+         *
+         * @return std::shared_ptr<Affine> Batch normalization layer
+         */
+        static std::shared_ptr<Affine> batch_norm(const Eigen::RowVectorXd &gamma, const Eigen::RowVectorXd &beta,
+                                                  const Eigen::RowVectorXd &mean, const Eigen::RowVectorXd &variance, double epsilon = 1e-5)
+        {
+            Eigen::RowVectorXd scale = gamma.array() / (variance.array() + epsilon).sqrt();
+            return std::make_shared<Affine>(scale, beta - mean.cwiseProduct(scale));
+        }
+
+        /**
+         * @brief Forward pass of the affine layer
+         *
+         * @param[out] out Output of the layer
+         * @param[in] x Input of the layer, may alias out
+         */
+        void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x) override
+        {
+            out = (x.array().rowwise() * _scale.array()).rowwise() + _shift.array();
+        }
+
+        /**
+         * @brief Backward pass of the affine layer
+         *
+         * @param[out] out Input gradient
+         * @param[in] dx Output gradient, may alias out
+         */
+        void backward(Eigen::MatrixXd &out, const Eigen::MatrixXd &dx) override
+        {
+            out = dx.array().rowwise() * _scale.array();
+        }
+
+        /**
+         * @brief Get the factor of every feature
+         *
+         * @return Eigen::RowVectorXd& Scale
+         */
+        const Eigen::RowVectorXd &scale() const
+        {
+            return _scale;
+        }
+
+        /**
+         * @brief Get the offset of every feature
+         *
+         * @return Eigen::RowVectorXd& Shift
+         */
+        const Eigen::RowVectorXd &shift() const
+        {
+            return _shift;
+        }
+
+        /**
+         * @brief Sets the factor of every feature
+         *
+         * @param scale New scale, one factor per feature
+         *
+         * @throws std::invalid_argument if the number of features differs
+         */
+        void scale(const Eigen::RowVectorXd &scale)
+        {
+            if (scale.size() != _scale.size())
+            {
+                LOG_ERROR("Shape of new matrix does not match to initial's matrix shape.");
+                throw std::invalid_argument("Shape of new matrix does not match to initial's matrix shape.");
+            }
+            _scale = scale;
+            _version++;
+        }
+
+        /**
+         * @brief Sets the offset of every feature
+         *
+         * @param shift New shift, one offset per feature
+         *
+         * @throws std::invalid_argument if the number of features differs
+         */
+        void shift(const Eigen::RowVectorXd &shift)
+        {
+            if (shift.size() != _shift.size())
+            {
+                LOG_ERROR("Shape of new matrix does not match to initial's matrix shape.");
+                throw std::invalid_argument("Shape of new matrix does not match to initial's matrix shape.");
+            }
+            _shift = shift;
+            _version++;
+        }
+
+        /**
+         * @brief Get the parameter version of the affine layer
+         *
+         * @details The version is increased every time the scale or the shift is replaced.
+         *
+         * @return uint64_t Parameter version
+         */
+        uint64_t version() const
+        {
+            return _version;
+        }
+
+        /**
+         * @brief Get the number of features
+         *
+         * @return int Number of features
+         */
+        int size() const
+        {
+            return static_cast<int>(_scale.size());
+        }
+
+        /**
+         * @brief Whether the layer leaves its input unchanged
+         *
+         * @return bool True if every scale is 1 and every shift is 0
+         */
+        bool identity() const
+        {
+            return (_scale.array() == 1.).all() && (_shift.array() == 0.).all();
+        }
+
+    private:
+        Eigen::RowVectorXd _scale; // Factor of every feature
+        Eigen::RowVectorXd _shift; // Offset of every feature
+        uint64_t _version = 0;     // Parameter version, increased whenever the scale or the shift is replaced
+    };
+} // namespace NNFS
@@ -1,8 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <random>
+#include <utility>
+#include <vector>
+#include <Eigen/Sparse>
 #include "Layer.hpp"
+#include "../Activation/Activation.hpp"
+#include "../Utilities/FastMath.hpp"
+#include "../Utilities/Gemm.hpp"
+#include "../Utilities/Memory.hpp"
 
 namespace NNFS
 {
@@ -14,6 +22,9 @@ namespace NNFS
      */
     class Dense : public Layer
     {
+    public:
+        using SparseInput = Eigen::SparseMatrix<double, Eigen::RowMajor>; // CSR batch, one sample per row
+
     public:
         /**
          * @brief Construct a new Dense object.
@@ -41,15 +52,19 @@ namespace NNFS
             std::mt19937 gen(rd());
             std::uniform_real_distribution<double> dis(-1, 1);
 
+            // The weight-shaped matrices are advised to use huge pages before they are first written, see Memory
+            Memory::resize(_weights, n_input, n_output);
             _weights = Eigen::MatrixXd::Zero(n_input, n_output).unaryExpr([&](double)
                                                                           { return .1 * dis(gen); });
             _biases = Eigen::MatrixXd::Zero(1, n_output);
 
-            _weights_optimizer = Eigen::MatrixXd::Zero(n_input, n_output);
+            Memory::resize(_weights_optimizer, n_input, n_output);
+            _weights_optimizer.setZero();
 
             _biases_optimizer = Eigen::MatrixXd::Zero(1, n_output);
 
-            _weights_optimizer_additional = Eigen::MatrixXd::Zero(n_input, n_output);
+            Memory::resize(_weights_optimizer_additional, n_input, n_output);
+            _weights_optimizer_additional.setZero();
 
             _biases_optimizer_additional = Eigen::MatrixXd::Zero(1, n_output);
         }
@@ -62,32 +77,136 @@ namespace NNFS
          */
         void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
         {
+            _sparse_forward = false;
+
+            // Inputs that are mostly zeros (e.g. after a ReLU) are multiplied in compressed form, see sparsity_threshold()
+            _input_sparsity = x.size() > 0 ? static_cast<double>((x.array() == 0).count()) / x.size() : 0.;
+            _compressed_forward = _input_sparsity >= _sparsity_threshold;
+            if (_compressed_forward)
+            {
+                compress(x);
+                forward_compressed(out);
+                epilogue(out, true);
+                return;
+            }
+
+            // The product reads the kept copy of the input, so it can be written straight into out even if out aliases x
             _forward_input = x;
-            out = x * _weights;
-            for (int row = 0; row < out.rows(); ++row)
+            Gemm::product(out, _forward_input, false, _weights, false);
+            epilogue(out, true);
+        }
+
+        /**
+         * @brief Forward pass of the dense layer for a sparse batch
+         *
+         * @details Used for inputs such as bag-of-words or one-hot vectors where only a small fraction of the features is non-zero. The
+         * product only visits the stored entries, so its cost scales with the number of non-zeros instead of the input width, and the
+         * input is kept in CSR form for backward().
+         *
+         * @param[out] out Output of the layer
+         * @param[in] x Input of the layer, one sample per row
+         */
+        void forward(Eigen::MatrixXd &out, const SparseInput &x)
+        {
+            _sparse_input = x;
+            _sparse_forward = true;
+            _compressed_forward = false;
+            out.noalias() = x * _weights;
+            epilogue(out, true);
+        }
+
+        /**
+         * @brief Incremental forward pass for a single sample
+         *
+         * @details Keeps the pre-activation of the previous sample and, when only a few input features changed, updates it with the
+         * rank-k correction (x_new - x_old)[i] * W.row(i) over the changed indices i instead of recomputing x * W. The cost therefore
+         * scales with the number of changed features rather than the input width. A full product is computed for the first sample,
+         * after the parameters change, when more than max_changed_fraction of the features differ, and every refresh_interval updates
+         * to bound floating point drift. A fused activation is applied to the result. Does not touch the state used by backward().
+         *
+         * @param[out] out Output of the layer (1 x n_output)
+         * @param[in] x Input of the layer, must be a single row
+         * @param[in] max_changed_fraction Fraction of changed features above which the full product is cheaper (default: 0.25)
+         * @param[in] refresh_interval Number of incremental updates between two full recomputations (default: 1024)
+         */
+        void forward_incremental(Eigen::MatrixXd &out, const Eigen::MatrixXd &x, double max_changed_fraction = .25, int refresh_interval = 1024)
+        {
+            bool full = x.rows() != 1 || _incremental_input.rows() != 1 || _incremental_input.cols() != x.cols() || _incremental_version != _version ||
+                        _incremental_updates >= refresh_interval;
+
+            if (!full)
+            {
+                _changed.clear();
+                const int max_changed = static_cast<int>(max_changed_fraction * _n_input);
+                for (int i = 0; i < _n_input && static_cast<int>(_changed.size()) <= max_changed; ++i)
+                {
+                    if (x(0, i) != _incremental_input(0, i))
+                    {
+                        _changed.push_back(i);
+                    }
+                }
+                full = static_cast<int>(_changed.size()) > max_changed;
+            }
+
+            if (full)
             {
-                out.row(row).array() += _biases.array();
+                _incremental_output.noalias() = x * _weights;
+                _incremental_input = x;
+                _incremental_version = _version;
+                _incremental_updates = 0;
             }
+            else if (!_changed.empty())
+            {
+                for (int i : _changed)
+                {
+                    _incremental_output.noalias() += (x(0, i) - _incremental_input(0, i)) * _weights.row(i);
+                    _incremental_input(0, i) = x(0, i);
+                }
+                _incremental_updates++;
+            }
+
+            out = _incremental_output;
+            epilogue(out, false);
         }
 
         /**
          * @brief Backward pass of the dense layer
          *
+         * @details After a sparse forward pass the weights gradient is computed from the CSR input, touching only the rows of the weights
+         * that belong to non-zero features. The input gradient is not computed in that case since a sparse input is always the data fed
+         * to the network and nothing consumes its gradient, out is left empty. With a fused activation dx is the gradient of the
+         * activation output, it is first multiplied by the activation derivative kept by the forward pass.
+         *
          * @param[out] out Input gradient
-         * @param[in] dx Output gradient
+         * @param[in] output_gradient Output gradient, may alias out
          */
-        void backward(Eigen::MatrixXd &out, const Eigen::MatrixXd &dx)
+        void backward(Eigen::MatrixXd &out, const Eigen::MatrixXd &output_gradient)
         {
-            _dweights = _forward_input.transpose() * dx;
+            if (_activation != ActivationType::NONE)
+            {
+                _dactivation.array() *= output_gradient.array();
+            }
+            const Eigen::MatrixXd &dx = _activation != ActivationType::NONE ? _dactivation : output_gradient;
+
+            if (_sparse_forward)
+            {
+                _dweights.noalias() = _sparse_input.transpose() * dx;
+            }
+            else if (_compressed_forward)
+            {
+                dweights_compressed(dx);
+            }
+            else
+            {
+                Gemm::product(_dweights, _forward_input, true, dx, false);
+            }
             _dbiases = dx.colwise().sum().array();
 
             // Gradients on regularization
             // L1 on weights
             if (_l1_weights_regularizer > 0)
             {
-                Eigen::MatrixXd dL1 = Eigen::MatrixXd::Ones(_weights.rows(), _weights.cols());
-                dL1 = (_weights.array() < 0).select(-1, dL1);
-                _dweights += _l1_weights_regularizer * dL1;
+                _dweights.array() += (_weights.array() < 0).select(-_l1_weights_regularizer, Eigen::ArrayXXd::Constant(_weights.rows(), _weights.cols(), _l1_weights_regularizer));
             }
             // L2 on weights
             if (_l2_weights_regularizer > 0)
@@ -97,9 +216,7 @@ namespace NNFS
             // L1 on biases
             if (_l1_biases_regularizer > 0)
             {
-                Eigen::MatrixXd dL1 = Eigen::MatrixXd::Ones(_biases.rows(), _biases.cols());
-                dL1 = (_biases.array() < 0).select(-1, dL1);
-                _dbiases += _l1_biases_regularizer * dL1;
+                _dbiases.array() += (_biases.array() < 0).select(-_l1_biases_regularizer, Eigen::ArrayXXd::Constant(_biases.rows(), _biases.cols(), _l1_biases_regularizer));
             }
             // L2 on biases
             if (_l2_biases_regularizer > 0)
@@ -107,7 +224,114 @@ namespace NNFS
                 _dbiases += 2 * _l2_biases_regularizer * _biases;
             }
 
-            out = dx * _weights.transpose();
+            if (_sparse_forward)
+            {
+                out.resize(0, 0);
+                return;
+            }
+
+            if (_compressed_forward && _masked_input_gradient)
+            {
+                dinput_compressed(out, dx);
+                return;
+            }
+
+            Gemm::product(out, dx, false, _weights, true);
+        }
+
+        /**
+         * @brief Fuses an activation into the layer
+         *
+         * @details The bias and the activation are applied column by column right after the matrix product, while every column is still
+         * in cache, instead of in two further passes over the output by the dense and the activation layer. The forward pass keeps the
+         * activation derivative rather than the output, so backward() takes the gradient of the activation output and needs a single
+         * multiplication to reach the pre-activation gradient. NeuralNetwork::compile() fuses every dense layer followed by a ReLU,
+         * sigmoid or tanh activation and skips the activation layer.
+         *
+         * @param[in] activation ActivationType::RELU, SIGMOID or TANH, ActivationType::NONE removes the fused activation
+         * @param[in] fast_math Whether the sigmoid and tanh use the approximate kernels of FastMath (default: false)
+         *
+         * @throws std::invalid_argument if the activation cannot be fused
+         */
+        void fuse(ActivationType activation, bool fast_math = false)
+        {
+            if (activation == ActivationType::SOFTMAX)
+            {
+                LOG_ERROR("Softmax works on whole rows and cannot be fused into a dense layer.");
+                throw std::invalid_argument("Softmax works on whole rows and cannot be fused into a dense layer.");
+            }
+            _activation = activation;
+            _fast_math = fast_math;
+            _dactivation.resize(0, 0);
+        }
+
+        /**
+         * @brief Get the fused activation
+         *
+         * @return ActivationType Fused activation, ActivationType::NONE if there is none
+         */
+        ActivationType fused_activation() const
+        {
+            return _activation;
+        }
+
+        /**
+         * @brief Whether the fused activation uses the approximate kernels of FastMath
+         *
+         * @return bool True if fast math is enabled
+         */
+        bool fused_fast_math() const
+        {
+            return _fast_math;
+        }
+
+        /**
+         * @brief Set's the input sparsity above which the layer switches to compressed kernels
+         *
+         * @details forward() measures the fraction of zeros of every batch. At or above the threshold the input is compressed column by
+         * column and the forward product, the weights gradient and (if masked_input_gradient() is enabled) the input gradient only visit
+         * its non-zeros, otherwise the dense products are used. The crossover depends on the shape and on how fast the dense products
+         * are on the target CPU, tools/bench/sparsity_bench reports it. The default suits builds without -march flags and stays on the
+         * dense path for the ~50% zeros typical after a ReLU.
+         *
+         * @param[in] threshold Fraction of zeros in [0, 1], above 1 disables the compressed kernels (default: 0.95)
+         */
+        void sparsity_threshold(double threshold)
+        {
+            _sparsity_threshold = threshold;
+        }
+
+        /**
+         * @brief Get the input sparsity above which the layer switches to compressed kernels
+         *
+         * @return double Fraction of zeros
+         */
+        double sparsity_threshold() const
+        {
+            return _sparsity_threshold;
+        }
+
+        /**
+         * @brief Get the fraction of zeros of the input of the last forward() call
+         *
+         * @return double Fraction of zeros
+         */
+        double input_sparsity() const
+        {
+            return _input_sparsity;
+        }
+
+        /**
+         * @brief Allows the compressed kernels to skip the input gradient where the input is zero
+         *
+         * @details Only valid when the previous layer zeroes the gradient of those elements anyway, which is the case for a ReLU.
+         * NeuralNetwork::compile() enables it for dense layers that follow a ReLU.
+         *
+         * @param[in] masked Whether the input gradient may be left zero where the input is zero
+         */
+        void masked_input_gradient(bool masked)
+        {
+            _masked_input_gradient = masked;
         }
 
         /**
@@ -168,6 +392,7 @@ namespace NNFS
             }
 
             _weights = weights;
+            _version++;
         }
 
         /**
@@ -187,6 +412,36 @@ namespace NNFS
                 throw std::invalid_argument("Shape of new matrix does not match to initial's matrix shape.");
             }
             _biases = biases;
+            _version++;
+        }
+
+        /**
+         * @brief Get the parameter version of the dense layer
+         *
+         * @details The version is increased every time the weights or biases are replaced, which lets callers detect stale results computed with older parameters.
+         *
+         * @return uint64_t Parameter version
+         */
+        uint64_t version() const
+        {
+            return _version;
+        }
+
+        /**
+         * @brief Updates the parameters in place
+         *
+         * @details Used by the optimizers so an update is a single pass over the parameters, their gradients and the optimizer state, see
+         * Kernels. update is called once for the weights and once for the biases, with pointers to the parameters, the gradients, the
+         * optimizer matrix, the additional optimizer matrix and the number of parameters. The parameter version is increased afterwards.
+         *
+         * @param update Called as update(double *parameters, const double *gradients, double *optimizer, double *optimizer_additional, Eigen::Index n)
+         */
+        template <typename Update>
+        void update(Update update)
+        {
+            update(_weights.data(), _dweights.data(), _weights_optimizer.data(), _weights_optimizer_additional.data(), _weights.size());
+            update(_biases.data(), _dbiases.data(), _biases_optimizer.data(), _biases_optimizer_additional.data(), _biases.size());
+            _version++;
         }
 
         /**
@@ -332,6 +587,195 @@ namespace NNFS
         }
 
     private:
+        /**
+         * @brief Adds the biases to the product and applies the fused activation, one L1-sized segment of a column at a time
+         *
+         * @param[in,out] out Product of the input and the weights, output of the layer on return
+         * @param[in] keep_derivative Whether to keep the activation derivative for backward()
+         */
+        void epilogue(Eigen::MatrixXd &out, bool keep_derivative)
+        {
+            if (_activation == ActivationType::NONE)
+            {
+                out.rowwise() += _biases.row(0);
+                return;
+            }
+
+            const Eigen::Index segment_rows = 256;
+            if (keep_derivative)
+            {
+                _dactivation.resize(out.rows(), out.cols());
+            }
+            for (Eigen::Index o = 0; o < out.cols(); ++o)
+            {
+                const double bias = _biases(0, o);
+                for (Eigen::Index start = 0; start < out.rows(); start += segment_rows)
+                {
+                    const Eigen::Index rows = std::min(segment_rows, out.rows() - start);
+                    auto segment = out.col(o).segment(start, rows).array();
+                    switch (_activation)
+                    {
+                    case ActivationType::RELU:
+                        segment = (segment + bias).max(0.);
+                        break;
+                    case ActivationType::SIGMOID:
+                        if (_fast_math)
+                        {
+                            segment += bias;
+                            FastMath::sigmoid(segment.data(), segment.data(), rows);
+                        }
+                        else
+                        {
+                            segment = 1. / (1. + (-(segment + bias)).exp());
+                        }
+                        break;
+                    default:
+                        if (_fast_math)
+                        {
+                            segment += bias;
+                            FastMath::tanh(segment.data(), segment.data(), rows);
+                        }
+                        else
+                        {
+                            segment = (segment + bias).tanh();
+                        }
+                        break;
+                    }
+
+                    if (!keep_derivative)
+                    {
+                        continue;
+                    }
+
+                    // The derivatives are expressed in terms of the output, which is still in cache
+                    auto derivative = _dactivation.col(o).segment(start, rows).array();
+                    switch (_activation)
+                    {
+                    case ActivationType::RELU:
+                        derivative = (segment > 0.).select(1., Eigen::ArrayXd::Zero(rows));
+                        break;
+                    case ActivationType::SIGMOID:
+                        derivative = segment * (1. - segment);
+                        break;
+                    default:
+                        derivative = 1. - segment.square();
+                        break;
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Stores the non-zeros of the input in compressed column form
+         *
+         * @param[in] x Input of the layer
+         */
+        void compress(const Eigen::MatrixXd &x)
+        {
+            _compressed_rows = x.rows();
+            _compressed_start.resize(x.cols() + 1);
+            _compressed_index.clear();
+            _compressed_values.clear();
+
+            // Room for every coefficient, so later batches with more non-zeros do not reallocate
+            _compressed_index.reserve(x.size());
+            _compressed_values.reserve(x.size());
+
+            for (Eigen::Index col = 0; col < x.cols(); ++col)
+            {
+                _compressed_start[col] = static_cast<int>(_compressed_index.size());
+                const double *column = x.col(col).data();
+                for (Eigen::Index row = 0; row < x.rows(); ++row)
+                {
+                    if (column[row] != 0)
+                    {
+                        _compressed_index.push_back(static_cast<int>(row));
+                        _compressed_values.push_back(column[row]);
+                    }
+                }
+            }
+            _compressed_start[x.cols()] = static_cast<int>(_compressed_index.size());
+        }
+
+        /**
+         * @brief Forward product of the compressed input without biases, scatters every non-zero times a weight into one column of the output
+         *
+         * @param[out] out Output of the layer
+         */
+        void forward_compressed(Eigen::MatrixXd &out)
+        {
+            out.setZero(_compressed_rows, _n_output);
+            for (int o = 0; o < _n_output; ++o)
+            {
+                double *out_column = out.col(o).data();
+                const double *weights_column = _weights.col(o).data();
+                for (int i = 0; i < _n_input; ++i)
+                {
+                    const double weight = weights_column[i];
+                    for (int k = _compressed_start[i]; k < _compressed_start[i + 1]; ++k)
+                    {
+                        out_column[_compressed_index[k]] += _compressed_values[k] * weight;
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Weights gradient of the compressed input, a sparse dot product per weight
+         *
+         * @param[in] dx Output gradient
+         */
+        void dweights_compressed(const Eigen::MatrixXd &dx)
+        {
+            _dweights.resize(_n_input, _n_output);
+            for (int o = 0; o < _n_output; ++o)
+            {
+                const double *dx_column = dx.col(o).data();
+                double *dweights_column = _dweights.col(o).data();
+                for (int i = 0; i < _n_input; ++i)
+                {
+                    double sum = 0;
+                    for (int k = _compressed_start[i]; k < _compressed_start[i + 1]; ++k)
+                    {
+                        sum += _compressed_values[k] * dx_column[_compressed_index[k]];
+                    }
+                    dweights_column[i] = sum;
+                }
+            }
+        }
+
+        /**
+         * @brief Input gradient at the non-zeros of the compressed input, zero elsewhere
+         *
+         * @param[out] out Input gradient, may alias dx
+         * @param[in] dx Output gradient
+         */
+        void dinput_compressed(Eigen::MatrixXd &out, const Eigen::MatrixXd &dx)
+        {
+            // Written straight into out unless it aliases dx
+            Eigen::MatrixXd temporary;
+            Eigen::MatrixXd &dinput = &out == &dx ? temporary : out;
+            dinput.setZero(_compressed_rows, _n_input);
+            for (int o = 0; o < _n_output; ++o)
+            {
+                const double *dx_column = dx.col(o).data();
+                const double *weights_column = _weights.col(o).data();
+                for (int i = 0; i < _n_input; ++i)
+                {
+                    const double weight = weights_column[i];
+                    double *dinput_column = dinput.col(i).data();
+                    for (int k = _compressed_start[i]; k < _compressed_start[i + 1]; ++k)
+                    {
+                        dinput_column[_compressed_index[k]] += dx_column[_compressed_index[k]] * weight;
+                    }
+                }
+            }
+            if (&dinput != &out)
+            {
+                out = std::move(dinput);
+            }
+        }
+
         int _n_input;  // Number of input neurons
         int _n_output; // Number of output neurons
 
@@ -353,5 +797,28 @@ namespace NNFS
         double _l2_biases_regularizer;  // L2 biases regularizer
 
         Eigen::MatrixXd _forward_input; // Forward input
+        SparseInput _sparse_input;      // Forward input of the last sparse forward pass
+        bool _sparse_forward = false;   // Whether the last forward pass used a sparse input
+
+        double _sparsity_threshold = .95;       // Input sparsity at or above which the compressed kernels are used
+        double _input_sparsity = 0.;            // Fraction of zeros of the last dense input
+        bool _compressed_forward = false;       // Whether the last forward pass used the compressed kernels
+        bool _masked_input_gradient = false;    // Whether the input gradient may be skipped where the input is zero
+        Eigen::Index _compressed_rows = 0;      // Number of rows of the compressed input
+        std::vector<int> _compressed_start;     // Offset of the first non-zero of every input column
+        std::vector<int> _compressed_index;     // Row of every non-zero
+        std::vector<double> _compressed_values; // Value of every non-zero
+
+        ActivationType _activation = ActivationType::NONE; // Fused activation, see fuse()
+        bool _fast_math = false;                           // Whether the fused activation uses FastMath
+        Eigen::MatrixXd _dactivation;                      // Derivative of the fused activation at the last output
+
+        uint64_t _version = 0; // Parameter version, increased on every weights or biases update
+
+        Eigen::MatrixXd _incremental_input;  // Previous sample of forward_incremental()
+        Eigen::MatrixXd _incremental_output; // Pre-activation (without biases) of the previous sample
+        uint64_t _incremental_version = 0;   // Parameter version the pre-activation was computed with
+        int _incremental_updates = 0;        // Incremental updates since the last full recomputation
+        std::vector<int> _changed;           // Indices of the changed features, reused between calls
     };
 } // namespace NNFS
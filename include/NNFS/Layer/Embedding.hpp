@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Layer.hpp"
+#include "../Utilities/Memory.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Embedding layer
+     *
+     * @details Turns integer ids into rows of a trainable table. Every sample holds n_inputs ids (stored as doubles so embeddings fit
+     * the usual Eigen::MatrixXd pipeline) and the output is the concatenation of their rows. It is equivalent to a dense layer without
+     * biases fed with one-hot vectors, but the forward pass copies rows instead of multiplying and the backward pass only produces the
+     * gradient of the rows used by the batch, so the optimizers update those rows only. A training step therefore costs time
+     * proportional to the number of distinct ids in the batch, not to the size of the table. Must be the first layer of a network.
+     */
+    class Embedding : public Layer
+    {
+    public:
+        /**
+         * @brief Construct a new Embedding object
+         *
+         * @param n_ids Number of rows of the table, ids are in [0, n_ids)
+         * @param n_dims Dimension of every embedding
+         * @param n_inputs Number of ids per sample (default: 1)
+         */
+        Embedding(int n_ids, int n_dims, int n_inputs = 1) : Layer(LayerType::EMBEDDING), _n_ids(n_ids), _n_dims(n_dims), _n_inputs(n_inputs)
+        {
+            std::random_device rd;
+            std::mt19937 gen(rd());
+            std::uniform_real_distribution<double> dis(-1, 1);
+
+            Memory::resize(_table, n_ids, n_dims);
+            _table = Eigen::MatrixXd::Zero(n_ids, n_dims).unaryExpr([&](double)
+                                                                    { return .1 * dis(gen); });
+        }
+
+        /**
+         * @brief Forward pass of the embedding layer
+         *
+         * @param[out] out Concatenated embeddings of every sample (rows x n_inputs * n_dims)
+         * @param[in] x Ids of every sample (rows x n_inputs), may alias out
+         *
+         * @throws std::invalid_argument if x does not have n_inputs columns
+         * @throws std::out_of_range if an id is not an integer in [0, n_ids)
+         */
+        void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
+        {
+            if (x.cols() != _n_inputs)
+            {
+                throw std::invalid_argument("Embedding expects " + std::to_string(_n_inputs) + " ids per sample.");
+            }
+
+            // Ids are read before out is resized as the network passes the same matrix as input and output
+            Eigen::Index rows = x.rows();
+            _ids.resize(rows * _n_inputs);
+            for (Eigen::Index row = 0; row < rows; ++row)
+            {
+                for (int input = 0; input < _n_inputs; ++input)
+                {
+                    double id = x(row, input);
+                    if (!(id >= 0 && id < _n_ids) || id != static_cast<int>(id))
+                    {
+                        throw std::out_of_range("Embedding id " + std::to_string(id) + " is not in [0, " + std::to_string(_n_ids) + ").");
+                    }
+                    _ids[row * _n_inputs + input] = static_cast<int>(id);
+                }
+            }
+
+            out.resize(rows, _n_inputs * _n_dims);
+            for (Eigen::Index row = 0; row < rows; ++row)
+            {
+                for (int input = 0; input < _n_inputs; ++input)
+                {
+                    out.block(row, input * _n_dims, 1, _n_dims) = _table.row(_ids[row * _n_inputs + input]);
+                }
+            }
+        }
+
+        /**
+         * @brief Backward pass of the embedding layer
+         *
+         * @details Sums the output gradient of every occurrence of an id into one row per distinct id, see rows() and drows(). Ids have
+         * no gradient, out is left empty.
+         *
+         * @param[out] out Input gradient, always empty
+         * @param[in] dx Output gradient
+         */
+        void backward(Eigen::MatrixXd &out, const Eigen::MatrixXd &dx)
+        {
+            _rows = _ids;
+            std::sort(_rows.begin(), _rows.end());
+            _rows.erase(std::unique(_rows.begin(), _rows.end()), _rows.end());
+
+            _drows.setZero(_rows.size(), _n_dims);
+            for (Eigen::Index row = 0; row < dx.rows(); ++row)
+            {
+                for (int input = 0; input < _n_inputs; ++input)
+                {
+                    int id = _ids[row * _n_inputs + input];
+                    Eigen::Index k = std::lower_bound(_rows.begin(), _rows.end(), id) - _rows.begin();
+                    _drows.row(k) += dx.block(row, input * _n_dims, 1, _n_dims);
+                }
+            }
+
+            out.resize(0, 0);
+        }
+
+        /**
+         * @brief Adds an update to the rows touched by the last backward pass
+         *
+         * @param[in] update Update of every row of rows(), in the same order
+         */
+        void update_rows(const Eigen::MatrixXd &update)
+        {
+            for (size_t k = 0; k < _rows.size(); ++k)
+            {
+                _table.row(_rows[k]) += update.row(k);
+            }
+            _version++;
+        }
+
+        /**
+         * @brief Get the table
+         *
+         * @return Eigen::MatrixXd& Table, one embedding per row
+         */
+        const Eigen::MatrixXd &table() const
+        {
+            return _table;
+        }
+
+        /**
+         * @brief Set's the table of the embedding layer
+         *
+         * @param[in] table New table, must have the shape of the initial table
+         *
+         * @throws std::invalid_argument if the shape of the new table does not match the shape of the initial table.
+         */
+        void table(const Eigen::MatrixXd &table)
+        {
+            if (_table.rows() != table.rows() || _table.cols() != table.cols())
+            {
+                LOG_ERROR("Shape of new matrix does not match to initial's matrix shape.");
+                throw std::invalid_argument("Shape of new matrix does not match to initial's matrix shape.");
+            }
+            _table = table;
+            _version++;
+        }
+
+        /**
+         * @brief Get the distinct ids of the last backward pass, in increasing order
+         *
+         * @return std::vector<int>& Ids
+         */
+        const std::vector<int> &rows() const
+        {
+            return _rows;
+        }
+
+        /**
+         * @brief Get the gradient of the rows of rows()
+         *
+         * @return Eigen::MatrixXd& Gradients, one row per id of rows()
+         */
+        const Eigen::MatrixXd &drows() const
+        {
+            return _drows;
+        }
+
+        /**
+         * @brief Get the optimizer state of the table for in-place row updates
+         *
+         * @details The state is allocated on first use, so optimizers without state (e.g. SGD without momentum) never pay for it.
+         *
+         * @return Eigen::MatrixXd& Optimizer matrix, same shape as the table
+         */
+        Eigen::MatrixXd &table_optimizer()
+        {
+            if (_table_optimizer.size() == 0)
+            {
+                Memory::resize(_table_optimizer, _n_ids, _n_dims);
+                _table_optimizer.setZero();
+            }
+            return _table_optimizer;
+        }
+
+        /**
+         * @brief Get the optimizer state of the table
+         *
+         * @return Eigen::MatrixXd& Optimizer matrix, empty if no optimizer used it yet
+         */
+        const Eigen::MatrixXd &table_optimizer() const
+        {
+            return _table_optimizer;
+        }
+
+        /**
+         * @brief Set's the optimizer state of the table
+         *
+         * @param toptimizer New optimizer matrix, empty or of the shape of the table
+         */
+        void table_optimizer(const Eigen::MatrixXd &toptimizer)
+        {
+            _table_optimizer = toptimizer;
+        }
+
+        /**
+         * @brief Get the additional optimizer state of the table for in-place row updates
+         *
+         * @details Allocated on first use like table_optimizer().
+         *
+         * @return Eigen::MatrixXd& Additional optimizer matrix, same shape as the table
+         */
+        Eigen::MatrixXd &table_optimizer_additional()
+        {
+            if (_table_optimizer_additional.size() == 0)
+            {
+                Memory::resize(_table_optimizer_additional, _n_ids, _n_dims);
+                _table_optimizer_additional.setZero();
+            }
+            return _table_optimizer_additional;
+        }
+
+        /**
+         * @brief Get the additional optimizer state of the table
+         *
+         * @return Eigen::MatrixXd& Additional optimizer matrix, empty if no optimizer used it yet
+         */
+        const Eigen::MatrixXd &table_optimizer_additional() const
+        {
+            return _table_optimizer_additional;
+        }
+
+        /**
+         * @brief Set's the additional optimizer state of the table
+         *
+         * @param toptimizer New additional optimizer matrix, empty or of the shape of the table
+         */
+        void table_optimizer_additional(const Eigen::MatrixXd &toptimizer)
+        {
+            _table_optimizer_additional = toptimizer;
+        }
+
+        /**
+         * @brief Get the parameter version of the embedding layer
+         *
+         * @details Increased every time the table is replaced or updated.
+         *
+         * @return uint64_t Parameter version
+         */
+        uint64_t version() const
+        {
+            return _version;
+        }
+
+        /**
+         * @brief Calculates the number of trainable parameters of the embedding layer
+         *
+         * @return int Number of parameters
+         */
+        int parameters() const
+        {
+            return _n_ids * _n_dims;
+        }
+
+        /**
+         * @brief Gives the shape of the embedding table
+         *
+         * @param[out] n_ids Number of rows of the table
+         * @param[out] n_dims Dimension of every embedding
+         * @param[out] n_inputs Number of ids per sample
+         */
+        void shape(int &n_ids, int &n_dims, int &n_inputs) const
+        {
+            n_ids = _n_ids;
+            n_dims = _n_dims;
+            n_inputs = _n_inputs;
+        }
+
+    private:
+        int _n_ids;    // Number of rows of the table
+        int _n_dims;   // Dimension of every embedding
+        int _n_inputs; // Number of ids per sample
+
+        Eigen::MatrixXd _table; // Embedding table
+
+        Eigen::MatrixXd _table_optimizer;            // Table optimizer matrix, allocated on first use
+        Eigen::MatrixXd _table_optimizer_additional; // Additional table optimizer matrix, allocated on first use
+
+        std::vector<int> _ids;  // Ids of the last forward pass, row-major
+        std::vector<int> _rows; // Distinct ids of the last backward pass
+        Eigen::MatrixXd _drows; // Gradient of every row of _rows
+
+        uint64_t _version = 0; // Parameter version, increased on every table update
+    };
+} // namespace NNFS
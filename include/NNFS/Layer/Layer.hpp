@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <Eigen/Dense>
 #include "../Utilities/clue.hpp"
 
@@ -11,7 +12,9 @@ namespace NNFS
     enum class LayerType
     {
         DENSE,
-        ACTIVATION
+        ACTIVATION,
+        EMBEDDING,
+        AFFINE
     };
 
     /**
@@ -26,9 +26,9 @@ namespace NNFS
          */
         void forward(Eigen::MatrixXd &sample_losses, const Eigen::MatrixXd &predictions, const Eigen::MatrixXd &labels) const
         {
-            Eigen::MatrixXd clipped_predictions = predictions.array().max(1e-7).min(1 - 1e-7); // clip data to prevent division by zero
-            Eigen::MatrixXd correct_confidences = (labels.array() * clipped_predictions.array()).rowwise().sum();
-            sample_losses = -(correct_confidences.array().log());
+            // Clip data to prevent division by zero, evaluated lazily so no temporary is allocated
+            auto clipped_predictions = predictions.array().max(1e-7).min(1 - 1e-7);
+            sample_losses = -(labels.array() * clipped_predictions).rowwise().sum().log();
         }
 
         /**
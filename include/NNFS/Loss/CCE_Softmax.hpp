@@ -30,11 +30,10 @@ namespace NNFS
          */
         void forward(Eigen::MatrixXd &sample_losses, const Eigen::MatrixXd &predictions, const Eigen::MatrixXd &labels) const
         {
-            Eigen::MatrixXd out;
+            // The softmax output is computed straight into the buffer the softmax layer keeps for backward(), see softmax_out()
+            _softmax->equation(_softmax->_forward_output, predictions);
 
-            _softmax->forward(out, predictions);
-
-            _cce->forward(sample_losses, out, labels);
+            _cce->forward(sample_losses, _softmax->_forward_output, labels);
         }
 
         /**
@@ -46,21 +45,15 @@ namespace NNFS
          */
         void backward(Eigen::MatrixXd &out, const Eigen::MatrixXd &predictions, const Eigen::MatrixXd &labels) const
         {
-            Eigen::MatrixXd _predictions = softmax_out();
             int samples = predictions.rows();
 
-            Eigen::VectorXi class_labels(labels.rows());
-            for (int k = 0; k < labels.rows(); ++k)
-            {
-                labels.row(k).maxCoeff(&class_labels[k]);
-            };
-
-            out = _predictions;
+            out = softmax_out();
 
             // Calculate gradient
             for (int i = 0; i < samples; i++)
             {
-                int index = class_labels(i);
+                Eigen::Index index;
+                labels.row(i).maxCoeff(&index);
                 out(i, index) -= 1;
             }
 
@@ -81,6 +74,5 @@ namespace NNFS
     private:
         std::shared_ptr<Softmax> _softmax; // Softmax activation layer
         std::shared_ptr<CCE> _cce;         // Cross-entropy loss function
-        Eigen::MatrixXd _softmax_out;      // Softmax output
     };
 } // namespace NNFS
@@ -65,9 +65,8 @@ namespace NNFS
          */
         void calculate(double &loss, const Eigen::MatrixXd &predictions, const Eigen::MatrixXd &labels)
         {
-            Eigen::MatrixXd sample_losses;
-            forward(sample_losses, predictions, labels);
-            loss = sample_losses.mean();
+            forward(_sample_losses, predictions, labels);
+            loss = _sample_losses.mean();
         }
 
         /**
@@ -107,5 +106,8 @@ namespace NNFS
 
             return regularization_loss;
         }
+
+    private:
+        Eigen::MatrixXd _sample_losses; // Per-sample losses of calculate(), kept to reuse the storage
     };
 } // namespace NNFS
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "NeuralNetwork.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Ahead-of-time code generator, turns a trained network into a standalone C++ translation unit
+     *
+     * @details The generated file depends only on <math.h>. The parameters of the optimized inference plan (see
+     * NeuralNetwork::inference_layers()) are emitted as one constexpr array: for every dense layer the weights, input-major, followed by
+     * the biases, each layer aligned to 64 bytes. Every loop bound is a literal, and layers with at most unroll_inputs inputs are unrolled
+     * into one expression per output, so the compiler keeps the accumulators in registers. For a network named spiral the file defines:
+     *
+     *     extern "C" const int spiral_inputs, spiral_outputs;
+     *     extern "C" void spiral_predict(const double *input, double *output);                 // One sample
+     *     extern "C" void spiral_predict_batch(const double *inputs, double *outputs, int rows); // Row-major samples
+     *
+     * Predictions match NeuralNetwork::predict(), including the softmax applied when the last layer is not an activation. Embedding
+     * layers are not supported. Activations always use the exact math functions, whatever their fast_math() setting.
+     */
+    class CodeGen
+    {
+    public:
+        static constexpr int unroll_inputs = 16; // Largest layer input that is unrolled
+
+    public:
+        /**
+         * @brief Writes the translation unit of a network
+         *
+         * @param[in] network Compiled network
+         * @param[out] out Stream receiving the source
+         * @param[in] name Prefix of the generated symbols, must be a C identifier
+         *
+         * @return bool True if the source was written, false if the network has a layer that cannot be generated or a non-finite
+         * parameter
+         */
+        static bool generate(NeuralNetwork &network, std::ostream &out, const std::string &name)
+        {
+            if (!identifier(name))
+            {
+                LOG_ERROR("Generated symbol prefix " << name << " is not a C identifier.");
+                return false;
+            }
+
+            int n_input, n_output;
+            network.shape(n_input, n_output);
+            if (network.layer_count() == 0 || n_input <= 0)
+            {
+                LOG_ERROR("Cannot generate code for a network that is not compiled.");
+                return false;
+            }
+
+            const std::vector<std::shared_ptr<Layer>> &layers = network.inference_layers();
+
+            // Parameters of every dense and affine layer, packed in layer order
+            std::vector<double> parameters;
+            std::vector<size_t> offsets;
+            int width = n_input;
+            int max_width = n_input;
+            for (const std::shared_ptr<Layer> &layer : layers)
+            {
+                if (layer->type == LayerType::DENSE)
+                {
+                    const Dense &dense = static_cast<const Dense &>(*layer);
+                    int layer_input, layer_output;
+                    dense.shape(layer_input, layer_output);
+
+                    // 64-byte alignment of every layer, 8 doubles
+                    parameters.resize((parameters.size() + 7) / 8 * 8, 0.);
+                    offsets.push_back(parameters.size());
+                    for (int i = 0; i < layer_input; ++i)
+                    {
+                        for (int j = 0; j < layer_output; ++j)
+                        {
+                            parameters.push_back(dense.weights()(i, j));
+                        }
+                    }
+                    for (int j = 0; j < layer_output; ++j)
+                    {
+                        parameters.push_back(dense.biases()(0, j));
+                    }
+                    width = layer_output;
+                }
+                else if (layer->type == LayerType::AFFINE)
+                {
+                    const Affine &affine = static_cast<const Affine &>(*layer);
+                    parameters.resize((parameters.size() + 7) / 8 * 8, 0.);
+                    offsets.push_back(parameters.size());
+                    parameters.insert(parameters.end(), affine.scale().data(), affine.scale().data() + affine.size());
+                    parameters.insert(parameters.end(), affine.shift().data(), affine.shift().data() + affine.size());
+                }
+                else if (layer->type != LayerType::ACTIVATION)
+                {
+                    LOG_ERROR("Code generation only supports dense, affine and activation layers.");
+                    return false;
+                }
+                max_width = std::max(max_width, width);
+            }
+
+            // nan and inf have no C++ literal, and a network holding them predicts nothing useful anyway
+            if (!std::all_of(parameters.begin(), parameters.end(), [](double value)
+                             { return std::isfinite(value); }))
+            {
+                LOG_ERROR("Cannot generate code for a network with non-finite parameters.");
+                return false;
+            }
+
+            out << "// Generated by NNFS::CodeGen from a " << n_input << " -> " << n_output << " network, do not edit.\n"
+                << "#include <math.h>\n\n"
+                << "namespace\n{\n"
+                << "    alignas(64) constexpr double parameters[" << std::max<size_t>(parameters.size(), 1) << "] = {";
+            for (size_t i = 0; i < parameters.size(); ++i)
+            {
+                out << (i % 4 == 0 ? "\n        " : " ") << number(parameters[i]) << ",";
+            }
+            if (parameters.empty())
+            {
+                out << "0.";
+            }
+            out << "\n    };\n\n";
+
+            // Softmax over a row, also used when the last layer is not an activation
+            out << "    template <int N>\n"
+                << "    inline void softmax(const double *x, double *y)\n"
+                << "    {\n"
+                << "        double max = x[0];\n"
+                << "        for (int j = 1; j < N; ++j)\n"
+                << "            max = x[j] > max ? x[j] : max;\n"
+                << "        double sum = 0.;\n"
+                << "        for (int j = 0; j < N; ++j)\n"
+                << "            sum += (y[j] = exp(x[j] - max));\n"
+                << "        for (int j = 0; j < N; ++j)\n"
+                << "            y[j] /= sum;\n"
+                << "    }\n\n";
+
+            // Forward pass, alternating between two buffers, the first layer reads the input directly
+            out << "    inline void forward(const double *input, double *output)\n"
+                << "    {\n"
+                << "        alignas(64) double a[" << max_width << "];\n"
+                << "        alignas(64) double b[" << max_width << "];\n"
+                << "        (void)a;\n"
+                << "        (void)b;\n";
+
+            std::string x = "input";
+            width = n_input;
+            size_t parameter_layer = 0;
+            for (const std::shared_ptr<Layer> &layer : layers)
+            {
+                std::string y = x == "a" ? "b" : "a";
+                if (layer->type == LayerType::DENSE)
+                {
+                    const Dense &dense = static_cast<const Dense &>(*layer);
+                    int layer_input, layer_output;
+                    dense.shape(layer_input, layer_output);
+                    size_t weights = offsets[parameter_layer++];
+                    size_t biases = weights + static_cast<size_t>(layer_input) * layer_output;
+
+                    out << "\n        // Dense " << layer_input << " x " << layer_output << "\n";
+                    if (layer_input <= unroll_inputs)
+                    {
+                        out << "        for (int j = 0; j < " << layer_output << "; ++j)\n"
+                            << "            " << y << "[j] = parameters[" << biases << " + j]";
+                        for (int i = 0; i < layer_input; ++i)
+                        {
+                            out << "\n                 + " << x << "[" << i << "] * parameters[" << weights + static_cast<size_t>(i) * layer_output << " + j]";
+                        }
+                        out << ";\n";
+                    }
+                    else
+                    {
+                        out << "        for (int j = 0; j < " << layer_output << "; ++j)\n"
+                            << "            " << y << "[j] = parameters[" << biases << " + j];\n"
+                            << "        for (int i = 0; i < " << layer_input << "; ++i)\n"
+                            << "            for (int j = 0; j < " << layer_output << "; ++j)\n"
+                            << "                " << y << "[j] += " << x << "[i] * parameters[" << weights << " + i * " << layer_output << " + j];\n";
+                    }
+                    x = y;
+                    width = layer_output;
+
+                    if (dense.fused_activation() != ActivationType::NONE)
+                    {
+                        activation(out, dense.fused_activation(), width, x, x);
+                    }
+                }
+                else if (layer->type == LayerType::AFFINE)
+                {
+                    size_t scale = offsets[parameter_layer++];
+                    out << "\n        // Affine " << width << "\n"
+                        << "        for (int j = 0; j < " << width << "; ++j)\n"
+                        << "            " << y << "[j] = " << x << "[j] * parameters[" << scale << " + j] + parameters[" << scale + width << " + j];\n";
+                    x = y;
+                }
+                else
+                {
+                    // Activations work in place, unless they would overwrite the input
+                    y = x == "input" ? "a" : x;
+                    activation(out, static_cast<const Activation &>(*layer).activation_type, width, x, y);
+                    x = y;
+                }
+            }
+
+            if (network.layer(network.layer_count() - 1)->type != LayerType::ACTIVATION)
+            {
+                out << "\n        // Softmax of the raw scores, like NeuralNetwork::predict()\n"
+                    << "        softmax<" << width << ">(" << x << ", output);\n";
+            }
+            else
+            {
+                out << "\n        for (int j = 0; j < " << n_output << "; ++j)\n"
+                    << "            output[j] = " << x << "[j];\n";
+            }
+            out << "    }\n"
+                << "} // namespace\n\n";
+
+            out << "extern \"C\" const int " << name << "_inputs = " << n_input << ";\n"
+                << "extern \"C\" const int " << name << "_outputs = " << n_output << ";\n\n"
+                << "extern \"C\" void " << name << "_predict(const double *input, double *output)\n"
+                << "{\n"
+                << "    forward(input, output);\n"
+                << "}\n\n"
+                << "extern \"C\" void " << name << "_predict_batch(const double *inputs, double *outputs, int rows)\n"
+                << "{\n"
+                << "    for (int r = 0; r < rows; ++r)\n"
+                << "        forward(inputs + r * " << n_input << ", outputs + r * " << n_output << ");\n"
+                << "}\n";
+
+            return out.good();
+        }
+
+    private:
+        /**
+         * @brief Writes an activation from buffer x to buffer y, which may be the same
+         */
+        static void activation(std::ostream &out, ActivationType type, int width, const std::string &x, const std::string &y)
+        {
+            out << "\n";
+            switch (type)
+            {
+            case ActivationType::RELU:
+                out << "        for (int j = 0; j < " << width << "; ++j)\n"
+                    << "            " << y << "[j] = " << x << "[j] > 0. ? " << x << "[j] : 0.;\n";
+                break;
+            case ActivationType::SIGMOID:
+                out << "        for (int j = 0; j < " << width << "; ++j)\n"
+                    << "            " << y << "[j] = 1. / (1. + exp(-" << x << "[j]));\n";
+                break;
+            case ActivationType::TANH:
+                out << "        for (int j = 0; j < " << width << "; ++j)\n"
+                    << "            " << y << "[j] = tanh(" << x << "[j]);\n";
+                break;
+            default:
+                out << "        softmax<" << width << ">(" << x << ", " << y << ");\n";
+                break;
+            }
+        }
+
+        /**
+         * @brief Formats a double so that it reads back exactly
+         */
+        static std::string number(double value)
+        {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+            std::string text = buffer;
+            if (text.find_first_of(".eEn") == std::string::npos)
+            {
+                text += ".";
+            }
+            return text;
+        }
+
+        /**
+         * @brief Whether a string is a valid C identifier
+         */
+        static bool identifier(const std::string &name)
+        {
+            if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+            {
+                return false;
+            }
+            for (char c : name)
+            {
+                if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+} // namespace NNFS
@@ -1,14 +1,22 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <random>
 #include <tuple>
 #include <vector>
 #include <chrono>
+#include <type_traits>
+#include <unordered_map>
 
 #include "Model.hpp"
+#include "PredictionCache.hpp"
+#include "Profiler.hpp"
 #include "../Layer/Layer.hpp"
 #include "../Layer/Dense.hpp"
+#include "../Layer/Embedding.hpp"
+#include "../Layer/Affine.hpp"
 
 #include "../Activation/Activation.hpp"
 #include "../Activation/ReLU.hpp"
@@ -22,6 +30,7 @@
 #include "../Metrics/Metrics.hpp"
 
 #include "../Optimizer/Optimizer.hpp"
+#include "../Utilities/Threading.hpp"
 
 namespace NNFS
 {
@@ -35,6 +44,13 @@ namespace NNFS
      */
     class NeuralNetwork : public Model
     {
+    public:
+        using CompactExamples = Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>; // Examples stored as bytes, one per row
+        using SparseExamples = Dense::SparseInput;                                                        // Examples stored in CSR form, one per row
+
+        template <typename Derived>
+        using IfCompact = typename std::enable_if<std::is_same<typename Derived::Scalar, uint8_t>::value, int>::type; // Selects the compact overloads
+
     public:
         /**
          * @brief Constructor for NeuralNetwork
@@ -46,7 +62,9 @@ namespace NNFS
             std::shared_ptr<Loss> loss = nullptr, std::shared_ptr<Optimizer> optimizer = nullptr)
             : loss_object(loss),
               optimizer_object(optimizer),
-              num_layers(0) {}
+              num_layers(0),
+              input_dim(-1),
+              output_dim(-1) {}
 
         /**
          * @brief Fit the neural network model to the given data
@@ -94,97 +112,158 @@ namespace NNFS
                 return;
             }
 
-            int num_examples = examples.rows();
-            int num_batches = num_examples / batch_size;
-            int batches_num_length = std::to_string(num_batches).length();
-
-            for (int epoch = 1; epoch <= epochs; ++epoch)
-            {
-                std::cout << "Epoch " << epoch << "/" << epochs << std::endl;
-
-                double total_loss = 0;
-                double total_data_loss = 0;
-                double total_reg_loss = 0;
-                int batch_time_total = 0;
-
-                auto time_start = std::chrono::high_resolution_clock::now();
-
-                for (int i = 0; i < num_batches; ++i)
+            train<Eigen::MatrixXd>(
+                examples.rows(), epochs, batch_size, verbose,
+                [&](int start, int count, Eigen::MatrixXd &batch_examples, Eigen::MatrixXd &batch_labels)
                 {
-                    auto batch_time_start = std::chrono::high_resolution_clock::now();
-                    double batch_loss = 0;
-                    double data_loss = 0;
-                    double reg_loss = 0;
-                    int start = i * batch_size;
-                    int end = std::min(start + batch_size, num_examples);
-
-                    Eigen::MatrixXd batch_examples = examples.middleRows(start, end - start);
-                    Eigen::MatrixXd batch_labels = labels.middleRows(start, end - start);
-
-                    forward(batch_examples);
-
-                    loss_object->calculate(data_loss, batch_examples, batch_labels);
-
-                    regularization_loss(reg_loss);
-
-                    optimizer_object->pre_update_params();
-                    backward(batch_examples, batch_labels);
-                    optimizer_object->post_update_params();
-
-                    if (verbose)
-                    {
-                        batch_loss = data_loss + reg_loss;
-                        total_loss += batch_loss;
-
-                        total_data_loss += data_loss;
-                        total_reg_loss += reg_loss;
-
-                        std::cout << " - " << std::setw(batches_num_length) << i + 1;
-                        std::cout << '/' << num_batches;
+                    batch_examples = examples.middleRows(start, count);
+                    batch_labels = labels.middleRows(start, count);
+                },
+                [&](Eigen::MatrixXd &batch_examples, Eigen::MatrixXd &batch_output)
+                {
+                    forward(batch_output, batch_examples);
+                },
+                [&](double &train_accuracy, double &test_accuracy)
+                {
+                    accuracy(train_accuracy, examples, labels);
+                    accuracy(test_accuracy, test_examples, test_labels);
+                });
+        }
 
-                        progressbar(num_batches, i, 50);
+        /**
+         * @brief Fit the neural network model to data stored in its compact form
+         *
+         * @details Examples stay as bytes (e.g. image pixels) and labels as class ids for the whole training run, only the current batch
+         * is scaled into a double buffer and one-hot encoded. This keeps the resident dataset 8x smaller than the double matrices taken by
+         * the other overload and lets the examples be views into a memory-mapped NNFS::PackedDataset.
+         *
+         * @param[in] examples Examples to evaluate the model on, one per row
+         * @param[in] labels Class ids of the examples, in [0, output dimension)
+         * @param[in] test_examples Examples to validate the model on, one per row
+         * @param[in] test_labels Class ids of the validation examples
+         * @param[in] epochs The number of epochs to train for
+         * @param[in] batch_size The batch size, i.e. the number of examples to train on in each batch
+         * @param[in] verbose Whether to print out information about the training process
+         * @param[in] scale Factor applied to every example byte (default: 1/255)
+         */
+        template <typename Examples, typename TestExamples, IfCompact<Examples> = 0, IfCompact<TestExamples> = 0>
+        void fit(const Eigen::DenseBase<Examples> &examples,
+                 const Eigen::Ref<const Eigen::VectorXi> &labels,
+                 const Eigen::DenseBase<TestExamples> &test_examples,
+                 const Eigen::Ref<const Eigen::VectorXi> &test_labels,
+                 int epochs,
+                 int batch_size,
+                 bool verbose = true,
+                 double scale = 1. / 255.)
+        {
+            fit_compact(examples.derived(), labels, test_examples.derived(), test_labels, epochs, batch_size, verbose, scale);
+        }
 
-                        auto batch_time_end = std::chrono::high_resolution_clock::now();
+        /**
+         * @brief Fit the neural network model to sparse data
+         *
+         * @details Examples stay in CSR form for the whole training run and every batch is fed to the first layer as a sparse matrix, see
+         * Dense::forward(). Intended for bag-of-words or one-hot inputs such as the ones read by NNFS::LibSVM, which would not fit in
+         * memory as dense matrices. The first layer must be a dense layer.
+         *
+         * @param[in] examples Examples to evaluate the model on, one per row
+         * @param[in] labels Class ids of the examples, in [0, output dimension)
+         * @param[in] test_examples Examples to validate the model on, one per row
+         * @param[in] test_labels Class ids of the validation examples
+         * @param[in] epochs The number of epochs to train for
+         * @param[in] batch_size The batch size, i.e. the number of examples to train on in each batch
+         * @param[in] verbose Whether to print out information about the training process
+         */
+        void fit(const SparseExamples &examples,
+                 const Eigen::Ref<const Eigen::VectorXi> &labels,
+                 const SparseExamples &test_examples,
+                 const Eigen::Ref<const Eigen::VectorXi> &test_labels,
+                 int epochs,
+                 int batch_size,
+                 bool verbose = true)
+        {
+            if (loss_object == nullptr || optimizer_object == nullptr)
+            {
+                LOG_ERROR("Training is not possible for this neural network object as the loss and optimizer have not been specified.");
+                return;
+            }
 
-                        auto running = std::chrono::duration_cast<std::chrono::seconds>(batch_time_end - time_start);
-                        auto batch_time = std::chrono::duration_cast<std::chrono::milliseconds>(batch_time_end - batch_time_start);
+            if (!compiled)
+            {
+                LOG_ERROR("Please compile the neural network object before attempting to train it.");
+                return;
+            }
 
-                        batch_time_total += batch_time.count();
+            if (layers[0]->type != LayerType::DENSE)
+            {
+                LOG_ERROR("Training on sparse examples requires a dense first layer.");
+                return;
+            }
 
-                        std::cout << "- " << std::setw(4) << running.count();
-                        std::cout << "s";
+            if (examples.cols() != input_dim || test_examples.cols() != input_dim)
+            {
+                LOG_ERROR("The number of columns in the examples matrix must match the input dimension of the neural network.");
+                return;
+            }
 
-                        if (i + 1 != num_batches)
-                        {
-                            std::cout << "\r";
-                            std::cout.flush();
-                        }
-                    }
-                }
+            if (!valid_class_ids(labels, examples.rows()) || !valid_class_ids(test_labels, test_examples.rows()))
+            {
+                LOG_ERROR("There must be one label per example and every label must be a class id below the output dimension of the neural network.");
+                return;
+            }
 
-                if (verbose)
+            train<SparseExamples>(
+                examples.rows(), epochs, batch_size, verbose,
+                [&](int start, int count, SparseExamples &batch_examples, Eigen::MatrixXd &batch_labels)
+                {
+                    batch_examples = examples.middleRows(start, count);
+                    onehot_batch(labels, start, count, batch_labels);
+                },
+                [&](SparseExamples &batch_examples, Eigen::MatrixXd &batch_output)
+                {
+                    forward(batch_output, batch_examples);
+                },
+                [&](double &train_accuracy, double &test_accuracy)
                 {
-                    double train_accuracy = 0;
-                    double test_accuracy = 0;
-
                     accuracy(train_accuracy, examples, labels);
                     accuracy(test_accuracy, test_examples, test_labels);
+                });
+        }
 
-                    batch_time_total /= num_batches;
-                    total_loss /= num_batches;
-                    total_data_loss /= num_batches;
-                    total_reg_loss /= num_batches;
+        /**
+         * @brief Runs one training step on a batch: forward pass, loss, backward pass and parameter update
+         *
+         * @details fit() runs the same step on every batch. The layers, the loss and the optimizer keep their buffers between steps, so
+         * once a batch of the same shape went through the network a step does not allocate memory, see tests/test_allocations.cpp. The
+         * exception are built-in products large enough to be split over Threading::intra_op(), which queue a few tasks.
+         *
+         * @param[out] data_loss Data loss of the batch
+         * @param[out] reg_loss Regularization loss of the network
+         * @param[in] examples Examples of the batch
+         * @param[in] labels One-hot labels of the batch
+         */
+        void train_on_batch(double &data_loss, double &reg_loss, const Eigen::MatrixXd &examples, const Eigen::MatrixXd &labels)
+        {
+            if (loss_object == nullptr || optimizer_object == nullptr)
+            {
+                LOG_ERROR("Training is not possible for this neural network object as the loss and optimizer have not been specified.");
+                return;
+            }
 
-                    double current_lr = optimizer_object->current_lr();
+            if (!compiled)
+            {
+                LOG_ERROR("Please compile the neural network object before attempting to train it.");
+                return;
+            }
 
-                    std::cout << " - " << batch_time_total << "ms/batch"
-                              << " - loss: " << std::fixed << std::setprecision(3) << total_loss
-                              << " ( data: " << total_data_loss << ", reg: " << total_reg_loss
-                              << " ) - train_accuracy: " << train_accuracy << " - test_accuracy: " << test_accuracy
-                              << " - lr: " << current_lr
-                              << std::endl;
-                }
+            if (examples.cols() != input_dim || labels.cols() != output_dim || labels.rows() != examples.rows())
+            {
+                LOG_ERROR("The examples and labels must have one row per example and match the input and output dimensions of the neural network.");
+                return;
             }
+
+            forward(step_output, examples);
+            step(data_loss, reg_loss, step_output, labels);
         }
 
         /**
@@ -204,10 +283,27 @@ namespace NNFS
          * @brief Compiles the neural network model
          *
          * @details This method compiles the neural network model by initializing the weights and biases of the layers and setting the input and output dimensions of each layer.
+         * Every dense layer followed by a ReLU, sigmoid or tanh activation runs that activation itself (see Dense::fuse()) and the
+         * activation layer is left out of the forward and backward passes. Compile again after changing the fast math setting of a fused
+         * activation.
+         *
+         * Predictions run a separate inference plan, built on first use and rebuilt whenever the parameters change. Consecutive dense
+         * layers without a nonlinearity between them are merged into one when that does not increase the number of multiplications,
+         * affine layers (input normalization, batch normalization) are folded into the adjacent dense layers and no-op layers (identity
+         * affine layers, a ReLU after a ReLU) are dropped. The plan is checked against the unoptimized network on random inputs and
+         * discarded if the outputs differ. Training always runs the layers as added.
+         *
+         * @param[in] fuse Whether to fuse activations into the preceding dense layers (default: true)
+         * @param[in] optimize Whether predictions run the optimized inference plan (default: true)
          */
-        void compile()
+        void compile(bool fuse = true, bool optimize = true)
         {
             compiled = false;
+            plan.clear();
+            inference.clear();
+            fuse_activations = fuse;
+            optimize_inference = optimize;
+            structure_version++;
             input_dim = -1;
             output_dim = -1;
 
@@ -251,8 +347,40 @@ namespace NNFS
                         return;
                     }
 
+                    // A ReLU zeroes the gradient wherever its output is zero, the dense layer does not need to compute it there
+                    dense_layer->masked_input_gradient(i > 0 && layers[i - 1]->type == LayerType::ACTIVATION &&
+                                                       std::static_pointer_cast<Activation>(layers[i - 1])->activation_type == ActivationType::RELU);
+
                     prev_out = cur_output;
                 }
+                else if (cur_type == LayerType::EMBEDDING)
+                {
+                    if (i != 0)
+                    {
+                        LOG_ERROR("An embedding layer detected in NNFS::compile() is not the first layer. Embedding layers take ids as input and must come first.");
+                        return;
+                    }
+
+                    std::shared_ptr<Embedding> embedding_layer = std::static_pointer_cast<Embedding>(layers[i]);
+
+                    int n_ids;
+                    int n_dims;
+                    int n_inputs;
+                    embedding_layer->shape(n_ids, n_dims, n_inputs);
+
+                    prev_out = n_inputs * n_dims;
+                }
+                else if (cur_type == LayerType::AFFINE)
+                {
+                    int size = std::static_pointer_cast<Affine>(layers[i])->size();
+                    if (prev_out != -1 && size != prev_out)
+                    {
+                        LOG_ERROR("Shape mismatch detected in NNFS::compile(). Previous layer output shape (" << prev_out << ") does not match affine layer shape (" << size << ").");
+                        return;
+                    }
+
+                    prev_out = size;
+                }
                 else
                 {
                     LOG_ERROR("Unknown layer type detected in NNFS::compile(). Please ensure that all layers in your neural network have a valid layer type and that the NNFS library supports the specified type.");
@@ -283,8 +411,56 @@ namespace NNFS
 
                     output_dim = cur_output;
                 }
+                else if (cur_type == LayerType::EMBEDDING)
+                {
+                    std::shared_ptr<Embedding> embedding_layer = std::static_pointer_cast<Embedding>(layers[i]);
+
+                    int n_ids;
+                    int n_dims;
+                    int n_inputs;
+                    embedding_layer->shape(n_ids, n_dims, n_inputs);
+
+                    input_dim = n_inputs;
+                    output_dim = n_inputs * n_dims;
+                }
+                else if (cur_type == LayerType::AFFINE)
+                {
+                    int size = std::static_pointer_cast<Affine>(layers[i])->size();
+                    if (input_dim == -1)
+                    {
+                        input_dim = size;
+                    }
+
+                    output_dim = size;
+                }
+            }
+
+            for (int i = 0; i < num_layers; i++)
+            {
+                plan.push_back(layers[i]);
+                if (layers[i]->type != LayerType::DENSE)
+                {
+                    continue;
+                }
+
+                std::shared_ptr<Dense> dense_layer = std::static_pointer_cast<Dense>(layers[i]);
+                dense_layer->fuse(ActivationType::NONE);
+
+                ActivationType activation;
+                bool fast_math;
+                if (fuse && i + 1 < num_layers && fusable(layers[i + 1], activation, fast_math))
+                {
+                    dense_layer->fuse(activation, fast_math);
+                    i++;
+                }
             }
 
+            layer_outputs.assign(plan.size(), Eigen::MatrixXd());
+            layer_gradients.assign(plan.size() + 1, Eigen::MatrixXd());
+            if (profiler_object)
+            {
+                profiler_object->layers(plan, optimizer_object ? optimizer_object->state_matrices() : 0);
+            }
             compiled = true;
         }
 
@@ -361,6 +537,60 @@ namespace NNFS
                     ofs.write(reinterpret_cast<char *>(weights_optimizer_additional.data()), weights_optimizer_additional.size() * sizeof(double));
                     ofs.write(reinterpret_cast<char *>(biases_optimizer_additional.data()), biases_optimizer_additional.size() * sizeof(double));
                 }
+                else if (layer->type == LayerType::EMBEDDING)
+                {
+                    std::shared_ptr<Embedding> embedding_layer = std::static_pointer_cast<Embedding>(layers[i]);
+
+                    // Schema for embedding layer
+                    // - int type
+                    // - int n_ids
+                    // - int n_dims
+                    // - int n_inputs
+                    // - Eigen::MatrixXd table
+                    // - int table_optimizer rows (0 if unused), Eigen::MatrixXd table_optimizer
+                    // - int table_optimizer_additional rows (0 if unused), Eigen::MatrixXd table_optimizer_additional
+
+                    int type = static_cast<int>(layer->type);
+                    int n_ids;
+                    int n_dims;
+                    int n_inputs;
+                    embedding_layer->shape(n_ids, n_dims, n_inputs);
+
+                    ofs.write(reinterpret_cast<char *>(&type), sizeof(type));
+                    ofs.write(reinterpret_cast<char *>(&n_ids), sizeof(n_ids));
+                    ofs.write(reinterpret_cast<char *>(&n_dims), sizeof(n_dims));
+                    ofs.write(reinterpret_cast<char *>(&n_inputs), sizeof(n_inputs));
+
+                    const Eigen::MatrixXd &table = embedding_layer->table();
+                    ofs.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(double));
+
+                    // Optimizer state is only allocated once an optimizer needs it, the const accessors do not allocate it
+                    const Embedding &embedding = *embedding_layer;
+                    for (const Eigen::MatrixXd *state : {&embedding.table_optimizer(), &embedding.table_optimizer_additional()})
+                    {
+                        int rows = static_cast<int>(state->rows());
+                        ofs.write(reinterpret_cast<char *>(&rows), sizeof(rows));
+                        ofs.write(reinterpret_cast<const char *>(state->data()), state->size() * sizeof(double));
+                    }
+                }
+                else if (layer->type == LayerType::AFFINE)
+                {
+                    std::shared_ptr<Affine> affine_layer = std::static_pointer_cast<Affine>(layers[i]);
+
+                    // Schema for affine layer
+                    // - int type
+                    // - int size
+                    // - Eigen::RowVectorXd scale
+                    // - Eigen::RowVectorXd shift
+
+                    int type = static_cast<int>(layer->type);
+                    int size = affine_layer->size();
+
+                    ofs.write(reinterpret_cast<char *>(&type), sizeof(type));
+                    ofs.write(reinterpret_cast<char *>(&size), sizeof(size));
+                    ofs.write(reinterpret_cast<const char *>(affine_layer->scale().data()), size * sizeof(double));
+                    ofs.write(reinterpret_cast<const char *>(affine_layer->shift().data()), size * sizeof(double));
+                }
                 else if (layer->type == LayerType::ACTIVATION)
                 {
                     std::shared_ptr<Activation> activation_layer = reinterpret_cast<const std::shared_ptr<Activation> &>(layers[i]);
@@ -472,6 +702,49 @@ namespace NNFS
                     // Add dense layer to layers
                     layers.push_back(dense_layer);
                 }
+                else if (type == static_cast<int>(LayerType::EMBEDDING))
+                {
+                    // Read table shape
+                    int n_ids;
+                    int n_dims;
+                    int n_inputs;
+                    ifs.read(reinterpret_cast<char *>(&n_ids), sizeof(n_ids));
+                    ifs.read(reinterpret_cast<char *>(&n_dims), sizeof(n_dims));
+                    ifs.read(reinterpret_cast<char *>(&n_inputs), sizeof(n_inputs));
+
+                    std::shared_ptr<Embedding> embedding_layer = std::make_shared<Embedding>(n_ids, n_dims, n_inputs);
+
+                    Eigen::MatrixXd table(n_ids, n_dims);
+                    ifs.read(reinterpret_cast<char *>(table.data()), table.size() * sizeof(double));
+                    embedding_layer->table(table);
+
+                    // Read optimizer state, empty if it was never used
+                    Eigen::MatrixXd state[2];
+                    for (Eigen::MatrixXd &matrix : state)
+                    {
+                        int rows;
+                        ifs.read(reinterpret_cast<char *>(&rows), sizeof(rows));
+                        matrix.resize(rows > 0 ? n_ids : 0, n_dims);
+                        ifs.read(reinterpret_cast<char *>(matrix.data()), matrix.size() * sizeof(double));
+                    }
+                    embedding_layer->table_optimizer(state[0]);
+                    embedding_layer->table_optimizer_additional(state[1]);
+
+                    // Add embedding layer to layers
+                    layers.push_back(embedding_layer);
+                }
+                else if (type == static_cast<int>(LayerType::AFFINE))
+                {
+                    int size;
+                    ifs.read(reinterpret_cast<char *>(&size), sizeof(size));
+
+                    Eigen::RowVectorXd scale(size);
+                    Eigen::RowVectorXd shift(size);
+                    ifs.read(reinterpret_cast<char *>(scale.data()), size * sizeof(double));
+                    ifs.read(reinterpret_cast<char *>(shift.data()), size * sizeof(double));
+
+                    layers.push_back(std::make_shared<Affine>(scale, shift));
+                }
                 else if (type == static_cast<int>(LayerType::ACTIVATION))
                 {
                     // Read activation type
@@ -563,74 +836,945 @@ namespace NNFS
         }
 
         /**
-         * @brief Predicts the class of the provided sample(s).
+         * @brief Calculates the accuracy of the neural network on data stored in its compact form
          *
-         * @param[in] sample Sample(s) to predict the class of.
+         * @details Examples are converted in chunks, so the full dataset is never expanded to doubles.
          *
-         * @return Predictions of the neural network for the provided sample(s).
+         * @param[out] accuracy The accuracy of the neural network
+         * @param[in] examples The examples to calculate the accuracy on, one per row
+         * @param[in] labels Class ids of the examples
+         * @param[in] scale Factor applied to every example byte (default: 1/255)
          */
-        Eigen::MatrixXd predict(const Eigen::MatrixXd &sample)
+        template <typename Examples, IfCompact<Examples> = 0>
+        void accuracy(double &accuracy, const Eigen::DenseBase<Examples> &examples, const Eigen::Ref<const Eigen::VectorXi> &labels, double scale = 1. / 255.)
         {
-            if (sample.cols() != input_dim)
+            accuracy_compact(accuracy, examples.derived(), labels, scale);
+        }
+
+        /**
+         * @brief Calculates the accuracy of the neural network on sparse data
+         *
+         * @param[out] accuracy The accuracy of the neural network
+         * @param[in] examples The examples to calculate the accuracy on, one per row
+         * @param[in] labels Class ids of the examples
+         */
+        void accuracy(double &accuracy, const SparseExamples &examples, const Eigen::Ref<const Eigen::VectorXi> &labels)
+        {
+            if (examples.cols() != input_dim || !valid_class_ids(labels, examples.rows()) || layers[0]->type != LayerType::DENSE)
             {
-                LOG_ERROR("Input dimension of the neural network does not match the dimension of the provided sample.");
-                return Eigen::MatrixXd::Zero(sample.rows(), sample.cols());
+                LOG_ERROR("Input and output dimensions of the neural network do not match the dimensions of the provided samples and labels.");
+                return;
             }
 
-            Eigen::MatrixXd prediction = sample;
-            forward(prediction);
+            const int chunk = 1024;
+            SparseExamples chunk_examples;
+            Eigen::MatrixXd predictions;
+            Eigen::VectorXi predicted_labels;
+            Eigen::Index correct = 0;
 
-            if (layers[layers.size() - 1]->type != LayerType::ACTIVATION) {
-                Softmax softmax = Softmax();
-                Eigen::MatrixXd prediction_softmax = prediction;
-                softmax.forward(prediction_softmax, prediction);
-                return prediction_softmax;
+            for (Eigen::Index start = 0; start < examples.rows(); start += chunk)
+            {
+                Eigen::Index count = std::min<Eigen::Index>(chunk, examples.rows() - start);
+                chunk_examples = examples.middleRows(start, count);
+                forward(predictions, chunk_examples);
+                Metrics::onehotdecode(predicted_labels, predictions);
+                correct += (predicted_labels.array() == labels.segment(start, count).array()).count();
             }
 
-            return prediction;
+            accuracy = examples.rows() > 0 ? static_cast<double>(correct) / examples.rows() : 0.;
         }
 
-    private:
         /**
-         * @brief Implements the forward pass of the neural network.
+         * @brief Predicts the class of the provided sample(s).
          *
-         * @param[in, out] x Input of the neural network. The output of the neural network is stored in this matrix.
+         * @details If a prediction cache is enabled, rows seen before are answered from the cache and only the remaining rows are run through the network.
+         *
+         * @param[in] sample Sample(s) to predict the class of.
+         *
+         * @return Predictions of the neural network for the provided sample(s).
          */
-        void forward(Eigen::MatrixXd &x) override
+        Eigen::MatrixXd predict(const Eigen::MatrixXd &sample)
         {
-            for (int i = 0; i < num_layers; i++)
-            {
-                layers[i]->forward(x, x);
-            }
+            return predict(sample, false);
         }
 
         /**
-         * @brief Implements the backward pass of the neural network.
+         * @brief Predicts the class of a single sample, reusing the work done for the previous one.
          *
-         * @details The backward pass of the neural network is implemented by first calculating the loss of the neural network and then propagating the loss backwards through the neural network.
+         * @details Intended for interactive use where successive samples differ in a few features only (e.g. a canvas being drawn on).
+         * The first dense layer updates its cached pre-activation with the changed features only, see Dense::forward_incremental().
+         * Falls back to predict() for batches or if the first layer is not a dense layer.
          *
-         * @param[in] predicted Predicted output of the neural network.
-         * @param[in] labels Labels of the provided examples.
+         * @param[in] sample Sample to predict the class of.
+         *
+         * @return Prediction of the neural network for the provided sample.
          */
-        void backward(Eigen::MatrixXd &predicted, const Eigen::MatrixXd &labels) override
+        Eigen::MatrixXd predict_incremental(const Eigen::MatrixXd &sample)
         {
-            Eigen::MatrixXd dx;
-            loss_object->backward(dx, predicted, labels);
+            return predict(sample, sample.rows() == 1 && num_layers > 0 && layers[0]->type == LayerType::DENSE);
+        }
 
-            for (int i = num_layers - 1; i >= 0; --i)
-            {
-                layers[i]->backward(dx, dx);
-            }
+        /**
+         * @brief Enables or disables the prediction cache.
+         *
+         * @details The cache keeps the predictions of the most recently seen input rows and is invalidated automatically whenever the weights of any dense layer change or the model is recompiled.
+         *
+         * @param[in] capacity Maximum number of cached rows, 0 disables the cache.
+         */
+        void prediction_cache(size_t capacity)
+        {
+            cache = capacity > 0 ? std::make_shared<PredictionCache>(capacity) : nullptr;
+        }
 
-            for (int i = 0; i < num_layers; i++)
-            {
-                if (layers[i]->type == LayerType::DENSE)
+        /**
+         * @brief Get the prediction cache, e.g. to read its hit and miss counters.
+         *
+         * @return Prediction cache or nullptr if it is disabled.
+         */
+        std::shared_ptr<const PredictionCache> prediction_cache() const
+        {
+            return cache;
+        }
+
+        /**
+         * @brief Enables or disables the per-layer profiler of the training steps.
+         *
+         * @details The profiler times the forward pass, the backward pass and the update of every layer and the loss, and counts their
+         * floating point operations and bytes, see Profiler. fit() prints the table at the end of every epoch and appends the JSON to
+         * json_path, then starts over. When it is disabled the training steps only test for it, they do not read the clock.
+         *
+         * @param[in] enabled Whether to profile the training steps.
+         * @param[in] json_path File the JSON report of every epoch is appended to, empty for none.
+         */
+        void profile(bool enabled, const std::string &json_path = "")
+        {
+            profiler_object = enabled ? std::make_shared<Profiler>(json_path) : nullptr;
+            if (profiler_object && compiled)
+            {
+                profiler_object->layers(plan, optimizer_object ? optimizer_object->state_matrices() : 0);
+            }
+        }
+
+        /**
+         * @brief Get the profiler, e.g. to read the measurements of train_on_batch() steps.
+         *
+         * @return Profiler or nullptr if it is disabled.
+         */
+        std::shared_ptr<Profiler> profiler() const
+        {
+            return profiler_object;
+        }
+
+        /**
+         * @brief Get the parameter version of the neural network.
+         *
+         * @details The version changes whenever the model is (re)compiled or loaded, the weights or biases of any dense layer, the table of an embedding layer or the
+         * scale or shift of an affine layer are updated, or the fast math setting of an activation is changed.
+         *
+         * @return uint64_t Parameter version
+         */
+        uint64_t parameters_version() const
+        {
+            uint64_t version = structure_version << 40;
+            for (int i = 0; i < num_layers; i++)
+            {
+                if (layers[i]->type == LayerType::DENSE)
                 {
-                    std::shared_ptr<Dense> _dense_layer = reinterpret_cast<const std::shared_ptr<Dense> &>(layers[i]);
+                    std::shared_ptr<Dense> dense_layer = reinterpret_cast<const std::shared_ptr<Dense> &>(layers[i]);
+                    version += dense_layer->version();
+                }
+                else if (layers[i]->type == LayerType::EMBEDDING)
+                {
+                    version += std::static_pointer_cast<Embedding>(layers[i])->version();
+                }
+                else if (layers[i]->type == LayerType::AFFINE)
+                {
+                    version += std::static_pointer_cast<Affine>(layers[i])->version();
+                }
+                else if (layers[i]->type == LayerType::ACTIVATION)
+                {
+                    version += std::static_pointer_cast<Activation>(layers[i])->version();
+                }
+            }
+            return version;
+        }
+
+        /**
+         * @brief Gives the input and output dimensions of the compiled neural network
+         *
+         * @details Both dimensions are -1 if the neural network has not been compiled (or loaded) successfully.
+         *
+         * @param[out] n_input Number of input features
+         * @param[out] n_output Number of output features
+         */
+        void shape(int &n_input, int &n_output) const
+        {
+            n_input = compiled ? input_dim : -1;
+            n_output = compiled ? output_dim : -1;
+        }
+
+        /**
+         * @brief Get the number of layers added to the network
+         *
+         * @return int Number of layers
+         */
+        int layer_count() const
+        {
+            return num_layers;
+        }
 
-                    optimizer_object->update_params(_dense_layer);
+        /**
+         * @brief Get a layer of the network, in the order the layers were added
+         *
+         * @param[in] index Index of the layer
+         *
+         * @return std::shared_ptr<const Layer> Layer
+         *
+         * @throws std::out_of_range if there is no such layer
+         */
+        std::shared_ptr<const Layer> layer(int index) const
+        {
+            return layers.at(index);
+        }
+
+        /**
+         * @brief Get the layers run by predictions
+         *
+         * @details The optimized inference plan (see compile()) is rebuilt first if the parameters changed since it was built. Its layers
+         * may be shared with the network, they must not be modified. Rebuilding runs the layers forward and invalidates the caches their
+         * backward pass needs, so it must not be called in the middle of a training step.
+         *
+         * @return std::vector<std::shared_ptr<Layer>>& Inference plan
+         */
+        const std::vector<std::shared_ptr<Layer>> &inference_layers()
+        {
+            if (!optimize_inference)
+            {
+                return plan;
+            }
+
+            uint64_t version = parameters_version();
+            if (inference.empty() || inference_version != version)
+            {
+                optimize();
+                inference_version = version;
+            }
+            return inference;
+        }
+
+    private:
+        /**
+         * @brief Predicts the class of the provided sample(s), answering rows from the prediction cache when it is enabled.
+         *
+         * @param[in] sample Sample(s) to predict the class of.
+         * @param[in] incremental Whether the first dense layer runs incrementally, see predict_incremental().
+         *
+         * @return Predictions of the neural network for the provided sample(s).
+         */
+        Eigen::MatrixXd predict(const Eigen::MatrixXd &sample, bool incremental)
+        {
+            if (sample.cols() != input_dim)
+            {
+                LOG_ERROR("Input dimension of the neural network does not match the dimension of the provided sample.");
+                return Eigen::MatrixXd::Zero(sample.rows(), sample.cols());
+            }
+
+            if (!cache)
+            {
+                return predict_uncached(sample, incremental);
+            }
+
+            cache->validate(parameters_version());
+
+            Eigen::MatrixXd prediction(sample.rows(), output_dim);
+            std::vector<Eigen::Index> missing;
+            std::vector<std::pair<Eigen::Index, size_t>> duplicates; // Row repeating a missing row, and the position of that row in missing
+            std::unordered_map<uint64_t, size_t> pending;            // Hash of every missing row to its position in missing
+
+            for (Eigen::Index i = 0; i < sample.rows(); ++i)
+            {
+                // A row that already missed earlier in the batch is computed once and not looked up again
+                if (!pending.empty())
+                {
+                    auto first = pending.find(PredictionCache::hash(sample.row(i)));
+                    if (first != pending.end() && sample.row(missing[first->second]) == sample.row(i))
+                    {
+                        duplicates.emplace_back(i, first->second);
+                        continue;
+                    }
+                }
+
+                if (!cache->lookup(sample.row(i), prediction.row(i)))
+                {
+                    pending.emplace(PredictionCache::hash(sample.row(i)), missing.size());
+                    missing.push_back(i);
                 }
             }
+
+            if (missing.empty())
+            {
+                return prediction;
+            }
+
+            Eigen::MatrixXd missing_prediction = predict_uncached(sample(missing, Eigen::all), incremental);
+
+            for (size_t j = 0; j < missing.size(); ++j)
+            {
+                prediction.row(missing[j]) = missing_prediction.row(j);
+                cache->insert(sample.row(missing[j]), missing_prediction.row(j));
+            }
+            for (const auto &duplicate : duplicates)
+            {
+                prediction.row(duplicate.first) = missing_prediction.row(duplicate.second);
+            }
+
+            return prediction;
+        }
+
+        /**
+         * @brief Runs the provided sample(s) through the network, applying softmax if the last layer is not an activation.
+         *
+         * @param[in] sample Sample(s) to predict the class of.
+         * @param[in] incremental Whether the first dense layer runs incrementally, see predict_incremental().
+         *
+         * @return Predictions of the neural network for the provided sample(s).
+         */
+        Eigen::MatrixXd predict_uncached(const Eigen::MatrixXd &sample, bool incremental)
+        {
+            Eigen::MatrixXd prediction;
+
+            if (incremental)
+            {
+                std::shared_ptr<Dense> dense_layer = reinterpret_cast<const std::shared_ptr<Dense> &>(layers[0]);
+                dense_layer->forward_incremental(prediction, sample);
+                for (size_t i = 1; i < plan.size(); i++)
+                {
+                    plan[i]->forward(prediction, prediction);
+                }
+            }
+            else
+            {
+                prediction = sample;
+                for (const std::shared_ptr<Layer> &layer : inference_layers())
+                {
+                    layer->forward(prediction, prediction);
+                }
+            }
+
+            if (layers[layers.size() - 1]->type != LayerType::ACTIVATION)
+            {
+                Softmax softmax = Softmax();
+                Eigen::MatrixXd prediction_softmax = prediction;
+                softmax.forward(prediction_softmax, prediction);
+                return prediction_softmax;
+            }
+
+            return prediction;
+        }
+
+        /**
+         * @brief Builds the optimized inference plan from the training plan, see compile()
+         *
+         * @details The plan is checked by running a probe batch forward through the training layers and the inference layers, which
+         * shares most of them. That overwrites the inputs, outputs and masks the layers keep for backward, so it must not run between
+         * a forward pass and its backward pass.
+         */
+        void optimize()
+        {
+            inference.clear();
+
+            // Pending linear map x * weights + biases, weights is diagonal (stored in scale) until a dense layer joins the chain
+            enum class Pending
+            {
+                NONE,
+                DIAGONAL,
+                FULL
+            } pending = Pending::NONE;
+            Eigen::RowVectorXd scale;
+            Eigen::MatrixXd weights;
+            Eigen::MatrixXd biases;
+            std::shared_ptr<Dense> source; // Dense layer the pending map is an unchanged copy of, reused as is
+
+            auto flush = [&](ActivationType activation, bool fast_math)
+            {
+                if (pending == Pending::DIAGONAL)
+                {
+                    std::shared_ptr<Affine> affine_layer = std::make_shared<Affine>(scale, biases.row(0));
+                    if (!affine_layer->identity())
+                    {
+                        inference.push_back(affine_layer);
+                    }
+                }
+                else if (pending == Pending::FULL && source)
+                {
+                    inference.push_back(source);
+                }
+                else if (pending == Pending::FULL)
+                {
+                    std::shared_ptr<Dense> merged = std::make_shared<Dense>(static_cast<int>(weights.rows()), static_cast<int>(weights.cols()));
+                    merged->weights(weights);
+                    merged->biases(biases);
+                    merged->fuse(activation, fast_math);
+                    inference.push_back(merged);
+                }
+                pending = Pending::NONE;
+                source = nullptr;
+            };
+
+            // Whether the last layer of the plan outputs the result of a ReLU
+            auto relu_output = [&]()
+            {
+                if (pending != Pending::NONE || inference.empty())
+                {
+                    return false;
+                }
+                const std::shared_ptr<Layer> &last = inference.back();
+                return (last->type == LayerType::ACTIVATION && std::static_pointer_cast<Activation>(last)->activation_type == ActivationType::RELU) ||
+                       (last->type == LayerType::DENSE && std::static_pointer_cast<Dense>(last)->fused_activation() == ActivationType::RELU);
+            };
+
+            for (const std::shared_ptr<Layer> &layer : plan)
+            {
+                if (layer->type == LayerType::AFFINE)
+                {
+                    std::shared_ptr<Affine> affine_layer = std::static_pointer_cast<Affine>(layer);
+                    if (pending == Pending::NONE)
+                    {
+                        scale = affine_layer->scale();
+                        biases = affine_layer->shift();
+                        pending = Pending::DIAGONAL;
+                    }
+                    else
+                    {
+                        if (pending == Pending::DIAGONAL)
+                        {
+                            scale.array() *= affine_layer->scale().array();
+                        }
+                        else
+                        {
+                            weights.array().rowwise() *= affine_layer->scale().array();
+                        }
+                        biases = (biases.array() * affine_layer->scale().array() + affine_layer->shift().array()).matrix();
+                    }
+                    source = nullptr;
+                    continue;
+                }
+
+                if (layer->type == LayerType::DENSE)
+                {
+                    std::shared_ptr<Dense> dense_layer = std::static_pointer_cast<Dense>(layer);
+                    const Eigen::MatrixXd &layer_weights = dense_layer->weights();
+
+                    // Merging a wide layer between two narrow ones would cost more multiplications than it saves
+                    if (pending == Pending::FULL && weights.rows() * layer_weights.cols() > weights.size() + layer_weights.size())
+                    {
+                        flush(ActivationType::NONE, false);
+                    }
+
+                    if (pending == Pending::NONE)
+                    {
+                        weights = layer_weights;
+                        biases = dense_layer->biases();
+                        source = dense_layer;
+                    }
+                    else
+                    {
+                        if (pending == Pending::DIAGONAL)
+                        {
+                            weights = layer_weights.array().colwise() * scale.transpose().array();
+                        }
+                        else
+                        {
+                            weights = weights * layer_weights;
+                        }
+                        biases = biases * layer_weights + dense_layer->biases();
+                        source = nullptr;
+                    }
+                    pending = Pending::FULL;
+
+                    if (dense_layer->fused_activation() != ActivationType::NONE)
+                    {
+                        flush(dense_layer->fused_activation(), dense_layer->fused_fast_math());
+                    }
+                    continue;
+                }
+
+                if (layer->type == LayerType::ACTIVATION && std::static_pointer_cast<Activation>(layer)->activation_type == ActivationType::RELU && relu_output())
+                {
+                    continue;
+                }
+
+                // An activation compile() could not fuse because an affine layer came first is fused into the merged dense layer
+                ActivationType activation;
+                bool fast_math;
+                if (fuse_activations && pending == Pending::FULL && fusable(layer, activation, fast_math))
+                {
+                    source = nullptr;
+                    flush(activation, fast_math);
+                    continue;
+                }
+
+                flush(ActivationType::NONE, false);
+                inference.push_back(layer);
+            }
+            flush(ActivationType::NONE, false);
+
+            // Merging changes the rounding only, anything more means the plan is wrong and the unoptimized layers are used instead. The
+            // probe has its own generator so optimizing does not move the std::rand() state seeded training relies on
+            std::mt19937 generator(42);
+            std::uniform_real_distribution<double> uniform(-1., 1.);
+            Eigen::MatrixXd probe = Eigen::MatrixXd::NullaryExpr(4, input_dim, [&]()
+                                                                 { return uniform(generator); });
+            if (layers[0]->type == LayerType::EMBEDDING)
+            {
+                probe.setZero();
+            }
+            Eigen::MatrixXd expected = probe;
+            for (const std::shared_ptr<Layer> &layer : plan)
+            {
+                layer->forward(expected, expected);
+            }
+            for (const std::shared_ptr<Layer> &layer : inference)
+            {
+                layer->forward(probe, probe);
+            }
+            if (probe.rows() != expected.rows() || probe.cols() != expected.cols() ||
+                (probe - expected).cwiseAbs().maxCoeff() > 1e-8 * std::max(1., expected.cwiseAbs().maxCoeff()))
+            {
+                LOG_WARNING("The optimized inference plan does not match the network, predictions use the unoptimized layers.");
+                inference = plan;
+            }
+        }
+
+        /**
+         * @brief Checks whether a layer is an activation a dense layer can run itself, see Dense::fuse()
+         *
+         * @param[in] layer Layer following a dense layer
+         * @param[out] activation Activation to fuse
+         * @param[out] fast_math Whether the activation uses fast math
+         *
+         * @return bool True if the layer can be fused
+         */
+        static bool fusable(const std::shared_ptr<Layer> &layer, ActivationType &activation, bool &fast_math)
+        {
+            if (layer->type != LayerType::ACTIVATION)
+            {
+                return false;
+            }
+
+            activation = std::static_pointer_cast<Activation>(layer)->activation_type;
+            switch (activation)
+            {
+            case ActivationType::RELU:
+                fast_math = false;
+                return true;
+            case ActivationType::SIGMOID:
+                fast_math = std::static_pointer_cast<Sigmoid>(layer)->fast_math();
+                return true;
+            case ActivationType::TANH:
+                fast_math = std::static_pointer_cast<Tanh>(layer)->fast_math();
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        /**
+         * @brief Implements fit() for compact examples
+         */
+        void fit_compact(const Eigen::Ref<const CompactExamples> &examples,
+                         const Eigen::Ref<const Eigen::VectorXi> &labels,
+                         const Eigen::Ref<const CompactExamples> &test_examples,
+                         const Eigen::Ref<const Eigen::VectorXi> &test_labels,
+                         int epochs,
+                         int batch_size,
+                         bool verbose,
+                         double scale)
+        {
+            if (loss_object == nullptr || optimizer_object == nullptr)
+            {
+                LOG_ERROR("Training is not possible for this neural network object as the loss and optimizer have not been specified.");
+                return;
+            }
+
+            if (!compiled)
+            {
+                LOG_ERROR("Please compile the neural network object before attempting to train it.");
+                return;
+            }
+
+            if (examples.cols() != input_dim || test_examples.cols() != input_dim)
+            {
+                LOG_ERROR("The number of columns in the examples matrix must match the input dimension of the neural network.");
+                return;
+            }
+
+            if (!valid_class_ids(labels, examples.rows()) || !valid_class_ids(test_labels, test_examples.rows()))
+            {
+                LOG_ERROR("There must be one label per example and every label must be a class id below the output dimension of the neural network.");
+                return;
+            }
+
+            train<Eigen::MatrixXd>(
+                examples.rows(), epochs, batch_size, verbose,
+                [&](int start, int count, Eigen::MatrixXd &batch_examples, Eigen::MatrixXd &batch_labels)
+                {
+                    decode_batch(examples, labels, start, count, scale, batch_examples, batch_labels);
+                },
+                [&](Eigen::MatrixXd &batch_examples, Eigen::MatrixXd &batch_output)
+                {
+                    forward(batch_output, batch_examples);
+                },
+                [&](double &train_accuracy, double &test_accuracy)
+                {
+                    accuracy(train_accuracy, examples, labels, scale);
+                    accuracy(test_accuracy, test_examples, test_labels, scale);
+                });
+        }
+
+        /**
+         * @brief Implements accuracy() for compact examples
+         */
+        void accuracy_compact(double &accuracy, const Eigen::Ref<const CompactExamples> &examples, const Eigen::Ref<const Eigen::VectorXi> &labels, double scale)
+        {
+            if (examples.cols() != input_dim || !valid_class_ids(labels, examples.rows()))
+            {
+                LOG_ERROR("Input and output dimensions of the neural network do not match the dimensions of the provided samples and labels.");
+                return;
+            }
+
+            const int chunk = 1024;
+            Eigen::MatrixXd predictions;
+            Eigen::VectorXi predicted_labels;
+            Eigen::Index correct = 0;
+
+            for (Eigen::Index start = 0; start < examples.rows(); start += chunk)
+            {
+                Eigen::Index count = std::min<Eigen::Index>(chunk, examples.rows() - start);
+                predictions = examples.middleRows(start, count).cast<double>() * scale;
+                forward(predictions);
+                Metrics::onehotdecode(predicted_labels, predictions);
+                correct += (predicted_labels.array() == labels.segment(start, count).array()).count();
+            }
+
+            accuracy = examples.rows() > 0 ? static_cast<double>(correct) / examples.rows() : 0.;
+        }
+
+        /**
+         * @brief Runs the training loop shared by the fit() overloads
+         *
+         * @details The next batch is loaded on Threading::inter_op() while the current one trains. load_batch must therefore only read
+         * the examples and write its own arguments.
+         *
+         * @tparam Batch Type of the batch examples
+         *
+         * @param[in] num_examples Number of training examples
+         * @param[in] epochs The number of epochs to train for
+         * @param[in] batch_size The batch size
+         * @param[in] verbose Whether to print out information about the training process
+         * @param[in] load_batch Copies a range of examples and fills their one-hot labels
+         * @param[in] forward_batch Runs a loaded batch through the network, the batch may be consumed
+         * @param[in] evaluate Computes the train and test accuracy at the end of an epoch
+         */
+        template <typename Batch, typename LoadBatch, typename ForwardBatch, typename Evaluate>
+        void train(int num_examples, int epochs, int batch_size, bool verbose, LoadBatch load_batch, ForwardBatch forward_batch, Evaluate evaluate)
+        {
+            int num_batches = num_examples / batch_size;
+            int batches_num_length = std::to_string(num_batches).length();
+
+            // Batch buffers, two of each so one can be loaded while the other trains
+            Batch batch_examples[2];
+            Eigen::MatrixXd batch_labels[2];
+            Eigen::MatrixXd batch_output;
+
+            auto load = [&](int i)
+            {
+                int start = i * batch_size;
+                int end = std::min(start + batch_size, num_examples);
+                load_batch(start, end - start, batch_examples[i % 2], batch_labels[i % 2]);
+            };
+
+            // Queued by reference for every batch, a task capturing one reference is small enough not to allocate
+            int next = 0;
+            auto prefetch = [&]()
+            {
+                load(next);
+            };
+
+            for (int epoch = 1; epoch <= epochs; ++epoch)
+            {
+                std::cout << "Epoch " << epoch << "/" << epochs << std::endl;
+
+                double total_loss = 0;
+                double total_data_loss = 0;
+                double total_reg_loss = 0;
+                int batch_time_total = 0;
+
+                auto time_start = std::chrono::high_resolution_clock::now();
+
+                TaskGroup loading(Threading::inter_op());
+                if (num_batches > 0)
+                {
+                    load(0);
+                }
+
+                for (int i = 0; i < num_batches; ++i)
+                {
+                    auto batch_time_start = std::chrono::high_resolution_clock::now();
+                    double batch_loss = 0;
+                    double data_loss = 0;
+                    double reg_loss = 0;
+
+                    loading.wait();
+                    if (i + 1 < num_batches)
+                    {
+                        next = i + 1;
+                        loading.run([&prefetch]()
+                                    { prefetch(); });
+                    }
+
+                    forward_batch(batch_examples[i % 2], batch_output);
+                    step(data_loss, reg_loss, batch_output, batch_labels[i % 2]);
+
+                    if (verbose)
+                    {
+                        batch_loss = data_loss + reg_loss;
+                        total_loss += batch_loss;
+
+                        total_data_loss += data_loss;
+                        total_reg_loss += reg_loss;
+
+                        std::cout << " - " << std::setw(batches_num_length) << i + 1;
+                        std::cout << '/' << num_batches;
+
+                        progressbar(num_batches, i, 50);
+
+                        auto batch_time_end = std::chrono::high_resolution_clock::now();
+
+                        auto running = std::chrono::duration_cast<std::chrono::seconds>(batch_time_end - time_start);
+                        auto batch_time = std::chrono::duration_cast<std::chrono::milliseconds>(batch_time_end - batch_time_start);
+
+                        batch_time_total += batch_time.count();
+
+                        std::cout << "- " << std::setw(4) << running.count();
+                        std::cout << "s";
+
+                        if (i + 1 != num_batches)
+                        {
+                            std::cout << "\r";
+                            std::cout.flush();
+                        }
+                    }
+                }
+
+                if (verbose)
+                {
+                    double train_accuracy = 0;
+                    double test_accuracy = 0;
+
+                    evaluate(train_accuracy, test_accuracy);
+
+                    batch_time_total /= num_batches;
+                    total_loss /= num_batches;
+                    total_data_loss /= num_batches;
+                    total_reg_loss /= num_batches;
+
+                    double current_lr = optimizer_object->current_lr();
+
+                    std::cout << " - " << batch_time_total << "ms/batch"
+                              << " - loss: " << std::fixed << std::setprecision(3) << total_loss
+                              << " ( data: " << total_data_loss << ", reg: " << total_reg_loss
+                              << " ) - train_accuracy: " << train_accuracy << " - test_accuracy: " << test_accuracy
+                              << " - lr: " << current_lr
+                              << std::endl;
+                }
+
+                if (profiler_object && num_batches > 0)
+                {
+                    profiler_object->report(std::cout, epoch);
+                }
+            }
+        }
+
+        /**
+         * @brief Scales a range of compact examples and one-hot encodes their labels
+         *
+         * @param[in] examples Compact examples
+         * @param[in] labels Class ids of the examples
+         * @param[in] start Index of the first example
+         * @param[in] count Number of examples
+         * @param[in] scale Factor applied to every example byte
+         * @param[out] batch_examples Scaled examples
+         * @param[out] batch_labels One-hot labels
+         */
+        void decode_batch(const Eigen::Ref<const CompactExamples> &examples, const Eigen::Ref<const Eigen::VectorXi> &labels,
+                          int start, int count, double scale, Eigen::MatrixXd &batch_examples, Eigen::MatrixXd &batch_labels)
+        {
+            batch_examples = examples.middleRows(start, count).cast<double>() * scale;
+            onehot_batch(labels, start, count, batch_labels);
+        }
+
+        /**
+         * @brief One-hot encodes the class ids of a range of examples
+         *
+         * @param[in] labels Class ids of the examples
+         * @param[in] start Index of the first example
+         * @param[in] count Number of examples
+         * @param[out] batch_labels One-hot labels
+         */
+        void onehot_batch(const Eigen::Ref<const Eigen::VectorXi> &labels, int start, int count, Eigen::MatrixXd &batch_labels)
+        {
+            batch_labels.setZero(count, output_dim);
+            for (int i = 0; i < count; ++i)
+            {
+                batch_labels(i, labels(start + i)) = 1.;
+            }
+        }
+
+        /**
+         * @brief Checks that there is one class id per example and that all of them are valid for this network
+         *
+         * @param[in] labels Class ids
+         * @param[in] rows Number of examples
+         *
+         * @return bool True if the labels are valid
+         */
+        bool valid_class_ids(const Eigen::Ref<const Eigen::VectorXi> &labels, Eigen::Index rows) const
+        {
+            return labels.size() == rows && (rows == 0 || (labels.minCoeff() >= 0 && labels.maxCoeff() < output_dim));
+        }
+
+        /**
+         * @brief Implements the forward pass of the neural network.
+         *
+         * @param[in, out] x Input of the neural network. The output of the neural network is stored in this matrix.
+         */
+        void forward(Eigen::MatrixXd &x) override
+        {
+            for (const std::shared_ptr<Layer> &layer : plan)
+            {
+                layer->forward(x, x);
+            }
+        }
+
+        /**
+         * @brief Implements the forward pass of the neural network for sparse examples
+         *
+         * @param[out] out Output of the neural network
+         * @param[in] x Sparse input of the neural network, the first layer must be a dense layer
+         */
+        void forward(Eigen::MatrixXd &out, const SparseExamples &x)
+        {
+            profiled(0, Profiler::FORWARD, layer_outputs[0], [&]()
+                     { std::static_pointer_cast<Dense>(plan[0])->forward(layer_outputs[0], x); });
+            for (size_t i = 1; i < plan.size(); i++)
+            {
+                profiled(i, Profiler::FORWARD, layer_outputs[i], [&]()
+                         { plan[i]->forward(layer_outputs[i], layer_outputs[i - 1]); });
+            }
+            out = layer_outputs.back();
+        }
+
+        /**
+         * @brief Implements the forward pass of the training steps
+         *
+         * @details Every layer writes its own output buffer, so once the buffers have the batch shape the pass does not allocate,
+         * unlike the in-place forward(Eigen::MatrixXd &) where every change of width reallocates the matrix.
+         *
+         * @param[out] out Output of the neural network
+         * @param[in] x Input of the neural network
+         */
+        void forward(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
+        {
+            for (size_t i = 0; i < plan.size(); i++)
+            {
+                profiled(i, Profiler::FORWARD, layer_outputs[i], [&]()
+                         { plan[i]->forward(layer_outputs[i], i == 0 ? x : layer_outputs[i - 1]); });
+            }
+            out = layer_outputs.back();
+        }
+
+        /**
+         * @brief Trains the network on a batch that went through the forward pass
+         *
+         * @param[out] data_loss Data loss of the batch
+         * @param[out] reg_loss Regularization loss of the network
+         * @param[in] predicted Output of the network for the batch
+         * @param[in] labels One-hot labels of the batch
+         */
+        void step(double &data_loss, double &reg_loss, Eigen::MatrixXd &predicted, const Eigen::MatrixXd &labels)
+        {
+            profiled(plan.size(), Profiler::FORWARD, predicted, [&]()
+                     { loss_object->calculate(data_loss, predicted, labels); });
+
+            reg_loss = 0;
+            regularization_loss(reg_loss);
+
+            optimizer_object->pre_update_params();
+            backward(predicted, labels);
+            optimizer_object->post_update_params();
+        }
+
+        /**
+         * @brief Implements the backward pass of the neural network.
+         *
+         * @details The backward pass of the neural network is implemented by first calculating the loss of the neural network and then propagating the loss backwards through the neural network.
+         *
+         * @param[in] predicted Predicted output of the neural network.
+         * @param[in] labels Labels of the provided examples.
+         */
+        void backward(Eigen::MatrixXd &predicted, const Eigen::MatrixXd &labels) override
+        {
+            // Every layer writes its own gradient buffer, layer_gradients[i + 1] is the gradient of the output of plan[i]
+            profiled(plan.size(), Profiler::BACKWARD, predicted, [&]()
+                     { loss_object->backward(layer_gradients.back(), predicted, labels); });
+
+            for (size_t i = plan.size(); i-- > 0;)
+            {
+                profiled(i, Profiler::BACKWARD, layer_outputs[i], [&]()
+                         { plan[i]->backward(layer_gradients[i], layer_gradients[i + 1]); });
+            }
+
+            // The plan holds the same dense and embedding layers as layers, in the same order
+            for (size_t i = 0; i < plan.size(); i++)
+            {
+                if (plan[i]->type == LayerType::DENSE)
+                {
+                    std::shared_ptr<Dense> _dense_layer = reinterpret_cast<const std::shared_ptr<Dense> &>(plan[i]);
+
+                    profiled(i, Profiler::UPDATE, layer_outputs[i], [&]()
+                             { optimizer_object->update_params(_dense_layer); });
+                }
+                else if (plan[i]->type == LayerType::EMBEDDING)
+                {
+                    std::shared_ptr<Embedding> embedding_layer = std::static_pointer_cast<Embedding>(plan[i]);
+
+                    profiled(i, Profiler::UPDATE, layer_outputs[i], [&]()
+                             { optimizer_object->update_params(embedding_layer); });
+                }
+            }
+        }
+
+        /**
+         * @brief Runs one pass of a layer of the training steps, timed when the profiler is enabled
+         *
+         * @param[in] slot Index of the layer in the plan, the number of layers for the loss
+         * @param[in] pass Pass
+         * @param[in] out Output of the layer, or predictions of the network for the loss, read after the pass for the cost model
+         * @param[in] function Runs the pass
+         */
+        template <typename Function>
+        void profiled(size_t slot, Profiler::Pass pass, const Eigen::MatrixXd &out, Function function)
+        {
+            if (!profiler_object)
+            {
+                function();
+                return;
+            }
+
+            Profiler::Clock::time_point start = Profiler::Clock::now();
+            function();
+            profiler_object->record(slot, pass, start, out.rows(), out.size());
         }
 
         /**
@@ -683,13 +1827,24 @@ namespace NNFS
             std::cout << "% ";
         }
 
-        std::vector<std::shared_ptr<Layer>> layers;  // Layers of the neural network
-        std::shared_ptr<Loss> loss_object;           // Loss function of the neural network
-        std::shared_ptr<Optimizer> optimizer_object; // Optimizer of the neural network
-        int num_layers;                              // Number of layers in the neural network
-        int input_dim;                               // Input dimension of the neural network
-        int output_dim;                              // Output dimension of the neural network
-        bool compiled = false;                       // Indicates whether the neural network has been compiled
+        std::vector<std::shared_ptr<Layer>> layers;    // Layers of the neural network
+        std::vector<std::shared_ptr<Layer>> plan;      // Layers run by the forward and backward passes, without the fused activations
+        std::vector<std::shared_ptr<Layer>> inference; // Layers run by predictions, see optimize()
+        std::vector<Eigen::MatrixXd> layer_outputs;    // Output of every layer of the plan in the training steps
+        std::vector<Eigen::MatrixXd> layer_gradients;  // Gradient of the input of every layer of the plan, then of the network output
+        Eigen::MatrixXd step_output;                   // Output of the network in train_on_batch()
+        uint64_t inference_version = 0;                // Parameter version the inference plan was built for
+        bool fuse_activations = true;                  // Whether activations are fused into the preceding dense layers
+        bool optimize_inference = true;                // Whether predictions run the optimized inference plan
+        std::shared_ptr<Loss> loss_object;             // Loss function of the neural network
+        std::shared_ptr<Optimizer> optimizer_object;   // Optimizer of the neural network
+        int num_layers;                                // Number of layers in the neural network
+        int input_dim;                                 // Input dimension of the neural network
+        int output_dim;                                // Output dimension of the neural network
+        bool compiled = false;                         // Indicates whether the neural network has been compiled
+        uint64_t structure_version = 0;                // Increased on every compilation, part of the parameter version
+        std::shared_ptr<PredictionCache> cache;        // Optional prediction cache
+        std::shared_ptr<Profiler> profiler_object;     // Optional profiler of the training steps
     };
 
 } // namespace NNFS
\ No newline at end of file
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+
+#include <Eigen/Dense>
+
+namespace NNFS
+{
+    /**
+     * @brief Bounded LRU cache of predictions keyed by the input row
+     *
+     * @details Rows are looked up by a fast 64-bit hash and confirmed by an exact comparison with the stored input, so a hash collision
+     * can only cause a miss, never a wrong prediction. The cache is tagged with the parameter version of the network it was filled from
+     * and is cleared as soon as that version changes.
+     */
+    class PredictionCache
+    {
+    public:
+        using RowRef = Eigen::Ref<const Eigen::RowVectorXd, 0, Eigen::InnerStride<>>; // Any row, including rows of column-major matrices
+        using RowOut = Eigen::Ref<Eigen::RowVectorXd, 0, Eigen::InnerStride<>>;       // Writable row
+
+    public:
+        /**
+         * @brief Construct a new PredictionCache object
+         *
+         * @param capacity Maximum number of cached rows
+         */
+        PredictionCache(size_t capacity) : _capacity(capacity) {}
+
+        /**
+         * @brief Looks up the prediction of a single row
+         *
+         * @param[in] row Input row
+         * @param[out] out Cached prediction, left untouched on a miss
+         *
+         * @return bool True if the row was found
+         */
+        bool lookup(const RowRef &row, RowOut out)
+        {
+            auto it = _index.find(hash(row));
+            if (it == _index.end() || it->second->input != row)
+            {
+                _misses++;
+                return false;
+            }
+
+            // Move the entry to the front of the LRU list
+            _entries.splice(_entries.begin(), _entries, it->second);
+            out = it->second->output;
+            _hits++;
+            return true;
+        }
+
+        /**
+         * @brief Stores the prediction of a single row, evicting the least recently used entry if the cache is full
+         *
+         * @param[in] row Input row
+         * @param[in] prediction Prediction of the row
+         */
+        void insert(const RowRef &row, const RowRef &prediction)
+        {
+            if (_capacity == 0)
+            {
+                return;
+            }
+
+            uint64_t key = hash(row);
+            auto it = _index.find(key);
+            if (it != _index.end())
+            {
+                // Same row inserted twice or a colliding row, either way the newest one wins
+                _entries.erase(it->second);
+                _index.erase(it);
+            }
+            else if (_entries.size() >= _capacity)
+            {
+                _index.erase(_entries.back().key);
+                _entries.pop_back();
+            }
+
+            _entries.push_front({key, row, prediction});
+            _index[key] = _entries.begin();
+        }
+
+        /**
+         * @brief Drops all entries if they were computed with another parameter version
+         *
+         * @param version Current parameter version of the network
+         */
+        void validate(uint64_t version)
+        {
+            if (version != _version)
+            {
+                clear();
+                _version = version;
+            }
+        }
+
+        /**
+         * @brief Drops all entries, the hit and miss counters are kept
+         */
+        void clear()
+        {
+            _entries.clear();
+            _index.clear();
+        }
+
+        /**
+         * @brief Get the number of cache hits
+         *
+         * @return uint64_t Number of hits
+         */
+        uint64_t hits() const
+        {
+            return _hits;
+        }
+
+        /**
+         * @brief Get the number of cache misses
+         *
+         * @return uint64_t Number of misses
+         */
+        uint64_t misses() const
+        {
+            return _misses;
+        }
+
+        /**
+         * @brief Get the number of cached rows
+         *
+         * @return size_t Number of cached rows
+         */
+        size_t size() const
+        {
+            return _entries.size();
+        }
+
+        /**
+         * @brief Get the maximum number of cached rows
+         *
+         * @return size_t Capacity of the cache
+         */
+        size_t capacity() const
+        {
+            return _capacity;
+        }
+
+        /**
+         * @brief Hashes the raw bytes of a row
+         *
+         * @details Processes one 64-bit word per step, which keeps hashing a 784-pixel row well below the cost of the first Dense layer.
+         *
+         * @param[in] row Row to hash
+         *
+         * @return uint64_t Hash of the row
+         */
+        static uint64_t hash(const RowRef &row)
+        {
+            uint64_t h = 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(row.size());
+            for (Eigen::Index i = 0; i < row.size(); ++i)
+            {
+                uint64_t word;
+                double value = row(i);
+                std::memcpy(&word, &value, sizeof(word));
+
+                h ^= word * 0xBF58476D1CE4E5B9ull;
+                h = (h << 31) | (h >> 33);
+                h *= 0x94D049BB133111EBull;
+            }
+            return h ^ (h >> 29);
+        }
+
+    private:
+        struct Entry
+        {
+            uint64_t key;              // Hash of the input
+            Eigen::RowVectorXd input;  // Input row, used to rule out collisions
+            Eigen::RowVectorXd output; // Cached prediction
+        };
+
+        size_t _capacity;                                                // Maximum number of entries
+        uint64_t _version = 0;                                           // Parameter version the entries belong to
+        uint64_t _hits = 0;                                              // Number of hits
+        uint64_t _misses = 0;                                            // Number of misses
+        std::list<Entry> _entries;                                       // Entries, most recently used first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> _index; // Hash to entry
+    };
+} // namespace NNFS
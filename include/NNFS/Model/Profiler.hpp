@@ -0,0 +1,337 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include "../Utilities/clue.hpp"
+#include "../Layer/Layer.hpp"
+#include "../Layer/Dense.hpp"
+#include "../Layer/Embedding.hpp"
+#include "../Layer/Affine.hpp"
+#include "../Activation/Activation.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Per-layer timings of the training steps, with the work they did
+     *
+     * @details Every layer of the training plan, and the loss, gets one slot. A slot accumulates the wall time, the calls, the floating
+     * point operations and the bytes moved by the forward pass, the backward pass and the parameter update of its layer. Operations and
+     * bytes come from a cost model of each layer rather than from hardware counters:
+     *
+     * - Dense: 2 * rows * inputs * outputs operations for the forward product and twice as many backward (the weights gradient and the
+     *   input gradient), plus the bias and the fused activation. Bytes are the matrices read and written once each, which is what the
+     *   blocked products come close to.
+     * - Activations, affine layers and the loss: one operation per element, bytes of their input and output.
+     * - Updates: no operations, the parameters, their gradients and the optimizer state read and written once each.
+     *
+     * The achieved GFLOP/s next to the GB/s and the operations per byte tell compute-bound layers (large dense products, near the peak
+     * of the core) from bandwidth-bound ones (activations, updates, thin dense layers). NeuralNetwork::profile() enables it, fit() prints
+     * the table and writes the JSON at the end of every epoch.
+     */
+    class Profiler
+    {
+    public:
+        /**
+         * @brief Passes timed for every layer
+         */
+        enum Pass
+        {
+            FORWARD,
+            BACKWARD,
+            UPDATE,
+            PASSES
+        };
+
+        /**
+         * @brief Accumulated measurements of one layer
+         */
+        struct Slot
+        {
+            std::string name;                    // Layer name, e.g. dense 784x128 relu
+            uint64_t calls[PASSES] = {};         // Timed calls of every pass
+            double seconds[PASSES] = {};         // Wall time of every pass
+            double flops[PASSES] = {};           // Floating point operations of every pass, from the cost model
+            double bytes[PASSES] = {};           // Bytes read and written by every pass, from the cost model
+            std::shared_ptr<const Layer> layer;  // Layer, null for the loss
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+    public:
+        /**
+         * @brief Construct a new Profiler object
+         *
+         * @param json_path File the JSON report of every epoch is appended to, one line per epoch, empty for none
+         */
+        explicit Profiler(const std::string &json_path = "") : _json_path(json_path) {}
+
+        /**
+         * @brief Sets the layers, one slot per layer and a last one for the loss, and clears the measurements
+         *
+         * @param layers Layers of the training plan
+         * @param state_matrices Optimizer matrices updated with every parameter matrix, see Optimizer::state_matrices()
+         */
+        void layers(const std::vector<std::shared_ptr<Layer>> &layers, int state_matrices)
+        {
+            _slots.clear();
+            for (const std::shared_ptr<Layer> &layer : layers)
+            {
+                Slot slot;
+                slot.name = name(*layer);
+                slot.layer = layer;
+                _slots.push_back(slot);
+            }
+            Slot loss;
+            loss.name = "loss";
+            _slots.push_back(loss);
+            _state_matrices = state_matrices;
+        }
+
+        /**
+         * @brief Records one timed pass
+         *
+         * @param slot Index of the layer in the plan, the number of layers for the loss
+         * @param pass Pass
+         * @param start Time the pass started
+         * @param rows Rows of the batch
+         * @param elements Elements of the output of the layer, or of the predictions for the loss
+         */
+        void record(size_t slot, Pass pass, Clock::time_point start, Eigen::Index rows, Eigen::Index elements)
+        {
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            Slot &entry = _slots[slot];
+            double flops = 0, bytes = 0;
+            cost(entry, pass, static_cast<double>(rows), static_cast<double>(elements), flops, bytes);
+            entry.calls[pass]++;
+            entry.seconds[pass] += seconds;
+            entry.flops[pass] += flops;
+            entry.bytes[pass] += bytes;
+        }
+
+        /**
+         * @brief Get the measurements
+         *
+         * @return const std::vector<Slot>& One slot per layer, then the loss
+         */
+        const std::vector<Slot> &slots() const
+        {
+            return _slots;
+        }
+
+        /**
+         * @brief Clears the measurements, keeping the layers
+         */
+        void reset()
+        {
+            for (Slot &slot : _slots)
+            {
+                Slot cleared;
+                cleared.name = slot.name;
+                cleared.layer = slot.layer;
+                slot = cleared;
+            }
+        }
+
+        /**
+         * @brief Prints one row per layer and pass: calls, total time, share of the step, GFLOP/s, GB/s and operations per byte
+         *
+         * @param out Stream
+         */
+        void table(std::ostream &out) const
+        {
+            static const char *passes[PASSES] = {"forward", "backward", "update"};
+            double total = 0;
+            for (const Slot &slot : _slots)
+            {
+                for (int pass = 0; pass < PASSES; ++pass)
+                {
+                    total += slot.seconds[pass];
+                }
+            }
+
+            std::ios::fmtflags flags = out.flags();
+            std::streamsize precision = out.precision();
+            out << std::left << std::setw(28) << "layer" << std::setw(10) << "pass" << std::right << std::setw(8) << "calls"
+                << std::setw(12) << "time ms" << std::setw(8) << "%" << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s"
+                << std::setw(10) << "FLOP/B" << std::endl;
+            for (const Slot &slot : _slots)
+            {
+                for (int pass = 0; pass < PASSES; ++pass)
+                {
+                    if (slot.calls[pass] == 0)
+                    {
+                        continue;
+                    }
+                    const double seconds = slot.seconds[pass];
+                    out << std::left << std::setw(28) << slot.name << std::setw(10) << passes[pass] << std::right << std::setw(8)
+                        << slot.calls[pass] << std::fixed << std::setprecision(2) << std::setw(12) << seconds * 1e3 << std::setprecision(1)
+                        << std::setw(8) << (total > 0 ? 100. * seconds / total : 0.);
+                    if (slot.flops[pass] > 0)
+                    {
+                        out << std::setprecision(2) << std::setw(10) << (seconds > 0 ? slot.flops[pass] / seconds * 1e-9 : 0.);
+                    }
+                    else
+                    {
+                        out << std::setw(10) << "-";
+                    }
+                    out << std::setprecision(2) << std::setw(10) << (seconds > 0 ? slot.bytes[pass] / seconds * 1e-9 : 0.)
+                        << std::setw(10) << (slot.bytes[pass] > 0 ? slot.flops[pass] / slot.bytes[pass] : 0.) << std::endl;
+                }
+            }
+            out.flags(flags);
+            out.precision(precision);
+        }
+
+        /**
+         * @brief Writes the measurements as one JSON object
+         *
+         * @param out Stream
+         * @param epoch Epoch the measurements belong to
+         */
+        void json(std::ostream &out, int epoch) const
+        {
+            static const char *passes[PASSES] = {"forward", "backward", "update"};
+            std::ostringstream stream;
+            stream.precision(9);
+            stream << "{\"epoch\":" << epoch << ",\"layers\":[";
+            for (size_t i = 0; i < _slots.size(); ++i)
+            {
+                const Slot &slot = _slots[i];
+                stream << (i > 0 ? "," : "") << "{\"name\":\"" << slot.name << "\"";
+                for (int pass = 0; pass < PASSES; ++pass)
+                {
+                    if (slot.calls[pass] == 0)
+                    {
+                        continue;
+                    }
+                    stream << ",\"" << passes[pass] << "\":{\"calls\":" << slot.calls[pass] << ",\"seconds\":" << slot.seconds[pass]
+                           << ",\"flops\":" << slot.flops[pass] << ",\"bytes\":" << slot.bytes[pass] << "}";
+                }
+                stream << "}";
+            }
+            stream << "]}";
+            out << stream.str() << std::endl;
+        }
+
+        /**
+         * @brief Prints the table, appends the JSON to the file given at construction and clears the measurements
+         *
+         * @param out Stream the table is printed to
+         * @param epoch Epoch the measurements belong to
+         */
+        void report(std::ostream &out, int epoch)
+        {
+            table(out);
+            if (!_json_path.empty())
+            {
+                std::ofstream file(_json_path, std::ios::app);
+                if (!file.good())
+                {
+                    LOG_ERROR("Could not open the profile file " << _json_path << ".");
+                }
+                else
+                {
+                    json(file, epoch);
+                }
+            }
+            reset();
+        }
+
+    private:
+        /**
+         * @brief Gives a layer a short name with its shape
+         */
+        static std::string name(const Layer &layer)
+        {
+            static const char *activations[] = {"relu", "sigmoid", "tanh", "softmax", "none"};
+            std::ostringstream stream;
+            switch (layer.type)
+            {
+            case LayerType::DENSE:
+            {
+                const Dense &dense = static_cast<const Dense &>(layer);
+                int n_input, n_output;
+                dense.shape(n_input, n_output);
+                stream << "dense " << n_input << "x" << n_output;
+                if (dense.fused_activation() != ActivationType::NONE)
+                {
+                    stream << " " << activations[static_cast<int>(dense.fused_activation())];
+                }
+                break;
+            }
+            case LayerType::ACTIVATION:
+                stream << activations[static_cast<int>(static_cast<const Activation &>(layer).activation_type)];
+                break;
+            case LayerType::EMBEDDING:
+            {
+                int n_ids, n_dims, n_inputs;
+                static_cast<const Embedding &>(layer).shape(n_ids, n_dims, n_inputs);
+                stream << "embedding " << n_ids << "x" << n_dims;
+                break;
+            }
+            default:
+                stream << "affine " << static_cast<const Affine &>(layer).size();
+                break;
+            }
+            return stream.str();
+        }
+
+        /**
+         * @brief Operations and bytes of one pass, see the cost model of the class
+         */
+        void cost(const Slot &slot, Pass pass, double rows, double elements, double &flops, double &bytes) const
+        {
+            constexpr double size = sizeof(double);
+            if (!slot.layer || slot.layer->type == LayerType::ACTIVATION || slot.layer->type == LayerType::AFFINE)
+            {
+                // Input and output, plus the output gradient backward
+                flops = pass == UPDATE ? 0. : elements;
+                bytes = pass == UPDATE ? 0. : (pass == FORWARD ? 2. : 3.) * elements * size;
+                return;
+            }
+
+            if (slot.layer->type == LayerType::EMBEDDING)
+            {
+                // Rows gathered forward, scattered backward and updated with the optimizer state
+                flops = 0;
+                bytes = (pass == UPDATE ? 3. + 2. * _state_matrices : 2.) * elements * size;
+                return;
+            }
+
+            const Dense &dense = static_cast<const Dense &>(*slot.layer);
+            int n_input, n_output;
+            dense.shape(n_input, n_output);
+            const double inputs = n_input, outputs = n_output, parameters = inputs * outputs + outputs;
+            const double epilogue = dense.fused_activation() != ActivationType::NONE ? 2. : 1.;
+            switch (pass)
+            {
+            case FORWARD:
+                // x * W, the bias and the fused activation, reading x and W and writing the output (and the activation derivative)
+                flops = 2. * rows * inputs * outputs + epilogue * rows * outputs;
+                bytes = (rows * inputs + parameters + epilogue * rows * outputs) * size;
+                break;
+            case BACKWARD:
+                // x^T * dx and dx * W^T, the bias gradient, reading x, dx and W and writing both gradients
+                flops = 4. * rows * inputs * outputs + epilogue * rows * outputs;
+                bytes = (2. * rows * inputs + epilogue * rows * outputs + 2. * parameters) * size;
+                break;
+            default:
+                flops = 0;
+                bytes = (3. + 2. * _state_matrices) * parameters * size;
+                break;
+            }
+        }
+
+        std::vector<Slot> _slots; // One slot per layer of the plan, then the loss
+        int _state_matrices = 0;  // Optimizer matrices updated with every parameter matrix
+        std::string _json_path;   // File the JSON reports are appended to, empty for none
+    };
+} // namespace NNFS
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+
+#include <Eigen/Dense>
+#include "NeuralNetwork.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Layers of NNFS::StaticNetwork
+     *
+     * @details Every layer maps a fixed-size row vector to another one. Shapes are template arguments, so layer shapes are checked by
+     * the compiler and Eigen unrolls the products for small layers.
+     */
+    namespace Static
+    {
+        /**
+         * @brief Dense layer with compile-time shape
+         *
+         * @tparam Inputs Number of input neurons
+         * @tparam Outputs Number of output neurons
+         */
+        template <int Inputs, int Outputs>
+        class Dense
+        {
+        public:
+            static constexpr bool activation = false; // Whether the layer is an activation
+            static constexpr int outputs = Outputs;   // Number of output neurons
+
+            using Input = Eigen::Matrix<double, 1, Inputs>;   // Input sample
+            using Output = Eigen::Matrix<double, 1, Outputs>; // Output sample
+
+        public:
+            /**
+             * @brief Forward pass of the dense layer
+             *
+             * @param x Input sample
+             *
+             * @return Output Output sample
+             */
+            template <typename Derived>
+            Output forward(const Eigen::MatrixBase<Derived> &x) const
+            {
+                static_assert(Derived::ColsAtCompileTime == Inputs, "The input width of a static dense layer does not match the previous layer.");
+                return x * _weights + _biases;
+            }
+
+            /**
+             * @brief Copies the parameters of a trained dense layer
+             *
+             * @param layer Layer of a NeuralNetwork
+             *
+             * @return bool True if the layer is a dense layer of the same shape
+             */
+            bool assign(const std::shared_ptr<const Layer> &layer)
+            {
+                if (layer->type != LayerType::DENSE)
+                {
+                    return false;
+                }
+
+                const NNFS::Dense &dense = static_cast<const NNFS::Dense &>(*layer);
+                int n_input, n_output;
+                dense.shape(n_input, n_output);
+                if (n_input != Inputs || n_output != Outputs)
+                {
+                    return false;
+                }
+
+                _weights = dense.weights();
+                _biases = dense.biases();
+                return true;
+            }
+
+            /**
+             * @brief Get weights
+             *
+             * @return Eigen::Matrix<double, Inputs, Outputs>& Weights
+             */
+            Eigen::Matrix<double, Inputs, Outputs> &weights()
+            {
+                return _weights;
+            }
+
+            /**
+             * @brief Get biases
+             *
+             * @return Output& Biases
+             */
+            Output &biases()
+            {
+                return _biases;
+            }
+
+        private:
+            Eigen::Matrix<double, Inputs, Outputs> _weights = Eigen::Matrix<double, Inputs, Outputs>::Zero(); // Weights matrix
+            Output _biases = Output::Zero();                                                                 // Biases row
+        };
+
+        /**
+         * @brief Base of the static activations, they have no parameters and keep the width of their input
+         *
+         * @tparam Type Activation type of the matching NNFS activation layer
+         */
+        template <ActivationType Type>
+        class Activation
+        {
+        public:
+            static constexpr bool activation = true; // Whether the layer is an activation
+
+        public:
+            /**
+             * @brief Checks a trained layer is the same activation
+             *
+             * @param layer Layer of a NeuralNetwork
+             *
+             * @return bool True if the layer is an activation of the same type
+             */
+            bool assign(const std::shared_ptr<const Layer> &layer)
+            {
+                return layer->type == LayerType::ACTIVATION && static_cast<const NNFS::Activation &>(*layer).activation_type == Type;
+            }
+        };
+
+        /**
+         * @brief Base of the static activations with an approximate kernel, see FastMath
+         *
+         * @tparam Type Activation type of the matching NNFS activation layer
+         * @tparam Trained Matching NNFS activation layer, the fast math setting is copied from it
+         */
+        template <ActivationType Type, typename Trained>
+        class FastMathActivation : public Activation<Type>
+        {
+        public:
+            /**
+             * @brief Checks a trained layer is the same activation and copies its fast math setting
+             *
+             * @param layer Layer of a NeuralNetwork
+             *
+             * @return bool True if the layer is an activation of the same type
+             */
+            bool assign(const std::shared_ptr<const Layer> &layer)
+            {
+                if (!Activation<Type>::assign(layer))
+                {
+                    return false;
+                }
+                _fast_math = static_cast<const Trained &>(*layer).fast_math();
+                return true;
+            }
+
+            /**
+             * @brief Selects the approximate kernel of FastMath instead of the exact one
+             *
+             * @param enabled True to use the approximate kernel
+             */
+            void fast_math(bool enabled)
+            {
+                _fast_math = enabled;
+            }
+
+            /**
+             * @brief Whether the approximate kernel of FastMath is used
+             *
+             * @return bool True if enabled
+             */
+            bool fast_math() const
+            {
+                return _fast_math;
+            }
+
+        protected:
+            bool _fast_math = false; // Whether the FastMath kernel is used
+        };
+
+        /**
+         * @brief ReLU activation
+         */
+        class ReLU : public Activation<ActivationType::RELU>
+        {
+        public:
+            template <typename Derived>
+            typename Derived::PlainObject forward(const Eigen::MatrixBase<Derived> &x) const
+            {
+                return x.cwiseMax(0.);
+            }
+        };
+
+        /**
+         * @brief Sigmoid activation
+         */
+        class Sigmoid : public FastMathActivation<ActivationType::SIGMOID, NNFS::Sigmoid>
+        {
+        public:
+            template <typename Derived>
+            typename Derived::PlainObject forward(const Eigen::MatrixBase<Derived> &x) const
+            {
+                typename Derived::PlainObject y = x;
+                if (_fast_math)
+                {
+                    FastMath::sigmoid(y.data(), y.data(), y.size());
+                    return y;
+                }
+                return (1. / (1. + (-y.array()).exp())).matrix();
+            }
+        };
+
+        /**
+         * @brief Tanh activation
+         */
+        class Tanh : public FastMathActivation<ActivationType::TANH, NNFS::Tanh>
+        {
+        public:
+            template <typename Derived>
+            typename Derived::PlainObject forward(const Eigen::MatrixBase<Derived> &x) const
+            {
+                typename Derived::PlainObject y = x;
+                if (_fast_math)
+                {
+                    FastMath::tanh(y.data(), y.data(), y.size());
+                    return y;
+                }
+                return y.array().tanh().matrix();
+            }
+        };
+
+        /**
+         * @brief Softmax activation
+         */
+        class Softmax : public FastMathActivation<ActivationType::SOFTMAX, NNFS::Softmax>
+        {
+        public:
+            template <typename Derived>
+            typename Derived::PlainObject forward(const Eigen::MatrixBase<Derived> &x) const
+            {
+                typename Derived::PlainObject e = (x.array() - x.maxCoeff()).matrix();
+                if (_fast_math)
+                {
+                    FastMath::exp(e.data(), e.data(), e.size());
+                }
+                else
+                {
+                    e = e.array().exp().matrix();
+                }
+                return e / e.sum();
+            }
+        };
+    } // namespace Static
+
+    /**
+     * @brief Neural network with every shape fixed at compile time, for serving tiny models
+     *
+     * @details For small models such as StaticNetwork<Static::Dense<2, 64>, Static::ReLU, Static::Dense<64, 3>> the virtual calls,
+     * dynamic sizes and allocations of NeuralNetwork cost more than the arithmetic. Here the layers are held by value, every
+     * intermediate result is a fixed-size Eigen vector on the stack and the whole forward pass is inlined, so a prediction does not
+     * allocate. Layer shapes that do not chain fail to compile. Meant for inference only: train a NeuralNetwork with the same layers and
+     * copy it with load(). Fixed-size matrices live on the stack, so layers are limited by EIGEN_STACK_ALLOCATION_LIMIT (128 KB by
+     * default, e.g. 128 x 128 weights).
+     *
+     * @tparam Layers Static layers, e.g. Static::Dense<2, 64>, Static::ReLU
+     */
+    template <typename... Layers>
+    class StaticNetwork
+    {
+        static_assert(sizeof...(Layers) > 0, "A static network needs at least one layer.");
+        static_assert(!std::tuple_element<0, std::tuple<Layers...>>::type::activation, "The first layer of a static network must be a dense layer.");
+
+        template <size_t Index, typename Input>
+        using Result = decltype(std::declval<const typename std::tuple_element<Index, std::tuple<Layers...>>::type &>().forward(std::declval<const Input &>()));
+
+        // Output type of the layers from Index on
+        template <size_t Index, typename Input, typename Enable = void>
+        struct Chain
+        {
+            using Output = typename Chain<Index + 1, Result<Index, Input>>::Output;
+        };
+        template <size_t Index, typename Input>
+        struct Chain<Index, Input, typename std::enable_if<Index == sizeof...(Layers)>::type>
+        {
+            using Output = Input;
+        };
+
+        using Last = typename std::tuple_element<sizeof...(Layers) - 1, std::tuple<Layers...>>::type;
+
+    public:
+        using Input = typename std::tuple_element<0, std::tuple<Layers...>>::type::Input; // Input sample
+        using Output = typename Chain<0, Input>::Output;                                    // Output sample
+
+    public:
+        /**
+         * @brief Copies the parameters of a trained network
+         *
+         * @details The fast math setting of the sigmoid, tanh and softmax layers is copied along with the parameters. Nothing is changed if
+         * any layer does not match.
+         *
+         * @param[in] network Network with the same layers, in the same order
+         *
+         * @return bool True if the layers matched and were copied
+         */
+        bool load(const NeuralNetwork &network)
+        {
+            if (network.layer_count() != static_cast<int>(sizeof...(Layers)))
+            {
+                LOG_ERROR("The network has " << network.layer_count() << " layers, the static network " << sizeof...(Layers) << ".");
+                return false;
+            }
+
+            // Layers are loaded into a copy, so a mismatch found at a later layer leaves the network as it was
+            std::unique_ptr<std::tuple<Layers...>> loaded = std::make_unique<std::tuple<Layers...>>();
+            if (!assign<0>(network, *loaded))
+            {
+                LOG_ERROR("The layers of the network do not match the types and shapes of the static network.");
+                return false;
+            }
+            _layers = *loaded;
+            return true;
+        }
+
+        /**
+         * @brief Predicts the class scores of a single sample
+         *
+         * @details Like NeuralNetwork::predict(), a softmax is applied if the last layer is not an activation.
+         *
+         * @param[in] sample Input sample
+         *
+         * @return Output Prediction
+         */
+        Output predict(const Input &sample) const
+        {
+            Output prediction = forward<0>(sample);
+            if constexpr (!Last::activation)
+            {
+                prediction = Static::Softmax().forward(prediction);
+            }
+            return prediction;
+        }
+
+        /**
+         * @brief Predicts the class scores of a batch, one sample per row
+         *
+         * @param[in] samples Input samples
+         *
+         * @return Eigen::MatrixXd Predictions, one per row, empty if the samples do not have the input width
+         */
+        Eigen::MatrixXd predict(const Eigen::MatrixXd &samples) const
+        {
+            if (samples.cols() != Input::ColsAtCompileTime)
+            {
+                LOG_ERROR("Input dimension of the static network does not match the dimension of the provided samples.");
+                return Eigen::MatrixXd();
+            }
+
+            Eigen::MatrixXd predictions(samples.rows(), Output::ColsAtCompileTime);
+            for (Eigen::Index row = 0; row < samples.rows(); ++row)
+            {
+                predictions.row(row) = predict(Input(samples.row(row)));
+            }
+            return predictions;
+        }
+
+        /**
+         * @brief Get a layer
+         *
+         * @tparam Index Index of the layer
+         *
+         * @return Layer at that index
+         */
+        template <size_t Index>
+        typename std::tuple_element<Index, std::tuple<Layers...>>::type &layer()
+        {
+            return std::get<Index>(_layers);
+        }
+
+    private:
+        template <size_t Index, typename Derived>
+        auto forward(const Derived &x) const
+        {
+            if constexpr (Index == sizeof...(Layers))
+            {
+                return x;
+            }
+            else
+            {
+                return forward<Index + 1>(std::get<Index>(_layers).forward(x));
+            }
+        }
+
+        template <size_t Index>
+        static bool assign(const NeuralNetwork &network, std::tuple<Layers...> &layers)
+        {
+            if constexpr (Index == sizeof...(Layers))
+            {
+                return true;
+            }
+            else
+            {
+                return std::get<Index>(layers).assign(network.layer(static_cast<int>(Index))) && assign<Index + 1>(network, layers);
+            }
+        }
+
+        std::tuple<Layers...> _layers; // Layers of the network
+    };
+} // namespace NNFS
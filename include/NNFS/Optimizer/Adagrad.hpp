@@ -2,6 +2,7 @@
 
 #include <Eigen/Dense>
 #include "Optimizer.hpp"
+#include "../Utilities/Kernels.hpp"
 
 namespace NNFS
 {
@@ -31,25 +32,39 @@ namespace NNFS
          */
         void update_params(std::shared_ptr<Dense> &layer)
         {
-            Eigen::MatrixXd weights = layer->weights();
-            Eigen::MatrixXd biases = layer->biases();
-            Eigen::MatrixXd dweights = layer->dweights();
-            Eigen::MatrixXd dbiases = layer->dbiases();
-
-            Eigen::MatrixXd weights_cache = layer->weights_optimizer();
-            Eigen::MatrixXd biases_cache = layer->biases_optimizer();
+            layer->update([this](double *parameters, const double *gradients, double *cache, double *, Eigen::Index n)
+                          { Kernels::adagrad(parameters, cache, gradients, n, _current_lr, _epsilon); });
+        }
 
-            weights_cache += dweights.cwisePow(2);
-            biases_cache += dbiases.cwisePow(2);
+        /**
+         * @brief Update the rows of the embedding table used by the last batch
+         *
+         * @param[in,out] layer Layer to update
+         */
+        void update_params(std::shared_ptr<Embedding> &layer)
+        {
+            const std::vector<int> &rows = layer->rows();
+            const Eigen::MatrixXd &drows = layer->drows();
+            Eigen::MatrixXd &cache = layer->table_optimizer();
 
-            weights += (-_current_lr * dweights.array() / (weights_cache.array().sqrt() + _epsilon)).matrix();
-            biases += (-_current_lr * dbiases.array() / (biases_cache.array().sqrt() + _epsilon)).matrix();
+            Eigen::MatrixXd updates(drows.rows(), drows.cols());
+            for (size_t k = 0; k < rows.size(); ++k)
+            {
+                cache.row(rows[k]) += drows.row(k).cwisePow(2);
+                updates.row(k) = -_current_lr * drows.row(k).array() / (cache.row(rows[k]).array().sqrt() + _epsilon);
+            }
 
-            layer->weights_optimizer(weights_cache);
-            layer->biases_optimizer(biases_cache);
+            layer->update_rows(updates);
+        }
 
-            layer->weights(weights);
-            layer->biases(biases);
+        /**
+         * @brief Get the number of optimizer state matrices updated along with every parameter matrix
+         *
+         * @return int Gradient caches
+         */
+        int state_matrices() const
+        {
+            return 1;
         }
 
     private:
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Optimizer.hpp"
+#include "../Utilities/Kernels.hpp"
 
 namespace NNFS
 {
@@ -33,40 +34,51 @@ namespace NNFS
          */
         void update_params(std::shared_ptr<Dense> &layer)
         {
-            Eigen::MatrixXd weights = layer->weights();
-            Eigen::MatrixXd biases = layer->biases();
-            Eigen::MatrixXd dweights = layer->dweights();
-            Eigen::MatrixXd dbiases = layer->dbiases();
+            double momentums_correction = 1 - std::pow(_beta_1, (_iterations + 1));
+            double cache_correction = 1 - std::pow(_beta_2, (_iterations + 1));
 
-            Eigen::MatrixXd weights_cache = layer->weights_optimizer();
-            Eigen::MatrixXd biases_cache = layer->biases_optimizer();
-
-            Eigen::MatrixXd weights_momentums = layer->weights_optimizer_additional();
-            Eigen::MatrixXd biases_momentums = layer->biases_optimizer_additional();
-
-            weights_momentums = _beta_1 * weights_momentums + (1 - _beta_1) * dweights;
-            biases_momentums = _beta_1 * biases_momentums + (1 - _beta_1) * dbiases;
-
-            Eigen::MatrixXd weights_momentums_corrected = weights_momentums / (1 - std::pow(_beta_1, (_iterations + 1)));
-            Eigen::MatrixXd biases_momentums_corrected = biases_momentums / (1 - std::pow(_beta_1, (_iterations + 1)));
+            layer->update([&](double *parameters, const double *gradients, double *cache, double *momentums, Eigen::Index n)
+                          { Kernels::adam(parameters, cache, momentums, gradients, n, _current_lr, _epsilon, _beta_1, _beta_2, momentums_correction, cache_correction); });
+        }
 
-            weights_cache = _beta_2 * weights_cache + (1 - _beta_2) * dweights.cwisePow(2);
-            biases_cache = _beta_2 * biases_cache + (1 - _beta_2) * dbiases.cwisePow(2);
+        /**
+         * @brief Update the rows of the embedding table used by the last batch
+         *
+         * @details Lazy Adam: the moments of a row only decay when the row is used, the bias correction uses the global iteration count.
+         *
+         * @param[in,out] layer Layer to update
+         */
+        void update_params(std::shared_ptr<Embedding> &layer)
+        {
+            const std::vector<int> &rows = layer->rows();
+            const Eigen::MatrixXd &drows = layer->drows();
+            Eigen::MatrixXd &cache = layer->table_optimizer();
+            Eigen::MatrixXd &momentums = layer->table_optimizer_additional();
 
-            Eigen::MatrixXd weights_cache_corrected = weights_cache / (1 - std::pow(_beta_2, (_iterations + 1)));
-            Eigen::MatrixXd biases_cache_corrected = biases_cache / (1 - std::pow(_beta_2, (_iterations + 1)));
+            double momentums_correction = 1 - std::pow(_beta_1, (_iterations + 1));
+            double cache_correction = 1 - std::pow(_beta_2, (_iterations + 1));
 
-            weights += ((-_current_lr * weights_momentums_corrected).array() / (weights_cache_corrected.cwisePow(.5).array() + _epsilon)).matrix();
-            biases += ((-_current_lr * biases_momentums_corrected).array() / (biases_cache_corrected.cwisePow(.5).array() + _epsilon)).matrix();
+            Eigen::MatrixXd updates(drows.rows(), drows.cols());
+            for (size_t k = 0; k < rows.size(); ++k)
+            {
+                momentums.row(rows[k]) = _beta_1 * momentums.row(rows[k]) + (1 - _beta_1) * drows.row(k);
+                cache.row(rows[k]) = _beta_2 * cache.row(rows[k]) + (1 - _beta_2) * drows.row(k).cwisePow(2);
 
-            layer->weights_optimizer(weights_cache);
-            layer->biases_optimizer(biases_cache);
+                updates.row(k) = (-_current_lr * momentums.row(rows[k]) / momentums_correction).array() /
+                                 ((cache.row(rows[k]) / cache_correction).cwisePow(.5).array() + _epsilon);
+            }
 
-            layer->weights_optimizer_additional(weights_momentums);
-            layer->biases_optimizer_additional(biases_momentums);
+            layer->update_rows(updates);
+        }
 
-            layer->weights(weights);
-            layer->biases(biases);
+        /**
+         * @brief Get the number of optimizer state matrices updated along with every parameter matrix
+         *
+         * @return int Momentums and caches
+         */
+        int state_matrices() const
+        {
+            return 2;
         }
 
     private:
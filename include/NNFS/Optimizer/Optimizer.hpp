@@ -3,6 +3,7 @@
 #include <Eigen/Dense>
 #include "../Utilities/clue.hpp"
 #include "../Layer/Dense.hpp"
+#include "../Layer/Embedding.hpp"
 
 namespace NNFS
 {
@@ -34,6 +35,27 @@ namespace NNFS
          */
         virtual void update_params(std::shared_ptr<Dense> &layer) = 0;
 
+        /**
+         * @brief Update the rows of the embedding table used by the last batch
+         *
+         * @details Only the rows of Embedding::rows() and their optimizer state are touched (lazy updates), rows that were not used keep
+         * their optimizer state until the next batch that uses them.
+         *
+         * @param[in,out] layer Layer to update
+         */
+        virtual void update_params(std::shared_ptr<Embedding> &layer) = 0;
+
+        /**
+         * @brief Get the number of optimizer state matrices updated along with every parameter matrix (e.g. 2 for the momentums and
+         * caches of Adam), used by Profiler to count the bytes of an update
+         *
+         * @return int Number of state matrices
+         */
+        virtual int state_matrices() const
+        {
+            return 0;
+        }
+
         /**
          * @brief Pre-update parameters (e.g. learning rate decay)
          */
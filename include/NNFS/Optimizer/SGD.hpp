@@ -2,6 +2,7 @@
 
 #include <Eigen/Dense>
 #include "Optimizer.hpp"
+#include "../Utilities/Kernels.hpp"
 
 namespace NNFS
 {
@@ -30,36 +31,41 @@ namespace NNFS
          */
         void update_params(std::shared_ptr<Dense> &layer)
         {
-            Eigen::MatrixXd weights = layer->weights();
-            Eigen::MatrixXd biases = layer->biases();
-            Eigen::MatrixXd dweights = layer->dweights();
-            Eigen::MatrixXd dbiases = layer->dbiases();
-
-            Eigen::MatrixXd weights_updates;
-            Eigen::MatrixXd bias_updates;
-            if (_momentum > 0)
-            {
-                Eigen::MatrixXd weights_momentums = layer->weights_optimizer();
-                Eigen::MatrixXd biases_momentums = layer->biases_optimizer();
-
-                weights_updates = _momentum * weights_momentums - _current_lr * dweights;
+            layer->update([this](double *parameters, const double *gradients, double *momentums, double *, Eigen::Index n)
+                          { Kernels::sgd(parameters, momentums, gradients, n, _current_lr, _momentum); });
+        }
 
-                bias_updates = _momentum * biases_momentums - _current_lr * dbiases;
+        /**
+         * @brief Update the rows of the embedding table used by the last batch
+         *
+         * @param[in,out] layer Layer to update
+         */
+        void update_params(std::shared_ptr<Embedding> &layer)
+        {
+            const std::vector<int> &rows = layer->rows();
+            Eigen::MatrixXd updates = -_current_lr * layer->drows();
 
-                layer->weights_optimizer(weights_updates);
-                layer->biases_optimizer(bias_updates);
-            }
-            else
+            if (_momentum > 0)
             {
-                weights_updates = -_current_lr * dweights;
-                bias_updates = -_current_lr * dbiases;
+                Eigen::MatrixXd &momentums = layer->table_optimizer();
+                for (size_t k = 0; k < rows.size(); ++k)
+                {
+                    updates.row(k) += _momentum * momentums.row(rows[k]);
+                    momentums.row(rows[k]) = updates.row(k);
+                }
             }
 
-            weights += weights_updates;
-            biases += bias_updates;
+            layer->update_rows(updates);
+        }
 
-            layer->weights(weights);
-            layer->biases(biases);
+        /**
+         * @brief Get the number of optimizer state matrices updated along with every parameter matrix
+         *
+         * @return int Momentums, when momentum is used
+         */
+        int state_matrices() const
+        {
+            return _momentum > 0 ? 1 : 0;
         }
 
     private:
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace NNFS
+{
+    /**
+     * @brief Counter of the heap allocations of the process
+     *
+     * @details The counts only move in a program that installs the allocation hook: exactly one translation unit defines
+     * NNFS_COUNT_ALLOCATIONS before including NNFS. On glibc the hook wraps malloc, calloc, realloc and the aligned allocation
+     * functions, so Eigen's storage (which comes from std::malloc) is counted along with operator new. Elsewhere it replaces the global
+     * operator new, and Eigen allocations are not counted.
+     *
+     * Counts are process-wide, so allocations made by other threads during a measurement are included.
+     */
+    class Allocations
+    {
+    public:
+        /**
+         * @brief Whether the allocation hook is installed
+         *
+         * @return bool True if a translation unit defines NNFS_COUNT_ALLOCATIONS
+         */
+        static bool counted()
+        {
+            return installed().load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Get the number of allocations so far
+         *
+         * @return uint64_t Allocations since the start of the process
+         */
+        static uint64_t count()
+        {
+            return counter().load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Get the number of bytes allocated so far
+         *
+         * @return uint64_t Bytes requested since the start of the process, frees are not subtracted
+         */
+        static uint64_t bytes()
+        {
+            return byte_counter().load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Records an allocation, called by the hook
+         *
+         * @param bytes Requested size
+         */
+        static void record(size_t bytes)
+        {
+            counter().fetch_add(1, std::memory_order_relaxed);
+            byte_counter().fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Marks the hook as installed, called by the hook
+         */
+        static bool install()
+        {
+            installed().store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        // Constant-initialized, so they are usable by allocations made before static initialization
+        static std::atomic<uint64_t> &counter()
+        {
+            static std::atomic<uint64_t> count{0};
+            return count;
+        }
+
+        static std::atomic<uint64_t> &byte_counter()
+        {
+            static std::atomic<uint64_t> bytes{0};
+            return bytes;
+        }
+
+        static std::atomic<bool> &installed()
+        {
+            static std::atomic<bool> installed{false};
+            return installed;
+        }
+    };
+
+    /**
+     * @brief Counts the allocations made during its lifetime, see Allocations
+     */
+    class AllocationScope
+    {
+    public:
+        /**
+         * @brief Starts counting
+         */
+        AllocationScope() : _count(Allocations::count()), _bytes(Allocations::bytes()) {}
+
+        /**
+         * @brief Get the number of allocations since construction
+         *
+         * @return uint64_t Allocations
+         */
+        uint64_t count() const
+        {
+            return Allocations::count() - _count;
+        }
+
+        /**
+         * @brief Get the number of bytes allocated since construction
+         *
+         * @return uint64_t Bytes
+         */
+        uint64_t bytes() const
+        {
+            return Allocations::bytes() - _bytes;
+        }
+
+    private:
+        uint64_t _count; // Allocations at construction
+        uint64_t _bytes; // Bytes at construction
+    };
+} // namespace NNFS
+
+#ifdef NNFS_COUNT_ALLOCATIONS
+#ifdef __GLIBC__
+// glibc's own entry points, which the wrappers forward to
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    NNFS::Allocations::record(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    NNFS::Allocations::record(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    NNFS::Allocations::record(size);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size)
+{
+    NNFS::Allocations::record(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size)
+{
+    NNFS::Allocations::record(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **pointer, size_t alignment, size_t size)
+{
+    NNFS::Allocations::record(size);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer ? 0 : ENOMEM;
+}
+#else
+void *operator new(size_t size)
+{
+    NNFS::Allocations::record(size);
+    if (void *pointer = std::malloc(size ? size : 1))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+// Marks the hook as installed during static initialization
+static const bool nnfs_allocations_installed = NNFS::Allocations::install();
+#endif // NNFS_COUNT_ALLOCATIONS
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NNFS_DISPATCH 1 // Kernels are compiled for several x86 instruction sets and selected at run time
+#else
+#define NNFS_DISPATCH 0
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Instruction set levels the hot kernels are compiled for, see Kernels
+     */
+    enum class ISA
+    {
+        BASELINE, // Whatever the library is compiled for, SSE2 on x86-64 without -march
+        SSE4_2,   // SSE4.2
+        AVX2,     // AVX2 and FMA
+        AVX512    // AVX-512F
+    };
+
+    /**
+     * @brief Processor feature detection and selection of the instruction set used by the kernels
+     *
+     * @details The level defaults to the best one the processor supports. It can be lowered with the NNFS_ISA environment variable
+     * (baseline, sse4.2, avx2 or avx512), read on first use, or with level(ISA) at any time, e.g. to compare results or timings across
+     * levels. Only x86 builds with GCC or Clang have kernels beyond ISA::BASELINE.
+     */
+    class CPU
+    {
+    public:
+        /**
+         * @brief Get the best level supported by the processor
+         *
+         * @return ISA Detected level
+         */
+        static ISA detected()
+        {
+#if NNFS_DISPATCH
+            static const ISA isa = []()
+            {
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f"))
+                {
+                    return ISA::AVX512;
+                }
+                if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                {
+                    return ISA::AVX2;
+                }
+                if (__builtin_cpu_supports("sse4.2"))
+                {
+                    return ISA::SSE4_2;
+                }
+                return ISA::BASELINE;
+            }();
+            return isa;
+#else
+            return ISA::BASELINE;
+#endif
+        }
+
+        /**
+         * @brief Get the level used by the kernels
+         *
+         * @return ISA Current level
+         */
+        static ISA level()
+        {
+            return static_cast<ISA>(current().load(std::memory_order_relaxed));
+        }
+
+        /**
+         * @brief Set the level used by the kernels
+         *
+         * @param isa Requested level, lowered to detected() if the processor does not support it
+         *
+         * @return ISA Level now in use
+         */
+        static ISA level(ISA isa)
+        {
+            if (isa > detected())
+            {
+                isa = detected();
+            }
+            current().store(static_cast<int>(isa), std::memory_order_relaxed);
+            return isa;
+        }
+
+        /**
+         * @brief Get the name of a level
+         *
+         * @param isa Level
+         *
+         * @return const char* baseline, sse4.2, avx2 or avx512
+         */
+        static const char *name(ISA isa)
+        {
+            switch (isa)
+            {
+            case ISA::SSE4_2:
+                return "sse4.2";
+            case ISA::AVX2:
+                return "avx2";
+            case ISA::AVX512:
+                return "avx512";
+            default:
+                return "baseline";
+            }
+        }
+
+        /**
+         * @brief Parses the name of a level
+         *
+         * @param[in] name Name as returned by name()
+         * @param[out] isa Level
+         *
+         * @return bool True if the name is known
+         */
+        static bool parse(const std::string &name, ISA &isa)
+        {
+            for (ISA candidate : {ISA::BASELINE, ISA::SSE4_2, ISA::AVX2, ISA::AVX512})
+            {
+                if (name == CPU::name(candidate))
+                {
+                    isa = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        /**
+         * @brief Level in use, initialized from NNFS_ISA or detected()
+         */
+        static std::atomic<int> &current()
+        {
+            static std::atomic<int> isa([]()
+                                        {
+                                            ISA requested = detected();
+                                            const char *variable = std::getenv("NNFS_ISA");
+                                            if (variable && parse(variable, requested) && requested < detected())
+                                            {
+                                                return static_cast<int>(requested);
+                                            }
+                                            return static_cast<int>(detected()); }());
+            return isa;
+        }
+    };
+} // namespace NNFS
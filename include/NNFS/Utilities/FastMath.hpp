@@ -0,0 +1,135 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include "Kernels.hpp"
+
+namespace NNFS
+{
+    /**
+     * @brief Approximate exp, sigmoid and tanh kernels
+     *
+     * @details The element-wise loops are in Kernels, compiled for every instruction set level and selected at run time (see CPU). exp
+     * reduces its argument to r in [-ln2/2, ln2/2], evaluates a degree 7 polynomial of e^r and adds the integer part straight to the
+     * exponent bits. Maximum errors, measured against the standard library over the whole input range and at every level (see
+     * tests/test_fastmath.cpp):
+     *
+     * | kernel  | maximum error                                                    |
+     * |---------|------------------------------------------------------------------|
+     * | exp     | 1e-8 relative, inputs are clamped to [-708, 709], exp(-inf) is 0 |
+     * | sigmoid | 1e-8 relative                                                    |
+     * | tanh    | 5e-9 absolute, 3e-8 relative                                     |
+     *
+     * That is far below what training notices, but results are not bit-identical to the exact kernels, so fast math is opt-in per
+     * activation (see Sigmoid::fast_math(), Tanh::fast_math() and Softmax::fast_math()). The choice is not saved with a model, set it
+     * again after NeuralNetwork::load().
+     */
+    class FastMath
+    {
+    public:
+        static constexpr double max_exp_error = 1e-8;           // Maximum relative error of exp()
+        static constexpr double max_sigmoid_error = 1e-8;       // Maximum relative error of sigmoid()
+        static constexpr double max_tanh_error = 5e-9;          // Maximum absolute error of tanh()
+        static constexpr double max_tanh_relative_error = 3e-8; // Maximum relative error of tanh()
+
+    public:
+        /**
+         * @brief Approximate e^x of every element
+         *
+         * @param[out] out Result, may alias x
+         * @param[in] x Input
+         */
+        static void exp(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
+        {
+            out.resize(x.rows(), x.cols());
+            exp(out.data(), x.data(), x.size());
+        }
+
+        /**
+         * @brief Approximate 1 / (1 + e^-x) of every element
+         *
+         * @param[out] out Result, may alias x
+         * @param[in] x Input
+         */
+        static void sigmoid(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
+        {
+            out.resize(x.rows(), x.cols());
+            sigmoid(out.data(), x.data(), x.size());
+        }
+
+        /**
+         * @brief Approximate tanh of every element
+         *
+         * @param[out] out Result, may alias x
+         * @param[in] x Input
+         */
+        static void tanh(Eigen::MatrixXd &out, const Eigen::MatrixXd &x)
+        {
+            out.resize(x.rows(), x.cols());
+            tanh(out.data(), x.data(), x.size());
+        }
+
+        /**
+         * @brief Approximate e^x of n contiguous doubles
+         *
+         * @param[out] out Result, may alias in
+         * @param[in] in Input
+         * @param[in] n Number of elements
+         */
+        static void exp(double *out, const double *in, Eigen::Index n)
+        {
+            Kernels::exp(out, in, n);
+        }
+
+        /**
+         * @brief Approximate 1 / (1 + e^-x) of n contiguous doubles
+         *
+         * @param[out] out Result, may alias in
+         * @param[in] in Input
+         * @param[in] n Number of elements
+         */
+        static void sigmoid(double *out, const double *in, Eigen::Index n)
+        {
+            Kernels::sigmoid(out, in, n);
+        }
+
+        /**
+         * @brief Approximate tanh of n contiguous doubles
+         *
+         * @param[out] out Result, may alias in
+         * @param[in] in Input
+         * @param[in] n Number of elements
+         */
+        static void tanh(double *out, const double *in, Eigen::Index n)
+        {
+            Kernels::tanh(out, in, n);
+        }
+
+        /**
+         * @brief Approximate e^x of a single value
+         *
+         * @param x Input, clamped to [-708, 709] so the result stays a normal number
+         *
+         * @return double e^x
+         */
+        static double exp(double x)
+        {
+            double result;
+            Kernels::exp(&result, &x, 1);
+            return result;
+        }
+
+        /**
+         * @brief Approximate tanh of a single value
+         *
+         * @param x Input
+         *
+         * @return double tanh(x)
+         */
+        static double tanh(double x)
+        {
+            double result;
+            tanh(&result, &x, 1);
+            return result;
+        }
+    };
+} // namespace NNFS
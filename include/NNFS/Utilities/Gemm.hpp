@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include <Eigen/Dense>
+#include "clue.hpp"
+#include "Kernels.hpp"
+#include "Threading.hpp"
+
+#ifdef NNFS_BLAS
+// Fortran BLAS interface, exported by OpenBLAS, MKL and the reference BLAS alike
+extern "C" void dgemm_(const char *transa, const char *transb, const int *m, const int *n, const int *k, const double *alpha, const double *a,
+                       const int *lda, const double *b, const int *ldb, const double *beta, double *c, const int *ldc);
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Implementations of the matrix products of the dense layers
+     */
+    enum class GemmBackend
+    {
+        AUTOMATIC, // The small-matrix kernel for a few rows, else BLAS if it was built in, else the packed kernel
+        EIGEN,     // Eigen's product
+        BLAS,      // The system BLAS dgemm, only with the NNFS_USE_BLAS CMake option
+        BUILTIN    // The kernels of Kernels, small_gemm() for a few rows and gemm() for the others
+    };
+
+    /**
+     * @brief Matrix product used by Dense::forward() and Dense::backward(), with a backend selectable at run time
+     *
+     * @details The backend defaults to GemmBackend::AUTOMATIC. It can be changed with the NNFS_GEMM environment variable (automatic, eigen,
+     * blas or builtin), read on first use, or with backend(GemmBackend) at any time. An optimized BLAS is usually the fastest for large
+     * batches, while small_gemm() avoids the packing and blocking overhead of every other backend on batch-1 inference. The BLAS backend
+     * needs a build with the NNFS_USE_BLAS CMake option, which links the BLAS found by FindBLAS (pick one with BLA_VENDOR, e.g. OpenBLAS
+     * or Intel10_64lp) and defines NNFS_BLAS.
+     *
+     * Built-in products large enough are split over Threading::intra_op(), along the longer of the rows and the columns of C. Eigen and
+     * BLAS products use the threads of their own runtime.
+     */
+    class Gemm
+    {
+    public:
+        static constexpr Eigen::Index small_rows = 4;    // Products with at most this many rows use Kernels::small_gemm() by default
+        static constexpr double parallel_work = 1 << 20; // Multiply-adds per thread below which built-in products are not split
+
+    public:
+        /**
+         * @brief Get the backend in use
+         *
+         * @return GemmBackend Current backend
+         */
+        static GemmBackend backend()
+        {
+            return static_cast<GemmBackend>(current().load(std::memory_order_relaxed));
+        }
+
+        /**
+         * @brief Set the backend
+         *
+         * @param backend Requested backend
+         *
+         * @return bool True if the backend is available and now in use
+         */
+        static bool backend(GemmBackend backend)
+        {
+            if (!available(backend))
+            {
+                LOG_ERROR("The " << name(backend) << " GEMM backend is not available, build with the NNFS_USE_BLAS CMake option.");
+                return false;
+            }
+            current().store(static_cast<int>(backend), std::memory_order_relaxed);
+            return true;
+        }
+
+        /**
+         * @brief Whether a backend was built in
+         *
+         * @param backend Backend
+         *
+         * @return bool False only for GemmBackend::BLAS without NNFS_BLAS
+         */
+        static bool available(GemmBackend backend)
+        {
+#ifdef NNFS_BLAS
+            (void)backend;
+            return true;
+#else
+            return backend != GemmBackend::BLAS;
+#endif
+        }
+
+        /**
+         * @brief Get the name of a backend
+         *
+         * @param backend Backend
+         *
+         * @return const char* automatic, eigen, blas or builtin
+         */
+        static const char *name(GemmBackend backend)
+        {
+            switch (backend)
+            {
+            case GemmBackend::EIGEN:
+                return "eigen";
+            case GemmBackend::BLAS:
+                return "blas";
+            case GemmBackend::BUILTIN:
+                return "builtin";
+            default:
+                return "automatic";
+            }
+        }
+
+        /**
+         * @brief Parses the name of a backend
+         *
+         * @param[in] name Name as returned by name()
+         * @param[out] backend Backend
+         *
+         * @return bool True if the name is known
+         */
+        static bool parse(const std::string &name, GemmBackend &backend)
+        {
+            for (GemmBackend candidate : {GemmBackend::AUTOMATIC, GemmBackend::EIGEN, GemmBackend::BLAS, GemmBackend::BUILTIN})
+            {
+                if (name == Gemm::name(candidate))
+                {
+                    backend = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Matrix product C = op(A) * op(B) of column-major matrices with the current backend, see Kernels::gemm() for the arguments
+         */
+        static void gemm(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda,
+                         const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            switch (backend())
+            {
+            case GemmBackend::EIGEN:
+                Kernels::eigen_gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                break;
+            case GemmBackend::BLAS:
+                blas(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                break;
+            case GemmBackend::BUILTIN:
+                builtin(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                break;
+            default:
+#ifdef NNFS_BLAS
+                if (m > small_rows)
+                {
+                    blas(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                    break;
+                }
+#endif
+                builtin(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                break;
+            }
+        }
+
+        /**
+         * @brief Matrix product out = op(a) * op(b) through gemm()
+         *
+         * @param[out] out Result, resized, may alias a or b
+         * @param[in] a Left operand
+         * @param[in] transpose_a Whether a is transposed
+         * @param[in] b Right operand
+         * @param[in] transpose_b Whether b is transposed
+         */
+        static void product(Eigen::MatrixXd &out, const Eigen::MatrixXd &a, bool transpose_a, const Eigen::MatrixXd &b, bool transpose_b)
+        {
+            if (&out == &a || &out == &b)
+            {
+                Eigen::MatrixXd result;
+                product(result, a, transpose_a, b, transpose_b);
+                out.swap(result);
+                return;
+            }
+
+            out.resize(transpose_a ? a.cols() : a.rows(), transpose_b ? b.rows() : b.cols());
+            gemm(transpose_a, transpose_b, out.rows(), out.cols(), transpose_a ? a.rows() : a.cols(), a.data(), a.rows(), b.data(), b.rows(),
+                 out.data(), out.rows());
+        }
+
+    private:
+        static void builtin(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda,
+                            const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            if (m <= small_rows)
+            {
+                Kernels::small_gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                return;
+            }
+
+            ThreadPool &pool = Threading::intra_op();
+            const Eigen::Index tasks = std::min<Eigen::Index>(pool.size(), static_cast<Eigen::Index>(static_cast<double>(m) * n * k / parallel_work));
+            if (tasks <= 1)
+            {
+                Kernels::gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                return;
+            }
+
+            // Slices in multiples of 24 rows or columns, a multiple of the register blocks of every level
+            const Eigen::Index length = std::max(m, n);
+            const Eigen::Index grain = ((length + tasks - 1) / tasks + 23) / 24 * 24;
+            pool.parallel_for(0, length, grain, [&](int64_t begin, int64_t end)
+                              {
+                                  const Eigen::Index size = end - begin;
+                                  if (n >= m)
+                                  {
+                                      const double *columns = transpose_b ? b + begin : b + begin * ldb;
+                                      Kernels::gemm(transpose_a, transpose_b, m, size, k, a, lda, columns, ldb, c + begin * ldc, ldc);
+                                  }
+                                  else
+                                  {
+                                      const double *rows = transpose_a ? a + begin * lda : a + begin;
+                                      Kernels::gemm(transpose_a, transpose_b, size, n, k, rows, lda, b, ldb, c + begin, ldc);
+                                  } });
+        }
+
+        static void blas(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda,
+                         const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+#ifdef NNFS_BLAS
+            // 32-bit BLAS integers, larger products and empty ones (which some BLAS reject) go to Eigen
+            constexpr Eigen::Index limit = std::numeric_limits<int>::max();
+            if (m > 0 && n > 0 && k > 0 && m <= limit && n <= limit && k <= limit && lda <= limit && ldb <= limit && ldc <= limit)
+            {
+                const char ta = transpose_a ? 'T' : 'N', tb = transpose_b ? 'T' : 'N';
+                const int im = static_cast<int>(m), in = static_cast<int>(n), ik = static_cast<int>(k);
+                const int ilda = static_cast<int>(lda), ildb = static_cast<int>(ldb), ildc = static_cast<int>(ldc);
+                const double alpha = 1., beta = 0.;
+                dgemm_(&ta, &tb, &im, &in, &ik, &alpha, a, &ilda, b, &ildb, &beta, c, &ildc);
+                return;
+            }
+#endif
+            Kernels::eigen_gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+        }
+
+        /**
+         * @brief Backend in use, initialized from NNFS_GEMM or GemmBackend::AUTOMATIC
+         */
+        static std::atomic<int> &current()
+        {
+            static std::atomic<int> backend([]()
+                                            {
+                                                GemmBackend requested = GemmBackend::AUTOMATIC;
+                                                const char *variable = std::getenv("NNFS_GEMM");
+                                                if (variable && parse(variable, requested) && available(requested))
+                                                {
+                                                    return static_cast<int>(requested);
+                                                }
+                                                return static_cast<int>(GemmBackend::AUTOMATIC); }());
+            return backend;
+        }
+    };
+} // namespace NNFS
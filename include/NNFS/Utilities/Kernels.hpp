@@ -0,0 +1,773 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Dense>
+#include "CPU.hpp"
+#include "Memory.hpp"
+
+// The clamps and selections of the kernels are plain conditionals, GCC only turns them into SIMD min, max and blends without trapping
+// math, and the square roots of the optimizers into SIMD square roots without errno. The loops are vectorized at -O2 as well, whose
+// cost model otherwise skips any loop that needs a remainder
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("no-trapping-math", "no-math-errno", "tree-vectorize", "vect-cost-model=dynamic")
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NNFS_INLINE inline __attribute__((always_inline))
+#else
+#define NNFS_INLINE inline
+#endif
+
+// Fully unrolls the loops over the registers of the micro-kernel, which -O2 leaves rolled
+#if defined(__GNUC__) && !defined(__clang__)
+#define NNFS_UNROLL _Pragma("GCC unroll 16")
+#elif defined(__clang__)
+#define NNFS_UNROLL _Pragma("unroll")
+#else
+#define NNFS_UNROLL
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Hot kernels compiled for every instruction set level of ISA and selected at run time
+     *
+     * @details Distributable builds have no -march flag, so Eigen only uses SSE2. The kernels below are written once as plain loops (and a
+     * GEMM micro-kernel on GCC vector extensions) and compiled a second, third and fourth time with SSE4.2, AVX2 + FMA and AVX-512
+     * function attributes. Every call goes through the function table of CPU::level(), so the level can be changed at any time.
+     *
+     * - gemm(): packed, register-blocked matrix product for AVX2 and AVX-512. The baseline and SSE4.2 levels use Eigen's product, which is
+     *   as fast at 128 bits.
+     * - small_gemm(): matrix product of a few rows, e.g. a batch-1 forward or backward pass, without packing.
+     * - exp(), sigmoid(), tanh(): the approximate kernels of FastMath, also used by the fast-math softmax.
+     * - sgd(), adagrad(), rmsprop(), adam(): the in-place parameter updates of the optimizers, see Dense::update().
+     *
+     * Results of different levels agree to rounding: wider levels contract multiplications and additions into FMAs and sum GEMM products
+     * in a different order.
+     */
+    class Kernels
+    {
+    public:
+        /**
+         * @brief Matrix product C = op(A) * op(B) of column-major matrices
+         *
+         * @param[in] transpose_a Whether op(A) is A transposed
+         * @param[in] transpose_b Whether op(B) is B transposed
+         * @param[in] m Rows of op(A) and C
+         * @param[in] n Columns of op(B) and C
+         * @param[in] k Columns of op(A) and rows of op(B)
+         * @param[in] a A
+         * @param[in] lda Distance between the columns of A
+         * @param[in] b B
+         * @param[in] ldb Distance between the columns of B
+         * @param[out] c C, must not overlap A or B
+         * @param[in] ldc Distance between the columns of C
+         */
+        static void gemm(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda,
+                         const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            table().gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+        }
+
+        /**
+         * @brief Matrix product of a few rows, same arguments as gemm()
+         *
+         * @details Meant for m up to a handful of rows, where packing costs more than the product. The rows of op(A) are copied once, then
+         * every element of C is a vectorized dot product with a column of B, or, when B is transposed, every row of C accumulates the
+         * contiguous rows of B. Works for any m, but reads B m times.
+         */
+        static void small_gemm(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda,
+                               const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            table().small_gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+        }
+
+        /**
+         * @brief Matrix product with Eigen, same arguments as gemm()
+         *
+         * @details Used by gemm() at the levels whose vectors are not wider than SSE2, and for products too thin for its blocks.
+         */
+        static void eigen_gemm(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda,
+                               const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            using Input = Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<>>;
+            Input A(a, transpose_a ? k : m, transpose_a ? m : k, Eigen::OuterStride<>(lda));
+            Input B(b, transpose_b ? n : k, transpose_b ? k : n, Eigen::OuterStride<>(ldb));
+            Eigen::Map<Eigen::MatrixXd, 0, Eigen::OuterStride<>> C(c, m, n, Eigen::OuterStride<>(ldc));
+
+            if (transpose_a && transpose_b)
+            {
+                C.noalias() = A.transpose() * B.transpose();
+            }
+            else if (transpose_a)
+            {
+                C.noalias() = A.transpose() * B;
+            }
+            else if (transpose_b)
+            {
+                C.noalias() = A * B.transpose();
+            }
+            else
+            {
+                C.noalias() = A * B;
+            }
+        }
+
+        /**
+         * @brief Approximate e^x of n contiguous doubles, see FastMath::exp()
+         *
+         * @param[out] out Result, may alias in
+         * @param[in] in Input
+         * @param[in] n Number of elements
+         */
+        static void exp(double *out, const double *in, Eigen::Index n)
+        {
+            table().exp(out, in, n);
+        }
+
+        /**
+         * @brief Approximate 1 / (1 + e^-x) of n contiguous doubles, see FastMath::sigmoid()
+         *
+         * @param[out] out Result, may alias in
+         * @param[in] in Input
+         * @param[in] n Number of elements
+         */
+        static void sigmoid(double *out, const double *in, Eigen::Index n)
+        {
+            table().sigmoid(out, in, n);
+        }
+
+        /**
+         * @brief Approximate tanh of n contiguous doubles, see FastMath::tanh()
+         *
+         * @param[out] out Result, may alias in
+         * @param[in] in Input
+         * @param[in] n Number of elements
+         */
+        static void tanh(double *out, const double *in, Eigen::Index n)
+        {
+            table().tanh(out, in, n);
+        }
+
+        /**
+         * @brief SGD update, with momentum: momentums = momentum * momentums - learning_rate * gradients and parameters += momentums
+         *
+         * @param[in,out] parameters Parameters
+         * @param[in,out] momentums Momentums, unused without momentum
+         * @param[in] gradients Gradients
+         * @param[in] n Number of parameters
+         * @param[in] learning_rate Current learning rate
+         * @param[in] momentum Momentum, 0 for plain SGD
+         */
+        static void sgd(double *parameters, double *momentums, const double *gradients, Eigen::Index n, double learning_rate, double momentum)
+        {
+            table().sgd(parameters, momentums, gradients, n, learning_rate, momentum);
+        }
+
+        /**
+         * @brief Adagrad update: cache += gradients^2 and parameters -= learning_rate * gradients / (sqrt(cache) + epsilon)
+         *
+         * @param[in,out] parameters Parameters
+         * @param[in,out] cache Sums of the squared gradients
+         * @param[in] gradients Gradients
+         * @param[in] n Number of parameters
+         * @param[in] learning_rate Current learning rate
+         * @param[in] epsilon Added to the root of the cache
+         */
+        static void adagrad(double *parameters, double *cache, const double *gradients, Eigen::Index n, double learning_rate, double epsilon)
+        {
+            table().adagrad(parameters, cache, gradients, n, learning_rate, epsilon);
+        }
+
+        /**
+         * @brief RMSProp update: cache = rho * cache + (1 - rho) * gradients^2 and parameters -= learning_rate * gradients / (sqrt(cache) +
+         * epsilon)
+         *
+         * @param[in,out] parameters Parameters
+         * @param[in,out] cache Moving averages of the squared gradients
+         * @param[in] gradients Gradients
+         * @param[in] n Number of parameters
+         * @param[in] learning_rate Current learning rate
+         * @param[in] epsilon Added to the root of the cache
+         * @param[in] rho Decay of the cache
+         */
+        static void rmsprop(double *parameters, double *cache, const double *gradients, Eigen::Index n, double learning_rate, double epsilon,
+                            double rho)
+        {
+            table().rmsprop(parameters, cache, gradients, n, learning_rate, epsilon, rho);
+        }
+
+        /**
+         * @brief Adam update of the moments and the parameters
+         *
+         * @param[in,out] parameters Parameters
+         * @param[in,out] cache Moving averages of the squared gradients
+         * @param[in,out] momentums Moving averages of the gradients
+         * @param[in] gradients Gradients
+         * @param[in] n Number of parameters
+         * @param[in] learning_rate Current learning rate
+         * @param[in] epsilon Added to the root of the corrected cache
+         * @param[in] beta_1 Decay of the momentums
+         * @param[in] beta_2 Decay of the cache
+         * @param[in] momentums_correction Bias correction of the momentums, 1 - beta_1^t
+         * @param[in] cache_correction Bias correction of the cache, 1 - beta_2^t
+         */
+        static void adam(double *parameters, double *cache, double *momentums, const double *gradients, Eigen::Index n, double learning_rate,
+                         double epsilon, double beta_1, double beta_2, double momentums_correction, double cache_correction)
+        {
+            table().adam(parameters, cache, momentums, gradients, n, learning_rate, epsilon, beta_1, beta_2, momentums_correction, cache_correction);
+        }
+
+        static constexpr double min_exp = -708.; // Smallest exp() input with a normal result
+        static constexpr double max_exp = 709.;  // Largest exp() input with a finite result
+
+    private:
+        /**
+         * @brief Kernels of one instruction set level
+         */
+        struct Table
+        {
+            void (*gemm)(bool, bool, Eigen::Index, Eigen::Index, Eigen::Index, const double *, Eigen::Index, const double *, Eigen::Index, double *,
+                         Eigen::Index);
+            void (*small_gemm)(bool, bool, Eigen::Index, Eigen::Index, Eigen::Index, const double *, Eigen::Index, const double *, Eigen::Index,
+                               double *, Eigen::Index);
+            void (*exp)(double *, const double *, Eigen::Index);
+            void (*sigmoid)(double *, const double *, Eigen::Index);
+            void (*tanh)(double *, const double *, Eigen::Index);
+            void (*sgd)(double *, double *, const double *, Eigen::Index, double, double);
+            void (*adagrad)(double *, double *, const double *, Eigen::Index, double, double);
+            void (*rmsprop)(double *, double *, const double *, Eigen::Index, double, double, double);
+            void (*adam)(double *, double *, double *, const double *, Eigen::Index, double, double, double, double, double, double);
+        };
+
+        // The packed product is written on GCC vector extensions, only the levels of NNFS_DISPATCH builds use it
+#if defined(__GNUC__)
+        /**
+         * @brief Packed matrix product
+         *
+         * @details Goto's scheme: blocks of kc rows of op(B) and then mc x kc blocks of op(A) are copied into contiguous panels, B in strips
+         * of NR columns and A in strips of MR = W * MV rows, zero-padded at the edges. The micro-kernel keeps an MR x NR block of C in
+         * NR * MV vector registers and adds the product of one A strip and one B strip, one rank-1 update per row of the strips. The A
+         * block stays in L2 and the B strip in L1 while they are reused. Products too thin to fill a strip go to Eigen.
+         *
+         * @tparam W Doubles per vector register
+         * @tparam MV Vector registers per column of the C block
+         * @tparam NR Columns of the C block
+         */
+        template <int W, int MV, int NR>
+        static NNFS_INLINE void gemm_body(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a,
+                                          Eigen::Index lda, const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            constexpr Eigen::Index MR = W * MV;
+            constexpr Eigen::Index KC = 256;
+            constexpr Eigen::Index MC = 8 * MR;
+            constexpr Eigen::Index NC = 1024 / NR * NR;
+
+            if (m < MR || n < NR || k == 0)
+            {
+                eigen_gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);
+                return;
+            }
+
+            for (Eigen::Index j = 0; j < n; ++j)
+            {
+                std::memset(c + j * ldc, 0, m * sizeof(double));
+            }
+
+            // Panels are 64-byte aligned, they are sized once per thread
+            const size_t a_size = MC * KC;
+            const size_t b_size = ((std::min(n, NC) + NR - 1) / NR * NR) * KC;
+            double *packed_a = Workspace::get(0, a_size + b_size);
+            double *packed_b = packed_a + a_size;
+
+            for (Eigen::Index jc = 0; jc < n; jc += NC)
+            {
+                const Eigen::Index nc = std::min(NC, n - jc);
+                for (Eigen::Index pc = 0; pc < k; pc += KC)
+                {
+                    const Eigen::Index kc = std::min(KC, k - pc);
+
+                    // op(B)(pc + p, jc + j) to packed_b[strip * kc * NR + p * NR + j % NR]
+                    for (Eigen::Index strip = 0; strip * NR < nc; ++strip)
+                    {
+                        double *panel = packed_b + strip * kc * NR;
+                        for (Eigen::Index jj = 0; jj < NR; ++jj)
+                        {
+                            const Eigen::Index j = jc + strip * NR + jj;
+                            for (Eigen::Index p = 0; p < kc; ++p)
+                            {
+                                panel[p * NR + jj] = j < jc + nc ? (transpose_b ? b[j + (pc + p) * ldb] : b[(pc + p) + j * ldb]) : 0.;
+                            }
+                        }
+                    }
+
+                    for (Eigen::Index ic = 0; ic < m; ic += MC)
+                    {
+                        const Eigen::Index mc = std::min(MC, m - ic);
+
+                        // op(A)(ic + i, pc + p) to packed_a[strip * kc * MR + p * MR + i % MR]
+                        for (Eigen::Index strip = 0; strip * MR < mc; ++strip)
+                        {
+                            double *panel = packed_a + strip * kc * MR;
+                            const Eigen::Index rows = std::min(MR, mc - strip * MR);
+                            const Eigen::Index i0 = ic + strip * MR;
+                            for (Eigen::Index p = 0; p < kc; ++p)
+                            {
+                                double *row = panel + p * MR;
+                                if (transpose_a)
+                                {
+                                    for (Eigen::Index i = 0; i < rows; ++i)
+                                    {
+                                        row[i] = a[(pc + p) + (i0 + i) * lda];
+                                    }
+                                }
+                                else
+                                {
+                                    std::memcpy(row, a + i0 + (pc + p) * lda, rows * sizeof(double));
+                                }
+                                for (Eigen::Index i = rows; i < MR; ++i)
+                                {
+                                    row[i] = 0.;
+                                }
+                            }
+                        }
+
+                        for (Eigen::Index jr = 0; jr < nc; jr += NR)
+                        {
+                            const double *panel_b = packed_b + jr / NR * kc * NR;
+                            for (Eigen::Index ir = 0; ir < mc; ir += MR)
+                            {
+                                const double *panel_a = packed_a + ir / MR * kc * MR;
+
+                                micro_kernel<W, MV, NR>(kc, panel_a, panel_b, c + (ic + ir) + (jc + jr) * ldc, ldc, std::min(MR, m - ic - ir),
+                                                        std::min<Eigen::Index>(NR, n - jc - jr));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Adds the product of an A strip and a B strip to an MR x NR block of C
+         *
+         * @param[in] kc Length of the strips
+         * @param[in] a A strip, MR doubles per step
+         * @param[in] b B strip, NR doubles per step
+         * @param[in,out] c Block of C
+         * @param[in] ldc Distance between the columns of C
+         * @param[in] rows Rows of the block inside C, at most MR
+         * @param[in] columns Columns of the block inside C, at most NR
+         */
+        template <int W, int MV, int NR>
+        static NNFS_INLINE void micro_kernel(Eigen::Index kc, const double *__restrict a, const double *__restrict b, double *__restrict c, Eigen::Index ldc,
+                                             Eigen::Index rows, Eigen::Index columns)
+        {
+            typedef double Vector __attribute__((vector_size(W * sizeof(double))));
+
+            Vector accumulators[NR][MV];
+            NNFS_UNROLL
+            for (int j = 0; j < NR; ++j)
+            {
+                NNFS_UNROLL
+                for (int v = 0; v < MV; ++v)
+                {
+                    accumulators[j][v] = Vector{};
+                }
+            }
+
+            for (Eigen::Index p = 0; p < kc; ++p)
+            {
+                Vector column[MV];
+                NNFS_UNROLL
+                for (int v = 0; v < MV; ++v)
+                {
+                    std::memcpy(&column[v], a + p * W * MV + v * W, sizeof(Vector));
+                }
+                NNFS_UNROLL
+                for (int j = 0; j < NR; ++j)
+                {
+                    const double scalar = b[p * NR + j];
+                    NNFS_UNROLL
+                    for (int v = 0; v < MV; ++v)
+                    {
+                        accumulators[j][v] += column[v] * scalar;
+                    }
+                }
+            }
+
+            if (rows == W * MV && columns == NR)
+            {
+                NNFS_UNROLL
+                for (int j = 0; j < NR; ++j)
+                {
+                    NNFS_UNROLL
+                    for (int v = 0; v < MV; ++v)
+                    {
+                        Vector sum;
+                        std::memcpy(&sum, c + j * ldc + v * W, sizeof(Vector));
+                        sum += accumulators[j][v];
+                        std::memcpy(c + j * ldc + v * W, &sum, sizeof(Vector));
+                    }
+                }
+                return;
+            }
+
+            // Stores through a tile so the accumulators never have their address taken and stay in registers
+            alignas(64) double edge[NR][W * MV];
+            for (int j = 0; j < NR; ++j)
+            {
+                for (int v = 0; v < MV; ++v)
+                {
+                    *reinterpret_cast<Vector *>(&edge[j][v * W]) = accumulators[j][v];
+                }
+            }
+            for (Eigen::Index j = 0; j < columns; ++j)
+            {
+                for (Eigen::Index i = 0; i < rows; ++i)
+                {
+                    c[i + j * ldc] += edge[j][i];
+                }
+            }
+        }
+#endif
+
+        /**
+         * @brief Matrix product of a few rows, see small_gemm()
+         *
+         * @tparam W Doubles per vector register
+         */
+        template <int W>
+        static NNFS_INLINE void small_gemm_body(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a,
+                                                Eigen::Index lda, const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)
+        {
+            // Rows of op(A), and the rows of C when B is transposed, sized once per thread
+            const size_t rows_size = static_cast<size_t>(m) * k;
+            const size_t size = rows_size + (transpose_b ? static_cast<size_t>(m) * n : 0);
+            double *rows = Workspace::get(1, size);
+            for (Eigen::Index i = 0; i < m; ++i)
+            {
+                for (Eigen::Index p = 0; p < k; ++p)
+                {
+                    rows[i * k + p] = transpose_a ? a[p + i * lda] : a[i + p * lda];
+                }
+            }
+
+            if (transpose_b)
+            {
+                // C(i, :) = sum over p of op(A)(i, p) * B(:, p), every column of B is a contiguous row of op(B)
+                double *__restrict sums = rows + rows_size;
+                std::fill(sums, sums + m * n, 0.);
+                for (Eigen::Index p = 0; p < k; ++p)
+                {
+                    const double *__restrict row = b + p * ldb;
+                    for (Eigen::Index i = 0; i < m; ++i)
+                    {
+                        const double scalar = rows[i * k + p];
+                        double *__restrict sum = sums + i * n;
+                        for (Eigen::Index j = 0; j < n; ++j)
+                        {
+                            sum[j] += scalar * row[j];
+                        }
+                    }
+                }
+                for (Eigen::Index j = 0; j < n; ++j)
+                {
+                    for (Eigen::Index i = 0; i < m; ++i)
+                    {
+                        c[i + j * ldc] = sums[i * n + j];
+                    }
+                }
+                return;
+            }
+
+            // C(i, j) = op(A)(i, :) . B(:, j), NR columns at a time, two vectors per column to hide the latency of the additions. Compilers
+            // without GCC vector extensions compute every column in the scalar loop below
+            Eigen::Index j = 0;
+#if defined(__GNUC__)
+            typedef double Vector __attribute__((vector_size(W * sizeof(double))));
+            constexpr int NR = 4; // Columns of B per pass, NR * 2 independent accumulators
+            const Eigen::Index vectorized = k / (2 * W) * (2 * W);
+            for (; j + NR <= n; j += NR)
+            {
+                for (Eigen::Index i = 0; i < m; ++i)
+                {
+                    const double *__restrict row = rows + i * k;
+                    Vector accumulators[NR][2];
+                    NNFS_UNROLL
+                    for (int jj = 0; jj < NR; ++jj)
+                    {
+                        accumulators[jj][0] = accumulators[jj][1] = Vector{};
+                    }
+                    for (Eigen::Index p = 0; p < vectorized; p += 2 * W)
+                    {
+                        Vector x[2];
+                        std::memcpy(&x[0], row + p, sizeof(Vector));
+                        std::memcpy(&x[1], row + p + W, sizeof(Vector));
+                        NNFS_UNROLL
+                        for (int jj = 0; jj < NR; ++jj)
+                        {
+                            Vector y[2];
+                            std::memcpy(&y[0], b + p + (j + jj) * ldb, sizeof(Vector));
+                            std::memcpy(&y[1], b + p + W + (j + jj) * ldb, sizeof(Vector));
+                            accumulators[jj][0] += x[0] * y[0];
+                            accumulators[jj][1] += x[1] * y[1];
+                        }
+                    }
+                    NNFS_UNROLL
+                    for (int jj = 0; jj < NR; ++jj)
+                    {
+                        const Vector total = accumulators[jj][0] + accumulators[jj][1];
+                        double lanes[W];
+                        std::memcpy(lanes, &total, sizeof(Vector));
+                        double sum = 0.;
+                        for (int w = 0; w < W; ++w)
+                        {
+                            sum += lanes[w];
+                        }
+                        for (Eigen::Index p = vectorized; p < k; ++p)
+                        {
+                            sum += row[p] * b[p + (j + jj) * ldb];
+                        }
+                        c[i + (j + jj) * ldc] = sum;
+                    }
+                }
+            }
+#endif
+            for (; j < n; ++j)
+            {
+                for (Eigen::Index i = 0; i < m; ++i)
+                {
+                    double sum = 0.;
+                    for (Eigen::Index p = 0; p < k; ++p)
+                    {
+                        sum += rows[i * k + p] * b[p + j * ldb];
+                    }
+                    c[i + j * ldc] = sum;
+                }
+            }
+        }
+
+        /**
+         * @brief e^x for x in [min_exp, max_exp]
+         *
+         * @details Reduces x to r in [-ln2/2, ln2/2], evaluates the degree 7 Taylor polynomial of e^r and adds the integer part straight
+         * to the exponent bits.
+         */
+        static NNFS_INLINE double exp_reduced(double x)
+        {
+            constexpr double log2e = 1.4426950408889634;
+            constexpr double ln2_hi = 6.93147180369123816490e-01; // ln2 split so k * ln2_hi is exact
+            constexpr double ln2_lo = 1.90821492927058770002e-10;
+            constexpr double round = 6755399441055744.0; // 1.5 * 2^52, adding it rounds to an integer kept in the low mantissa bits
+
+            const double shifted = x * log2e + round;
+            const double k = shifted - round;
+            const double r = x - k * ln2_hi - k * ln2_lo;
+
+            // Taylor series of e^r, the truncation error is below r^8 / 8! on [-ln2/2, ln2/2]
+            double p = 1. / 5040.;
+            p = p * r + 1. / 720.;
+            p = p * r + 1. / 120.;
+            p = p * r + 1. / 24.;
+            p = p * r + 1. / 6.;
+            p = p * r + .5;
+            p = p * r + 1.;
+            p = p * r + 1.;
+
+            // The low 12 bits of shifted hold k in two's complement, shifting them into the exponent multiplies p by 2^k
+            uint64_t k_bits, p_bits;
+            std::memcpy(&k_bits, &shifted, sizeof(double));
+            std::memcpy(&p_bits, &p, sizeof(double));
+            p_bits += k_bits << 52;
+            std::memcpy(&p, &p_bits, sizeof(double));
+            return p;
+        }
+
+        /**
+         * @brief x clamped to [min_exp, max_exp]
+         */
+        static NNFS_INLINE double clamp_exp(double x)
+        {
+            x = x < min_exp ? min_exp : x;
+            return x > max_exp ? max_exp : x;
+        }
+
+        /**
+         * @brief Applies function to every element, with a separate loop for in-place calls so both vectorize without overlap checks
+         */
+        template <typename Function>
+        static NNFS_INLINE void map(double *out, const double *in, Eigen::Index n, Function function)
+        {
+            if (out == in)
+            {
+                for (Eigen::Index i = 0; i < n; ++i)
+                {
+                    out[i] = function(out[i]);
+                }
+            }
+            else
+            {
+                double *__restrict result = out;
+                const double *__restrict x = in;
+                for (Eigen::Index i = 0; i < n; ++i)
+                {
+                    result[i] = function(x[i]);
+                }
+            }
+        }
+
+        static NNFS_INLINE void exp_body(double *out, const double *in, Eigen::Index n)
+        {
+            // Clamping -inf would return e^-708 instead of 0, e.g. for the masked logits of a softmax
+            map(out, in, n, [](double x)
+                { return x == -std::numeric_limits<double>::infinity() ? 0. : exp_reduced(clamp_exp(x)); });
+        }
+
+        static NNFS_INLINE void sigmoid_body(double *out, const double *in, Eigen::Index n)
+        {
+            map(out, in, n, [](double x)
+                { return 1. / (1. + exp_reduced(clamp_exp(-x))); });
+        }
+
+        static NNFS_INLINE void tanh_body(double *out, const double *in, Eigen::Index n)
+        {
+            map(out, in, n, [](double x)
+                {
+                    // 1 - 2 / (e^2x + 1) loses the relative precision close to 0, where the Taylor series takes over
+                    const double x2 = x * x;
+                    const double series = x * (1. + x2 * (-1. / 3. + x2 * (2. / 15. + x2 * (-17. / 315. + x2 * (62. / 2835.)))));
+                    const double exact = 1. - 2. / (exp_reduced(clamp_exp(2. * x)) + 1.);
+                    return (x < .125 && x > -.125) ? series : exact; });
+        }
+
+        static NNFS_INLINE void sgd_body(double *__restrict parameters, double *__restrict momentums, const double *__restrict gradients, Eigen::Index n,
+                                         double learning_rate, double momentum)
+        {
+            if (momentum > 0)
+            {
+                for (Eigen::Index i = 0; i < n; ++i)
+                {
+                    momentums[i] = momentum * momentums[i] - learning_rate * gradients[i];
+                    parameters[i] += momentums[i];
+                }
+            }
+            else
+            {
+                for (Eigen::Index i = 0; i < n; ++i)
+                {
+                    parameters[i] += -learning_rate * gradients[i];
+                }
+            }
+        }
+
+        static NNFS_INLINE void adagrad_body(double *__restrict parameters, double *__restrict cache, const double *__restrict gradients, Eigen::Index n,
+                                             double learning_rate, double epsilon)
+        {
+            for (Eigen::Index i = 0; i < n; ++i)
+            {
+                cache[i] += gradients[i] * gradients[i];
+                parameters[i] += -learning_rate * gradients[i] / (std::sqrt(cache[i]) + epsilon);
+            }
+        }
+
+        static NNFS_INLINE void rmsprop_body(double *__restrict parameters, double *__restrict cache, const double *__restrict gradients, Eigen::Index n,
+                                             double learning_rate, double epsilon, double rho)
+        {
+            for (Eigen::Index i = 0; i < n; ++i)
+            {
+                cache[i] = rho * cache[i] + (1 - rho) * (gradients[i] * gradients[i]);
+                parameters[i] += -learning_rate * gradients[i] / (std::sqrt(cache[i]) + epsilon);
+            }
+        }
+
+        static NNFS_INLINE void adam_body(double *__restrict parameters, double *__restrict cache, double *__restrict momentums, const double *__restrict gradients,
+                                          Eigen::Index n, double learning_rate, double epsilon, double beta_1, double beta_2, double momentums_correction,
+                                          double cache_correction)
+        {
+            for (Eigen::Index i = 0; i < n; ++i)
+            {
+                momentums[i] = beta_1 * momentums[i] + (1 - beta_1) * gradients[i];
+                cache[i] = beta_2 * cache[i] + (1 - beta_2) * (gradients[i] * gradients[i]);
+                parameters[i] += (-learning_rate * (momentums[i] / momentums_correction)) / (std::sqrt(cache[i] / cache_correction) + epsilon);
+            }
+        }
+
+// Kernels of one level: Target is the function attribute, Gemm the matrix product and Width the doubles per vector register
+#define NNFS_KERNELS(Level, Target, Gemm, Width)                                                                                                      \
+    struct Level                                                                                                                                      \
+    {                                                                                                                                                 \
+        Target static void gemm(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a, Eigen::Index lda, \
+                                const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)                                                       \
+        {                                                                                                                                             \
+            Gemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);                                                                          \
+        }                                                                                                                                             \
+        Target static void small_gemm(bool transpose_a, bool transpose_b, Eigen::Index m, Eigen::Index n, Eigen::Index k, const double *a,          \
+                                      Eigen::Index lda, const double *b, Eigen::Index ldb, double *c, Eigen::Index ldc)                               \
+        {                                                                                                                                             \
+            small_gemm_body<Width>(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc);                                                        \
+        }                                                                                                                                             \
+        Target static void exp(double *out, const double *in, Eigen::Index n) { exp_body(out, in, n); }                                               \
+        Target static void sigmoid(double *out, const double *in, Eigen::Index n) { sigmoid_body(out, in, n); }                                       \
+        Target static void tanh(double *out, const double *in, Eigen::Index n) { tanh_body(out, in, n); }                                             \
+        Target static void sgd(double *parameters, double *momentums, const double *gradients, Eigen::Index n, double learning_rate, double momentum) \
+        {                                                                                                                                             \
+            sgd_body(parameters, momentums, gradients, n, learning_rate, momentum);                                                                   \
+        }                                                                                                                                             \
+        Target static void adagrad(double *parameters, double *cache, const double *gradients, Eigen::Index n, double learning_rate, double epsilon)  \
+        {                                                                                                                                             \
+            adagrad_body(parameters, cache, gradients, n, learning_rate, epsilon);                                                                    \
+        }                                                                                                                                             \
+        Target static void rmsprop(double *parameters, double *cache, const double *gradients, Eigen::Index n, double learning_rate, double epsilon,   \
+                                   double rho)                                                                                                        \
+        {                                                                                                                                             \
+            rmsprop_body(parameters, cache, gradients, n, learning_rate, epsilon, rho);                                                               \
+        }                                                                                                                                             \
+        Target static void adam(double *parameters, double *cache, double *momentums, const double *gradients, Eigen::Index n, double learning_rate,   \
+                                double epsilon, double beta_1, double beta_2, double momentums_correction, double cache_correction)                   \
+        {                                                                                                                                             \
+            adam_body(parameters, cache, momentums, gradients, n, learning_rate, epsilon, beta_1, beta_2, momentums_correction, cache_correction);     \
+        }                                                                                                                                             \
+        static Table table()                                                                                                                          \
+        {                                                                                                                                             \
+            return {&gemm, &small_gemm, &exp, &sigmoid, &tanh, &sgd, &adagrad, &rmsprop, &adam};                                                                   \
+        }                                                                                                                                             \
+    };
+
+        NNFS_KERNELS(Baseline, , eigen_gemm, 2)
+#if NNFS_DISPATCH
+        NNFS_KERNELS(SSE42, __attribute__((target("sse4.2"))), eigen_gemm, 2)
+        NNFS_KERNELS(AVX2, __attribute__((target("avx2,fma"))), (gemm_body<4, 2, 6>), 4)
+        NNFS_KERNELS(AVX512, __attribute__((target("avx512f,avx2,fma"))), (gemm_body<8, 2, 6>), 8)
+#endif
+
+#undef NNFS_KERNELS
+
+        /**
+         * @brief Get the kernels of CPU::level()
+         */
+        static const Table &table()
+        {
+#if NNFS_DISPATCH
+            static const Table tables[] = {Baseline::table(), SSE42::table(), AVX2::table(), AVX512::table()};
+#else
+            static const Table tables[] = {Baseline::table(), Baseline::table(), Baseline::table(), Baseline::table()};
+#endif
+            return tables[static_cast<int>(CPU::level())];
+        }
+    };
+} // namespace NNFS
+
+#undef NNFS_INLINE
+#undef NNFS_UNROLL
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,506 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Huge page policies of Memory
+     */
+    enum class HugePages
+    {
+        NONE,        // Regular pages only
+        TRANSPARENT, // Transparent huge pages, requested with madvise(MADV_HUGEPAGE)
+        EXPLICIT     // Huge pages reserved by the administrator (MAP_HUGETLB), falling back to transparent ones when none is free
+    };
+
+    /**
+     * @brief Memory statistics, see Memory::stats()
+     */
+    struct MemoryStats
+    {
+        size_t allocated_bytes = 0;             // Live bytes returned by Memory::allocate()
+        size_t explicit_huge_page_bytes = 0;    // Live bytes of them on reserved huge pages
+        size_t transparent_advised_bytes = 0;   // Live bytes of them advised to use transparent huge pages
+        size_t transparent_huge_page_bytes = 0; // Anonymous memory of the whole process backed by transparent huge pages
+
+        /**
+         * @brief Get the memory backed by huge pages
+         *
+         * @return size_t Bytes on reserved huge pages plus bytes on transparent huge pages
+         */
+        size_t huge_page_bytes() const
+        {
+            return explicit_huge_page_bytes + transparent_huge_page_bytes;
+        }
+    };
+
+    /**
+     * @brief Allocator of large, 64-byte aligned buffers backed by huge pages where possible
+     *
+     * @details With parameter matrices of tens of megabytes and datasets of hundreds, the 4 KiB pages of the heap need more TLB entries
+     * than the core has, and page walks start to show in the products. Allocations of at least huge_page_size bytes are therefore
+     * mapped directly, aligned on a huge page, and backed according to the policy:
+     *
+     * - HugePages::TRANSPARENT (the default) advises the kernel to back them with transparent huge pages, which it does when
+     *   /sys/kernel/mm/transparent_hugepage/enabled is "always" or "madvise".
+     * - HugePages::EXPLICIT first tries the huge pages reserved in /proc/sys/vm/nr_hugepages, then falls back to transparent ones.
+     * - HugePages::NONE maps regular pages.
+     *
+     * Smaller allocations come from the heap. The policy can be set with the NNFS_HUGE_PAGES environment variable (none, transparent
+     * or explicit), read on first use, or with huge_pages(HugePages) at any time. Huge pages are only implemented on Linux.
+     *
+     * Eigen matrices own their storage, so the layers and data loaders that create large ones size them with resize(), which advises
+     * the huge-page-aligned part of the new storage before anything is written to it.
+     */
+    class Memory
+    {
+    public:
+        static constexpr size_t alignment = 64;                   // Alignment of every allocation, one cache line
+        static constexpr size_t huge_page_size = size_t(2) << 20; // Size of a huge page, the smallest huge-page-backed allocation
+
+    public:
+        /**
+         * @brief Get the huge page policy
+         *
+         * @return HugePages Current policy
+         */
+        static HugePages huge_pages()
+        {
+            return static_cast<HugePages>(policy().load(std::memory_order_relaxed));
+        }
+
+        /**
+         * @brief Set the huge page policy of the following allocations
+         *
+         * @param huge_pages Policy
+         */
+        static void huge_pages(HugePages huge_pages)
+        {
+            policy().store(static_cast<int>(huge_pages), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Parses the name of a huge page policy
+         *
+         * @param[in] name none, transparent or explicit
+         * @param[out] huge_pages Policy
+         *
+         * @return bool True if the name is known
+         */
+        static bool parse(const std::string &name, HugePages &huge_pages)
+        {
+            const std::pair<const char *, HugePages> names[] = {
+                {"none", HugePages::NONE}, {"transparent", HugePages::TRANSPARENT}, {"explicit", HugePages::EXPLICIT}};
+            for (const auto &[candidate, value] : names)
+            {
+                if (name == candidate)
+                {
+                    huge_pages = value;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Allocates a buffer aligned on alignment bytes, on huge pages if it is large enough
+         *
+         * @param bytes Size of the buffer
+         *
+         * @return void* Buffer, nullptr if the memory is exhausted
+         */
+        static void *allocate(size_t bytes)
+        {
+            if (bytes == 0)
+            {
+                bytes = 1;
+            }
+            if (bytes > std::numeric_limits<size_t>::max() - huge_page_size)
+            {
+                return nullptr;
+            }
+
+            void *pointer = nullptr;
+            Kind kind = Kind::HEAP;
+#ifdef __linux__
+            if (bytes >= huge_page_size)
+            {
+                pointer = map(bytes, kind);
+            }
+            else
+#endif
+            {
+                pointer = std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+            }
+
+            if (pointer)
+            {
+                std::lock_guard<std::mutex> lock(registry().mutex);
+                registry().allocations[pointer] = {bytes, kind};
+                account(bytes, kind, true);
+            }
+            return pointer;
+        }
+
+        /**
+         * @brief Frees a buffer returned by allocate()
+         *
+         * @param pointer Buffer, nullptr is ignored
+         */
+        static void deallocate(void *pointer)
+        {
+            if (!pointer)
+            {
+                return;
+            }
+
+            Allocation allocation;
+            {
+                std::lock_guard<std::mutex> lock(registry().mutex);
+                auto it = registry().allocations.find(pointer);
+                if (it == registry().allocations.end())
+                {
+                    return;
+                }
+                allocation = it->second;
+                registry().allocations.erase(it);
+                account(allocation.bytes, allocation.kind, false);
+            }
+
+#ifdef __linux__
+            if (allocation.kind != Kind::HEAP)
+            {
+                munmap(pointer, round_up(allocation.bytes));
+                return;
+            }
+#endif
+            std::free(pointer);
+        }
+
+        /**
+         * @brief Advises the kernel to back memory allocated elsewhere with transparent huge pages
+         *
+         * @details Only the huge pages entirely inside the range are advised. Pages already touched are only collapsed later by
+         * khugepaged, so the advice is best given right after allocation. Does nothing with HugePages::NONE.
+         *
+         * @param data Start of the memory
+         * @param bytes Size of the memory
+         *
+         * @return size_t Bytes advised
+         */
+        static size_t advise(void *data, size_t bytes)
+        {
+#ifdef __linux__
+            if (huge_pages() == HugePages::NONE || bytes < huge_page_size)
+            {
+                return 0;
+            }
+            const uintptr_t begin = round_up(reinterpret_cast<uintptr_t>(data));
+            const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) / huge_page_size * huge_page_size;
+            if (end > begin && madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE) == 0)
+            {
+                return end - begin;
+            }
+#else
+            (void)data;
+            (void)bytes;
+#endif
+            return 0;
+        }
+
+        /**
+         * @brief Resizes a matrix and advises its storage, see advise()
+         *
+         * @details The storage is only reallocated, and so advised, if the number of coefficients changes.
+         *
+         * @param matrix Matrix, its coefficients are uninitialized if it was reallocated
+         * @param rows Number of rows
+         * @param cols Number of columns
+         */
+        template <typename Derived>
+        static void resize(Eigen::PlainObjectBase<Derived> &matrix, Eigen::Index rows, Eigen::Index cols)
+        {
+            if (matrix.size() == rows * cols)
+            {
+                matrix.resize(rows, cols);
+                return;
+            }
+            matrix.resize(rows, cols);
+            advise(matrix.data(), static_cast<size_t>(matrix.size()) * sizeof(typename Derived::Scalar));
+        }
+
+        /**
+         * @brief Get the memory statistics
+         *
+         * @return MemoryStats Live allocations of allocate() and the transparent huge pages of the process
+         */
+        static MemoryStats stats()
+        {
+            MemoryStats stats;
+            {
+                std::lock_guard<std::mutex> lock(registry().mutex);
+                stats = registry().stats;
+            }
+            stats.transparent_huge_page_bytes = transparent_huge_page_bytes();
+            return stats;
+        }
+
+    private:
+        enum class Kind
+        {
+            HEAP,        // aligned_alloc
+            MAPPED,      // Anonymous mapping on regular pages
+            TRANSPARENT, // Anonymous mapping advised to use transparent huge pages
+            HUGE_TLB     // Anonymous mapping on reserved huge pages
+        };
+
+        struct Allocation
+        {
+            size_t bytes = 0;       // Requested size
+            Kind kind = Kind::HEAP; // Where the memory comes from
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;                                   // Guards the members below
+            std::unordered_map<void *, Allocation> allocations; // Live allocations
+            MemoryStats stats;                                  // Totals of the live allocations
+        };
+
+        // Never destroyed, buffers of thread_local workspaces and other statics are freed after the statics of this header are gone
+        static Registry &registry()
+        {
+            static Registry *registry = new Registry();
+            return *registry;
+        }
+
+        static size_t round_up(size_t bytes)
+        {
+            return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+        }
+
+        // Adds an allocation to the totals, or removes it, the registry mutex must be held
+        static void account(size_t bytes, Kind kind, bool add)
+        {
+            MemoryStats &stats = registry().stats;
+            size_t &huge = kind == Kind::HUGE_TLB ? stats.explicit_huge_page_bytes : stats.transparent_advised_bytes;
+            const size_t mapped = kind == Kind::HUGE_TLB || kind == Kind::TRANSPARENT ? round_up(bytes) : 0;
+            if (add)
+            {
+                stats.allocated_bytes += bytes;
+                huge += mapped;
+            }
+            else
+            {
+                stats.allocated_bytes -= bytes;
+                huge -= mapped;
+            }
+        }
+
+#ifdef __linux__
+        // Maps whole huge pages aligned on a huge page
+        static void *map(size_t bytes, Kind &kind)
+        {
+            const size_t size = round_up(bytes);
+            const HugePages huge_pages = Memory::huge_pages();
+            if (huge_pages == HugePages::EXPLICIT)
+            {
+                void *pointer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (pointer != MAP_FAILED)
+                {
+                    kind = Kind::HUGE_TLB;
+                    return pointer;
+                }
+            }
+
+            // Over-allocate by a huge page and unmap what sticks out of the aligned range
+            void *mapping = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED)
+            {
+                return nullptr;
+            }
+            const uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+            const uintptr_t aligned = round_up(start);
+            if (aligned > start)
+            {
+                munmap(mapping, aligned - start);
+            }
+            if (start + huge_page_size > aligned)
+            {
+                munmap(reinterpret_cast<void *>(aligned + size), start + huge_page_size - aligned);
+            }
+
+            kind = Kind::MAPPED;
+            if (huge_pages != HugePages::NONE && madvise(reinterpret_cast<void *>(aligned), size, MADV_HUGEPAGE) == 0)
+            {
+                kind = Kind::TRANSPARENT;
+            }
+            return reinterpret_cast<void *>(aligned);
+        }
+#endif
+
+        // AnonHugePages of /proc/self/smaps_rollup, 0 where it is not available
+        static size_t transparent_huge_page_bytes()
+        {
+            std::ifstream file("/proc/self/smaps_rollup");
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (line.rfind("AnonHugePages:", 0) == 0)
+                {
+                    std::istringstream stream(line.substr(14));
+                    size_t kilobytes = 0;
+                    stream >> kilobytes;
+                    return kilobytes * 1024;
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Huge page policy, initialized from NNFS_HUGE_PAGES or HugePages::TRANSPARENT
+         */
+        static std::atomic<int> &policy()
+        {
+            static std::atomic<int> huge_pages([]()
+                                               {
+                                                   HugePages requested = HugePages::TRANSPARENT;
+                                                   const char *variable = std::getenv("NNFS_HUGE_PAGES");
+                                                   if (variable && parse(variable, requested))
+                                                   {
+                                                       return static_cast<int>(requested);
+                                                   }
+                                                   return static_cast<int>(HugePages::TRANSPARENT); }());
+            return huge_pages;
+        }
+    };
+
+    /**
+     * @brief Standard allocator on top of Memory, for containers of workspaces and datasets
+     *
+     * @tparam T Element type
+     */
+    template <typename T>
+    class AlignedAllocator
+    {
+    public:
+        using value_type = T;
+
+        AlignedAllocator() = default;
+
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U> &) {}
+
+        /**
+         * @brief Allocates storage for n elements
+         *
+         * @param n Number of elements
+         *
+         * @return T* Storage aligned on Memory::alignment bytes
+         */
+        T *allocate(size_t n)
+        {
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+            {
+                throw std::bad_alloc();
+            }
+            void *pointer = Memory::allocate(n * sizeof(T));
+            if (!pointer)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(pointer);
+        }
+
+        /**
+         * @brief Frees storage returned by allocate()
+         *
+         * @param pointer Storage
+         */
+        void deallocate(T *pointer, size_t)
+        {
+            Memory::deallocate(pointer);
+        }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U> &) const
+        {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U> &) const
+        {
+            return false;
+        }
+    };
+
+    template <typename T>
+    using AlignedVector = std::vector<T, AlignedAllocator<T>>; // Vector whose storage comes from Memory
+
+    /**
+     * @brief Scratch buffers of the calling thread, for kernels that pack their operands
+     *
+     * @details Every thread has one buffer per slot, grown on demand and kept for the next call, so steady-state kernels do not
+     * allocate. Pool workers release theirs before they exit, other threads when their thread_local storage is destroyed.
+     */
+    class Workspace
+    {
+    public:
+        static constexpr int slots = 2; // Independent buffers per thread
+
+        /**
+         * @brief Get a buffer of the calling thread
+         *
+         * @param slot Buffer index, below slots, kernels that may run nested use different ones
+         * @param size Number of doubles needed, the contents are kept if the buffer is large enough
+         *
+         * @return double* Buffer of at least size doubles, aligned on Memory::alignment bytes
+         */
+        static double *get(int slot, size_t size)
+        {
+            AlignedVector<double> &buffer = buffers()[slot];
+            if (buffer.size() < size)
+            {
+                buffer.resize(size);
+            }
+            return buffer.data();
+        }
+
+        /**
+         * @brief Frees the buffers of the calling thread
+         */
+        static void release()
+        {
+            for (AlignedVector<double> &buffer : buffers())
+            {
+                AlignedVector<double>().swap(buffer);
+            }
+        }
+
+    private:
+        static AlignedVector<double> (&buffers())[slots]
+        {
+            thread_local AlignedVector<double> buffers[slots];
+            return buffers;
+        }
+    };
+} // namespace NNFS
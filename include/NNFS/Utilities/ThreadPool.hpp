@@ -0,0 +1,513 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Memory.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Work-stealing pool of worker threads
+     *
+     * @details Every worker owns a deque: tasks it submits go to the back and it takes its own work from the back, newest first, which
+     * keeps the data of recursively split work in its cache. An idle worker steals from the front of the other deques, oldest and so
+     * largest first. Tasks submitted from outside the pool go to a shared deque that every worker takes from. Workers with nothing to
+     * do sleep until a task is queued.
+     *
+     * The deques are ring buffers that keep their size, so once they are large enough queuing a task allocates nothing beyond what
+     * std::function needs for it, which is nothing for lambdas capturing a pointer or two on common standard libraries.
+     *
+     * A pool of size n runs n - 1 workers. Threads waiting on a TaskGroup, including the thread that called parallel_for(), run queued
+     * tasks until the group is done, so they count as the n-th thread, waiting never blocks a worker and groups can be nested.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * @brief Starts the workers
+         *
+         * @param threads Number of threads running parallel loops, the caller included, 0 uses every hardware thread
+         * @param cpus CPUs the workers are pinned to, worker i on cpus[i % size], empty to leave them unpinned
+         */
+        explicit ThreadPool(int threads = 0, const std::vector<int> &cpus = {})
+        {
+            if (threads <= 0)
+            {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            _size = threads;
+
+            // One deque per worker, the last one receives the tasks submitted from outside the pool
+            for (int i = 0; i < threads; ++i)
+            {
+                _queues.emplace_back(new Queue());
+            }
+            for (int i = 0; i < threads - 1; ++i)
+            {
+                _workers.emplace_back([this, i]()
+                                      { work(i); });
+                if (!cpus.empty())
+                {
+                    pin(_workers.back(), cpus[i % cpus.size()]);
+                }
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * @brief Finishes the queued tasks and joins the workers
+         */
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_sleep_mutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (std::thread &worker : _workers)
+            {
+                worker.join();
+            }
+        }
+
+        /**
+         * @brief Get the number of threads running parallel loops, the caller included
+         *
+         * @return int Size of the pool
+         */
+        int size() const
+        {
+            return _size;
+        }
+
+        /**
+         * @brief Queues a task, run on the calling thread if the pool has no worker
+         *
+         * @param task Task, must not throw, see TaskGroup for tasks that may
+         */
+        void submit(std::function<void()> task)
+        {
+            if (_workers.empty())
+            {
+                task();
+                return;
+            }
+
+            Queue &queue = *_queues[worker_index() >= 0 ? worker_index() : _queues.size() - 1];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.push_back(std::move(task));
+            }
+            _queued++;
+            if (_sleeping.load() > 0)
+            {
+                std::lock_guard<std::mutex> lock(_sleep_mutex);
+                _wake.notify_one();
+            }
+        }
+
+        /**
+         * @brief Runs one queued task on the calling thread
+         *
+         * @return bool True if a task was run, false if none was queued
+         */
+        bool run_pending()
+        {
+            std::function<void()> task;
+            if (!pop(task))
+            {
+                return false;
+            }
+            task();
+            return true;
+        }
+
+        /**
+         * @brief Runs queued tasks on the calling thread until done() holds
+         *
+         * @details The caller spins briefly while there is nothing to run and then sleeps like an idle worker, so it is woken by a new
+         * task as well as by wake().
+         *
+         * @param done Condition to wait for, checked with the sleep mutex held
+         */
+        template <typename Done>
+        void run_until(const Done &done)
+        {
+            int idle = 0;
+            while (!done())
+            {
+                if (run_pending())
+                {
+                    idle = 0;
+                    continue;
+                }
+                if (++idle < spins)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _sleeping++;
+                _wake.wait(lock, [&]()
+                           { return done() || _queued.load() > 0; });
+                _sleeping--;
+                idle = 0;
+
+                // The wake-up submit() meant for an idle worker may have landed here, pass it on if the task is left behind
+                if (done() && _queued.load() > 0)
+                {
+                    _wake.notify_one();
+                }
+            }
+        }
+
+        /**
+         * @brief Wakes the threads sleeping in run_until() after their condition changed, idle workers go back to sleep
+         */
+        void wake()
+        {
+            if (_sleeping.load() > 0)
+            {
+                std::lock_guard<std::mutex> lock(_sleep_mutex);
+                _wake.notify_all();
+            }
+        }
+
+        /**
+         * @brief Runs function over [begin, end) in chunks of grain indices and waits for all of them
+         *
+         * @details The range is halved recursively, one half queued and the other kept, until chunks are at most grain long, so idle
+         * workers steal the largest pieces left. Chunk boundaries are begin + i * grain whatever the number of threads.
+         *
+         * @param begin First index
+         * @param end Index past the last one
+         * @param grain Indices per chunk, at least 1
+         * @param function Called as function(chunk_begin, chunk_end), concurrently from several threads
+         *
+         * @throws The first exception thrown by function, once every chunk is done
+         */
+        template <typename Function>
+        void parallel_for(int64_t begin, int64_t end, int64_t grain, const Function &function);
+
+    private:
+        static constexpr int spins = 64; // Failed attempts to find a task before run_until() sleeps
+
+        // Double-ended queue in a ring buffer that only grows, so queuing does not allocate once it is large enough
+        struct Queue
+        {
+            std::mutex mutex;                         // Guards the members below
+            std::vector<std::function<void()>> tasks; // Ring buffer, the size is a power of two
+            size_t head = 0;                          // Slot of the oldest task
+            size_t count = 0;                         // Number of queued tasks
+
+            Queue() : tasks(64) {}
+
+            bool empty() const
+            {
+                return count == 0;
+            }
+
+            void push_back(std::function<void()> &&task)
+            {
+                if (count == tasks.size())
+                {
+                    std::vector<std::function<void()>> grown(tasks.size() * 2);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        grown[i] = std::move(tasks[(head + i) & (tasks.size() - 1)]);
+                    }
+                    tasks.swap(grown);
+                    head = 0;
+                }
+                tasks[(head + count) & (tasks.size() - 1)] = std::move(task);
+                count++;
+            }
+
+            void pop_back(std::function<void()> &task)
+            {
+                count--;
+                std::function<void()> &slot = tasks[(head + count) & (tasks.size() - 1)];
+                task = std::move(slot);
+                slot = nullptr;
+            }
+
+            void pop_front(std::function<void()> &task)
+            {
+                std::function<void()> &slot = tasks[head];
+                task = std::move(slot);
+                slot = nullptr;
+                head = (head + 1) & (tasks.size() - 1);
+                count--;
+            }
+        };
+
+        // Index of the calling thread among the workers of this pool, -1 for other threads
+        int worker_index() const
+        {
+            return current_pool() == this ? current_worker() : -1;
+        }
+
+        // Takes the newest task of the caller's own deque, else the oldest task of the shared deque or of another worker
+        bool pop(std::function<void()> &task)
+        {
+            const int own = worker_index();
+            const int queues = static_cast<int>(_queues.size());
+            if (own >= 0)
+            {
+                Queue &queue = *_queues[own];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.empty())
+                {
+                    queue.pop_back(task);
+                    _queued--;
+                    return true;
+                }
+            }
+
+            for (int i = 0; i < queues; ++i)
+            {
+                const int victim = (queues - 1 + i + (own >= 0 ? own + 1 : 0)) % queues;
+                if (victim == own)
+                {
+                    continue;
+                }
+                Queue &queue = *_queues[victim];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.empty())
+                {
+                    queue.pop_front(task);
+                    _queued--;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void work(int index)
+        {
+            current_pool() = this;
+            current_worker() = index;
+            while (true)
+            {
+                if (run_pending())
+                {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _sleeping++;
+                _wake.wait(lock, [this]()
+                           { return _stop || _queued.load() > 0; });
+                _sleeping--;
+                if (_stop && _queued.load() == 0)
+                {
+                    break;
+                }
+            }
+
+            // Kernel workspaces would otherwise live until the thread_local storage is destroyed
+            Workspace::release();
+        }
+
+        static const ThreadPool *&current_pool()
+        {
+            thread_local const ThreadPool *pool = nullptr;
+            return pool;
+        }
+
+        static int &current_worker()
+        {
+            thread_local int worker = -1;
+            return worker;
+        }
+
+        static void pin(std::thread &thread, int cpu)
+        {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+            (void)thread;
+            (void)cpu;
+#endif
+        }
+
+        int _size = 1;                               // Threads running parallel loops, the caller included
+        std::vector<std::unique_ptr<Queue>> _queues; // One deque per worker, then the shared one
+        std::vector<std::thread> _workers;           // Worker threads
+        std::atomic<int64_t> _queued{0};             // Tasks in all the queues
+        std::atomic<int> _sleeping{0};               // Workers waiting on _wake
+        std::mutex _sleep_mutex;                     // Guards _stop and the sleeps
+        std::condition_variable _wake;               // Signals a new task or the stop
+        bool _stop = false;                          // Whether the workers should exit once the deques are empty
+    };
+
+    /**
+     * @brief Set of tasks of a ThreadPool that can be waited for together
+     *
+     * @details wait() runs queued tasks, of this group or any other, until every task of the group is done, and sleeps when there is
+     * nothing left to run. An exception thrown by a task is caught on the thread running it, the first one is rethrown by wait() once
+     * every task is done and the others are dropped. The destructor waits too, but drops the exception.
+     */
+    class TaskGroup
+    {
+    public:
+        /**
+         * @brief Creates an empty group
+         *
+         * @param pool Pool running the tasks
+         */
+        explicit TaskGroup(ThreadPool &pool) : _pool(pool) {}
+
+        TaskGroup(const TaskGroup &) = delete;
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        /**
+         * @brief Waits for the tasks still running
+         */
+        ~TaskGroup()
+        {
+            join();
+        }
+
+        /**
+         * @brief Queues a task of the group
+         *
+         * @param task Task, copied or moved into the queue
+         */
+        template <typename Task>
+        void run(Task task)
+        {
+            _pending++;
+            _pool.submit([this, task = std::move(task)]() mutable
+                         {
+                             invoke(task);
+                             finish(); });
+        }
+
+        /**
+         * @brief Runs queued tasks until every task of the group is done
+         *
+         * @throws The first exception thrown by a task of the group since the last wait()
+         */
+        void wait()
+        {
+            join();
+
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> lock(_error_mutex);
+                error.swap(_error);
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        friend class ThreadPool;
+
+        // Runs a task of the group on the calling thread and keeps the first exception
+        template <typename Task>
+        void invoke(Task &&task)
+        {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_error_mutex);
+                if (!_error)
+                {
+                    _error = std::current_exception();
+                }
+            }
+        }
+
+        // Marks a task done and wakes the waiting thread if it was the last one
+        void finish()
+        {
+            // The group may be destroyed as soon as _pending drops to zero
+            ThreadPool &pool = _pool;
+            if (--_pending == 0)
+            {
+                pool.wake();
+            }
+        }
+
+        void join()
+        {
+            _pool.run_until([this]()
+                            { return _pending.load() == 0; });
+        }
+
+        ThreadPool &_pool;                // Pool running the tasks
+        std::atomic<int64_t> _pending{0}; // Tasks queued or running
+        std::mutex _error_mutex;          // Guards _error
+        std::exception_ptr _error;        // First exception thrown by a task
+    };
+
+    template <typename Function>
+    void ThreadPool::parallel_for(int64_t begin, int64_t end, int64_t grain, const Function &function)
+    {
+        grain = std::max<int64_t>(1, grain);
+        if (end - begin <= grain || _workers.empty())
+        {
+            // Like the parallel path, every chunk runs and the first exception is rethrown
+            std::exception_ptr error;
+            for (int64_t i = begin; i < end; i += grain)
+            {
+                try
+                {
+                    function(i, std::min(end, i + grain));
+                }
+                catch (...)
+                {
+                    error = error ? error : std::current_exception();
+                }
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+            return;
+        }
+
+        TaskGroup group(*this);
+        std::function<void(int64_t, int64_t)> split = [&](int64_t low, int64_t high)
+        {
+            while (high - low > grain)
+            {
+                const int64_t middle = low + (high - low + grain - 1) / grain / 2 * grain;
+                group.run([&split, middle, high]()
+                          { split(middle, high); });
+                high = middle;
+            }
+            function(low, high);
+        };
+        group.invoke([&]()
+                     { split(begin, end); });
+        group.wait();
+    }
+} // namespace NNFS
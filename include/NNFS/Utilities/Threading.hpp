@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include "clue.hpp"
+#include "ThreadPool.hpp"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace NNFS
+{
+    /**
+     * @brief Options of Threading::configure
+     */
+    struct ThreadingOptions
+    {
+        int intra_op_threads = 0; // Threads of one operation, e.g. a matrix product, 0 uses every allowed CPU
+        int inter_op_threads = 0; // Threads of independent work, e.g. data loading, evaluation or serving, 0 uses every allowed CPU
+        bool pin = false;         // Whether workers are pinned, intra-op ones to the first allowed CPUs and inter-op ones to the next
+        int numa_node = -1;       // NUMA node whose CPUs are allowed, -1 allows every CPU of the process
+    };
+
+    /**
+     * @brief Process-wide threading configuration and the pools it creates
+     *
+     * @details Parallel code of the library takes its threads from one of two pools instead of starting its own:
+     *
+     * - intra_op(): splits a single operation, the built-in matrix products of Gemm. Eigen's own products use as many OpenMP threads
+     *   when the library is built with the NNFS_USE_OPENMP CMake option.
+     * - inter_op(): runs independent work side by side, e.g. the parser threads of CSV::load.
+     *
+     * With pin, intra-op workers are pinned to the first intra_op_threads allowed CPUs and inter-op workers to the following ones, so
+     * training and data loading do not compete for cores when the machine has enough of them. numa_node restricts the allowed CPUs to
+     * one node, read from /sys/devices/system/node. Pinning and NUMA restriction are only implemented on Linux.
+     *
+     * The pools are created on first use. configure() replaces them and must not be called while parallel work is running.
+     */
+    class Threading
+    {
+    public:
+        /**
+         * @brief Sets the threading configuration
+         *
+         * @param options Options
+         *
+         * @return bool True if the configuration was applied, false if the NUMA node has no allowed CPU
+         */
+        static bool configure(const ThreadingOptions &options)
+        {
+            std::vector<int> allowed = cpus(options.numa_node);
+            if (allowed.empty())
+            {
+                LOG_ERROR("NUMA node " << options.numa_node << " has no CPU this process may run on.");
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(state().mutex);
+            State &current = state();
+            current.options = options;
+            current.intra_op.reset();
+            current.inter_op.reset();
+            Eigen::setNbThreads(intra_op_threads(current.options, allowed));
+            return true;
+        }
+
+        /**
+         * @brief Get the threading configuration
+         *
+         * @return ThreadingOptions Current options
+         */
+        static ThreadingOptions options()
+        {
+            std::lock_guard<std::mutex> lock(state().mutex);
+            return state().options;
+        }
+
+        /**
+         * @brief Get the pool splitting single operations
+         *
+         * @return ThreadPool& Intra-op pool
+         */
+        static ThreadPool &intra_op()
+        {
+            std::lock_guard<std::mutex> lock(state().mutex);
+            State &current = state();
+            if (!current.intra_op)
+            {
+                std::vector<int> allowed = cpus(current.options.numa_node);
+                int threads = intra_op_threads(current.options, allowed);
+                current.intra_op.reset(new ThreadPool(threads, current.options.pin ? slice(allowed, 0, threads) : std::vector<int>()));
+            }
+            return *current.intra_op;
+        }
+
+        /**
+         * @brief Get the pool running independent work
+         *
+         * @return ThreadPool& Inter-op pool
+         */
+        static ThreadPool &inter_op()
+        {
+            std::lock_guard<std::mutex> lock(state().mutex);
+            State &current = state();
+            if (!current.inter_op)
+            {
+                std::vector<int> allowed = cpus(current.options.numa_node);
+                int threads = current.options.inter_op_threads > 0 ? current.options.inter_op_threads : static_cast<int>(allowed.size());
+                int first = current.options.intra_op_threads > 0 ? current.options.intra_op_threads : 0;
+                current.inter_op.reset(new ThreadPool(threads, current.options.pin ? slice(allowed, first, threads) : std::vector<int>()));
+            }
+            return *current.inter_op;
+        }
+
+        /**
+         * @brief Get the CPUs the process may run on
+         *
+         * @param numa_node NUMA node to restrict them to, -1 for every node
+         *
+         * @return std::vector<int> CPU ids, ascending
+         */
+        static std::vector<int> cpus(int numa_node = -1)
+        {
+            std::vector<int> allowed;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                {
+                    if (CPU_ISSET(cpu, &set))
+                    {
+                        allowed.push_back(cpu);
+                    }
+                }
+            }
+
+            if (numa_node >= 0)
+            {
+                std::vector<int> node = parse_cpu_list("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist");
+                std::vector<int> both;
+                std::set_intersection(allowed.begin(), allowed.end(), node.begin(), node.end(), std::back_inserter(both));
+                return both;
+            }
+#else
+            // Without NUMA information every CPU is on node 0
+            if (numa_node > 0)
+            {
+                return allowed;
+            }
+#endif
+            if (allowed.empty())
+            {
+                for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                {
+                    allowed.push_back(static_cast<int>(cpu));
+                }
+            }
+            return allowed;
+        }
+
+    private:
+        struct State
+        {
+            std::mutex mutex;                     // Guards the members below
+            ThreadingOptions options;             // Current options
+            std::unique_ptr<ThreadPool> intra_op; // Intra-op pool, created on first use
+            std::unique_ptr<ThreadPool> inter_op; // Inter-op pool, created on first use
+        };
+
+        static State &state()
+        {
+            static State state;
+            return state;
+        }
+
+        static int intra_op_threads(const ThreadingOptions &options, const std::vector<int> &allowed)
+        {
+            return options.intra_op_threads > 0 ? options.intra_op_threads : static_cast<int>(allowed.size());
+        }
+
+        // Count CPUs from first on, wrapping around when there are not enough
+        static std::vector<int> slice(const std::vector<int> &allowed, int first, int count)
+        {
+            std::vector<int> result;
+            for (int i = 0; i < count; ++i)
+            {
+                result.push_back(allowed[(first + i) % allowed.size()]);
+            }
+            return result;
+        }
+
+        // Parses a kernel CPU list such as 0-3,8-11
+        static std::vector<int> parse_cpu_list(const std::string &path)
+        {
+            std::vector<int> list;
+            std::ifstream file(path);
+            std::string range;
+            while (std::getline(file, range, ','))
+            {
+                int low, high;
+                char dash;
+                std::istringstream stream(range);
+                if (!(stream >> low))
+                {
+                    continue;
+                }
+                if (!(stream >> dash >> high))
+                {
+                    high = low;
+                }
+                for (int cpu = low; cpu <= high; ++cpu)
+                {
+                    list.push_back(cpu);
+                }
+            }
+            std::sort(list.begin(), list.end());
+            return list;
+        }
+    };
+
+    /**
+     * @brief Sets the number of threads of the intra-op and inter-op pools, see Threading::configure
+     *
+     * @param intra_op_threads Threads of one operation, 0 uses every allowed CPU
+     * @param inter_op_threads Threads of independent work, 0 uses every allowed CPU
+     */
+    inline void set_num_threads(int intra_op_threads, int inter_op_threads = 0)
+    {
+        ThreadingOptions options = Threading::options();
+        options.intra_op_threads = intra_op_threads;
+        options.inter_op_threads = inter_op_threads;
+        Threading::configure(options);
+    }
+} // namespace NNFS
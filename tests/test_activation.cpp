@@ -38,6 +38,29 @@ TEST_F(ReLUTest, GeneralTest)
     EXPECT_TRUE(dx_out.isApprox(dx_expected, 1e-7));
 }
 
+// Test ReLU in place on a batch whose size is not a multiple of the 64-bit mask words
+TEST_F(ReLUTest, InPlaceTest)
+{
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(13, 11);
+    x.topRows(6).setConstant(1.);    // Whole words of ones
+    x.row(7).setConstant(-1.);       // Mixed words
+    x.bottomRows(5).setConstant(0.); // Zeros do not let the gradient through
+    Eigen::MatrixXd dx = Eigen::MatrixXd::Random(13, 11);
+
+    Eigen::MatrixXd expected_out = x.cwiseMax(0.);
+    Eigen::MatrixXd expected_dx = (x.array() > 0).select(dx, 0.);
+
+    Eigen::MatrixXd inout = x;
+    ReLU_.forward(inout, inout);
+    EXPECT_TRUE(inout == expected_out);
+
+    inout = dx;
+    ReLU_.backward(inout, inout);
+    EXPECT_TRUE(inout == expected_dx);
+
+    EXPECT_THROW(ReLU_.backward(inout, Eigen::MatrixXd::Zero(2, 2)), std::invalid_argument);
+}
+
 class SoftmaxTest : public ::testing::Test
 {
 protected:
@@ -0,0 +1,176 @@
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#define LOG_LEVEL LOG_SEV_NONE
+#define NNFS_COUNT_ALLOCATIONS
+
+#include <NNFS/Core>
+
+class AllocationsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        examples = Eigen::MatrixXd::Random(64, 16);
+        labels = Eigen::MatrixXd::Zero(64, 8);
+        for (int i = 0; i < 64; ++i)
+        {
+            labels(i, i % 8) = 1.;
+        }
+    }
+
+    // Network with an activation between two dense layers, regularized so backward() computes every gradient term
+    std::shared_ptr<NNFS::NeuralNetwork> model(std::shared_ptr<NNFS::Layer> activation, std::shared_ptr<NNFS::Optimizer> optimizer, bool fuse)
+    {
+        auto network = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), optimizer);
+        network->add_layer(std::make_shared<NNFS::Dense>(16, 32, 1e-4, 1e-4, 1e-4, 1e-4));
+        network->add_layer(activation);
+        network->add_layer(std::make_shared<NNFS::Dense>(32, 8));
+        network->compile(fuse);
+        return network;
+    }
+
+    // Allocations of the steps after two warm-up steps
+    uint64_t step_allocations(NNFS::NeuralNetwork &network, int steps = 3)
+    {
+        double data_loss = 0, reg_loss = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            network.train_on_batch(data_loss, reg_loss, examples, labels);
+        }
+
+        NNFS::AllocationScope scope;
+        for (int i = 0; i < steps; ++i)
+        {
+            network.train_on_batch(data_loss, reg_loss, examples, labels);
+        }
+        return scope.count();
+    }
+
+    Eigen::MatrixXd examples;
+    Eigen::MatrixXd labels;
+};
+
+// Test the hook counts Eigen and standard library allocations
+TEST_F(AllocationsTest, HookTest)
+{
+    ASSERT_TRUE(NNFS::Allocations::counted());
+
+    NNFS::AllocationScope scope;
+    Eigen::MatrixXd matrix(100, 100);
+    EXPECT_EQ(scope.count(), 1u);
+    EXPECT_GE(scope.bytes(), 100 * 100 * sizeof(double));
+
+    std::vector<int> vector(10);
+    EXPECT_EQ(scope.count(), 2u);
+    matrix.setZero();
+    EXPECT_EQ(scope.count(), 2u);
+}
+
+// Test a training step does not allocate with any activation, fused into the dense layer or not
+TEST_F(AllocationsTest, ActivationTest)
+{
+    const std::vector<std::pair<std::string, std::function<std::shared_ptr<NNFS::Layer>()>>> activations = {
+        {"relu", []()
+         { return std::make_shared<NNFS::ReLU>(); }},
+        {"sigmoid", []()
+         { return std::make_shared<NNFS::Sigmoid>(); }},
+        {"tanh", []()
+         { return std::make_shared<NNFS::Tanh>(); }},
+        {"softmax", []()
+         { return std::make_shared<NNFS::Softmax>(); }}};
+
+    for (const auto &[name, activation] : activations)
+    {
+        for (bool fuse : {false, true})
+        {
+            SCOPED_TRACE(name + (fuse ? " fused" : ""));
+            auto network = model(activation(), std::make_shared<NNFS::SGD>(.01, 1e-3, .9), fuse);
+            EXPECT_EQ(step_allocations(*network), 0u);
+        }
+    }
+}
+
+// Test a training step does not allocate with any optimizer
+TEST_F(AllocationsTest, OptimizerTest)
+{
+    const std::vector<std::pair<std::string, std::function<std::shared_ptr<NNFS::Optimizer>()>>> optimizers = {
+        {"sgd", []()
+         { return std::make_shared<NNFS::SGD>(.01); }},
+        {"sgd momentum", []()
+         { return std::make_shared<NNFS::SGD>(.01, 1e-3, .9); }},
+        {"adagrad", []()
+         { return std::make_shared<NNFS::Adagrad>(.01, 1e-3); }},
+        {"rmsprop", []()
+         { return std::make_shared<NNFS::RMSProp>(); }},
+        {"adam", []()
+         { return std::make_shared<NNFS::Adam>(.01, 1e-3); }}};
+
+    for (const auto &[name, optimizer] : optimizers)
+    {
+        SCOPED_TRACE(name);
+        auto network = model(std::make_shared<NNFS::ReLU>(), optimizer(), true);
+        EXPECT_EQ(step_allocations(*network), 0u);
+    }
+}
+
+// Test the compressed kernels of sparse inputs do not allocate either
+TEST_F(AllocationsTest, CompressedTest)
+{
+    auto network = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.01));
+    auto dense = std::make_shared<NNFS::Dense>(32, 8);
+    dense->sparsity_threshold(0.);
+    network->add_layer(std::make_shared<NNFS::Dense>(16, 32));
+    network->add_layer(std::make_shared<NNFS::ReLU>());
+    network->add_layer(dense);
+    network->compile(false);
+    EXPECT_EQ(step_allocations(*network), 0u);
+}
+
+// Test the steps learn and reject batches of the wrong shape
+TEST_F(AllocationsTest, TrainOnBatchTest)
+{
+    auto network = model(std::make_shared<NNFS::ReLU>(), std::make_shared<NNFS::Adam>(.01), true);
+    double first_loss = 0, data_loss = 0, reg_loss = 0;
+    network->train_on_batch(first_loss, reg_loss, examples, labels);
+    for (int i = 0; i < 200; ++i)
+    {
+        network->train_on_batch(data_loss, reg_loss, examples, labels);
+    }
+    EXPECT_LT(data_loss, first_loss);
+    EXPECT_GT(reg_loss, 0.);
+
+    // Mismatched shapes are rejected without touching the weights or the losses
+    const Eigen::MatrixXd first_weights = std::static_pointer_cast<const NNFS::Dense>(network->layer(0))->weights();
+    const Eigen::MatrixXd last_weights = std::static_pointer_cast<const NNFS::Dense>(network->layer(2))->weights();
+    const double previous_data_loss = data_loss, previous_reg_loss = reg_loss;
+    network->train_on_batch(data_loss, reg_loss, examples.leftCols(4), labels);
+    EXPECT_TRUE(std::static_pointer_cast<const NNFS::Dense>(network->layer(0))->weights() == first_weights);
+    EXPECT_TRUE(std::static_pointer_cast<const NNFS::Dense>(network->layer(2))->weights() == last_weights);
+    EXPECT_EQ(data_loss, previous_data_loss);
+    EXPECT_EQ(reg_loss, previous_reg_loss);
+}
+
+// Test fit() allocates its batch buffers once, not per batch, also while the next batch is loaded on another thread
+TEST_F(AllocationsTest, FitTest)
+{
+    // An inter-op worker, so the next batch is really queued
+    NNFS::set_num_threads(1, 2);
+    auto network = model(std::make_shared<NNFS::ReLU>(), std::make_shared<NNFS::Adam>(.01), true);
+    network->fit(examples, labels, examples, labels, 1, 8, false);
+
+    auto fit_allocations = [&](int epochs)
+    {
+        NNFS::AllocationScope scope;
+        network->fit(examples, labels, examples, labels, epochs, 8, false);
+        return scope.count();
+    };
+
+    // 8 batches per epoch, four epochs allocate no more than one
+    const uint64_t one_epoch = fit_allocations(1);
+    EXPECT_EQ(fit_allocations(4), one_epoch);
+    NNFS::Threading::configure(NNFS::ThreadingOptions());
+}
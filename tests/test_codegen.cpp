@@ -0,0 +1,163 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+
+#include <dlfcn.h>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class CodeGenTest : public ::testing::Test
+{
+protected:
+    using Predict = void (*)(const double *, double *);
+    using PredictBatch = void (*)(const double *, double *, int);
+
+    void TearDown() override
+    {
+        if (library_)
+        {
+            dlclose(library_);
+        }
+    }
+
+    static std::shared_ptr<NNFS::NeuralNetwork> network()
+    {
+        return std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.01));
+    }
+
+    static void train(std::shared_ptr<NNFS::NeuralNetwork> model, const Eigen::MatrixXd &x)
+    {
+        int n_input, n_output;
+        model->shape(n_input, n_output);
+        Eigen::MatrixXd labels = Eigen::MatrixXd::Zero(x.rows(), n_output);
+        for (Eigen::Index i = 0; i < x.rows(); ++i)
+        {
+            labels(i, i % n_output) = 1.;
+        }
+        model->fit(x, labels, x, labels, 3, 16, false);
+    }
+
+    // Saves the model, generates the source from the saved file like tools/codegen.cpp, builds it as a shared library and loads it
+    bool build(std::shared_ptr<NNFS::NeuralNetwork> model, const std::string &name)
+    {
+        std::string base = testing::TempDir() + "nnfs_codegen_" + name;
+        model->save(base + ".bin");
+        NNFS::NeuralNetwork loaded;
+        loaded.load(base + ".bin");
+        std::remove((base + ".bin").c_str());
+
+        std::ofstream out(base + ".cpp");
+        if (!NNFS::CodeGen::generate(loaded, out, name))
+        {
+            return false;
+        }
+        out.close();
+
+        std::string command = std::string(NNFS_CODEGEN_CXX) + " -std=c++17 -O2 -shared -fPIC -o " + base + ".so " + base + ".cpp";
+        int status = std::system(command.c_str());
+        std::remove((base + ".cpp").c_str());
+        if (status != 0)
+        {
+            ADD_FAILURE() << "Generated source did not compile: " << command;
+            return false;
+        }
+
+        library_ = dlopen((base + ".so").c_str(), RTLD_NOW | RTLD_LOCAL);
+        std::remove((base + ".so").c_str());
+        if (!library_)
+        {
+            ADD_FAILURE() << dlerror();
+            return false;
+        }
+
+        predict_ = reinterpret_cast<Predict>(dlsym(library_, (name + "_predict").c_str()));
+        predict_batch_ = reinterpret_cast<PredictBatch>(dlsym(library_, (name + "_predict_batch").c_str()));
+        return predict_ && predict_batch_;
+    }
+
+    void *library_ = nullptr;
+    Predict predict_ = nullptr;
+    PredictBatch predict_batch_ = nullptr;
+};
+
+// Test the generated spiral network, whose last layer is not an activation, matches predict() for single samples and batches
+TEST_F(CodeGenTest, SpiralTest)
+{
+    auto model = network();
+    model->add_layer(std::make_shared<NNFS::Dense>(2, 64));
+    model->add_layer(std::make_shared<NNFS::ReLU>());
+    model->add_layer(std::make_shared<NNFS::Dense>(64, 3));
+    model->compile();
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(48, 2);
+    train(model, x);
+    ASSERT_TRUE(build(model, "spiral"));
+
+    Eigen::MatrixXd expected = model->predict(x);
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> samples = x;
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> predictions(x.rows(), 3);
+    predict_batch_(samples.data(), predictions.data(), static_cast<int>(x.rows()));
+    EXPECT_TRUE(predictions.isApprox(expected, 1e-12));
+
+    Eigen::RowVector3d prediction;
+    predict_(samples.row(5).data(), prediction.data());
+    EXPECT_TRUE(prediction.isApprox(expected.row(5), 1e-12));
+}
+
+// Test affine layers, every activation and layers too wide to unroll
+TEST_F(CodeGenTest, LayersTest)
+{
+    auto model = network();
+    model->add_layer(NNFS::Affine::standardize(Eigen::RowVectorXd::Random(20), Eigen::RowVectorXd::Constant(20, 2.)));
+    model->add_layer(std::make_shared<NNFS::Dense>(20, 32));
+    model->add_layer(std::make_shared<NNFS::Sigmoid>());
+    model->add_layer(std::make_shared<NNFS::Dense>(32, 16));
+    model->add_layer(std::make_shared<NNFS::Tanh>());
+    model->add_layer(std::make_shared<NNFS::Dense>(16, 4));
+    model->add_layer(std::make_shared<NNFS::Softmax>());
+    model->compile();
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(32, 20);
+    train(model, x);
+    ASSERT_TRUE(build(model, "layers"));
+
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> samples = x;
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> predictions(x.rows(), 4);
+    predict_batch_(samples.data(), predictions.data(), static_cast<int>(x.rows()));
+    EXPECT_TRUE(predictions.isApprox(model->predict(x), 1e-12));
+}
+
+// Test networks with layers that cannot be generated, and invalid names, are rejected
+TEST_F(CodeGenTest, UnsupportedTest)
+{
+    std::ostringstream out;
+
+    auto model = network();
+    model->add_layer(std::make_shared<NNFS::Embedding>(10, 4, 2));
+    model->add_layer(std::make_shared<NNFS::Dense>(8, 3));
+    model->compile();
+    EXPECT_FALSE(NNFS::CodeGen::generate(*model, out, "embedding"));
+
+    auto dense = network();
+    auto layer = std::make_shared<NNFS::Dense>(2, 3);
+    dense->add_layer(layer);
+    dense->compile();
+    EXPECT_FALSE(NNFS::CodeGen::generate(*dense, out, "2model"));
+    EXPECT_TRUE(NNFS::CodeGen::generate(*dense, out, "model"));
+
+    // Parameters without a C++ literal
+    Eigen::MatrixXd weights = Eigen::MatrixXd::Ones(2, 3);
+    weights(1, 2) = std::numeric_limits<double>::quiet_NaN();
+    layer->weights(weights);
+    dense->compile();
+    EXPECT_FALSE(NNFS::CodeGen::generate(*dense, out, "nan"));
+    weights(1, 2) = std::numeric_limits<double>::infinity();
+    layer->weights(weights);
+    dense->compile();
+    EXPECT_FALSE(NNFS::CodeGen::generate(*dense, out, "inf"));
+}
@@ -0,0 +1,494 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class PackedDatasetTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        features_ = Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>(5, 3);
+        features_ << 0, 1, 2,
+            3, 4, 5,
+            6, 7, 8,
+            9, 10, 11,
+            255, 128, 0;
+        labels_ = Eigen::Matrix<int32_t, Eigen::Dynamic, 1>(5);
+        labels_ << 0, 2, 1, 2, 0;
+    }
+
+    void TearDown() override
+    {
+        std::remove(path_.c_str());
+    }
+
+    std::string path_ = testing::TempDir() + "nnfs_packed_dataset_test.pack";
+    Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> features_;
+    Eigen::Matrix<int32_t, Eigen::Dynamic, 1> labels_;
+};
+
+// Test PackedDataset write and zero-copy views of a uint8 dataset
+TEST_F(PackedDatasetTest, RoundTripUInt8)
+{
+    ASSERT_TRUE(NNFS::PackedDataset::write<uint8_t>(path_, features_, labels_, 3));
+
+    NNFS::PackedDataset dataset(path_);
+    ASSERT_TRUE(dataset.is_open());
+    EXPECT_EQ(dataset.samples(), 5);
+    EXPECT_EQ(dataset.features(), 3);
+    EXPECT_EQ(dataset.classes(), 3);
+    EXPECT_EQ(dataset.type(), NNFS::PackedType::UINT8);
+
+    auto rows = dataset.features_u8(1, 3);
+    EXPECT_EQ(rows.rows(), 3);
+    EXPECT_TRUE(rows == features_.middleRows(1, 3));
+    EXPECT_TRUE(dataset.labels(1, 3) == labels_.segment(1, 3));
+
+    // Sections are page aligned
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(dataset.features_u8(0, 1).data()) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(dataset.labels(0, 1).data()) % 64, 0u);
+
+    dataset.prefetch(0, 5);
+
+    EXPECT_THROW(dataset.features_f32(0, 1), std::invalid_argument);
+    EXPECT_THROW(dataset.features_u8(4, 2), std::out_of_range);
+}
+
+// Test PackedDataset conversion to the matrices used by NeuralNetwork
+TEST_F(PackedDatasetTest, Batch)
+{
+    ASSERT_TRUE(NNFS::PackedDataset::write<uint8_t>(path_, features_, labels_, 3));
+
+    NNFS::PackedDataset dataset(path_);
+    Eigen::MatrixXd x, y;
+    dataset.batch(3, 2, x, y);
+
+    Eigen::MatrixXd expected_x = features_.middleRows(3, 2).cast<double>() / 255.;
+    Eigen::MatrixXd expected_y(2, 3);
+    expected_y << 0, 0, 1,
+        1, 0, 0;
+
+    EXPECT_TRUE(x.isApprox(expected_x));
+    EXPECT_TRUE(y == expected_y);
+}
+
+// Test PackedDataset with float32 features
+TEST_F(PackedDatasetTest, RoundTripFloat32)
+{
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> features = features_.cast<float>() * .5f;
+    ASSERT_TRUE(NNFS::PackedDataset::write<float>(path_, features, labels_, 3));
+
+    NNFS::PackedDataset dataset(path_);
+    ASSERT_TRUE(dataset.is_open());
+    EXPECT_EQ(dataset.type(), NNFS::PackedType::FLOAT32);
+    EXPECT_TRUE(dataset.features_f32(0, 5) == features);
+
+    Eigen::MatrixXd x, y;
+    dataset.batch(0, 5, x, y);
+    EXPECT_TRUE(x.isApprox(features.cast<double>()));
+}
+
+// Test PackedDataset rejects invalid input and malformed files
+TEST_F(PackedDatasetTest, RejectsInvalid)
+{
+    // Label out of range
+    EXPECT_FALSE(NNFS::PackedDataset::write<uint8_t>(path_, features_, labels_, 2));
+
+    // Missing file
+    NNFS::PackedDataset dataset;
+    EXPECT_FALSE(dataset.open(path_ + ".missing"));
+    EXPECT_FALSE(dataset.is_open());
+
+    // Truncated file
+    ASSERT_TRUE(NNFS::PackedDataset::write<uint8_t>(path_, features_, labels_, 3));
+    {
+        std::ifstream ifs(path_, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        std::ofstream ofs(path_, std::ios::binary | std::ios::trunc);
+        ofs.write(contents.data(), contents.size() - 4);
+    }
+    EXPECT_FALSE(dataset.open(path_));
+
+    // Wrong magic
+    {
+        std::ofstream ofs(path_, std::ios::binary | std::ios::trunc);
+        ofs << std::string(8192, 'x');
+    }
+    EXPECT_FALSE(dataset.open(path_));
+
+    // Sizes whose product wraps to zero, with a file long enough for the labels so only the size bounds can reject it
+    ASSERT_TRUE(NNFS::PackedDataset::write<uint8_t>(path_, features_, labels_, 3));
+    NNFS::PackedHeader header;
+    {
+        std::ifstream ifs(path_, std::ios::binary);
+        ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    }
+    header.samples = uint64_t(1) << 24;
+    header.features = uint64_t(1) << 40;
+    header.labels_offset = header.features_offset;
+    {
+        std::ofstream ofs(path_, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.seekp(header.labels_offset + header.samples * sizeof(int32_t) - 1);
+        ofs.put(0);
+    }
+    EXPECT_FALSE(dataset.open(path_));
+}
+
+// Test NeuralNetwork::fit on compact data matches training on the equivalent double matrices
+TEST(CompactFit, MatchesDoubleFit)
+{
+    Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> examples =
+        (Eigen::MatrixXd::Random(64, 6).array().abs() * 255).cast<uint8_t>();
+    Eigen::VectorXi labels = Eigen::VectorXi::LinSpaced(64, 0, 63).unaryExpr([](int i)
+                                                                             { return i % 3; });
+
+    Eigen::MatrixXd examples_double = examples.cast<double>() / 255.;
+    Eigen::MatrixXd labels_onehot = Eigen::MatrixXd::Zero(64, 3);
+    for (int i = 0; i < 64; ++i)
+    {
+        labels_onehot(i, labels(i)) = 1.;
+    }
+
+    auto make_model = [](const std::shared_ptr<NNFS::Dense> &first, const std::shared_ptr<NNFS::Dense> &second)
+    {
+        auto model = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::SGD>(.1));
+        model->add_layer(first);
+        model->add_layer(std::make_shared<NNFS::ReLU>());
+        model->add_layer(second);
+        model->compile();
+        return model;
+    };
+
+    auto compact_first = std::make_shared<NNFS::Dense>(6, 8);
+    auto compact_second = std::make_shared<NNFS::Dense>(8, 3);
+    auto double_first = std::make_shared<NNFS::Dense>(6, 8);
+    auto double_second = std::make_shared<NNFS::Dense>(8, 3);
+    Eigen::MatrixXd first_weights = compact_first->weights();
+    Eigen::MatrixXd second_weights = compact_second->weights();
+    double_first->weights(first_weights);
+    double_second->weights(second_weights);
+
+    auto compact_model = make_model(compact_first, compact_second);
+    auto double_model = make_model(double_first, double_second);
+
+    compact_model->fit(examples, labels, examples, labels, 3, 16, false);
+    double_model->fit(examples_double, labels_onehot, examples_double, labels_onehot, 3, 16, false);
+
+    EXPECT_TRUE(compact_first->weights().isApprox(double_first->weights()));
+    EXPECT_TRUE(compact_second->weights().isApprox(double_second->weights()));
+
+    double compact_accuracy = -1;
+    double double_accuracy = -1;
+    compact_model->accuracy(compact_accuracy, examples, labels);
+    double_model->accuracy(double_accuracy, examples_double, labels_onehot);
+    EXPECT_DOUBLE_EQ(compact_accuracy, double_accuracy);
+
+    // Out of range class ids are rejected before training
+    Eigen::VectorXi bad_labels = labels;
+    bad_labels(0) = 3;
+    Eigen::MatrixXd before = compact_first->weights();
+    compact_model->fit(examples, bad_labels, examples, labels, 1, 16, false);
+    EXPECT_TRUE(compact_first->weights() == before);
+}
+
+class CSVTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        std::remove(path_.c_str());
+    }
+
+    void write(const std::string &contents)
+    {
+        std::ofstream ofs(path_, std::ios::binary | std::ios::trunc);
+        ofs << contents;
+    }
+
+    std::string path_ = testing::TempDir() + "nnfs_csv_test.csv";
+};
+
+// Test CSV::load with a numeric label column, a header and Windows line endings
+TEST_F(CSVTest, NumericLabels)
+{
+    write("a,label,b\r\n1.5,2,-3\r\n\r\n4e2,0, 5\r\n");
+
+    NNFS::CSVOptions options;
+    options.header = true;
+    options.label_column = 1;
+
+    NNFS::CSV::Features features;
+    Eigen::VectorXi labels;
+    std::vector<std::string> classes;
+    ASSERT_TRUE(NNFS::CSV::load(path_, features, labels, classes, options));
+
+    NNFS::CSV::Features expected(2, 2);
+    expected << 1.5, -3,
+        400, 5;
+    EXPECT_TRUE(features == expected);
+    EXPECT_EQ(labels, Eigen::Vector2i(2, 0));
+    EXPECT_EQ(classes, (std::vector<std::string>{"0", "1", "2"}));
+}
+
+// Test CSV::load numbers sparse integer labels by value instead of making a class for every id up to the largest one
+TEST_F(CSVTest, SparseNumericLabels)
+{
+    write("1,2000000000\n2,7\n3,2000000000\n4,10\n");
+
+    NNFS::CSVOptions options;
+    options.label_column = 1;
+
+    NNFS::CSV::Features features;
+    Eigen::VectorXi labels;
+    std::vector<std::string> classes;
+    ASSERT_TRUE(NNFS::CSV::load(path_, features, labels, classes, options));
+
+    EXPECT_EQ(classes, (std::vector<std::string>{"7", "10", "2000000000"}));
+    EXPECT_EQ(labels, Eigen::Vector4i(2, 0, 2, 1));
+}
+
+// Test CSV::load maps string labels to sorted class ids and reads TSV files
+TEST_F(CSVTest, StringLabels)
+{
+    write("0.5\tdog\n1\t\"cat\"\n2\tdog\n3\tbird");
+
+    NNFS::CSVOptions options;
+    options.delimiter = '\t';
+    options.label_column = 1;
+
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> features;
+    Eigen::VectorXi labels;
+    std::vector<std::string> classes;
+    ASSERT_TRUE(NNFS::CSV::load(path_, features, labels, classes, options));
+
+    EXPECT_EQ(features.rows(), 4);
+    EXPECT_EQ(features.cols(), 1);
+    EXPECT_FLOAT_EQ(features(3, 0), 3.f);
+    EXPECT_EQ(classes, (std::vector<std::string>{"bird", "cat", "dog"}));
+    EXPECT_EQ(labels, Eigen::Vector4i(2, 1, 2, 0));
+}
+
+// Test CSV::load rejects malformed rows
+TEST_F(CSVTest, RejectsMalformed)
+{
+    NNFS::CSV::Features features;
+
+    write("1,2,3\n4,5\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    write("1,2,3\n4,x,6\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    write("1,2,3\n4,5,6,7\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    // Numbers out of the range of the scalar type and repeated signs
+    write("1,2,3\n4,1e999,6\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    write("1,2,3\n4,1e-400,6\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> single;
+    write("1,2,3\n4,1e300,6\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, single));
+
+    write("1,2,3\n4,++5,6\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    write("1,2,3\n4,+-5,6\n");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    write("1,2,3\n4,+5,6\n");
+    ASSERT_TRUE(NNFS::CSV::load(path_, features));
+    EXPECT_EQ(features(1, 1), 5.);
+
+    write("");
+    EXPECT_FALSE(NNFS::CSV::load(path_, features));
+
+    EXPECT_FALSE(NNFS::CSV::load(path_ + ".missing", features));
+}
+
+// Test CSV::load gives the same result with any number of threads
+TEST_F(CSVTest, ThreadsAgree)
+{
+    // Large enough to be split into several ranges
+    std::string contents;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dis(-100., 100.);
+    for (int row = 0; row < 60000; ++row)
+    {
+        contents += std::to_string(row % 7);
+        for (int column = 0; column < 4; ++column)
+        {
+            contents += "," + std::to_string(dis(gen));
+        }
+        contents += "\n";
+    }
+    write(contents);
+
+    NNFS::CSVOptions options;
+    options.label_column = 0;
+
+    NNFS::CSV::Features single, multi;
+    Eigen::VectorXi single_labels, multi_labels;
+    std::vector<std::string> classes;
+
+    options.threads = 1;
+    ASSERT_TRUE(NNFS::CSV::load(path_, single, single_labels, classes, options));
+    options.threads = 4;
+    ASSERT_TRUE(NNFS::CSV::load(path_, multi, multi_labels, classes, options));
+
+    EXPECT_EQ(single.rows(), 60000);
+    EXPECT_TRUE(single == multi);
+    EXPECT_TRUE(single_labels == multi_labels);
+    EXPECT_EQ(classes.size(), 7u);
+}
+
+class LibSVMTest : public CSVTest
+{
+};
+
+// Test LibSVM::load with class id labels, comments and qid pairs
+TEST_F(LibSVMTest, Load)
+{
+    write("2 1:0.5 4:-1 # comment\n\n0 qid:3 2:1.5\t3:2\r\n1\n# only a comment\n2 5:1e2\n");
+
+    NNFS::LibSVM::Features features;
+    Eigen::VectorXi labels;
+    std::vector<std::string> classes;
+    ASSERT_TRUE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    Eigen::MatrixXd expected = Eigen::MatrixXd::Zero(4, 5);
+    expected(0, 0) = .5;
+    expected(0, 3) = -1.;
+    expected(1, 1) = 1.5;
+    expected(1, 2) = 2.;
+    expected(3, 4) = 100.;
+
+    EXPECT_EQ(features.nonZeros(), 5);
+    EXPECT_TRUE(Eigen::MatrixXd(features) == expected);
+    EXPECT_EQ(labels, Eigen::Vector4i(2, 0, 1, 2));
+    EXPECT_EQ(classes, (std::vector<std::string>{"0", "1", "2"}));
+
+    // A fixed width and zero-based indices
+    NNFS::LibSVMOptions options;
+    options.features = 10;
+    options.zero_based = true;
+    write("-1 0:1 9:2\n+1 4:3\n");
+    ASSERT_TRUE(NNFS::LibSVM::load(path_, features, labels, classes, options));
+    EXPECT_EQ(features.cols(), 10);
+    EXPECT_EQ(features.coeff(0, 9), 2.);
+    EXPECT_EQ(labels, Eigen::Vector2i(0, 1));
+    EXPECT_EQ(classes, (std::vector<std::string>{"-1", "1"}));
+
+    // Sparse integer labels are numbered by value instead of making a class for every id up to the largest one
+    write("1e9 1:1\n5 1:2\n1e9 1:3\n");
+    ASSERT_TRUE(NNFS::LibSVM::load(path_, features, labels, classes));
+    EXPECT_EQ(labels, Eigen::Vector3i(1, 0, 1));
+    EXPECT_EQ(classes, (std::vector<std::string>{"5", "1000000000"}));
+}
+
+// Test LibSVM::load rejects malformed lines
+TEST_F(LibSVMTest, RejectsMalformed)
+{
+    NNFS::LibSVM::Features features;
+    Eigen::VectorXi labels;
+    std::vector<std::string> classes;
+
+    write("1 3:1 2:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("1 0:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("1 2:x\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("1 2:1x\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("a 2:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("1e999 2:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("1 2:1e-400\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("++1 2:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("1 2:+++1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("nan 2:1\n1 2:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    write("-inf 2:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+
+    NNFS::LibSVMOptions options;
+    options.features = 4;
+    write("1 5:1\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes, options));
+
+    write("# nothing\n");
+    EXPECT_FALSE(NNFS::LibSVM::load(path_, features, labels, classes));
+}
+
+// Test NeuralNetwork::fit on sparse data matches training on the equivalent dense matrices
+TEST(SparseFit, MatchesDenseFit)
+{
+    Eigen::MatrixXd examples = (Eigen::MatrixXd::Random(64, 40).array() > .9).cast<double>();
+    Eigen::VectorXi labels = Eigen::VectorXi::LinSpaced(64, 0, 63).unaryExpr([](int i)
+                                                                             { return i % 3; });
+    NNFS::NeuralNetwork::SparseExamples sparse = examples.sparseView();
+
+    Eigen::MatrixXd labels_onehot = Eigen::MatrixXd::Zero(64, 3);
+    for (int i = 0; i < 64; ++i)
+    {
+        labels_onehot(i, labels(i)) = 1.;
+    }
+
+    auto make_model = [](const std::shared_ptr<NNFS::Dense> &first, const std::shared_ptr<NNFS::Dense> &second)
+    {
+        auto model = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.01));
+        model->add_layer(first);
+        model->add_layer(std::make_shared<NNFS::ReLU>());
+        model->add_layer(second);
+        model->compile();
+        return model;
+    };
+
+    auto sparse_first = std::make_shared<NNFS::Dense>(40, 8);
+    auto sparse_second = std::make_shared<NNFS::Dense>(8, 3);
+    auto dense_first = std::make_shared<NNFS::Dense>(40, 8);
+    auto dense_second = std::make_shared<NNFS::Dense>(8, 3);
+    Eigen::MatrixXd first_weights = sparse_first->weights();
+    Eigen::MatrixXd second_weights = sparse_second->weights();
+    dense_first->weights(first_weights);
+    dense_second->weights(second_weights);
+
+    auto sparse_model = make_model(sparse_first, sparse_second);
+    auto dense_model = make_model(dense_first, dense_second);
+
+    sparse_model->fit(sparse, labels, sparse, labels, 3, 16, false);
+    dense_model->fit(examples, labels_onehot, examples, labels_onehot, 3, 16, false);
+
+    EXPECT_TRUE(sparse_first->weights().isApprox(dense_first->weights()));
+    EXPECT_TRUE(sparse_second->weights().isApprox(dense_second->weights()));
+
+    double sparse_accuracy = -1;
+    double dense_accuracy = -1;
+    sparse_model->accuracy(sparse_accuracy, sparse, labels);
+    dense_model->accuracy(dense_accuracy, examples, labels_onehot);
+    EXPECT_DOUBLE_EQ(sparse_accuracy, dense_accuracy);
+}
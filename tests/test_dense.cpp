@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 
+#include <cstdio>
+
 #define LOG_LEVEL LOG_SEV_NONE
 
 #include <NNFS/Core>
@@ -141,4 +143,203 @@ TEST_F(DenseTest, RegularizationTest)
 
     EXPECT_TRUE(dense_optimization_->dbiases().isApprox(expected_dbiases, 1e-7));
     EXPECT_TRUE(dense_optimization_->dweights().isApprox(expected_dweights, 1e-7));
-}
\ No newline at end of file
+}
+
+// Test Dense::forward_incremental against the full forward pass
+TEST_F(DenseTest, IncrementalForwardTest)
+{
+    std::shared_ptr<NNFS::Dense> dense = std::make_shared<NNFS::Dense>(16, 5);
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(1, 16);
+    Eigen::MatrixXd expected;
+    Eigen::MatrixXd out;
+
+    dense->forward_incremental(out, x);
+    dense->forward(expected, x);
+    EXPECT_TRUE(out.isApprox(expected, 1e-12));
+
+    // A few changed features take the incremental path
+    x(0, 3) = 0.5;
+    x(0, 11) = -0.25;
+    dense->forward_incremental(out, x);
+    dense->forward(expected, x);
+    EXPECT_TRUE(out.isApprox(expected, 1e-12));
+
+    // Unchanged input
+    dense->forward_incremental(out, x);
+    EXPECT_TRUE(out.isApprox(expected, 1e-12));
+
+    // Most features changed, falls back to the full product
+    x = Eigen::MatrixXd::Random(1, 16);
+    dense->forward_incremental(out, x);
+    dense->forward(expected, x);
+    EXPECT_TRUE(out.isApprox(expected, 1e-12));
+
+    // Updated parameters invalidate the cached pre-activation
+    Eigen::MatrixXd weights = Eigen::MatrixXd::Random(16, 5);
+    dense->weights(weights);
+    x(0, 0) = 1.;
+    dense->forward_incremental(out, x);
+    dense->forward(expected, x);
+    EXPECT_TRUE(out.isApprox(expected, 1e-12));
+}
+
+// Test Dense::forward and Dense::backward with a sparse input against the dense path
+TEST_F(DenseTest, SparseInputTest)
+{
+    std::shared_ptr<NNFS::Dense> dense = std::make_shared<NNFS::Dense>(50, 4, 1e-3, 0., 1e-3, 0.);
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Zero(6, 50);
+    x(0, 3) = 1.;
+    x(1, 49) = -2.;
+    x(2, 0) = .5;
+    x(2, 17) = 1.5;
+    x(4, 3) = 3.;
+    NNFS::Dense::SparseInput sparse = x.sparseView();
+    Eigen::MatrixXd dx = Eigen::MatrixXd::Random(6, 4);
+
+    Eigen::MatrixXd expected_out, expected_din;
+    dense->forward(expected_out, x);
+    dense->backward(expected_din, dx);
+    Eigen::MatrixXd expected_dweights = dense->dweights();
+    Eigen::MatrixXd expected_dbiases = dense->dbiases();
+
+    Eigen::MatrixXd out, din;
+    dense->forward(out, sparse);
+    dense->backward(din, dx);
+
+    EXPECT_TRUE(out.isApprox(expected_out, 1e-12));
+    EXPECT_TRUE(dense->dweights().isApprox(expected_dweights, 1e-12));
+    EXPECT_TRUE(dense->dbiases().isApprox(expected_dbiases, 1e-12));
+    EXPECT_EQ(din.size(), 0);
+
+    // A dense forward pass switches back to the dense gradients
+    dense->forward(out, x);
+    dense->backward(din, dx);
+    EXPECT_TRUE(din.isApprox(expected_din, 1e-12));
+}
+
+// Test the compressed kernels used for mostly-zero inputs against the dense products
+TEST_F(DenseTest, CompressedKernelsTest)
+{
+    std::shared_ptr<NNFS::Dense> compressed = std::make_shared<NNFS::Dense>(40, 6, 1e-3, 0., 1e-3, 0.);
+    std::shared_ptr<NNFS::Dense> dense = std::make_shared<NNFS::Dense>(40, 6, 1e-3, 0., 1e-3, 0.);
+    Eigen::MatrixXd weights = compressed->weights();
+    dense->weights(weights);
+    compressed->sparsity_threshold(.5);
+    dense->sparsity_threshold(2.);
+
+    // Output of a ReLU with about 90% zeros
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(8, 40);
+    x = (x.array() < .8).select(0., x);
+    Eigen::MatrixXd dx = Eigen::MatrixXd::Random(8, 6);
+
+    Eigen::MatrixXd out, expected_out, din, expected_din;
+    compressed->forward(out, x);
+    dense->forward(expected_out, x);
+    EXPECT_GT(compressed->input_sparsity(), .5);
+    EXPECT_TRUE(out.isApprox(expected_out, 1e-12));
+
+    compressed->backward(din, dx);
+    dense->backward(expected_din, dx);
+    EXPECT_TRUE(compressed->dweights().isApprox(dense->dweights(), 1e-12));
+    EXPECT_TRUE(compressed->dbiases().isApprox(dense->dbiases(), 1e-12));
+    EXPECT_TRUE(din.isApprox(expected_din, 1e-12));
+
+    // The masked input gradient matches the dense one wherever the ReLU lets the gradient through
+    compressed->masked_input_gradient(true);
+    compressed->forward(out, x);
+    compressed->backward(din, dx);
+    EXPECT_TRUE(din.isApprox((x.array() != 0).select(expected_din, 0.), 1e-12));
+
+    // The network passes the same matrix as input and output
+    Eigen::MatrixXd inout = x;
+    compressed->forward(inout, inout);
+    EXPECT_TRUE(inout.isApprox(expected_out, 1e-12));
+    inout = dx;
+    compressed->backward(inout, inout);
+    EXPECT_TRUE(inout.isApprox(din, 1e-12));
+}
+
+// Test a fused activation against a dense layer followed by the activation layer
+TEST_F(DenseTest, FusedActivationTest)
+{
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(8, 4) * 3.;
+    Eigen::MatrixXd dx = Eigen::MatrixXd::Random(8, 3);
+    Eigen::MatrixXd biases = Eigen::MatrixXd::Random(1, 3);
+    dense_->biases(biases);
+
+    std::vector<std::pair<NNFS::ActivationType, std::shared_ptr<NNFS::Activation>>> activations = {
+        {NNFS::ActivationType::RELU, std::make_shared<NNFS::ReLU>()},
+        {NNFS::ActivationType::SIGMOID, std::make_shared<NNFS::Sigmoid>()},
+        {NNFS::ActivationType::TANH, std::make_shared<NNFS::Tanh>()}};
+    for (auto &activation : activations)
+    {
+        Eigen::MatrixXd expected_out, expected_din;
+        dense_->fuse(NNFS::ActivationType::NONE);
+        dense_->forward(expected_out, x);
+        activation.second->forward(expected_out, expected_out);
+        activation.second->backward(expected_din, dx);
+        dense_->backward(expected_din, expected_din);
+        Eigen::MatrixXd expected_dweights = dense_->dweights();
+        Eigen::MatrixXd expected_dbiases = dense_->dbiases();
+
+        // The network passes the same matrix as input and output
+        dense_->fuse(activation.first);
+        EXPECT_EQ(dense_->fused_activation(), activation.first);
+        Eigen::MatrixXd inout = x;
+        dense_->forward(inout, inout);
+        EXPECT_TRUE(inout.isApprox(expected_out, 1e-12));
+        inout = dx;
+        dense_->backward(inout, inout);
+        EXPECT_TRUE(inout.isApprox(expected_din, 1e-12));
+        EXPECT_TRUE(dense_->dweights().isApprox(expected_dweights, 1e-12));
+        EXPECT_TRUE(dense_->dbiases().isApprox(expected_dbiases, 1e-12));
+
+        // The incremental forward pass applies the activation too
+        Eigen::MatrixXd incremental;
+        dense_->forward_incremental(incremental, x.topRows(1));
+        EXPECT_TRUE(incremental.isApprox(expected_out.topRows(1), 1e-12));
+    }
+
+    EXPECT_THROW(dense_->fuse(NNFS::ActivationType::SOFTMAX), std::invalid_argument);
+}
+
+// Test NeuralNetwork::compile() fuses activations without changing what the network computes or learns
+TEST_F(DenseTest, NeuralNetworkFusionTest)
+{
+    Eigen::MatrixXd examples = Eigen::MatrixXd::Random(64, 4);
+    Eigen::MatrixXd labels = Eigen::MatrixXd::Zero(64, 2);
+    for (int i = 0; i < 64; ++i)
+    {
+        labels(i, examples(i, 0) * examples(i, 1) > 0 ? 1 : 0) = 1.;
+    }
+
+    std::shared_ptr<NNFS::NeuralNetwork> models[2];
+    for (int m = 0; m < 2; ++m)
+    {
+        models[m] = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.01));
+        models[m]->add_layer(std::make_shared<NNFS::Dense>(4, 16));
+        models[m]->add_layer(std::make_shared<NNFS::ReLU>());
+        models[m]->add_layer(std::make_shared<NNFS::Dense>(16, 16));
+        models[m]->add_layer(std::make_shared<NNFS::Tanh>());
+        models[m]->add_layer(std::make_shared<NNFS::Dense>(16, 8));
+        models[m]->add_layer(std::make_shared<NNFS::Sigmoid>());
+        models[m]->add_layer(std::make_shared<NNFS::Dense>(8, 2));
+    }
+    models[0]->compile(false);
+    models[1]->compile();
+
+    // Same starting point, saved from the unfused model
+    std::string path = testing::TempDir() + "nnfs_fusion_test.bin";
+    models[0]->save(path);
+    models[1]->load(path);
+    std::remove(path.c_str());
+    EXPECT_TRUE(models[1]->predict(examples).isApprox(models[0]->predict(examples), 1e-12));
+
+    for (auto &model : models)
+    {
+        model->fit(examples, labels, examples, labels, 5, 16, false);
+    }
+    EXPECT_TRUE(models[1]->predict(examples).isApprox(models[0]->predict(examples), 1e-9));
+}
@@ -0,0 +1,190 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class EmbeddingTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ids_ = Eigen::MatrixXd(3, 2);
+        ids_ << 4, 1,
+            1, 7,
+            0, 4;
+        dx_ = Eigen::MatrixXd::Random(3, 6);
+    }
+
+    // One-hot encoding of ids_, one block of n_ids columns per input
+    Eigen::MatrixXd onehot(int n_ids) const
+    {
+        Eigen::MatrixXd x = Eigen::MatrixXd::Zero(ids_.rows(), n_ids);
+        for (int row = 0; row < ids_.rows(); ++row)
+        {
+            for (int input = 0; input < ids_.cols(); ++input)
+            {
+                x(row, static_cast<int>(ids_(row, input))) = 1.;
+            }
+        }
+        return x;
+    }
+
+    Eigen::MatrixXd ids_;
+    Eigen::MatrixXd dx_;
+};
+
+// Test Embedding::forward gathers rows of the table
+TEST_F(EmbeddingTest, ForwardTest)
+{
+    NNFS::Embedding embedding(8, 3, 2);
+
+    Eigen::MatrixXd out;
+    embedding.forward(out, ids_);
+    ASSERT_EQ(out.rows(), 3);
+    ASSERT_EQ(out.cols(), 6);
+    EXPECT_TRUE(out.block(0, 0, 1, 3) == embedding.table().row(4));
+    EXPECT_TRUE(out.block(1, 3, 1, 3) == embedding.table().row(7));
+
+    // The network passes the same matrix as input and output
+    Eigen::MatrixXd x = ids_;
+    embedding.forward(x, x);
+    EXPECT_TRUE(x == out);
+
+    Eigen::MatrixXd bad = ids_;
+    bad(1, 1) = 8;
+    EXPECT_THROW(embedding.forward(out, bad), std::out_of_range);
+    bad(1, 1) = 1.5;
+    EXPECT_THROW(embedding.forward(out, bad), std::out_of_range);
+    EXPECT_THROW(embedding.forward(out, Eigen::MatrixXd::Zero(3, 1)), std::invalid_argument);
+}
+
+// Test Embedding::backward against the gradient of a dense layer fed with one-hot vectors
+TEST_F(EmbeddingTest, BackwardTest)
+{
+    NNFS::Embedding embedding(8, 3, 1);
+    ids_ = ids_.col(0).eval();
+    ids_(2, 0) = 4;
+    dx_ = dx_.leftCols(3).eval();
+
+    Eigen::MatrixXd out;
+    embedding.forward(out, ids_);
+    embedding.backward(out, dx_);
+
+    NNFS::Dense dense(8, 3);
+    Eigen::MatrixXd dense_out;
+    dense.forward(dense_out, onehot(8));
+    dense.backward(dense_out, dx_);
+
+    // Id 4 is used twice, its gradients are summed
+    EXPECT_EQ(embedding.rows(), (std::vector<int>{1, 4}));
+    ASSERT_EQ(embedding.drows().rows(), 2);
+    EXPECT_TRUE(embedding.drows().row(0).isApprox(dense.dweights().row(1)));
+    EXPECT_TRUE(embedding.drows().row(1).isApprox(dense.dweights().row(4)));
+    EXPECT_EQ(out.size(), 0);
+}
+
+// Test lazy optimizer updates match the dense updates on the rows used by the batch and leave the other rows alone
+TEST_F(EmbeddingTest, LazyUpdatesTest)
+{
+    std::vector<std::shared_ptr<NNFS::Optimizer>> embedding_optimizers = {
+        std::make_shared<NNFS::SGD>(.1), std::make_shared<NNFS::SGD>(.1, 0., .9), std::make_shared<NNFS::Adagrad>(.1),
+        std::make_shared<NNFS::RMSProp>(.1), std::make_shared<NNFS::Adam>(.1)};
+    std::vector<std::shared_ptr<NNFS::Optimizer>> dense_optimizers = {
+        std::make_shared<NNFS::SGD>(.1), std::make_shared<NNFS::SGD>(.1, 0., .9), std::make_shared<NNFS::Adagrad>(.1),
+        std::make_shared<NNFS::RMSProp>(.1), std::make_shared<NNFS::Adam>(.1)};
+
+    ids_ = ids_.col(0).eval();
+    dx_ = dx_.leftCols(3).eval();
+
+    for (size_t i = 0; i < embedding_optimizers.size(); ++i)
+    {
+        auto embedding = std::make_shared<NNFS::Embedding>(8, 3);
+        auto dense = std::make_shared<NNFS::Dense>(8, 3);
+        Eigen::MatrixXd table = embedding->table();
+        dense->weights(table);
+
+        Eigen::MatrixXd out;
+        embedding->forward(out, ids_);
+        embedding->backward(out, dx_);
+        embedding_optimizers[i]->update_params(embedding);
+
+        dense->forward(out, onehot(8));
+        dense->backward(out, dx_);
+        dense_optimizers[i]->update_params(dense);
+
+        // After one step rows without gradient did not move in either layer
+        EXPECT_TRUE(embedding->table().isApprox(dense->weights())) << "optimizer " << i;
+        EXPECT_TRUE(embedding->table().row(2) == table.row(2)) << "optimizer " << i;
+    }
+}
+
+// Test a table with a million rows trains without touching the rows and optimizer state of unused ids
+TEST_F(EmbeddingTest, LargeTableTest)
+{
+    auto embedding = std::make_shared<NNFS::Embedding>(1000000, 4);
+    std::shared_ptr<NNFS::Optimizer> optimizer = std::make_shared<NNFS::SGD>(.1);
+    Eigen::MatrixXd before = embedding->table().topRows(10);
+
+    Eigen::MatrixXd ids(2, 1);
+    ids << 999999, 3;
+    Eigen::MatrixXd out;
+    for (int step = 0; step < 100; ++step)
+    {
+        embedding->forward(out, ids);
+        embedding->backward(out, Eigen::MatrixXd::Ones(2, 4));
+        optimizer->update_params(embedding);
+    }
+
+    const NNFS::Embedding &layer = *embedding;
+    EXPECT_EQ(layer.table_optimizer().size(), 0);
+    EXPECT_TRUE(layer.table().row(3).isApprox((before.row(3).array() - 10.).matrix()));
+    EXPECT_TRUE(layer.table().topRows(3) == before.topRows(3));
+}
+
+// Test NeuralNetwork with an embedding layer compiles, trains, saves and loads
+TEST_F(EmbeddingTest, NeuralNetworkTest)
+{
+    auto model = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.05));
+    model->add_layer(std::make_shared<NNFS::Embedding>(8, 3, 2));
+    model->add_layer(std::make_shared<NNFS::Dense>(6, 2));
+    model->compile();
+
+    int n_input, n_output;
+    model->shape(n_input, n_output);
+    EXPECT_EQ(n_input, 2);
+    EXPECT_EQ(n_output, 2);
+
+    // The class is whether the first id is even
+    Eigen::MatrixXd examples(8, 2);
+    Eigen::MatrixXd labels = Eigen::MatrixXd::Zero(8, 2);
+    for (int i = 0; i < 8; ++i)
+    {
+        examples(i, 0) = i;
+        examples(i, 1) = 7 - i;
+        labels(i, i % 2) = 1.;
+    }
+    model->fit(examples, labels, examples, labels, 100, 8, false);
+
+    double accuracy = 0;
+    model->accuracy(accuracy, examples, labels);
+    EXPECT_DOUBLE_EQ(accuracy, 1.);
+
+    std::string path = testing::TempDir() + "nnfs_embedding_test.bin";
+    model->save(path);
+    auto loaded = std::make_shared<NNFS::NeuralNetwork>();
+    loaded->load(path);
+    std::remove(path.c_str());
+
+    EXPECT_TRUE(loaded->predict(examples).isApprox(model->predict(examples)));
+
+    // Embeddings take ids and must come first
+    auto misplaced = std::make_shared<NNFS::NeuralNetwork>();
+    misplaced->add_layer(std::make_shared<NNFS::Dense>(2, 2));
+    misplaced->add_layer(std::make_shared<NNFS::Embedding>(8, 3));
+    misplaced->compile();
+    misplaced->shape(n_input, n_output);
+    EXPECT_EQ(n_input, -1);
+}
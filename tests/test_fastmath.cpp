@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class FastMathTest : public ::testing::Test
+{
+protected:
+    // Evenly spaced values over [low, high], the count is not a multiple of the block size so the tail is covered too
+    static Eigen::MatrixXd linspace(double low, double high, Eigen::Index count = 400001)
+    {
+        return Eigen::VectorXd::LinSpaced(count, low, high);
+    }
+};
+
+// Test exp against std::exp over the whole clamped range, including tiny and huge results
+TEST_F(FastMathTest, ExpAccuracyTest)
+{
+    Eigen::MatrixXd x = linspace(-708., 709.);
+    Eigen::MatrixXd out;
+    NNFS::FastMath::exp(out, x);
+
+    double max_error = 0;
+    for (Eigen::Index i = 0; i < x.size(); ++i)
+    {
+        double exact = std::exp(x(i));
+        max_error = std::max(max_error, std::abs(out(i) - exact) / exact);
+    }
+    EXPECT_LT(max_error, NNFS::FastMath::max_exp_error);
+
+    // Inputs outside of the range are clamped instead of overflowing
+    EXPECT_GT(NNFS::FastMath::exp(-1000.), 0.);
+    EXPECT_TRUE(std::isfinite(NNFS::FastMath::exp(1000.)));
+    EXPECT_DOUBLE_EQ(NNFS::FastMath::exp(0.), 1.);
+    EXPECT_EQ(NNFS::FastMath::exp(-std::numeric_limits<double>::infinity()), 0.);
+}
+
+// Test sigmoid against the exact formula
+TEST_F(FastMathTest, SigmoidAccuracyTest)
+{
+    Eigen::MatrixXd x = linspace(-40., 40.);
+    Eigen::MatrixXd out;
+    NNFS::FastMath::sigmoid(out, x);
+
+    double max_error = 0;
+    for (Eigen::Index i = 0; i < x.size(); ++i)
+    {
+        double exact = 1. / (1. + std::exp(-x(i)));
+        max_error = std::max(max_error, std::abs(out(i) - exact) / exact);
+    }
+    EXPECT_LT(max_error, NNFS::FastMath::max_sigmoid_error);
+
+    // Saturates without producing NaN
+    EXPECT_EQ(NNFS::FastMath::exp(-1e308), NNFS::FastMath::exp(-708.));
+    x = Eigen::MatrixXd::Constant(1, 3, 1e300);
+    x(0, 1) = -1e300;
+    NNFS::FastMath::sigmoid(out, x);
+    EXPECT_DOUBLE_EQ(out(0, 0), 1.);
+    EXPECT_NEAR(out(0, 1), 0., 1e-300);
+}
+
+// Test tanh against std::tanh, in absolute terms everywhere and in relative terms close to 0
+TEST_F(FastMathTest, TanhAccuracyTest)
+{
+    Eigen::MatrixXd x = linspace(-40., 40.);
+    Eigen::MatrixXd out;
+    NNFS::FastMath::tanh(out, x);
+
+    double max_error = 0;
+    double max_relative_error = 0;
+    for (Eigen::Index i = 0; i < x.size(); ++i)
+    {
+        double exact = std::tanh(x(i));
+        max_error = std::max(max_error, std::abs(out(i) - exact));
+        if (exact != 0)
+        {
+            max_relative_error = std::max(max_relative_error, std::abs(out(i) - exact) / std::abs(exact));
+        }
+    }
+    EXPECT_LT(max_error, NNFS::FastMath::max_tanh_error);
+    EXPECT_LT(max_relative_error, NNFS::FastMath::max_tanh_relative_error);
+
+    for (double value = 1e-300; value < 1.; value *= 1.01)
+    {
+        EXPECT_NEAR(NNFS::FastMath::tanh(value), std::tanh(value), NNFS::FastMath::max_tanh_relative_error * std::tanh(value)) << value;
+    }
+}
+
+// Test the kernels may write over their input like the network does
+TEST_F(FastMathTest, InPlaceTest)
+{
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(37, 29) * 5.;
+    Eigen::MatrixXd expected, out = x;
+
+    NNFS::FastMath::tanh(expected, x);
+    NNFS::FastMath::tanh(out, out);
+    EXPECT_TRUE(out == expected);
+
+    out = x;
+    NNFS::FastMath::sigmoid(expected, x);
+    NNFS::FastMath::sigmoid(out, out);
+    EXPECT_TRUE(out == expected);
+}
+
+// Test the activations follow the exact kernels within the documented error when fast math is enabled
+TEST_F(FastMathTest, ActivationTest)
+{
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(64, 33) * 8.;
+    Eigen::MatrixXd dx = Eigen::MatrixXd::Random(64, 33);
+
+    NNFS::Sigmoid sigmoid, fast_sigmoid;
+    NNFS::Tanh tanh, fast_tanh;
+    NNFS::Softmax softmax, fast_softmax;
+    EXPECT_FALSE(fast_sigmoid.fast_math());
+    fast_sigmoid.fast_math(true);
+    fast_tanh.fast_math(true);
+    fast_softmax.fast_math(true);
+    EXPECT_TRUE(fast_sigmoid.fast_math());
+
+    std::vector<std::pair<NNFS::Activation *, NNFS::Activation *>> pairs = {{&sigmoid, &fast_sigmoid}, {&tanh, &fast_tanh}, {&softmax, &fast_softmax}};
+    for (auto &pair : pairs)
+    {
+        Eigen::MatrixXd exact, fast, exact_dx, fast_dx;
+        pair.first->forward(exact, x);
+        pair.second->forward(fast, x);
+        EXPECT_LT((fast - exact).cwiseAbs().maxCoeff(), 1e-8);
+
+        pair.first->backward(exact_dx, dx);
+        pair.second->backward(fast_dx, dx);
+        EXPECT_LT((fast_dx - exact_dx).cwiseAbs().maxCoeff(), 1e-8);
+    }
+}
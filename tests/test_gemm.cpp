@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class GemmTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        NNFS::Gemm::backend(NNFS::GemmBackend::AUTOMATIC);
+    }
+
+    // Every backend built in
+    static std::vector<NNFS::GemmBackend> backends()
+    {
+        std::vector<NNFS::GemmBackend> available;
+        for (NNFS::GemmBackend backend : {NNFS::GemmBackend::AUTOMATIC, NNFS::GemmBackend::EIGEN, NNFS::GemmBackend::BLAS, NNFS::GemmBackend::BUILTIN})
+        {
+            if (NNFS::Gemm::available(backend))
+            {
+                available.push_back(backend);
+            }
+        }
+        return available;
+    }
+};
+
+// Test backends can be selected by value and by name, and BLAS only when it is built in
+TEST_F(GemmTest, BackendTest)
+{
+    EXPECT_EQ(NNFS::Gemm::backend(), NNFS::GemmBackend::AUTOMATIC);
+    EXPECT_TRUE(NNFS::Gemm::backend(NNFS::GemmBackend::EIGEN));
+    EXPECT_EQ(NNFS::Gemm::backend(), NNFS::GemmBackend::EIGEN);
+
+#ifdef NNFS_BLAS
+    EXPECT_TRUE(NNFS::Gemm::backend(NNFS::GemmBackend::BLAS));
+    EXPECT_EQ(NNFS::Gemm::backend(), NNFS::GemmBackend::BLAS);
+#else
+    EXPECT_FALSE(NNFS::Gemm::available(NNFS::GemmBackend::BLAS));
+    EXPECT_FALSE(NNFS::Gemm::backend(NNFS::GemmBackend::BLAS));
+    EXPECT_EQ(NNFS::Gemm::backend(), NNFS::GemmBackend::EIGEN);
+#endif
+
+    NNFS::GemmBackend backend;
+    for (NNFS::GemmBackend candidate : {NNFS::GemmBackend::AUTOMATIC, NNFS::GemmBackend::EIGEN, NNFS::GemmBackend::BLAS, NNFS::GemmBackend::BUILTIN})
+    {
+        ASSERT_TRUE(NNFS::Gemm::parse(NNFS::Gemm::name(candidate), backend));
+        EXPECT_EQ(backend, candidate);
+    }
+    EXPECT_FALSE(NNFS::Gemm::parse("cublas", backend));
+}
+
+// Test every backend against Eigen, with batch-1 and few-row products that take the small-matrix kernel
+TEST_F(GemmTest, ProductTest)
+{
+    const Eigen::Index shapes[][3] = {{1, 128, 784}, {1, 3, 5}, {2, 17, 33}, {4, 64, 7}, {5, 40, 40}, {64, 10, 300}, {3, 1, 0}};
+    for (NNFS::GemmBackend backend : backends())
+    {
+        NNFS::Gemm::backend(backend);
+        for (const auto &shape : shapes)
+        {
+            const Eigen::Index m = shape[0], n = shape[1], k = shape[2];
+            for (bool transpose_a : {false, true})
+            {
+                for (bool transpose_b : {false, true})
+                {
+                    Eigen::MatrixXd a = transpose_a ? Eigen::MatrixXd::Random(k, m) : Eigen::MatrixXd::Random(m, k);
+                    Eigen::MatrixXd b = transpose_b ? Eigen::MatrixXd::Random(n, k) : Eigen::MatrixXd::Random(k, n);
+                    Eigen::MatrixXd expected = (transpose_a ? Eigen::MatrixXd(a.transpose()) : a) * (transpose_b ? Eigen::MatrixXd(b.transpose()) : b);
+
+                    Eigen::MatrixXd out;
+                    NNFS::Gemm::product(out, a, transpose_a, b, transpose_b);
+                    ASSERT_EQ(out.rows(), m);
+                    ASSERT_EQ(out.cols(), n);
+                    EXPECT_TRUE(out.isApprox(expected, 1e-12) || (expected.norm() == 0 && out.norm() == 0))
+                        << NNFS::Gemm::name(backend) << " " << m << "x" << n << "x" << k << " " << transpose_a << transpose_b;
+                }
+            }
+        }
+    }
+}
+
+// Test a dense layer gives the same forward and backward passes with every backend
+TEST_F(GemmTest, DenseTest)
+{
+    NNFS::Dense dense(12, 5);
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(3, 12);
+    Eigen::MatrixXd dy = Eigen::MatrixXd::Random(3, 5);
+
+    NNFS::Gemm::backend(NNFS::GemmBackend::EIGEN);
+    Eigen::MatrixXd expected_out, expected_dx;
+    dense.forward(expected_out, x);
+    dense.backward(expected_dx, dy);
+    Eigen::MatrixXd expected_dweights = dense.dweights();
+
+    for (NNFS::GemmBackend backend : backends())
+    {
+        NNFS::Gemm::backend(backend);
+        Eigen::MatrixXd out, dx;
+        dense.forward(out, x);
+        dense.backward(dx, dy);
+        EXPECT_TRUE(out.isApprox(expected_out, 1e-12)) << NNFS::Gemm::name(backend);
+        EXPECT_TRUE(dx.isApprox(expected_dx, 1e-12)) << NNFS::Gemm::name(backend);
+        EXPECT_TRUE(dense.dweights().isApprox(expected_dweights, 1e-12)) << NNFS::Gemm::name(backend);
+    }
+}
@@ -0,0 +1,153 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class KernelsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        NNFS::Gemm::backend(NNFS::GemmBackend::BUILTIN);
+    }
+
+    void TearDown() override
+    {
+        NNFS::CPU::level(NNFS::CPU::detected());
+        NNFS::Gemm::backend(NNFS::GemmBackend::AUTOMATIC);
+    }
+
+    // Every level the processor supports
+    static std::vector<NNFS::ISA> levels()
+    {
+        std::vector<NNFS::ISA> supported;
+        for (NNFS::ISA isa : {NNFS::ISA::BASELINE, NNFS::ISA::SSE4_2, NNFS::ISA::AVX2, NNFS::ISA::AVX512})
+        {
+            if (isa <= NNFS::CPU::detected())
+            {
+                supported.push_back(isa);
+            }
+        }
+        return supported;
+    }
+};
+
+// Test the level can be queried, lowered and not raised above what the processor supports
+TEST_F(KernelsTest, LevelTest)
+{
+    EXPECT_EQ(NNFS::CPU::level(), NNFS::CPU::detected());
+    EXPECT_EQ(NNFS::CPU::level(NNFS::ISA::BASELINE), NNFS::ISA::BASELINE);
+    EXPECT_EQ(NNFS::CPU::level(), NNFS::ISA::BASELINE);
+    EXPECT_EQ(NNFS::CPU::level(NNFS::ISA::AVX512), NNFS::CPU::detected());
+
+    NNFS::ISA isa;
+    for (NNFS::ISA level : levels())
+    {
+        ASSERT_TRUE(NNFS::CPU::parse(NNFS::CPU::name(level), isa));
+        EXPECT_EQ(isa, level);
+    }
+    EXPECT_FALSE(NNFS::CPU::parse("neon", isa));
+}
+
+// Test the matrix product of every level against Eigen, for every transposition and shapes with partial blocks
+TEST_F(KernelsTest, GemmTest)
+{
+    const Eigen::Index shapes[][3] = {{1, 7, 5}, {7, 5, 3}, {8, 6, 1}, {37, 29, 300}, {64, 64, 64}, {300, 17, 129}, {16, 1030, 9}};
+    for (NNFS::ISA level : levels())
+    {
+        NNFS::CPU::level(level);
+        for (const auto &shape : shapes)
+        {
+            const Eigen::Index m = shape[0], n = shape[1], k = shape[2];
+            for (bool transpose_a : {false, true})
+            {
+                for (bool transpose_b : {false, true})
+                {
+                    Eigen::MatrixXd a = transpose_a ? Eigen::MatrixXd::Random(k, m) : Eigen::MatrixXd::Random(m, k);
+                    Eigen::MatrixXd b = transpose_b ? Eigen::MatrixXd::Random(n, k) : Eigen::MatrixXd::Random(k, n);
+                    Eigen::MatrixXd expected = (transpose_a ? Eigen::MatrixXd(a.transpose()) : a) * (transpose_b ? Eigen::MatrixXd(b.transpose()) : b);
+
+                    Eigen::MatrixXd out = Eigen::MatrixXd::Constant(3, 3, 42.);
+                    NNFS::Gemm::product(out, a, transpose_a, b, transpose_b);
+                    EXPECT_TRUE(out.isApprox(expected, 1e-12)) << NNFS::CPU::name(level) << " " << m << "x" << n << "x" << k << " " << transpose_a << transpose_b;
+                }
+            }
+        }
+
+        // The result may replace an operand
+        Eigen::MatrixXd a = Eigen::MatrixXd::Random(40, 30);
+        Eigen::MatrixXd b = Eigen::MatrixXd::Random(30, 30);
+        Eigen::MatrixXd expected = a * b;
+        NNFS::Gemm::product(a, a, false, b, false);
+        EXPECT_TRUE(a.isApprox(expected, 1e-12)) << NNFS::CPU::name(level);
+    }
+}
+
+// Test the element-wise kernels of every level agree with the baseline ones
+TEST_F(KernelsTest, ElementwiseTest)
+{
+    Eigen::ArrayXd x = Eigen::ArrayXd::Random(1031) * 30.;
+    NNFS::CPU::level(NNFS::ISA::BASELINE);
+    Eigen::ArrayXd exp(x.size()), sigmoid(x.size()), tanh(x.size());
+    NNFS::Kernels::exp(exp.data(), x.data(), x.size());
+    NNFS::Kernels::sigmoid(sigmoid.data(), x.data(), x.size());
+    NNFS::Kernels::tanh(tanh.data(), x.data(), x.size());
+
+    for (NNFS::ISA level : levels())
+    {
+        NNFS::CPU::level(level);
+        Eigen::ArrayXd out(x.size());
+        NNFS::Kernels::exp(out.data(), x.data(), x.size());
+        EXPECT_TRUE(out.isApprox(exp, 1e-14)) << NNFS::CPU::name(level);
+        NNFS::Kernels::sigmoid(out.data(), x.data(), x.size());
+        EXPECT_TRUE(out.isApprox(sigmoid, 1e-14)) << NNFS::CPU::name(level);
+        out = x;
+        NNFS::Kernels::tanh(out.data(), out.data(), out.size());
+        EXPECT_TRUE(out.isApprox(tanh, 1e-14)) << NNFS::CPU::name(level);
+    }
+}
+
+// Test the optimizer updates of every level against the Eigen formulas
+TEST_F(KernelsTest, OptimizerTest)
+{
+    const Eigen::Index n = 203;
+    Eigen::ArrayXd parameters = Eigen::ArrayXd::Random(n);
+    Eigen::ArrayXd gradients = Eigen::ArrayXd::Random(n);
+    Eigen::ArrayXd cache = Eigen::ArrayXd::Random(n).abs();
+    Eigen::ArrayXd momentums = Eigen::ArrayXd::Random(n);
+    const double lr = .01, epsilon = 1e-7, rho = .9, beta_1 = .9, beta_2 = .999;
+
+    for (NNFS::ISA level : levels())
+    {
+        NNFS::CPU::level(level);
+
+        Eigen::ArrayXd p = parameters, c = cache, m = momentums;
+        NNFS::Kernels::sgd(p.data(), m.data(), gradients.data(), n, lr, .5);
+        Eigen::ArrayXd expected_m = .5 * momentums - lr * gradients;
+        EXPECT_TRUE(m.isApprox(expected_m, 1e-14));
+        EXPECT_TRUE(p.isApprox(parameters + expected_m, 1e-14));
+
+        p = parameters;
+        NNFS::Kernels::adagrad(p.data(), c.data(), gradients.data(), n, lr, epsilon);
+        Eigen::ArrayXd expected_c = cache + gradients.square();
+        EXPECT_TRUE(c.isApprox(expected_c, 1e-14));
+        EXPECT_TRUE(p.isApprox(parameters - lr * gradients / (expected_c.sqrt() + epsilon), 1e-14));
+
+        p = parameters, c = cache;
+        NNFS::Kernels::rmsprop(p.data(), c.data(), gradients.data(), n, lr, epsilon, rho);
+        expected_c = rho * cache + (1 - rho) * gradients.square();
+        EXPECT_TRUE(c.isApprox(expected_c, 1e-14));
+        EXPECT_TRUE(p.isApprox(parameters - lr * gradients / (expected_c.sqrt() + epsilon), 1e-14));
+
+        p = parameters, c = cache, m = momentums;
+        NNFS::Kernels::adam(p.data(), c.data(), m.data(), gradients.data(), n, lr, epsilon, beta_1, beta_2, 1 - beta_1, 1 - beta_2);
+        expected_m = beta_1 * momentums + (1 - beta_1) * gradients;
+        expected_c = beta_2 * cache + (1 - beta_2) * gradients.square();
+        EXPECT_TRUE(m.isApprox(expected_m, 1e-14));
+        EXPECT_TRUE(c.isApprox(expected_c, 1e-14));
+        EXPECT_TRUE(p.isApprox(parameters - lr * (expected_m / (1 - beta_1)) / ((expected_c / (1 - beta_2)).sqrt() + epsilon), 1e-14));
+    }
+}
@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class MemoryTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        NNFS::Memory::huge_pages(NNFS::HugePages::TRANSPARENT);
+    }
+};
+
+// Test small and large allocations are aligned, usable and accounted for until they are freed
+TEST_F(MemoryTest, AllocateTest)
+{
+    const NNFS::MemoryStats before = NNFS::Memory::stats();
+
+    for (NNFS::HugePages huge_pages : {NNFS::HugePages::NONE, NNFS::HugePages::TRANSPARENT, NNFS::HugePages::EXPLICIT})
+    {
+        NNFS::Memory::huge_pages(huge_pages);
+        for (size_t bytes : {size_t(1), size_t(100), NNFS::Memory::huge_page_size, 3 * NNFS::Memory::huge_page_size + 7})
+        {
+            char *buffer = static_cast<char *>(NNFS::Memory::allocate(bytes));
+            ASSERT_NE(buffer, nullptr);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer) % NNFS::Memory::alignment, 0u);
+            if (bytes >= NNFS::Memory::huge_page_size)
+            {
+                EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer) % NNFS::Memory::huge_page_size, 0u);
+            }
+            std::memset(buffer, 1, bytes);
+            EXPECT_EQ(buffer[bytes - 1], 1);
+
+            NNFS::MemoryStats stats = NNFS::Memory::stats();
+            EXPECT_EQ(stats.allocated_bytes, before.allocated_bytes + bytes);
+            if (huge_pages == NNFS::HugePages::NONE || bytes < NNFS::Memory::huge_page_size)
+            {
+                EXPECT_EQ(stats.explicit_huge_page_bytes + stats.transparent_advised_bytes,
+                          before.explicit_huge_page_bytes + before.transparent_advised_bytes);
+            }
+            else
+            {
+                // Whole huge pages, reserved ones or advised ones depending on what the system has
+                EXPECT_EQ(stats.explicit_huge_page_bytes + stats.transparent_advised_bytes - before.explicit_huge_page_bytes -
+                              before.transparent_advised_bytes,
+                          (bytes + NNFS::Memory::huge_page_size - 1) / NNFS::Memory::huge_page_size * NNFS::Memory::huge_page_size);
+            }
+            EXPECT_GE(stats.huge_page_bytes(), stats.explicit_huge_page_bytes);
+
+            NNFS::Memory::deallocate(buffer);
+            EXPECT_EQ(NNFS::Memory::stats().allocated_bytes, before.allocated_bytes);
+        }
+    }
+    NNFS::Memory::deallocate(nullptr);
+}
+
+// Test the policy names and the standard allocator
+TEST_F(MemoryTest, AllocatorTest)
+{
+    NNFS::HugePages huge_pages = NNFS::HugePages::NONE;
+    EXPECT_TRUE(NNFS::Memory::parse("explicit", huge_pages));
+    EXPECT_EQ(huge_pages, NNFS::HugePages::EXPLICIT);
+    EXPECT_TRUE(NNFS::Memory::parse("none", huge_pages));
+    EXPECT_EQ(huge_pages, NNFS::HugePages::NONE);
+    EXPECT_FALSE(NNFS::Memory::parse("always", huge_pages));
+    EXPECT_EQ(huge_pages, NNFS::HugePages::NONE);
+
+    const size_t allocated = NNFS::Memory::stats().allocated_bytes;
+    {
+        NNFS::AlignedVector<double> vector(NNFS::Memory::huge_page_size / sizeof(double) + 3, 2.);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(vector.data()) % NNFS::Memory::huge_page_size, 0u);
+        vector.resize(10);
+        vector.shrink_to_fit();
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(vector.data()) % NNFS::Memory::alignment, 0u);
+        EXPECT_EQ(vector[9], 2.);
+        EXPECT_EQ(NNFS::Memory::stats().allocated_bytes, allocated + 10 * sizeof(double));
+    }
+    EXPECT_EQ(NNFS::Memory::stats().allocated_bytes, allocated);
+}
+
+// Test resize() keeps the storage of matrices that do not change size
+TEST_F(MemoryTest, ResizeTest)
+{
+    Eigen::MatrixXd matrix;
+    NNFS::Memory::resize(matrix, 600, 500);
+    EXPECT_EQ(matrix.rows(), 600);
+    EXPECT_EQ(matrix.cols(), 500);
+    matrix.setOnes();
+
+    const double *data = matrix.data();
+    NNFS::Memory::resize(matrix, 500, 600);
+    EXPECT_EQ(matrix.data(), data);
+    EXPECT_EQ(matrix.rows(), 500);
+
+    NNFS::Memory::resize(matrix, 2, 3);
+    EXPECT_EQ(matrix.size(), 6);
+
+    // Layers size their parameters through it
+    NNFS::Dense dense(600, 500);
+    EXPECT_EQ(dense.weights().rows(), 600);
+    EXPECT_EQ(dense.weights_optimizer().squaredNorm(), 0.);
+    EXPECT_GT(dense.weights().squaredNorm(), 0.);
+}
+
+// Test workspaces are kept between calls and freed by the workers of a pool when it shuts down
+TEST_F(MemoryTest, WorkspaceTest)
+{
+    // Without the workspaces earlier products left
+    NNFS::Threading::configure(NNFS::ThreadingOptions());
+    NNFS::Workspace::release();
+
+    const size_t allocated = NNFS::Memory::stats().allocated_bytes;
+    double *buffer = NNFS::Workspace::get(0, 100);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer) % NNFS::Memory::alignment, 0u);
+    EXPECT_EQ(NNFS::Workspace::get(0, 50), buffer);
+    EXPECT_GE(NNFS::Memory::stats().allocated_bytes, allocated + 100 * sizeof(double));
+    NNFS::Workspace::release();
+    EXPECT_EQ(NNFS::Memory::stats().allocated_bytes, allocated);
+
+    // The built-in product packs its panels into the workspaces of the threads running it
+    NNFS::Gemm::backend(NNFS::GemmBackend::BUILTIN);
+    NNFS::set_num_threads(4, 1);
+    Eigen::MatrixXd a = Eigen::MatrixXd::Random(512, 512), c;
+    NNFS::Gemm::product(c, a, false, a, true);
+    EXPECT_GT(NNFS::Memory::stats().allocated_bytes, allocated);
+
+    NNFS::Threading::configure(NNFS::ThreadingOptions());
+    NNFS::Workspace::release();
+    EXPECT_EQ(NNFS::Memory::stats().allocated_bytes, allocated);
+    NNFS::Gemm::backend(NNFS::GemmBackend::AUTOMATIC);
+}
@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class PredictionCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        model_.add_layer(dense_);
+        model_.add_layer(std::make_shared<NNFS::ReLU>());
+        model_.add_layer(std::make_shared<NNFS::Dense>(8, 3));
+        model_.compile();
+    }
+
+    std::shared_ptr<NNFS::Dense> dense_ = std::make_shared<NNFS::Dense>(4, 8);
+    NNFS::NeuralNetwork model_;
+};
+
+// Test PredictionCache LRU eviction and counters
+TEST(PredictionCache, EvictsLeastRecentlyUsed)
+{
+    NNFS::PredictionCache cache(2);
+
+    Eigen::RowVectorXd a{{1., 2.}};
+    Eigen::RowVectorXd b{{3., 4.}};
+    Eigen::RowVectorXd c{{5., 6.}};
+    Eigen::RowVectorXd out(2);
+
+    cache.insert(a, a * 10);
+    cache.insert(b, b * 10);
+
+    // Touch a so that b becomes the least recently used entry
+    EXPECT_TRUE(cache.lookup(a, out));
+    EXPECT_TRUE(out.isApprox(a * 10));
+
+    cache.insert(c, c * 10);
+
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_FALSE(cache.lookup(b, out));
+    EXPECT_TRUE(cache.lookup(a, out));
+    EXPECT_TRUE(cache.lookup(c, out));
+
+    EXPECT_EQ(cache.hits(), 3);
+    EXPECT_EQ(cache.misses(), 1);
+}
+
+// Test that a cached network returns the same predictions as an uncached one
+TEST_F(PredictionCacheTest, MatchesUncachedPredictions)
+{
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(5, 4);
+    Eigen::MatrixXd expected = model_.predict(x);
+
+    model_.prediction_cache(16);
+
+    Eigen::MatrixXd first = model_.predict(x);
+    Eigen::MatrixXd second = model_.predict(x);
+
+    EXPECT_TRUE(first.isApprox(expected));
+    EXPECT_TRUE(second.isApprox(expected));
+    EXPECT_EQ(model_.prediction_cache()->misses(), 5);
+    EXPECT_EQ(model_.prediction_cache()->hits(), 5);
+}
+
+// Test that duplicate rows in a partially cached batch are resolved correctly
+TEST_F(PredictionCacheTest, MixedHitsAndMisses)
+{
+    model_.prediction_cache(16);
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(4, 4);
+    x.row(3) = x.row(1);
+    model_.predict(x.topRows(1));
+
+    // Row 0 hits, rows 1 and 2 miss and row 3 repeats row 1, which is computed once
+    Eigen::MatrixXd prediction = model_.predict(x);
+    EXPECT_EQ(model_.prediction_cache()->hits(), 1);
+    EXPECT_EQ(model_.prediction_cache()->misses(), 3);
+    EXPECT_EQ(model_.prediction_cache()->size(), 3);
+
+    model_.prediction_cache(0);
+    Eigen::MatrixXd expected = model_.predict(x);
+
+    EXPECT_TRUE(prediction.isApprox(expected));
+}
+
+// Test that the cache is invalidated when the weights change
+TEST_F(PredictionCacheTest, InvalidatedOnWeightChange)
+{
+    model_.prediction_cache(16);
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(2, 4);
+    Eigen::MatrixXd before = model_.predict(x);
+
+    Eigen::MatrixXd weights = Eigen::MatrixXd::Random(4, 8);
+    dense_->weights(weights);
+
+    Eigen::MatrixXd after = model_.predict(x);
+
+    EXPECT_EQ(model_.prediction_cache()->hits(), 0);
+    EXPECT_FALSE(after.isApprox(before));
+
+    model_.prediction_cache(0);
+    EXPECT_TRUE(after.isApprox(model_.predict(x)));
+}
+
+// Test that the cache is invalidated when the parameters of an affine layer or the fast math setting of an activation change
+TEST(PredictionCache, InvalidatedOnAffineAndFastMathChange)
+{
+    auto affine = std::make_shared<NNFS::Affine>(Eigen::RowVectorXd::Ones(4), Eigen::RowVectorXd::Zero(4));
+    auto sigmoid = std::make_shared<NNFS::Sigmoid>();
+    NNFS::NeuralNetwork model;
+    model.add_layer(affine);
+    model.add_layer(std::make_shared<NNFS::Dense>(4, 8));
+    model.add_layer(std::make_shared<NNFS::ReLU>());
+    model.add_layer(std::make_shared<NNFS::Dense>(8, 3));
+    model.add_layer(sigmoid);
+    model.compile(false);
+    model.prediction_cache(16);
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(2, 4);
+    Eigen::MatrixXd before = model.predict(x);
+
+    affine->shift(Eigen::RowVectorXd::Constant(4, .5));
+    Eigen::MatrixXd shifted = model.predict(x);
+    EXPECT_EQ(model.prediction_cache()->hits(), 0);
+    EXPECT_FALSE(shifted.isApprox(before));
+
+    sigmoid->fast_math(true);
+    model.predict(x);
+    EXPECT_EQ(model.prediction_cache()->hits(), 0);
+
+    model.prediction_cache(0);
+    EXPECT_TRUE(model.predict(x).isApprox(shifted, 1e-7));
+}
@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class ProfilerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        examples = Eigen::MatrixXd::Random(32, 16);
+        labels = Eigen::MatrixXd::Zero(32, 8);
+        for (int i = 0; i < 32; ++i)
+        {
+            labels(i, i % 8) = 1.;
+        }
+
+        network = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()),
+                                                        std::make_shared<NNFS::Adam>(.01));
+        network->add_layer(std::make_shared<NNFS::Dense>(16, 32));
+        network->add_layer(std::make_shared<NNFS::ReLU>());
+        network->add_layer(std::make_shared<NNFS::Dense>(32, 8));
+        network->add_layer(std::make_shared<NNFS::Softmax>());
+        network->compile();
+    }
+
+    Eigen::MatrixXd examples;
+    Eigen::MatrixXd labels;
+    std::shared_ptr<NNFS::NeuralNetwork> network;
+};
+
+TEST_F(ProfilerTest, DisabledTest)
+{
+    EXPECT_EQ(network->profiler(), nullptr);
+
+    double data_loss = 0, reg_loss = 0;
+    network->train_on_batch(data_loss, reg_loss, examples, labels);
+    EXPECT_EQ(network->profiler(), nullptr);
+
+    network->profile(true);
+    EXPECT_NE(network->profiler(), nullptr);
+    network->profile(false);
+    EXPECT_EQ(network->profiler(), nullptr);
+}
+
+TEST_F(ProfilerTest, RecordTest)
+{
+    network->profile(true);
+    double data_loss = 0, reg_loss = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        network->train_on_batch(data_loss, reg_loss, examples, labels);
+    }
+
+    // The ReLU is fused into the first dense layer, the softmax stays a layer of its own, then the loss
+    const std::vector<NNFS::Profiler::Slot> &slots = network->profiler()->slots();
+    ASSERT_EQ(slots.size(), 4u);
+    EXPECT_EQ(slots[0].name, "dense 16x32 relu");
+    EXPECT_EQ(slots[1].name, "dense 32x8");
+    EXPECT_EQ(slots[2].name, "softmax");
+    EXPECT_EQ(slots[3].name, "loss");
+
+    for (const NNFS::Profiler::Slot &slot : slots)
+    {
+        EXPECT_EQ(slot.calls[NNFS::Profiler::FORWARD], 3u);
+        EXPECT_EQ(slot.calls[NNFS::Profiler::BACKWARD], 3u);
+        EXPECT_GE(slot.seconds[NNFS::Profiler::FORWARD], 0.);
+    }
+    EXPECT_EQ(slots[0].calls[NNFS::Profiler::UPDATE], 3u);
+    EXPECT_EQ(slots[1].calls[NNFS::Profiler::UPDATE], 3u);
+    EXPECT_EQ(slots[2].calls[NNFS::Profiler::UPDATE], 0u);
+    EXPECT_EQ(slots[3].calls[NNFS::Profiler::UPDATE], 0u);
+
+    // Cost model of the dense layers: 2 * rows * inputs * outputs for the product, the bias and the fused activation
+    EXPECT_DOUBLE_EQ(slots[0].flops[NNFS::Profiler::FORWARD], 3. * (2. * 32 * 16 * 32 + 2. * 32 * 32));
+    EXPECT_DOUBLE_EQ(slots[1].flops[NNFS::Profiler::FORWARD], 3. * (2. * 32 * 32 * 8 + 32 * 8));
+    EXPECT_DOUBLE_EQ(slots[1].flops[NNFS::Profiler::BACKWARD], 3. * (4. * 32 * 32 * 8 + 32 * 8));
+
+    // Updates move the parameters, their gradients and the two Adam state matrices
+    EXPECT_DOUBLE_EQ(slots[1].flops[NNFS::Profiler::UPDATE], 0.);
+    EXPECT_DOUBLE_EQ(slots[1].bytes[NNFS::Profiler::UPDATE], 3. * 7. * (32 * 8 + 8) * sizeof(double));
+
+    network->profiler()->reset();
+    EXPECT_EQ(network->profiler()->slots()[0].calls[NNFS::Profiler::FORWARD], 0u);
+    EXPECT_EQ(network->profiler()->slots()[0].name, "dense 16x32 relu");
+}
+
+TEST_F(ProfilerTest, ReportTest)
+{
+    std::string path = testing::TempDir() + "nnfs_test_profiler.json";
+    std::remove(path.c_str());
+    network->profile(true, path);
+    double data_loss = 0, reg_loss = 0;
+    network->train_on_batch(data_loss, reg_loss, examples, labels);
+
+    std::ostringstream table;
+    network->profiler()->table(table);
+    EXPECT_NE(table.str().find("GFLOP/s"), std::string::npos);
+    EXPECT_NE(table.str().find("dense 32x8"), std::string::npos);
+    EXPECT_NE(table.str().find("update"), std::string::npos);
+
+    std::ostringstream json;
+    network->profiler()->json(json, 1);
+    EXPECT_EQ(json.str().rfind("{\"epoch\":1,\"layers\":[{\"name\":\"dense 16x32 relu\",\"forward\":{\"calls\":1,", 0), 0u);
+
+    // The report clears the measurements and appends one line per epoch
+    std::ostringstream out;
+    network->profiler()->report(out, 1);
+    network->train_on_batch(data_loss, reg_loss, examples, labels);
+    network->profiler()->report(out, 2);
+    EXPECT_EQ(network->profiler()->slots()[0].calls[NNFS::Profiler::FORWARD], 0u);
+
+    std::ifstream file(path);
+    std::string line;
+    int lines = 0;
+    while (std::getline(file, line))
+    {
+        EXPECT_NE(line.find("\"calls\":1,"), std::string::npos);
+        lines++;
+    }
+    EXPECT_EQ(lines, 2);
+    std::remove(path.c_str());
+}
+
+TEST_F(ProfilerTest, FitTest)
+{
+    network->profile(true);
+    testing::internal::CaptureStdout();
+    network->fit(examples, labels, examples, labels, 2, 8, false);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    // One table per epoch
+    size_t first = output.find("GFLOP/s");
+    ASSERT_NE(first, std::string::npos);
+    EXPECT_NE(output.find("GFLOP/s", first + 1), std::string::npos);
+    EXPECT_EQ(network->profiler()->slots()[0].calls[NNFS::Profiler::FORWARD], 0u);
+}
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class StaticNetworkTest : public ::testing::Test
+{
+protected:
+    // 2 inputs, 64 hidden neurons and 3 classes like the spiral network of tools/train.cpp
+    void SetUp() override
+    {
+        model_ = std::make_shared<NNFS::NeuralNetwork>(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.01));
+        model_->add_layer(std::make_shared<NNFS::Dense>(2, 64));
+        model_->add_layer(std::make_shared<NNFS::ReLU>());
+        model_->add_layer(std::make_shared<NNFS::Dense>(64, 16));
+        model_->add_layer(std::make_shared<NNFS::Tanh>());
+        model_->add_layer(std::make_shared<NNFS::Dense>(16, 3));
+        model_->compile();
+
+        Eigen::MatrixXd labels = Eigen::MatrixXd::Zero(x_.rows(), 3);
+        for (Eigen::Index i = 0; i < x_.rows(); ++i)
+        {
+            labels(i, i % 3) = 1.;
+        }
+        model_->fit(x_, labels, x_, labels, 3, 16, false);
+    }
+
+    std::shared_ptr<NNFS::NeuralNetwork> model_;
+    Eigen::MatrixXd x_ = Eigen::MatrixXd::Random(48, 2);
+};
+
+using Spiral = NNFS::StaticNetwork<NNFS::Static::Dense<2, 64>, NNFS::Static::ReLU, NNFS::Static::Dense<64, 16>, NNFS::Static::Tanh, NNFS::Static::Dense<16, 3>>;
+
+// Test a static network loaded from a trained network predicts the same, for single samples and batches
+TEST_F(StaticNetworkTest, PredictTest)
+{
+    Spiral network;
+    ASSERT_TRUE(network.load(*model_));
+
+    Eigen::MatrixXd expected = model_->predict(x_);
+    EXPECT_TRUE(network.predict(x_).isApprox(expected, 1e-12));
+
+    Spiral::Output sample = network.predict(Spiral::Input(x_.row(0)));
+    EXPECT_TRUE(sample.isApprox(expected.row(0), 1e-12));
+    EXPECT_NEAR(sample.sum(), 1., 1e-12);
+
+    // Batches of another width are rejected
+    Eigen::MatrixXd wide = Eigen::MatrixXd::Random(4, 3);
+    EXPECT_EQ(network.predict(wide).size(), 0);
+}
+
+// Test networks with other layers or shapes are rejected
+TEST_F(StaticNetworkTest, MismatchTest)
+{
+    NNFS::StaticNetwork<NNFS::Static::Dense<2, 64>, NNFS::Static::ReLU, NNFS::Static::Dense<64, 16>, NNFS::Static::Sigmoid, NNFS::Static::Dense<16, 3>> activation;
+    EXPECT_FALSE(activation.load(*model_));
+
+    NNFS::StaticNetwork<NNFS::Static::Dense<2, 64>, NNFS::Static::ReLU, NNFS::Static::Dense<64, 8>, NNFS::Static::Tanh, NNFS::Static::Dense<8, 3>> shape;
+    EXPECT_FALSE(shape.load(*model_));
+
+    NNFS::StaticNetwork<NNFS::Static::Dense<2, 64>, NNFS::Static::ReLU, NNFS::Static::Dense<64, 3>> depth;
+    EXPECT_FALSE(depth.load(*model_));
+}
+
+// Test a failed load leaves the layers loaded before untouched
+TEST_F(StaticNetworkTest, FailedLoadTest)
+{
+    Spiral network;
+    ASSERT_TRUE(network.load(*model_));
+    Eigen::MatrixXd expected = network.predict(x_);
+
+    // Every layer but the last one matches
+    NNFS::NeuralNetwork other(std::make_shared<NNFS::CCESoftmax>(std::make_shared<NNFS::Softmax>(), std::make_shared<NNFS::CCE>()), std::make_shared<NNFS::Adam>(.01));
+    other.add_layer(std::make_shared<NNFS::Dense>(2, 64));
+    other.add_layer(std::make_shared<NNFS::ReLU>());
+    other.add_layer(std::make_shared<NNFS::Dense>(64, 16));
+    other.add_layer(std::make_shared<NNFS::Tanh>());
+    other.add_layer(std::make_shared<NNFS::Dense>(16, 4));
+    other.compile();
+
+    EXPECT_FALSE(network.load(other));
+    EXPECT_TRUE(network.predict(x_) == expected);
+}
+
+// Test the fast math setting of the trained activations is copied
+TEST_F(StaticNetworkTest, FastMathTest)
+{
+    std::const_pointer_cast<NNFS::Tanh>(std::static_pointer_cast<const NNFS::Tanh>(model_->layer(3)))->fast_math(true);
+    model_->compile();
+
+    Spiral network;
+    ASSERT_TRUE(network.load(*model_));
+    EXPECT_TRUE(network.layer<3>().fast_math());
+    EXPECT_TRUE(network.predict(x_).isApprox(model_->predict(x_), 1e-12));
+
+    network.layer<3>().fast_math(false);
+    EXPECT_FALSE(network.predict(x_).isApprox(model_->predict(x_), 1e-12));
+    EXPECT_TRUE(network.predict(x_).isApprox(model_->predict(x_), 1e-6));
+}
@@ -0,0 +1,212 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#define LOG_LEVEL LOG_SEV_NONE
+
+#include <NNFS/Core>
+
+class ThreadingTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        NNFS::Threading::configure(NNFS::ThreadingOptions());
+    }
+};
+
+// Test a parallel loop runs every index exactly once, also when loops are nested
+TEST_F(ThreadingTest, ParallelForTest)
+{
+    NNFS::ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4);
+
+    std::vector<std::atomic<int>> counts(1000);
+    pool.parallel_for(0, 1000, 7, [&](int64_t begin, int64_t end)
+                      {
+                          for (int64_t i = begin; i < end; ++i)
+                          {
+                              counts[i]++;
+                          } });
+    for (const std::atomic<int> &count : counts)
+    {
+        EXPECT_EQ(count.load(), 1);
+    }
+
+    std::atomic<int> total{0};
+    pool.parallel_for(0, 8, 1, [&](int64_t, int64_t)
+                      { pool.parallel_for(0, 100, 10, [&](int64_t begin, int64_t end)
+                                          { total += static_cast<int>(end - begin); }); });
+    EXPECT_EQ(total.load(), 800);
+
+    // Empty ranges and a pool without workers
+    pool.parallel_for(5, 5, 1, [&](int64_t, int64_t)
+                      { total++; });
+    NNFS::ThreadPool single(1);
+    single.parallel_for(0, 10, 3, [&](int64_t begin, int64_t end)
+                        { total += static_cast<int>(end - begin); });
+    EXPECT_EQ(total.load(), 810);
+}
+
+// Recursive sum of [low, high), every level forks one half into the group
+static int64_t recursive_sum(NNFS::ThreadPool &pool, int64_t low, int64_t high)
+{
+    if (high - low <= 64)
+    {
+        int64_t sum = 0;
+        for (int64_t i = low; i < high; ++i)
+        {
+            sum += i;
+        }
+        return sum;
+    }
+    int64_t middle = (low + high) / 2, left = 0;
+    NNFS::TaskGroup group(pool);
+    group.run([&]()
+              { left = recursive_sum(pool, low, middle); });
+    int64_t right = recursive_sum(pool, middle, high);
+    group.wait();
+    return left + right;
+}
+
+// Test task groups wait for their own tasks, nested groups and the tasks left when the pool is destroyed
+TEST_F(ThreadingTest, TaskGroupTest)
+{
+    std::atomic<int> count{0};
+    {
+        NNFS::ThreadPool pool(4);
+        NNFS::TaskGroup group(pool);
+        for (int i = 0; i < 1000; ++i)
+        {
+            group.run([&]()
+                      { count++; });
+        }
+        group.wait();
+        EXPECT_EQ(count.load(), 1000);
+
+        EXPECT_EQ(recursive_sum(pool, 0, 100000), int64_t(100000) * 99999 / 2);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            pool.submit([&]()
+                        { count++; });
+        }
+    }
+    EXPECT_EQ(count.load(), 1100);
+
+    // Without workers tasks run on the caller
+    NNFS::ThreadPool single(1);
+    EXPECT_EQ(recursive_sum(single, 0, 1000), 999 * 1000 / 2);
+}
+
+// Test exceptions of tasks are rethrown by wait() once every task is done, and the group stays usable
+TEST_F(ThreadingTest, ExceptionTest)
+{
+    for (int threads : {4, 1})
+    {
+        SCOPED_TRACE(threads);
+        NNFS::ThreadPool pool(threads);
+        std::atomic<int> count{0};
+
+        NNFS::TaskGroup group(pool);
+        for (int i = 0; i < 100; ++i)
+        {
+            group.run([&, i]()
+                      {
+                          count++;
+                          if (i % 10 == 3)
+                          {
+                              throw std::runtime_error("task " + std::to_string(i));
+                          } });
+        }
+        EXPECT_THROW(group.wait(), std::runtime_error);
+        EXPECT_EQ(count.load(), 100);
+
+        group.run([&]()
+                  { count++; });
+        EXPECT_NO_THROW(group.wait());
+        EXPECT_EQ(count.load(), 101);
+
+        // Chunks run by the caller and by the workers
+        count = 0;
+        EXPECT_THROW(pool.parallel_for(0, 1000, 10, [&](int64_t begin, int64_t)
+                                       {
+                                           count++;
+                                           if (begin == 0 || begin == 990)
+                                           {
+                                               throw std::out_of_range("chunk");
+                                           } }),
+                     std::out_of_range);
+        EXPECT_EQ(count.load(), 100);
+    }
+}
+
+// Test the pools follow the configuration
+TEST_F(ThreadingTest, ConfigureTest)
+{
+    EXPECT_FALSE(NNFS::Threading::cpus().empty());
+
+    NNFS::set_num_threads(3, 2);
+    EXPECT_EQ(NNFS::Threading::options().intra_op_threads, 3);
+    EXPECT_EQ(NNFS::Threading::options().inter_op_threads, 2);
+    EXPECT_EQ(NNFS::Threading::intra_op().size(), 3);
+    EXPECT_EQ(NNFS::Threading::inter_op().size(), 2);
+
+    NNFS::ThreadingOptions options;
+    options.numa_node = 100000;
+    EXPECT_FALSE(NNFS::Threading::configure(options));
+    EXPECT_EQ(NNFS::Threading::options().intra_op_threads, 3);
+
+    options.numa_node = -1;
+    options.pin = true;
+    options.intra_op_threads = 2;
+    options.inter_op_threads = 2;
+    ASSERT_TRUE(NNFS::Threading::configure(options));
+
+#ifdef __linux__
+    // The inter-op worker is pinned to a single CPU, the one after the intra-op CPUs
+    std::vector<int> allowed = NNFS::Threading::cpus();
+    std::atomic<int> cpus{0};
+    std::atomic<bool> done{false};
+    NNFS::Threading::inter_op().submit([&]()
+                                       {
+                                           cpu_set_t set;
+                                           pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+                                           cpus = CPU_COUNT(&set);
+                                           done = true; });
+    while (!done)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(cpus.load(), 1);
+#endif
+}
+
+// Test products split over the intra-op pool match the single-threaded ones
+TEST_F(ThreadingTest, GemmTest)
+{
+    NNFS::Gemm::backend(NNFS::GemmBackend::BUILTIN);
+    Eigen::MatrixXd a = Eigen::MatrixXd::Random(300, 200);
+    Eigen::MatrixXd b = Eigen::MatrixXd::Random(200, 250);
+    Eigen::MatrixXd c = Eigen::MatrixXd::Random(300, 40);
+
+    NNFS::set_num_threads(1);
+    Eigen::MatrixXd expected_ab, expected_ac, expected_ca;
+    NNFS::Gemm::product(expected_ab, a, false, b, false);
+    NNFS::Gemm::product(expected_ac, a, true, c, false);
+    NNFS::Gemm::product(expected_ca, c, true, a, false);
+
+    // Split along the rows, and along the columns when there are more
+    NNFS::set_num_threads(4);
+    Eigen::MatrixXd ab, ac, ca;
+    NNFS::Gemm::product(ab, a, false, b, false);
+    NNFS::Gemm::product(ac, a, true, c, false);
+    NNFS::Gemm::product(ca, c, true, a, false);
+    EXPECT_TRUE(ab.isApprox(expected_ab, 1e-14));
+    EXPECT_TRUE(ac.isApprox(expected_ac, 1e-14));
+    EXPECT_TRUE(ca.isApprox(expected_ca, 1e-14));
+    NNFS::Gemm::backend(NNFS::GemmBackend::AUTOMATIC);
+}
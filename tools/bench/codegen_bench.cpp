@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <dlfcn.h>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Measures the average time of a function in nanoseconds over at least 0.2 seconds.
+ *
+ * @param function Function to measure
+ *
+ * @return double Nanoseconds per call
+ */
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+    long calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed(0);
+    do
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            function();
+        }
+        calls += 64;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 2e8);
+    return elapsed.count() / calls;
+}
+
+/**
+ * @brief Single-sample latency of the spiral network of tools/train.cpp: NeuralNetwork::predict(), StaticNetwork and the code
+ * generated by NNFS::CodeGen, built with the compiler of this benchmark and loaded at run time.
+ */
+int main(int argc, char *argv[])
+{
+    int hidden = argc > 1 ? std::stoi(argv[1]) : 64;
+    std::string base = argc > 2 ? argv[2] : "codegen_bench";
+
+    NNFS::NeuralNetwork network;
+    network.add_layer(std::make_shared<NNFS::Dense>(2, hidden));
+    network.add_layer(std::make_shared<NNFS::ReLU>());
+    network.add_layer(std::make_shared<NNFS::Dense>(hidden, 3));
+    network.compile();
+
+    std::ofstream source(base + ".cpp");
+    if (!NNFS::CodeGen::generate(network, source, "spiral"))
+    {
+        std::cerr << "Code generation failed" << std::endl;
+        return 1;
+    }
+    source.close();
+
+    std::string command = std::string(NNFS_CODEGEN_CXX) + " -std=c++17 -O3 -shared -fPIC -o " + base + ".so " + base + ".cpp";
+    if (std::system(command.c_str()) != 0)
+    {
+        std::cerr << "Failed: " << command << std::endl;
+        return 1;
+    }
+    void *library = dlopen(("./" + base + ".so").c_str(), RTLD_NOW);
+    if (!library)
+    {
+        std::cerr << dlerror() << std::endl;
+        return 1;
+    }
+    auto predict = reinterpret_cast<void (*)(const double *, double *)>(dlsym(library, "spiral_predict"));
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(1, 2);
+    Eigen::RowVector3d generated;
+    double sink = 0;
+
+    double network_ns = measure([&]()
+                                { sink += network.predict(x)(0, 0); });
+    double generated_ns = measure([&]()
+                                  { predict(x.data(), generated.data()); sink += generated(0); });
+
+    std::cout << "Single-sample latency, 2 x " << hidden << " x 3 network" << std::endl;
+    std::cout << std::setw(24) << "NeuralNetwork::predict" << std::setw(12) << std::fixed << std::setprecision(1) << network_ns << " ns" << std::endl;
+    std::cout << std::setw(24) << "generated" << std::setw(12) << generated_ns << " ns" << std::endl;
+    std::cout << std::setw(24) << "max difference" << std::setw(12) << std::scientific << std::setprecision(2) << (generated - network.predict(x)).cwiseAbs().maxCoeff() << std::endl;
+
+    if (hidden == 64)
+    {
+        NNFS::StaticNetwork<NNFS::Static::Dense<2, 64>, NNFS::Static::ReLU, NNFS::Static::Dense<64, 3>> static_network;
+        static_network.load(network);
+        Eigen::RowVector2d sample = x;
+        double static_ns = measure([&]()
+                                   { sink += static_network.predict(sample)(0); });
+        std::cout << std::setw(24) << "StaticNetwork" << std::setw(12) << std::fixed << std::setprecision(1) << static_ns << " ns" << std::endl;
+    }
+
+    dlclose(library);
+    std::remove((base + ".cpp").c_str());
+    std::remove((base + ".so").c_str());
+    return sink == 0.5 ? 2 : 0;
+}
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Writes a synthetic CSV file with a label column followed by numeric features.
+ *
+ * @param path Output path
+ * @param rows Number of rows
+ * @param cols Number of feature columns
+ */
+static void generate(const std::string &path, int rows, int cols)
+{
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> dis(-1000., 1000.);
+    std::uniform_int_distribution<int> label(0, 9);
+
+    std::string line;
+    char number[32];
+    for (int row = 0; row < rows; ++row)
+    {
+        line = std::to_string(label(gen));
+        for (int col = 0; col < cols; ++col)
+        {
+            std::snprintf(number, sizeof(number), ",%.6f", dis(gen));
+            line += number;
+        }
+        line += '\n';
+        ofs << line;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = argc > 1 ? argv[1] : "/tmp/nnfs_csv_bench.csv";
+    int rows = argc > 2 ? std::stoi(argv[2]) : 200000;
+    int cols = argc > 3 ? std::stoi(argv[3]) : 64;
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::ifstream exists(path);
+    if (!exists.good())
+    {
+        std::cout << "Generating " << path << " with " << rows << " rows and " << cols << " feature columns" << std::endl;
+        generate(path, rows, cols);
+    }
+
+    NNFS::MappedFile file;
+    file.open(path);
+    double megabytes = file.size() / 1e6;
+    file.close();
+
+    NNFS::CSVOptions options;
+    options.label_column = 0;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "file: " << path << " (" << megabytes << " MB)" << std::endl;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        options.threads = threads;
+
+        // Best of three runs, the first one also warms the page cache
+        double best = 1e30;
+        for (int run = 0; run < 3; ++run)
+        {
+            Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> features;
+            Eigen::VectorXi labels;
+            std::vector<std::string> classes;
+
+            auto start = std::chrono::steady_clock::now();
+            if (!NNFS::CSV::load(path, features, labels, classes, options))
+            {
+                return 1;
+            }
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        std::cout << "threads " << std::setw(3) << threads << ": " << std::setw(8) << best * 1e3 << " ms, "
+                  << std::setw(7) << megabytes / best << " MB/s" << std::endl;
+
+        if (threads * 2 > max_threads && threads != max_threads)
+        {
+            threads = max_threads / 2;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Measures the average time of a function in milliseconds over at least 0.2 seconds.
+ *
+ * @param function Function to measure
+ *
+ * @return double Milliseconds per call
+ */
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+    int calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed(0);
+    do
+    {
+        function();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 200.);
+    return elapsed.count() / calls;
+}
+
+int main()
+{
+    // The products of Kernels, whatever the default backend of the build
+    NNFS::Gemm::backend(NNFS::GemmBackend::BUILTIN);
+
+    std::vector<NNFS::ISA> levels;
+    for (NNFS::ISA isa : {NNFS::ISA::BASELINE, NNFS::ISA::SSE4_2, NNFS::ISA::AVX2, NNFS::ISA::AVX512})
+    {
+        if (isa <= NNFS::CPU::detected())
+        {
+            levels.push_back(isa);
+        }
+    }
+
+    std::cout << "Kernels per instruction set, detected " << NNFS::CPU::name(NNFS::CPU::detected()) << ", times in ms" << std::endl;
+    std::cout << std::setw(26) << "kernel";
+    for (NNFS::ISA isa : levels)
+    {
+        std::cout << std::setw(12) << NNFS::CPU::name(isa);
+    }
+    std::cout << std::endl;
+
+    auto run = [&](const std::string &name, auto function)
+    {
+        std::cout << std::setw(26) << name << std::fixed << std::setprecision(4);
+        for (NNFS::ISA isa : levels)
+        {
+            NNFS::CPU::level(isa);
+            std::cout << std::setw(12) << measure(function);
+        }
+        std::cout << std::defaultfloat << std::endl;
+    };
+
+    // Dense forward and backward products of a batch of MNIST-sized inputs, and of a small hidden layer
+    const Eigen::Index shapes[][3] = {{512, 128, 784}, {64, 64, 64}, {1, 128, 784}};
+    for (const auto &shape : shapes)
+    {
+        Eigen::MatrixXd a = Eigen::MatrixXd::Random(shape[0], shape[2]);
+        Eigen::MatrixXd b = Eigen::MatrixXd::Random(shape[2], shape[1]);
+        Eigen::MatrixXd d = Eigen::MatrixXd::Random(shape[0], shape[1]);
+        Eigen::MatrixXd out;
+        std::string size = std::to_string(shape[0]) + "x" + std::to_string(shape[1]) + "x" + std::to_string(shape[2]);
+        run("gemm " + size, [&]()
+            { NNFS::Gemm::product(out, a, false, b, false); });
+        run("gemm a^T " + size, [&]()
+            { NNFS::Gemm::product(out, a, true, d, false); });
+    }
+
+    // Element-wise kernels over one million values
+    const Eigen::Index n = 1 << 20;
+    Eigen::ArrayXd x = Eigen::ArrayXd::Random(n) * 8.;
+    Eigen::ArrayXd y(n);
+    run("exp", [&]()
+        { NNFS::Kernels::exp(y.data(), x.data(), n); });
+    run("sigmoid", [&]()
+        { NNFS::Kernels::sigmoid(y.data(), x.data(), n); });
+    run("tanh", [&]()
+        { NNFS::Kernels::tanh(y.data(), x.data(), n); });
+
+    Eigen::ArrayXd parameters = Eigen::ArrayXd::Random(n);
+    Eigen::ArrayXd gradients = Eigen::ArrayXd::Random(n) * 1e-3;
+    Eigen::ArrayXd cache = Eigen::ArrayXd::Zero(n);
+    Eigen::ArrayXd momentums = Eigen::ArrayXd::Zero(n);
+    run("sgd", [&]()
+        { NNFS::Kernels::sgd(parameters.data(), momentums.data(), gradients.data(), n, 1e-3, .9); });
+    run("adam", [&]()
+        { NNFS::Kernels::adam(parameters.data(), cache.data(), momentums.data(), gradients.data(), n, 1e-3, 1e-7, .9, .999, .1, .001); });
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Measures the average time of a function in milliseconds over at least 0.2 seconds.
+ *
+ * @param function Function to measure
+ *
+ * @return double Milliseconds per call
+ */
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+    int calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed(0);
+    do
+    {
+        function();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 200.);
+    return elapsed.count() / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    int batch = argc > 1 ? std::stoi(argv[1]) : 512;
+    int width = argc > 2 ? std::stoi(argv[2]) : 1024;
+
+    std::cout << "Activation forward pass, " << batch << " x " << width << " inputs in [-8, 8]" << std::endl;
+    std::cout << std::setw(10) << "kernel" << std::setw(12) << "exact ms" << std::setw(12) << "fast ms" << std::setw(10) << "speedup"
+              << std::setw(14) << "max error" << std::endl;
+
+    Eigen::MatrixXd x = Eigen::MatrixXd::Random(batch, width) * 8.;
+    Eigen::MatrixXd exact, fast;
+
+    auto run = [&](const std::string &name, std::shared_ptr<NNFS::Activation> exact_layer, std::shared_ptr<NNFS::Activation> fast_layer)
+    {
+        double exact_ms = measure([&]()
+                                  { exact_layer->forward(exact, x); });
+        double fast_ms = measure([&]()
+                                 { fast_layer->forward(fast, x); });
+        double error = (fast - exact).cwiseAbs().maxCoeff();
+
+        std::cout << std::setw(10) << name << std::fixed << std::setprecision(3) << std::setw(12) << exact_ms << std::setw(12) << fast_ms
+                  << std::setw(9) << std::setprecision(2) << exact_ms / fast_ms << "x" << std::scientific << std::setprecision(2)
+                  << std::setw(14) << error << std::defaultfloat << std::endl;
+    };
+
+    auto fast_sigmoid = std::make_shared<NNFS::Sigmoid>();
+    auto fast_tanh = std::make_shared<NNFS::Tanh>();
+    auto fast_softmax = std::make_shared<NNFS::Softmax>();
+    fast_sigmoid->fast_math(true);
+    fast_tanh->fast_math(true);
+    fast_softmax->fast_math(true);
+
+    run("sigmoid", std::make_shared<NNFS::Sigmoid>(), fast_sigmoid);
+    run("tanh", std::make_shared<NNFS::Tanh>(), fast_tanh);
+    run("softmax", std::make_shared<NNFS::Softmax>(), fast_softmax);
+    return 0;
+}
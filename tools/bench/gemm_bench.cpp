@@ -0,0 +1,82 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Measures the average time of a function in milliseconds over at least 0.2 seconds.
+ *
+ * @param function Function to measure
+ *
+ * @return double Milliseconds per call
+ */
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+    int calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed(0);
+    do
+    {
+        function();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 200.);
+    return elapsed.count() / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    int inputs = argc > 1 ? std::stoi(argv[1]) : 784;
+    int outputs = argc > 2 ? std::stoi(argv[2]) : 128;
+
+    std::vector<NNFS::GemmBackend> backends;
+    for (NNFS::GemmBackend backend : {NNFS::GemmBackend::EIGEN, NNFS::GemmBackend::BLAS, NNFS::GemmBackend::BUILTIN, NNFS::GemmBackend::AUTOMATIC})
+    {
+        if (NNFS::Gemm::available(backend))
+        {
+            backends.push_back(backend);
+        }
+    }
+
+    std::cout << "Dense " << inputs << " x " << outputs << " products per GEMM backend at " << NNFS::CPU::name(NNFS::CPU::level())
+              << ", GFLOP/s" << std::endl;
+    std::cout << std::setw(8) << "batch" << std::setw(12) << "product";
+    for (NNFS::GemmBackend backend : backends)
+    {
+        std::cout << std::setw(12) << NNFS::Gemm::name(backend);
+    }
+    std::cout << std::endl;
+
+    Eigen::MatrixXd weights = Eigen::MatrixXd::Random(inputs, outputs);
+    for (int batch : {1, 4, 32, 128, 512})
+    {
+        Eigen::MatrixXd x = Eigen::MatrixXd::Random(batch, inputs);
+        Eigen::MatrixXd dy = Eigen::MatrixXd::Random(batch, outputs);
+        Eigen::MatrixXd out;
+        const double flops = 2. * batch * inputs * outputs;
+
+        // The three products of Dense: forward, weight gradients and input gradients
+        auto run = [&](const std::string &name, const Eigen::MatrixXd &a, bool transpose_a, const Eigen::MatrixXd &b, bool transpose_b)
+        {
+            std::cout << std::setw(8) << batch << std::setw(12) << name << std::fixed << std::setprecision(2);
+            for (NNFS::GemmBackend backend : backends)
+            {
+                NNFS::Gemm::backend(backend);
+                double ms = measure([&]()
+                                    { NNFS::Gemm::product(out, a, transpose_a, b, transpose_b); });
+                std::cout << std::setw(12) << flops / ms * 1e-6;
+            }
+            std::cout << std::defaultfloat << std::endl;
+        };
+
+        run("x * W", x, false, weights, false);
+        run("x^T * dy", x, true, dy, false);
+        run("dy * W^T", dy, false, weights, true);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Measures the average time of a function in milliseconds over at least 0.2 seconds.
+ *
+ * @param function Function to measure
+ *
+ * @return double Milliseconds per call
+ */
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+    int calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed(0);
+    do
+    {
+        function();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 200.);
+    return elapsed.count() / calls;
+}
+
+// Compute-bound work on one index
+static double work(int64_t i)
+{
+    double x = static_cast<double>(i);
+    for (int j = 0; j < 64; ++j)
+    {
+        x = std::sqrt(x + j);
+    }
+    return x;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = argc > 1 ? std::stoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+
+    // Scheduling overhead: empty tasks, so the time is the cost of queuing, running and joining them
+    {
+        const int tasks = 10000;
+        NNFS::ThreadPool pool(max_threads);
+        std::atomic<int> count{0};
+
+        double group_ms = measure([&]()
+                                  {
+                                      NNFS::TaskGroup group(pool);
+                                      for (int i = 0; i < tasks; ++i)
+                                      {
+                                          group.run([&]()
+                                                    { count++; });
+                                      }
+                                      group.wait(); });
+        double loop_ms = measure([&]()
+                                 { pool.parallel_for(0, tasks, 1, [&](int64_t, int64_t)
+                                                     { count++; }); });
+        double async_ms = measure([&]()
+                                  {
+                                      std::vector<std::future<void>> futures;
+                                      for (int i = 0; i < tasks / 100; ++i)
+                                      {
+                                          futures.push_back(std::async(std::launch::async, [&]()
+                                                                       { count++; }));
+                                      }
+                                      for (std::future<void> &future : futures)
+                                      {
+                                          future.get();
+                                      } }) * 100;
+
+        std::cout << "Scheduling overhead with " << max_threads << " threads, ns per empty task" << std::endl;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(28) << "TaskGroup::run + wait" << std::setw(10) << group_ms * 1e6 / tasks
+                  << std::endl;
+        std::cout << std::setw(28) << "parallel_for, grain 1" << std::setw(10) << loop_ms * 1e6 / tasks << std::endl;
+        std::cout << std::setw(28) << "std::async thread" << std::setw(10) << async_ms * 1e6 / tasks << std::endl;
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+    // Scaling: the same loop over pools of increasing size, for a few grain sizes
+    const int64_t n = 1 << 20;
+    std::vector<double> out(n);
+    std::cout << "Scaling of a parallel_for over " << n << " compute-bound indices, ms (speedup)" << std::endl;
+    std::cout << std::setw(8) << "threads";
+    for (int64_t grain : {256, 4096, 65536})
+    {
+        std::cout << std::setw(20) << "grain " + std::to_string(grain);
+    }
+    std::cout << std::endl;
+
+    std::vector<double> single;
+    for (int threads = 1; threads <= max_threads; threads = threads * 2 > max_threads && threads != max_threads ? max_threads : threads * 2)
+    {
+        NNFS::ThreadPool pool(threads);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2);
+        int column = 0;
+        for (int64_t grain : {256, 4096, 65536})
+        {
+            double ms = measure([&]()
+                                { pool.parallel_for(0, n, grain, [&](int64_t begin, int64_t end)
+                                                    {
+                                                        for (int64_t i = begin; i < end; ++i)
+                                                        {
+                                                            out[i] = work(i);
+                                                        } }); });
+            if (threads == 1)
+            {
+                single.push_back(ms);
+            }
+            std::cout << std::setw(12) << ms << " (" << std::setw(4) << std::setprecision(1) << single[column++] / ms << "x)" << std::setprecision(2);
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Measures the average time of a function in milliseconds over at least 0.2 seconds.
+ *
+ * @param function Function to measure
+ *
+ * @return double Milliseconds per call
+ */
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+    int calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed(0);
+    do
+    {
+        function();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 200.);
+    return elapsed.count() / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    int batch = argc > 1 ? std::stoi(argv[1]) : 256;
+    int n_input = argc > 2 ? std::stoi(argv[2]) : 512;
+    int n_output = argc > 3 ? std::stoi(argv[3]) : 512;
+
+    std::cout << "Dense " << n_input << " -> " << n_output << ", batch " << batch
+              << ", forward + backward with masked input gradient" << std::endl;
+    std::cout << std::setw(10) << "sparsity" << std::setw(14) << "dense ms" << std::setw(16) << "compressed ms" << std::setw(10) << "speedup" << std::endl;
+
+    NNFS::Dense layer(n_input, n_output);
+    layer.masked_input_gradient(true);
+    Eigen::MatrixXd dx = Eigen::MatrixXd::Random(batch, n_output);
+    Eigen::MatrixXd out, din;
+
+    double crossover = -1;
+    for (double sparsity : {.5, .7, .8, .85, .9, .93, .95, .97, .98, .99, .995})
+    {
+        // Zeros at random positions, like the output of a ReLU
+        Eigen::MatrixXd x = Eigen::MatrixXd::Random(batch, n_input);
+        x = (x.array().abs() < sparsity).select(0., x);
+
+        auto step = [&]()
+        {
+            layer.forward(out, x);
+            layer.backward(din, dx);
+        };
+
+        layer.sparsity_threshold(2.);
+        double dense_ms = measure(step);
+        layer.sparsity_threshold(0.);
+        double compressed_ms = measure(step);
+
+        if (crossover < 0 && compressed_ms < dense_ms)
+        {
+            crossover = sparsity;
+        }
+
+        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << sparsity << std::setw(14) << dense_ms << std::setw(16) << compressed_ms
+                  << std::setw(9) << std::setprecision(2) << dense_ms / compressed_ms << "x" << std::endl;
+    }
+
+    if (crossover < 0)
+    {
+        std::cout << "The compressed kernels were never faster for this shape." << std::endl;
+    }
+    else
+    {
+        std::cout << "Crossover at about " << std::setprecision(3) << crossover << " sparsity, use Dense::sparsity_threshold(" << crossover
+                  << ") for this shape and CPU (default: " << NNFS::Dense(1, 1).sparsity_threshold() << ")." << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <NNFS/Core>
+
+/**
+ * @brief Turns a model written by NNFS::NeuralNetwork::save() into a standalone C++ source file, see NNFS::CodeGen.
+ *
+ * Usage: codegen <model.bin> <output.cpp> [name]
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <model.bin> <output.cpp> [name]" << std::endl;
+        return 1;
+    }
+
+    std::string name = argc > 3 ? argv[3] : "nnfs_model";
+
+    NNFS::NeuralNetwork network;
+    network.load(argv[1]);
+
+    std::ofstream out(argv[2]);
+    if (!out.good())
+    {
+        std::cerr << "Cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    if (!NNFS::CodeGen::generate(network, out, name))
+    {
+        std::cerr << "Cannot generate code for " << argv[1] << std::endl;
+        return 1;
+    }
+
+    int n_input, n_output;
+    network.shape(n_input, n_output);
+    std::cout << "Wrote " << argv[2] << ": " << name << "_predict(), " << n_input << " inputs, " << n_output << " outputs" << std::endl;
+    return 0;
+}
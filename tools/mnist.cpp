@@ -7,12 +7,14 @@
 #include <algorithm>
 #include <random>
 #include <filesystem>
+#include <tuple>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include <Eigen/Core>
+#include <NNFS/Core>
 
 #include <curl/curl.h>
 #include <zlib.h>
@@ -85,131 +87,323 @@ void download_file(const std::string &url, const std::string &path)
 }
 
 /**
- * @brief Unzip gz file and save to local path
- * @param gz_path Local path of gz file to unzip
- * @param out_path Local path to save unzipped file
- * @return True if unzipping was successful, false otherwise
+ * @brief Sequential reader over a gzip-compressed or plain file
+ *
+ * @details Compressed input is read in large chunks and inflated by zlib straight into the buffer passed to read(), so
+ * decoding a file costs one read() system call per chunk and no intermediate copy of the inflated data.
  */
-bool unzip_file(const std::string &gz_path, const std::string &out_path)
+class InflateStream
 {
-    gzFile gz = gzopen(gz_path.c_str(), "rb");
-    if (!gz)
+public:
+    static constexpr size_t CHUNK = 1 << 20; ///< Size of the compressed input chunks.
+
+    InflateStream() = default;
+    InflateStream(const InflateStream &) = delete;
+    InflateStream &operator=(const InflateStream &) = delete;
+
+    ~InflateStream()
     {
-        std::cerr << "Error opening gz file: " << gz_path << std::endl;
-        return false;
+        if (gzip)
+        {
+            inflateEnd(&stream);
+        }
+        if (file)
+        {
+            fclose(file);
+        }
     }
 
-    std::ofstream outfile(out_path, std::ofstream::binary);
-    if (!outfile.is_open())
+    /**
+     * @brief Open a file, gzip compression is detected from its first bytes
+     * @param path Path of the file
+     * @return True if the file was opened
+     */
+    bool open(const std::string &path)
     {
-        std::cerr << "Error opening output file: " << out_path << std::endl;
-        return false;
+        file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        input.resize(CHUNK);
+        if (!fill())
+        {
+            return true; // Empty file, every read fails
+        }
+
+        if (stream.avail_in >= 2 && input[0] == 0x1f && input[1] == 0x8b)
+        {
+            // 16 + MAX_WBITS selects the gzip wrapper
+            if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+            {
+                return false;
+            }
+            gzip = true;
+        }
+        return true;
     }
 
-    char buffer[1024];
-    int uncompressed_bytes;
-    while ((uncompressed_bytes = gzread(gz, buffer, sizeof(buffer))) > 0)
+    /**
+     * @brief Read exactly size decoded bytes
+     * @param data Destination
+     * @param size Number of bytes
+     * @return True if all bytes were read
+     */
+    bool read(void *data, size_t size)
     {
-        outfile.write(buffer, uncompressed_bytes);
+        unsigned char *out = static_cast<unsigned char *>(data);
+
+        while (size > 0)
+        {
+            if (stream.avail_in == 0 && !fill())
+            {
+                return false;
+            }
+
+            if (!gzip)
+            {
+                size_t n = std::min<size_t>(size, stream.avail_in);
+                std::copy(stream.next_in, stream.next_in + n, out);
+                stream.next_in += n;
+                stream.avail_in -= n;
+                out += n;
+                size -= n;
+                continue;
+            }
+
+            if (finished)
+            {
+                return false;
+            }
+
+            // avail_out is an unsigned int, larger reads are inflated in several steps
+            stream.next_out = out;
+            stream.avail_out = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+            uInt requested = stream.avail_out;
+
+            int status = inflate(&stream, Z_NO_FLUSH);
+            size_t n = requested - stream.avail_out;
+            if ((status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) || (status == Z_BUF_ERROR && n == 0 && stream.avail_in > 0))
+            {
+                return false;
+            }
+            finished = status == Z_STREAM_END;
+
+            out += n;
+            size -= n;
+        }
+        return true;
     }
 
-    outfile.close();
-    gzclose(gz);
+    /**
+     * @brief Check that all data has been consumed
+     * @return True if there is nothing left to decode
+     */
+    bool at_end()
+    {
+        if (gzip && !finished)
+        {
+            // The payload may end exactly at the end of the deflate stream, let zlib consume the gzip trailer
+            unsigned char byte;
+            return !read(&byte, 1) && finished && stream.avail_in == 0 && !fill();
+        }
+        return stream.avail_in == 0 && !fill();
+    }
 
-    return true;
-}
+private:
+    bool fill()
+    {
+        size_t n = fread(input.data(), 1, input.size(), file);
+        stream.next_in = input.data();
+        stream.avail_in = static_cast<uInt>(n);
+        return n > 0;
+    }
+
+    FILE *file = nullptr;              ///< Underlying file.
+    std::vector<unsigned char> input;  ///< Compressed input chunk.
+    z_stream stream{};                 ///< zlib state, also tracks the input position in plain mode.
+    bool gzip = false;                 ///< Whether the file is gzip-compressed.
+    bool finished = false;             ///< Whether the end of the deflate stream was reached.
+};
 
 /**
- * @brief Read a MNIST image file
+ * @brief Read an IDX file of unsigned bytes, gzip-compressed or not
+ *
+ * @details The header is validated before anything is allocated: the data type must be unsigned byte, the number of dimensions
+ * must match and the payload must fit in memory. The payload is then inflated directly into the destination matrix and the
+ * file must end right after it.
  *
  * @param filename Name of the file to read
- * @return A matrix containing the images
+ * @param dimensions Expected number of dimensions (3 for images, 1 for labels)
+ * @param data One item per row, the remaining dimensions flattened into the columns
+ * @return True if the file was read
  */
-Eigen::MatrixXd read_mnist_images(const std::string &filename)
+bool read_idx(const std::string &filename, int dimensions, Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> &data)
 {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file)
+    InflateStream stream;
+    if (!stream.open(filename))
     {
         std::cout << "Error: Failed to open file: " << filename.c_str() << std::endl;
-        return Eigen::MatrixXd();
+        return false;
     }
 
-    int magic_number = 0;
-    int num_images = 0;
-    int num_rows = 0;
-    int num_cols = 0;
+    // Magic number: two zero bytes, the data type (0x08 = unsigned byte) and the number of dimensions
+    unsigned char magic[4];
+    if (!stream.read(magic, sizeof(magic)) || magic[0] != 0 || magic[1] != 0 || magic[2] != 0x08 || magic[3] != dimensions)
+    {
+        std::cout << "Error: Invalid magic number in file: " << filename.c_str() << std::endl;
+        return false;
+    }
+
+    uint64_t items = 0;
+    uint64_t item_size = 1;
+    for (int i = 0; i < dimensions; ++i)
+    {
+        unsigned char bytes[4];
+        if (!stream.read(bytes, sizeof(bytes)))
+        {
+            std::cout << "Error: Truncated header in file: " << filename.c_str() << std::endl;
+            return false;
+        }
 
-    file.read((char *)&magic_number, sizeof(magic_number));
-    magic_number = ntohl(magic_number);
+        uint64_t size = (uint64_t(bytes[0]) << 24) | (uint64_t(bytes[1]) << 16) | (uint64_t(bytes[2]) << 8) | uint64_t(bytes[3]);
+        if (i == 0)
+        {
+            items = size;
+        }
+        else if ((item_size *= size) > (uint64_t(1) << 24))
+        {
+            break;
+        }
+    }
 
-    if (magic_number != 2051)
+    if (items > (uint64_t(1) << 31) || item_size > (uint64_t(1) << 24) || items * item_size > (uint64_t(1) << 36))
     {
-        std::cout << "Error: Invalid magic number in file: " << filename.c_str() << std::endl;
-        return Eigen::MatrixXd();
+        std::cout << "Error: Implausible dimensions in file: " << filename.c_str() << std::endl;
+        return false;
     }
 
-    file.read((char *)&num_images, sizeof(num_images));
-    file.read((char *)&num_rows, sizeof(num_rows));
-    file.read((char *)&num_cols, sizeof(num_cols));
+    NNFS::Memory::resize(data, items, item_size);
+    if (!stream.read(data.data(), data.size()) || !stream.at_end())
+    {
+        std::cout << "Error: Payload size does not match the header in file: " << filename.c_str() << std::endl;
+        data.resize(0, 0);
+        return false;
+    }
+    return true;
+}
 
-    num_images = ntohl(num_images);
-    num_rows = ntohl(num_rows);
-    num_cols = ntohl(num_cols);
+/**
+ * @brief Read a MNIST image file into bytes
+ *
+ * @param filename Name of the file to read, gzip-compressed or not
+ * @return A row-major matrix containing one image per row, pixels in [0, 255]
+ */
+Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> read_mnist_images_u8(const std::string &filename)
+{
+    Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> images;
+    read_idx(filename, 3, images);
+    return images;
+}
 
-    Eigen::MatrixXd images(num_rows * num_cols, num_images);
+/**
+ * @brief Read a MNIST label file into class ids
+ *
+ * @param filename Name of the file to read, gzip-compressed or not
+ * @return A vector containing the class id of every image
+ */
+Eigen::VectorXi read_mnist_labels_u8(const std::string &filename)
+{
+    Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> labels;
+    read_idx(filename, 1, labels);
+    return labels.cast<int>();
+}
 
-    for (int i = 0; i < num_images; ++i)
+/**
+ * @brief One-hot encode MNIST class ids
+ *
+ * @param ids Class ids, ids outside [0, 9] produce an all-zero row
+ * @return A matrix containing one row per label
+ */
+Eigen::MatrixXd onehot_mnist_labels(const Eigen::VectorXi &ids)
+{
+    Eigen::MatrixXd labels = Eigen::MatrixXd::Zero(ids.size(), 10);
+    for (int i = 0; i < ids.size(); ++i)
     {
-        for (int j = 0; j < num_rows * num_cols; ++j)
+        if (ids(i) >= 0 && ids(i) < 10)
         {
-            unsigned char pixel = 0;
-            file.read((char *)&pixel, sizeof(pixel));
-            images(j, i) = static_cast<double>(pixel) / 255.;
+            labels(i, ids(i)) = 1.0;
         }
     }
-    return images.transpose();
+    return labels;
+}
+
+/**
+ * @brief Read a MNIST image file
+ *
+ * @param filename Name of the file to read, gzip-compressed or not
+ * @return A matrix containing the images
+ */
+Eigen::MatrixXd read_mnist_images(const std::string &filename)
+{
+    return read_mnist_images_u8(filename).cast<double>() / 255.;
 }
 
 /**
  * @brief Read a MNIST label file
  *
- * @param filename Name of the file to read
+ * @param filename Name of the file to read, gzip-compressed or not
  * @return A matrix containing the labels
  */
 Eigen::MatrixXd read_mnist_labels(const std::string &filename)
 {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file)
-    {
-        std::cout << "Error: Failed to open file: " << filename.c_str() << std::endl;
-        return Eigen::MatrixXd();
-    }
-
-    int magic_number = 0;
-    int num_labels = 0;
+    return onehot_mnist_labels(read_mnist_labels_u8(filename));
+}
 
-    file.read((char *)&magic_number, sizeof(magic_number));
-    magic_number = ntohl(magic_number);
+/**
+ * @brief Fetch MNIST dataset in its compact form, downloading it to a local directory if it doesn't exist
+ *
+ * @details The four gzip files are decoded concurrently on the inter-op pool of NNFS::Threading, without writing
+ * inflated copies to disk.
+ *
+ * @param data_dir Local directory to save MNIST dataset in
+ *
+ * @return A tuple containing the training images and labels and the test images and labels
+ */
+std::tuple<Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, Eigen::VectorXi,
+           Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, Eigen::VectorXi>
+fetch_mnist_u8(const std::string &data_dir)
+{
+    const std::vector<std::string> names = {"train-images-idx3-ubyte.gz", "train-labels-idx1-ubyte.gz",
+                                            "t10k-images-idx3-ubyte.gz", "t10k-labels-idx1-ubyte.gz"};
 
-    if (magic_number != 2049)
+    std::filesystem::create_directories(data_dir);
+    for (const std::string &name : names)
     {
-        std::cout << "Error: Invalid magic number in file: " << filename.c_str();
-        return Eigen::MatrixXd();
+        if (!std::filesystem::exists(data_dir + "/" + name))
+        {
+            std::cout << "Downloading " << name << "..." << std::endl;
+            download_file(BASE_URL + name, data_dir + "/" + name);
+        }
     }
 
-    file.read((char *)&num_labels, sizeof(num_labels));
-    num_labels = ntohl(num_labels);
-
-    Eigen::MatrixXd labels = Eigen::MatrixXd::Zero(10, num_labels);
-
-    for (int i = 0; i < num_labels; ++i)
+    Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> x_train, x_test;
+    Eigen::VectorXi y_train, y_test;
     {
-        unsigned char label = 0;
-        file.read((char *)&label, sizeof(label));
-        int index = static_cast<int>(label);
-        labels(index, i) = 1.0;
+        NNFS::TaskGroup group(NNFS::Threading::inter_op());
+        group.run([&]()
+                  { x_train = read_mnist_images_u8(data_dir + "/" + names[0]); });
+        group.run([&]()
+                  { y_train = read_mnist_labels_u8(data_dir + "/" + names[1]); });
+        group.run([&]()
+                  { x_test = read_mnist_images_u8(data_dir + "/" + names[2]); });
+        group.run([&]()
+                  { y_test = read_mnist_labels_u8(data_dir + "/" + names[3]); });
+        group.wait();
     }
-    return labels.transpose();
+
+    return std::make_tuple(std::move(x_train), std::move(y_train), std::move(x_test), std::move(y_test));
 }
 
 /**
@@ -221,56 +415,14 @@ Eigen::MatrixXd read_mnist_labels(const std::string &filename)
 std::tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd>
 fetch_mnist(const std::string &data_dir)
 {
-    const std::string train_images_url = BASE_URL + "train-images-idx3-ubyte.gz";
-    const std::string train_images_path = data_dir + "/train-images-idx3-ubyte.gz";
-    const std::string train_images_file = data_dir + "/train-images-idx3-ubyte";
-    const std::string train_labels_url = BASE_URL + "train-labels-idx1-ubyte.gz";
-    const std::string train_labels_path = data_dir + "/train-labels-idx1-ubyte.gz";
-    const std::string train_labels_file = data_dir + "/train-labels-idx1-ubyte";
-    const std::string test_images_url = BASE_URL + "t10k-images-idx3-ubyte.gz";
-    const std::string test_images_path = data_dir + "/t10k-images-idx3-ubyte.gz";
-    const std::string test_images_file = data_dir + "/t10k-images-idx3-ubyte";
-    const std::string test_labels_url = BASE_URL + "t10k-labels-idx1-ubyte.gz";
-    const std::string test_labels_path = data_dir + "/t10k-labels-idx1-ubyte.gz";
-    const std::string test_labels_file = data_dir + "/t10k-labels-idx1-ubyte";
-
-    if (!std::filesystem::exists(train_images_file) ||
-        !std::filesystem::exists(train_labels_file) ||
-        !std::filesystem::exists(test_images_file) ||
-        !std::filesystem::exists(test_labels_file))
-    {
-        std::filesystem::create_directories(data_dir);
-
-        std::cout << "Downloading MNIST training images..." << std::endl;
-        download_file(train_images_url, train_images_path);
-
-        std::cout << "Downloading MNIST training labels..." << std::endl;
-        download_file(train_labels_url, train_labels_path);
-
-        std::cout << "Downloading MNIST test images..." << std::endl;
-        download_file(test_images_url, test_images_path);
-
-        std::cout << "Downloading MNIST test labels..." << std::endl;
-        download_file(test_labels_url, test_labels_path);
-
-        std::cout << "Extracting MNIST training images..." << std::endl;
-        unzip_file(train_images_path, train_images_file);
-
-        std::cout << "Extracting MNIST training labels..." << std::endl;
-        unzip_file(train_labels_path, train_labels_file);
-
-        std::cout << "Extracting MNIST test images..." << std::endl;
-        unzip_file(test_images_path, test_images_file);
-
-        std::cout << "Extracting MNIST test labels..." << std::endl;
-        unzip_file(test_labels_path, test_labels_file);
-    }
-
-    Eigen::MatrixXd x_train = read_mnist_images(train_images_file);
-    Eigen::MatrixXd y_train = read_mnist_labels(train_labels_file);
+    auto [x_train, y_train, x_test, y_test] = fetch_mnist_u8(data_dir);
 
-    Eigen::MatrixXd x_test = read_mnist_images(test_images_file);
-    Eigen::MatrixXd y_test = read_mnist_labels(test_labels_file);
+    // The scaled images are the largest buffers of the program, advise them to use huge pages before writing them
+    Eigen::MatrixXd x_train_scaled, x_test_scaled;
+    NNFS::Memory::resize(x_train_scaled, x_train.rows(), x_train.cols());
+    NNFS::Memory::resize(x_test_scaled, x_test.rows(), x_test.cols());
+    x_train_scaled = x_train.cast<double>() / 255.;
+    x_test_scaled = x_test.cast<double>() / 255.;
 
-    return std::make_tuple(x_train, y_train, x_test, y_test);
-};
\ No newline at end of file
+    return std::make_tuple(std::move(x_train_scaled), onehot_mnist_labels(y_train), std::move(x_test_scaled), onehot_mnist_labels(y_test));
+};
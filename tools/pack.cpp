@@ -0,0 +1,236 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <NNFS/Core>
+
+using FeaturesU8 = Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using FeaturesF32 = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using Labels = Eigen::VectorXi;
+
+/**
+ * @brief Reads exactly size bytes from a gzip or plain file
+ * @param gz File opened with gzopen
+ * @param data Destination
+ * @param size Number of bytes to read
+ * @return True if all bytes were read
+ */
+static bool read_exact(gzFile gz, void *data, size_t size)
+{
+    char *out = static_cast<char *>(data);
+    while (size > 0)
+    {
+        // gzread takes an unsigned int length
+        unsigned chunk = static_cast<unsigned>(std::min<size_t>(size, 1u << 30));
+        int n = gzread(gz, out, chunk);
+        if (n <= 0)
+        {
+            return false;
+        }
+        out += n;
+        size -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a big-endian 32-bit IDX header field
+ * @param gz File opened with gzopen
+ * @param value Decoded value
+ * @return True if the field was read
+ */
+static bool read_be32(gzFile gz, uint32_t &value)
+{
+    unsigned char bytes[4];
+    if (!read_exact(gz, bytes, sizeof(bytes)))
+    {
+        return false;
+    }
+    value = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+    return true;
+}
+
+/**
+ * @brief Reads an IDX image file, gzip-compressed or not
+ * @param path Path of the image file
+ * @param images One image per row
+ * @return True if the file was read
+ */
+static bool read_idx_images(const std::string &path, FeaturesU8 &images)
+{
+    gzFile gz = gzopen(path.c_str(), "rb");
+    if (!gz)
+    {
+        std::cerr << "Error opening image file: " << path << std::endl;
+        return false;
+    }
+    gzbuffer(gz, 1 << 20);
+
+    uint32_t magic, count, rows, cols;
+    bool ok = read_be32(gz, magic) && magic == 2051 && read_be32(gz, count) && read_be32(gz, rows) && read_be32(gz, cols) &&
+              uint64_t(count) * rows * cols < (uint64_t(1) << 40);
+    if (ok)
+    {
+        images.resize(count, static_cast<Eigen::Index>(rows) * cols);
+        ok = read_exact(gz, images.data(), images.size());
+    }
+    gzclose(gz);
+
+    if (!ok)
+    {
+        std::cerr << "Invalid or truncated IDX image file: " << path << std::endl;
+    }
+    return ok;
+}
+
+/**
+ * @brief Reads an IDX label file, gzip-compressed or not
+ * @param path Path of the label file
+ * @param labels Class id of every sample
+ * @return True if the file was read
+ */
+static bool read_idx_labels(const std::string &path, Labels &labels)
+{
+    gzFile gz = gzopen(path.c_str(), "rb");
+    if (!gz)
+    {
+        std::cerr << "Error opening label file: " << path << std::endl;
+        return false;
+    }
+
+    uint32_t magic, count;
+    std::vector<uint8_t> bytes;
+    bool ok = read_be32(gz, magic) && magic == 2049 && read_be32(gz, count) && count < (1u << 31);
+    if (ok)
+    {
+        bytes.resize(count);
+        ok = read_exact(gz, bytes.data(), bytes.size());
+    }
+    gzclose(gz);
+
+    if (!ok)
+    {
+        std::cerr << "Invalid or truncated IDX label file: " << path << std::endl;
+        return false;
+    }
+
+    labels = Eigen::Map<const Eigen::Matrix<uint8_t, Eigen::Dynamic, 1>>(bytes.data(), bytes.size()).cast<int32_t>();
+    return true;
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " idx <images> <labels> <output> [--float]" << std::endl
+              << "       " << program << " csv <input.csv> <output> [--label-column <n>] [--skip-header] [--delimiter <c>] [--uint8]" << std::endl
+              << std::endl
+              << "Converts IDX (optionally gzip-compressed) or CSV data into a packed dataset for NNFS::PackedDataset." << std::endl
+              << "IDX images are stored as uint8 unless --float is given, CSV features are stored as float32 unless --uint8 is given." << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string format = argv[1];
+    std::vector<std::string> positional;
+    bool as_float = false;
+    bool as_uint8 = false;
+    NNFS::CSVOptions csv_options;
+    csv_options.label_column = 0;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--float")
+            as_float = true;
+        else if (arg == "--uint8")
+            as_uint8 = true;
+        else if (arg == "--skip-header")
+            csv_options.header = true;
+        else if (arg == "--label-column" && i + 1 < argc)
+            csv_options.label_column = std::atoi(argv[++i]);
+        else if (arg == "--delimiter" && i + 1 < argc)
+            csv_options.delimiter = std::string(argv[++i]) == "\\t" ? '\t' : argv[i][0];
+        else if (arg.rfind("--", 0) == 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+            positional.push_back(arg);
+    }
+
+    FeaturesU8 features_u8;
+    FeaturesF32 features_f32;
+    Labels labels;
+    std::string output;
+
+    if (format == "idx" && positional.size() == 3)
+    {
+        if (!read_idx_images(positional[0], features_u8) || !read_idx_labels(positional[1], labels))
+        {
+            return 1;
+        }
+        if (features_u8.rows() != labels.rows())
+        {
+            std::cerr << "Image and label files contain a different number of samples" << std::endl;
+            return 1;
+        }
+        if (as_float)
+        {
+            features_f32 = features_u8.cast<float>() / 255.f;
+        }
+        as_uint8 = !as_float;
+        output = positional[2];
+    }
+    else if (format == "csv" && positional.size() == 2 && csv_options.label_column >= 0)
+    {
+        std::vector<std::string> classes;
+        if (!NNFS::CSV::load(positional[0], features_f32, labels, classes, csv_options))
+        {
+            return 1;
+        }
+        if (as_uint8)
+        {
+            if (features_f32.size() > 0 && (features_f32.minCoeff() < 0.f || features_f32.maxCoeff() > 255.f ||
+                                            (features_f32.array() != features_f32.array().round()).any()))
+            {
+                std::cerr << "--uint8 requires integer features in [0, 255]" << std::endl;
+                return 1;
+            }
+            features_u8 = features_f32.cast<uint8_t>();
+        }
+        output = positional[1];
+    }
+    else
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (labels.minCoeff() < 0)
+    {
+        std::cerr << "Labels must be non-negative class ids" << std::endl;
+        return 1;
+    }
+    int classes = labels.maxCoeff() + 1;
+
+    bool written = as_uint8 ? NNFS::PackedDataset::write<uint8_t>(output, features_u8, labels, classes)
+                            : NNFS::PackedDataset::write<float>(output, features_f32, labels, classes);
+    if (!written)
+    {
+        return 1;
+    }
+
+    std::cout << "Packed " << labels.size() << " samples with " << (as_uint8 ? features_u8.cols() : features_f32.cols())
+              << (as_uint8 ? " uint8" : " float32") << " features and " << classes << " classes into " << output << std::endl;
+    return 0;
+}
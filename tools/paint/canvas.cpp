@@ -48,6 +48,7 @@ void Canvas::mouseMoveEvent(QMouseEvent *event)
         lastPoint = currentPoint;
         QImage image_scaled = image.scaled(width(), height());
         setPixmap(QPixmap::fromImage(image_scaled));
+        updateMatrix();
     }
 }
 
@@ -56,12 +57,16 @@ void Canvas::mouseReleaseEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton || event->button() == Qt::RightButton)
     {
         drawing = false;
-        for (int row = 0; row < 28; row++)
-        {
-            for (int col = 0; col < 28; col++)
-            {
-                image_matrix(0, row * 28 + col) = (double)qGray(image.pixel(row, col)) / 255;
-            }
-        }
+        updateMatrix();
     }
-}
\ No newline at end of file
+}
+
+void Canvas::updateMatrix()
+{
+    // Convert the whole image at once and view it as a 28x28 byte matrix, scanlines may be padded
+    QImage gray = image.convertToFormat(QImage::Format_Grayscale8);
+    Eigen::Map<const Eigen::Matrix<uchar, 28, 28, Eigen::RowMajor>, 0, Eigen::OuterStride<>> pixels(gray.constBits(), Eigen::OuterStride<>(gray.bytesPerLine()));
+
+    // pixels(y, x) lands at index x * 28 + y, the column-wise layout the model was trained on
+    image_matrix = (pixels.cast<double>() / 255).reshaped(1, 784);
+}
@@ -72,6 +72,11 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
 
 private:
+    /**
+     * @brief Updates the matrix representation from the image.
+     */
+    void updateMatrix();
+
     bool drawing;                                                 ///< Flag indicating whether the user is currently drawing.
     QImage image;                                                 ///< The image used as the canvas.
     QPointF lastPoint;                                            ///< The last recorded point where the mouse was pressed or moved.
@@ -1,5 +1,5 @@
 #include "paint.h"
-#include <unistd.h>
+#include <QDir>
 
 Paint::Paint(QWidget *parent) : QMainWindow(parent), ui(new Ui::paint)
 {
@@ -8,9 +8,12 @@ Paint::Paint(QWidget *parent) : QMainWindow(parent), ui(new Ui::paint)
   // Set the window size to 28x28 pixels
   setFixedSize(28 * 10 + 200, 28 * 10 + 200);
   QPushButton *restartButton = ui->restartButton;
-  model = NNFS::NeuralNetwork();
-  char *home_dir = getenv("HOME");
-  model.load(strcat(home_dir, "/EMNIST.bin"));
+  // Inference runs on its own thread so drawing is never blocked by the network
+  predictor = new Predictor(QDir::homePath() + "/EMNIST.bin");
+  predictor->moveToThread(&worker);
+  connect(&worker, &QThread::finished, predictor, &QObject::deleteLater);
+  connect(predictor, &Predictor::predicted, this, &Paint::showPrediction);
+  worker.start();
   canvas->installEventFilter(this);
   connect(restartButton, &QPushButton::clicked, this, &Paint::restartCanvas);
   canvas->setMouseTracking(true);
@@ -22,10 +25,10 @@ void Paint::restartCanvas()
   canvas->restartCanvas();
 }
 
-// Run predict function on mouse move if Canvas::isDrawing() is true
+// Run predict function on mouse move and when a stroke ends
 bool Paint::eventFilter([[maybe_unused]] QObject *obj, QEvent *event)
 {
-  if (event->type() == QEvent::MouseMove || event->type() == QEvent::MouseMove)
+  if (event->type() == QEvent::MouseMove || event->type() == QEvent::MouseButtonRelease)
   {
     predict();
   }
@@ -34,13 +37,12 @@ bool Paint::eventFilter([[maybe_unused]] QObject *obj, QEvent *event)
 
 void Paint::predict()
 {
-  Eigen::MatrixXd image = canvas->getMatrix();
-  std::cout << image.reshaped(28, 28).transpose() << std::endl
-            << std::endl;
-  Eigen::MatrixXd output = model.predict(image);
+  predictor->submit(canvas->getMatrix());
+}
+
+void Paint::showPrediction(const Eigen::MatrixXd &output)
+{
   Eigen::VectorXi labels;
-  std::cout << output << std::endl
-            << std::endl;
   ui->zero_bar->setValue((int)(output(0, 0) * 100));
   ui->one_bar->setValue((int)(output(0, 1) * 100));
   ui->two_bar->setValue((int)(output(0, 2) * 100));
@@ -64,7 +66,6 @@ void Paint::predict()
   ui->zero->setStyleSheet("color: white; font-size: 24px;");
 
   NNFS::Metrics::onehotdecode(labels, output);
-  std::cout << labels << std::endl;
 
   int largest_index = labels(0);
 
@@ -97,5 +98,7 @@ void Paint::predict()
 
 Paint::~Paint()
 {
+  worker.quit();
+  worker.wait();
   delete ui;
 }
\ No newline at end of file
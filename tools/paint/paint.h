@@ -6,7 +6,9 @@
 #include <QWidget>
 #include <QLabel>
 #include <QPushButton>
+#include <QThread>
 #include <NNFS/Core>
+#include "predictor.h"
 
 /**
  * @brief The Paint class represents a painting application.
@@ -48,14 +50,22 @@ private slots:
     void restartCanvas();
 
     /**
-     * @brief Performs a prediction using the neural network model.
+     * @brief Sends the current canvas to the prediction worker.
      */
     void predict();
 
+    /**
+     * @brief Displays the probabilities computed by the prediction worker.
+     *
+     * @param output Class probabilities, a 1x10 row.
+     */
+    void showPrediction(const Eigen::MatrixXd &output);
+
 private:
     Ui::paint *ui;               // User interface
     Canvas *canvas;              // Painting canvas
-    NNFS::NeuralNetwork model;   // Neural network model
+    QThread worker;              // Thread running the predictor
+    Predictor *predictor;        // Neural network inference, lives on the worker thread
 };
 
 #endif // PAINT_H
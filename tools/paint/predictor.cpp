@@ -0,0 +1,32 @@
+#include "predictor.h"
+
+Predictor::Predictor(const QString &model_path, QObject *parent) : QObject(parent)
+{
+  qRegisterMetaType<Eigen::MatrixXd>();
+  model.load(model_path.toStdString());
+  // Mouse moves often leave the canvas unchanged, repeated rows are answered from the cache
+  model.prediction_cache(64);
+}
+
+void Predictor::submit(const Eigen::MatrixXd &image)
+{
+  QMutexLocker lock(&mutex);
+  latest = image;
+  if (!scheduled)
+  {
+    scheduled = true;
+    QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+  }
+}
+
+void Predictor::process()
+{
+  Eigen::MatrixXd image;
+  {
+    QMutexLocker lock(&mutex);
+    image.swap(latest);
+    scheduled = false;
+  }
+
+  emit predicted(model.predict_incremental(image));
+}
@@ -0,0 +1,62 @@
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <NNFS/Core>
+
+Q_DECLARE_METATYPE(Eigen::MatrixXd)
+
+/**
+ * @brief The Predictor class runs the neural network on a worker thread.
+ *
+ * @details The GUI thread hands over canvas snapshots with submit(). Only the most recent snapshot is kept, so when the user draws
+ * faster than the network can answer, intermediate states are dropped instead of queueing up behind each other.
+ * Results are delivered through the predicted() signal, which is queued back to the receiver's thread.
+ */
+class Predictor : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs a new Predictor object and loads the model.
+     *
+     * @param model_path Path to a model written by NNFS::NeuralNetwork::save.
+     * @param parent The parent QObject.
+     */
+    explicit Predictor(const QString &model_path, QObject *parent = nullptr);
+
+    /**
+     * @brief Queues a canvas snapshot for prediction, replacing any snapshot that has not been processed yet.
+     *
+     * @details Thread-safe, meant to be called from the GUI thread.
+     *
+     * @param image The canvas as a 1x784 row.
+     */
+    void submit(const Eigen::MatrixXd &image);
+
+signals:
+    /**
+     * @brief Emitted once a snapshot has been processed.
+     *
+     * @param output Class probabilities, a 1x10 row.
+     */
+    void predicted(const Eigen::MatrixXd &output);
+
+private slots:
+    /**
+     * @brief Predicts the latest submitted snapshot.
+     */
+    void process();
+
+private:
+    NNFS::NeuralNetwork model; // Neural network model, only used on the worker thread
+    QMutex mutex;              // Guards latest and scheduled
+    Eigen::MatrixXd latest;    // Most recent snapshot not yet processed
+    bool scheduled = false;    // Whether a call to process() is already queued
+};
+
+#endif // PREDICTOR_H
@@ -129,4 +129,18 @@ void TestCanvas::testMouseReleaseEvent_negative()
     QVERIFY(matrix.sum() == 0.0);
 }
 
+void TestCanvas::testMouseReleaseEvent_layout()
+{
+    Canvas canvas;
+    QTest::mousePress(&canvas, Qt::LeftButton, Qt::NoModifier, QPoint(50, 100));
+    QTest::mouseMove(&canvas, QPoint(50, 100));
+    QTest::mouseRelease(&canvas, Qt::LeftButton, Qt::NoModifier, QPoint(50, 100));
+
+    Eigen::MatrixXd matrix = canvas.getMatrix();
+
+    // Pixel (x, y) = (5, 10) is stored at x * 28 + y
+    QVERIFY(matrix(0, 5 * 28 + 10) > 0.5);
+    QVERIFY(matrix(0, 10 * 28 + 5) == 0.0);
+}
+
 QTEST_MAIN(TestCanvas)
@@ -27,6 +27,7 @@ private slots:
 
     void testMouseReleaseEvent_positive();
     void testMouseReleaseEvent_negative();
+    void testMouseReleaseEvent_layout();
 };
 
 #endif // TEST_CANVAS_H
@@ -0,0 +1,395 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <NNFS/Core>
+
+#include "protocol.h"
+
+/**
+ * @brief A loaded model together with one replica per inference worker.
+ *
+ * @details NNFS::NeuralNetwork caches intermediate results inside its layers, so a single
+ * instance must never run two forward passes concurrently. Every worker therefore owns
+ * its own replica of the same weights.
+ */
+struct ModelGeneration
+{
+    uint64_t id;                                                 ///< Monotonic generation number.
+    int input_dim;                                               ///< Number of input features.
+    int output_dim;                                              ///< Number of output classes.
+    std::vector<std::unique_ptr<NNFS::NeuralNetwork>> replicas;  ///< One network per worker.
+};
+
+/**
+ * @brief Owns the currently served model and swaps it atomically when the file on disk changes.
+ *
+ * @details Readers take a reference to the current generation with acquire() and keep it for
+ * the duration of a batch, so a reload never invalidates in-flight requests: the previous
+ * generation is released once its last batch completes.
+ */
+class ModelRegistry
+{
+public:
+    /**
+     * @brief Constructs a new ModelRegistry object.
+     *
+     * @param path Path to a model written by NNFS::NeuralNetwork::save
+     * @param replicas Number of replicas to load for every generation
+     * @param cache_rows Capacity of the prediction cache of every replica, 0 disables it
+     */
+    ModelRegistry(std::string path, int replicas, size_t cache_rows = 0) : _path(std::move(path)), _replicas(replicas), _cache_rows(cache_rows) {}
+
+    /**
+     * @brief Loads the model file and publishes it as the new current generation.
+     *
+     * @return True if the model was loaded, false if the previous generation was kept.
+     */
+    bool reload()
+    {
+        FileStamp before;
+        if (!stamp(before))
+        {
+            LOG_ERROR("Model file " << _path << " is not accessible.");
+            return false;
+        }
+
+        auto generation = std::make_shared<ModelGeneration>();
+        generation->input_dim = -1;
+        generation->output_dim = -1;
+
+        try
+        {
+            for (int i = 0; i < _replicas; ++i)
+            {
+                auto network = std::make_unique<NNFS::NeuralNetwork>();
+                network->load(_path);
+                network->prediction_cache(_cache_rows);
+
+                int n_input;
+                int n_output;
+                network->shape(n_input, n_output);
+
+                if (n_input <= 0 || (i > 0 && (n_input != generation->input_dim || n_output != generation->output_dim)))
+                {
+                    LOG_ERROR("Model file " << _path << " could not be loaded, keeping the previous model.");
+                    return false;
+                }
+
+                generation->input_dim = n_input;
+                generation->output_dim = n_output;
+                generation->replicas.push_back(std::move(network));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Model file " << _path << " could not be loaded (" << e.what() << "), keeping the previous model.");
+            return false;
+        }
+
+        // The file was rewritten while the replicas were being read, they might differ.
+        FileStamp after;
+        if (!stamp(after) || !(before == after))
+        {
+            LOG_WARNING("Model file " << _path << " changed while loading, retrying on next poll.");
+            return false;
+        }
+
+        generation->id = ++_generations;
+        std::atomic_store(&_current, std::shared_ptr<ModelGeneration>(generation));
+        _loaded = before;
+
+        LOG_INFO("Serving model generation " << generation->id << " (" << generation->input_dim << " -> " << generation->output_dim << ") from " << _path);
+        return true;
+    }
+
+    /**
+     * @brief Gets the current generation.
+     *
+     * @return The current generation or nullptr if no model has been loaded yet.
+     */
+    std::shared_ptr<ModelGeneration> acquire() const
+    {
+        return std::atomic_load(&_current);
+    }
+
+    /**
+     * @brief Polls the model file and reloads it whenever it changes.
+     *
+     * @details A change is only picked up once the file has been stable for one full interval,
+     * so a model that is still being written is never loaded.
+     *
+     * @param interval Polling interval
+     * @param running Polling stops once this flag becomes false
+     */
+    void watch(std::chrono::milliseconds interval, const std::atomic<bool> &running)
+    {
+        FileStamp pending;
+        bool has_pending = false;
+
+        while (running)
+        {
+            std::this_thread::sleep_for(interval);
+
+            FileStamp current;
+            if (!stamp(current) || current == _loaded)
+            {
+                has_pending = false;
+                continue;
+            }
+
+            if (has_pending && current == pending)
+            {
+                reload();
+                has_pending = false;
+            }
+            else
+            {
+                pending = current;
+                has_pending = true;
+            }
+        }
+    }
+
+private:
+    /**
+     * @brief Identity of a file revision on disk.
+     */
+    struct FileStamp
+    {
+        ino_t inode = 0;
+        off_t size = 0;
+        int64_t mtime_ns = 0;
+
+        bool operator==(const FileStamp &other) const
+        {
+            return inode == other.inode && size == other.size && mtime_ns == other.mtime_ns;
+        }
+    };
+
+    bool stamp(FileStamp &out) const
+    {
+        struct stat st;
+        if (::stat(_path.c_str(), &st) != 0)
+        {
+            return false;
+        }
+        out.inode = st.st_ino;
+        out.size = st.st_size;
+        out.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    std::string _path;                         // Path to the model file
+    int _replicas;                             // Replicas per generation
+    size_t _cache_rows;                        // Prediction cache capacity per replica
+    uint64_t _generations = 0;                 // Number of generations published so far
+    FileStamp _loaded;                         // Revision of the file currently served
+    std::shared_ptr<ModelGeneration> _current; // Current generation, accessed atomically
+};
+
+/**
+ * @brief Result of a single inference request.
+ */
+struct InferenceResult
+{
+    protocol::Status status;  ///< Outcome of the request.
+    Eigen::MatrixXd output;   ///< Probabilities, one row per input row (empty unless status is OK).
+};
+
+/**
+ * @brief Collects requests from all connections into batches executed by a pool of workers.
+ *
+ * @details A worker that picks up a request waits at most max_delay for more rows to arrive
+ * before running the batch, trading a bounded amount of latency for larger GEMMs.
+ */
+class Batcher
+{
+public:
+    /**
+     * @brief Constructs a new Batcher object and starts its workers.
+     *
+     * @param registry Source of the served model
+     * @param workers Number of inference workers, must match the number of replicas in the registry
+     * @param max_batch Maximum number of rows in a batch
+     * @param max_delay Maximum time a request waits for a batch to fill up
+     */
+    Batcher(ModelRegistry &registry, int workers, int max_batch, std::chrono::microseconds max_delay)
+        : _registry(registry), _max_batch(max_batch), _max_delay(max_delay)
+    {
+        for (int i = 0; i < workers; ++i)
+        {
+            _workers.emplace_back(&Batcher::worker_loop, this, i);
+        }
+    }
+
+    /**
+     * @brief Stops the workers after draining the queue.
+     */
+    ~Batcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cv.notify_all();
+        for (auto &worker : _workers)
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Queues a request for inference.
+     *
+     * @param input Input samples, one per row
+     * @return Future resolved once the batch containing the request has been executed.
+     */
+    std::future<InferenceResult> submit(Eigen::MatrixXd input)
+    {
+        auto request = std::make_unique<Request>();
+        request->input = std::move(input);
+        request->enqueued = std::chrono::steady_clock::now();
+        std::future<InferenceResult> result = request->result.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queued_rows += request->input.rows();
+            _queue.push_back(std::move(request));
+        }
+        _cv.notify_one();
+
+        return result;
+    }
+
+private:
+    struct Request
+    {
+        Eigen::MatrixXd input;
+        std::chrono::steady_clock::time_point enqueued;
+        std::promise<InferenceResult> result;
+    };
+
+    void worker_loop(int index)
+    {
+        std::vector<std::unique_ptr<Request>> batch;
+        Eigen::MatrixXd inputs;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this]
+                         { return _stopping || !_queue.empty(); });
+
+                if (_queue.empty())
+                {
+                    return;
+                }
+
+                // Give the batch a chance to fill up, but never delay the oldest request by more than max_delay
+                auto deadline = _queue.front()->enqueued + _max_delay;
+                while (!_stopping && _queued_rows < _max_batch && !_queue.empty())
+                {
+                    if (_cv.wait_until(lock, deadline) == std::cv_status::timeout)
+                    {
+                        break;
+                    }
+                }
+
+                // Another worker may have drained the queue while this one was waiting
+                if (_queue.empty())
+                {
+                    continue;
+                }
+
+                int rows = 0;
+                while (!_queue.empty() && (batch.empty() || rows + _queue.front()->input.rows() <= _max_batch))
+                {
+                    rows += _queue.front()->input.rows();
+                    batch.push_back(std::move(_queue.front()));
+                    _queue.pop_front();
+                }
+                _queued_rows -= rows;
+            }
+
+            run(index, batch, inputs);
+            batch.clear();
+        }
+    }
+
+    void run(int index, std::vector<std::unique_ptr<Request>> &batch, Eigen::MatrixXd &inputs)
+    {
+        // Holding the generation keeps its replicas alive even if the model is swapped meanwhile
+        std::shared_ptr<ModelGeneration> generation = _registry.acquire();
+
+        int rows = 0;
+        for (auto &request : batch)
+        {
+            if (!generation)
+            {
+                request->result.set_value({protocol::UNAVAILABLE, Eigen::MatrixXd()});
+            }
+            else if (request->input.cols() != generation->input_dim)
+            {
+                request->result.set_value({protocol::BAD_SHAPE, Eigen::MatrixXd()});
+            }
+            else
+            {
+                rows += request->input.rows();
+            }
+        }
+
+        if (rows == 0)
+        {
+            return;
+        }
+
+        inputs.resize(rows, generation->input_dim);
+        int offset = 0;
+        for (auto &request : batch)
+        {
+            if (request->input.cols() == generation->input_dim)
+            {
+                inputs.middleRows(offset, request->input.rows()) = request->input;
+                offset += request->input.rows();
+            }
+        }
+
+        Eigen::MatrixXd outputs = generation->replicas[index]->predict(inputs);
+
+        offset = 0;
+        for (auto &request : batch)
+        {
+            if (request->input.cols() == generation->input_dim)
+            {
+                request->result.set_value({protocol::OK, outputs.middleRows(offset, request->input.rows())});
+                offset += request->input.rows();
+            }
+        }
+    }
+
+    ModelRegistry &_registry;                    // Source of the served model
+    int _max_batch;                              // Maximum number of rows per batch
+    std::chrono::microseconds _max_delay;        // Maximum time a request waits for its batch
+    std::mutex _mutex;                           // Guards the queue
+    std::condition_variable _cv;                 // Signals new requests and shutdown
+    std::deque<std::unique_ptr<Request>> _queue; // Pending requests
+    int _queued_rows = 0;                        // Total rows in the queue
+    bool _stopping = false;                      // Set when the batcher is being destroyed
+    std::vector<std::thread> _workers;           // Inference workers
+};
+
+#endif // INFERENCE_H
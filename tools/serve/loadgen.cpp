@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "protocol.h"
+#include "shm_ring.h"
+
+/**
+ * @brief Command line options of the load generator.
+ */
+struct Options
+{
+    std::string socket_path = "/tmp/nnfs.sock"; ///< Path of the server socket.
+    std::string shm_name;                       ///< Shared-memory ring to use instead of the socket.
+    int connections = 4;                        ///< Number of concurrent clients.
+    int requests = 1000;                        ///< Requests sent by every client.
+    int warmup = 100;                           ///< Requests per client excluded from the statistics.
+    int rows = 1;                               ///< Samples per request.
+    int cols = 784;                             ///< Features per sample.
+};
+
+/**
+ * @brief Opens a connection to the server.
+ *
+ * @param path Path of the server socket
+ * @return Socket descriptor or -1 on failure.
+ */
+static int connect_to(const std::string &path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Sends requests over a single connection and records the latency of each one.
+ *
+ * @param options Load generator options
+ * @param seed Seed for the random inputs
+ * @param latencies Latencies in microseconds of the measured requests
+ * @param failures Incremented for every failed request
+ */
+static void client(const Options &options, unsigned seed, std::vector<double> &latencies, std::atomic<int> &failures)
+{
+    int fd = connect_to(options.socket_path);
+    if (fd < 0)
+    {
+        failures += options.warmup + options.requests;
+        return;
+    }
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dis(0.f, 1.f);
+
+    std::vector<float> input(static_cast<size_t>(options.rows) * options.cols);
+    std::generate(input.begin(), input.end(), [&]
+                  { return dis(gen); });
+
+    std::vector<float> output;
+    protocol::RequestHeader request{protocol::MAGIC, static_cast<uint32_t>(options.rows), static_cast<uint32_t>(options.cols)};
+    protocol::ResponseHeader response;
+
+    latencies.reserve(options.requests);
+
+    for (int i = 0; i < options.warmup + options.requests; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        if (!protocol::write_full(fd, &request, sizeof(request)) ||
+            !protocol::write_full(fd, input.data(), input.size() * sizeof(float)) ||
+            !protocol::read_full(fd, &response, sizeof(response)))
+        {
+            failures += options.warmup + options.requests - i;
+            break;
+        }
+
+        if (response.status != protocol::OK)
+        {
+            failures++;
+            continue;
+        }
+
+        output.resize(static_cast<size_t>(response.rows) * response.cols);
+        if (!protocol::read_full(fd, output.data(), output.size() * sizeof(float)))
+        {
+            failures += options.warmup + options.requests - i;
+            break;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        if (i >= options.warmup)
+        {
+            latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+    }
+
+    ::close(fd);
+}
+
+/**
+ * @brief Sends requests through the shared-memory ring and records the latency of each one.
+ *
+ * @param options Load generator options
+ * @param seed Seed for the random inputs
+ * @param latencies Latencies in microseconds of the measured requests
+ * @param failures Incremented for every failed request
+ */
+static void shm_client(const Options &options, unsigned seed, std::vector<double> &latencies, std::atomic<int> &failures)
+{
+    ShmRing ring;
+    if (!ring.open(options.shm_name) || ring.cols() != static_cast<uint32_t>(options.cols) ||
+        static_cast<uint32_t>(options.rows) > ring.capacity())
+    {
+        failures += options.warmup + options.requests;
+        return;
+    }
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dis(0., 1.);
+
+    std::vector<double> input(static_cast<size_t>(options.rows) * options.cols);
+    std::generate(input.begin(), input.end(), [&]
+                  { return dis(gen); });
+
+    std::vector<double> output(static_cast<size_t>(options.rows) * ring.out_cols());
+
+    latencies.reserve(options.requests);
+
+    for (int i = 0; i < options.warmup + options.requests; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        if (ring.infer(input.data(), output.data(), options.rows) != protocol::OK)
+        {
+            failures++;
+            continue;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        if (i >= options.warmup)
+        {
+            latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+    }
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p / 100. * sorted.size()));
+    return sorted[index];
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--socket <path> | --shm <name>] [--connections <n>] [--requests <n>]"
+              << " [--warmup <n>] [--rows <n>] [--cols <n>]" << std::endl;
+}
+
+static bool parse_options(int argc, char *argv[], Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+
+        std::string value = argv[++i];
+        if (arg == "--socket")
+            options.socket_path = value;
+        else if (arg == "--shm")
+            options.shm_name = value;
+        else if (arg == "--connections")
+            options.connections = std::stoi(value);
+        else if (arg == "--requests")
+            options.requests = std::stoi(value);
+        else if (arg == "--warmup")
+            options.warmup = std::stoi(value);
+        else if (arg == "--rows")
+            options.rows = std::stoi(value);
+        else if (arg == "--cols")
+            options.cols = std::stoi(value);
+        else
+            return false;
+    }
+
+    return options.connections > 0 && options.requests > 0 && options.warmup >= 0 && options.rows > 0 && options.cols > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<double>> latencies(options.connections);
+    std::vector<std::thread> clients;
+    std::atomic<int> failures(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < options.connections; ++i)
+    {
+        clients.emplace_back(options.shm_name.empty() ? client : shm_client, std::cref(options), i + 1, std::ref(latencies[i]), std::ref(failures));
+    }
+    for (auto &thread : clients)
+    {
+        thread.join();
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (auto &client_latencies : latencies)
+    {
+        all.insert(all.end(), client_latencies.begin(), client_latencies.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    // Warm-up requests are part of the elapsed time, so throughput accounts for them as well
+    double completed = static_cast<double>(options.connections) * (options.warmup + options.requests) - failures;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "transport:   " << (options.shm_name.empty() ? "socket " + options.socket_path : "shm " + options.shm_name) << std::endl;
+    std::cout << "connections: " << options.connections << ", rows/request: " << options.rows << ", cols: " << options.cols << std::endl;
+    std::cout << "requests:    " << all.size() << " measured, " << failures << " failed" << std::endl;
+    std::cout << "throughput:  " << completed / elapsed << " req/s, " << completed * options.rows / elapsed << " rows/s" << std::endl;
+    std::cout << "latency us:  p50 " << percentile(all, 50) << "  p90 " << percentile(all, 90) << "  p99 " << percentile(all, 99)
+              << "  p99.9 " << percentile(all, 99.9) << "  max " << (all.empty() ? 0. : all.back()) << std::endl;
+
+    return failures > 0 ? 1 : 0;
+}
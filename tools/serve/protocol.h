@@ -0,0 +1,114 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+
+#include <unistd.h>
+
+/**
+ * @brief Wire format of the NNFS inference server.
+ *
+ * @details Both peers live on the same host, so all fields are sent in host byte order.
+ * A request is a RequestHeader followed by rows * cols float32 values in row-major order.
+ * The server answers every request with a ResponseHeader followed by rows * cols float32
+ * probabilities (row-major). A connection may carry any number of requests, one after another.
+ */
+namespace protocol
+{
+    constexpr uint32_t MAGIC = 0x53464e4e; ///< "NNFS" in little-endian byte order.
+
+    constexpr uint32_t MAX_ROWS = 4096;  ///< Largest number of rows accepted in a single request.
+    constexpr uint32_t MAX_COLS = 65536; ///< Largest number of features accepted per row.
+
+    /**
+     * @brief Status codes sent back in ResponseHeader::status.
+     */
+    enum Status : uint32_t
+    {
+        OK = 0,          ///< Prediction succeeded, payload follows.
+        BAD_REQUEST = 1, ///< Malformed header (wrong magic or limits exceeded), the connection is closed.
+        BAD_SHAPE = 2,   ///< Number of columns does not match the model's input dimension.
+        UNAVAILABLE = 3  ///< No model is loaded.
+    };
+
+    /**
+     * @brief Header preceding every request payload.
+     */
+    struct RequestHeader
+    {
+        uint32_t magic; ///< Must be MAGIC.
+        uint32_t rows;  ///< Number of samples in the request.
+        uint32_t cols;  ///< Number of features per sample.
+    };
+
+    /**
+     * @brief Header preceding every response payload.
+     */
+    struct ResponseHeader
+    {
+        uint32_t magic;  ///< Always MAGIC.
+        uint32_t status; ///< One of protocol::Status.
+        uint32_t rows;   ///< Number of rows in the payload (0 unless status is OK).
+        uint32_t cols;   ///< Number of columns in the payload (0 unless status is OK).
+    };
+
+    /**
+     * @brief Reads exactly size bytes from a socket.
+     *
+     * @param fd Socket descriptor
+     * @param data Destination buffer
+     * @param size Number of bytes to read
+     * @return True on success, false on EOF or error.
+     */
+    inline bool read_full(int fd, void *data, size_t size)
+    {
+        char *ptr = static_cast<char *>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::read(fd, ptr, size);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Writes exactly size bytes to a socket.
+     *
+     * @param fd Socket descriptor
+     * @param data Source buffer
+     * @param size Number of bytes to write
+     * @return True on success, false on error.
+     */
+    inline bool write_full(int fd, const void *data, size_t size)
+    {
+        const char *ptr = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, ptr, size);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+} // namespace protocol
+
+#endif // PROTOCOL_H
@@ -0,0 +1,337 @@
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <NNFS/Core>
+
+#include "inference.h"
+#include "protocol.h"
+#include "shm_ring.h"
+
+/**
+ * @brief Command line options of the server.
+ */
+struct Options
+{
+    std::string model;                                           ///< Model file written by NNFS::NeuralNetwork::save.
+    std::string socket_path = "/tmp/nnfs.sock";                  ///< Path of the Unix domain socket.
+    int workers = std::max(1u, std::thread::hardware_concurrency()); ///< Number of inference workers.
+    int max_batch = 64;                                          ///< Maximum number of rows per batch.
+    int max_delay_us = 200;                                      ///< Maximum time a request waits for its batch to fill up.
+    int watch_ms = 500;                                          ///< Model file polling interval.
+    std::string shm_name;                                        ///< Name of the shared-memory ring, empty to disable it.
+    int shm_slots = 256;                                         ///< Number of slots in the shared-memory ring.
+    int cache_rows = 0;                                          ///< Prediction cache capacity per worker, 0 disables it.
+};
+
+static std::atomic<bool> running(true);
+
+static void handle_signal(int)
+{
+    running = false;
+}
+
+/**
+ * @brief A client connection served by its own thread.
+ *
+ * @details The descriptor is only closed by the accept loop, after the thread has been joined.
+ */
+struct Connection
+{
+    int fd;
+    std::atomic<bool> done{false};
+    std::thread thread;
+};
+
+/**
+ * @brief Serves requests from a single client until it disconnects.
+ *
+ * @param connection Client connection
+ * @param batcher Batcher executing the requests
+ */
+static void serve_connection(Connection &connection, Batcher &batcher)
+{
+    std::vector<float> buffer;
+    protocol::RequestHeader request;
+
+    while (protocol::read_full(connection.fd, &request, sizeof(request)))
+    {
+        protocol::ResponseHeader response{protocol::MAGIC, protocol::OK, 0, 0};
+
+        if (request.magic != protocol::MAGIC || request.rows == 0 || request.rows > protocol::MAX_ROWS ||
+            request.cols == 0 || request.cols > protocol::MAX_COLS)
+        {
+            response.status = protocol::BAD_REQUEST;
+            protocol::write_full(connection.fd, &response, sizeof(response));
+            break;
+        }
+
+        buffer.resize(static_cast<size_t>(request.rows) * request.cols);
+        if (!protocol::read_full(connection.fd, buffer.data(), buffer.size() * sizeof(float)))
+        {
+            break;
+        }
+
+        Eigen::MatrixXd input = Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(
+                                    buffer.data(), request.rows, request.cols)
+                                    .cast<double>();
+
+        InferenceResult result = batcher.submit(std::move(input)).get();
+
+        response.status = result.status;
+        if (result.status == protocol::OK)
+        {
+            response.rows = result.output.rows();
+            response.cols = result.output.cols();
+
+            buffer.resize(static_cast<size_t>(response.rows) * response.cols);
+            Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(buffer.data(), response.rows, response.cols) = result.output.cast<float>();
+        }
+
+        if (!protocol::write_full(connection.fd, &response, sizeof(response)) ||
+            (result.status == protocol::OK && !protocol::write_full(connection.fd, buffer.data(), buffer.size() * sizeof(float))))
+        {
+            break;
+        }
+    }
+
+    connection.done = true;
+}
+
+/**
+ * @brief Serves the shared-memory ring until the server shuts down.
+ *
+ * @details Batches are formed from whatever consecutive rows are already published. The network
+ * works on column-major matrices, so the row-major rows of the segment are copied once into a
+ * batch buffer reused across requests, and the probabilities are written back in place.
+ *
+ * @param ring Shared-memory ring
+ * @param registry Source of the served model
+ * @param replica Index of the replica reserved for this thread
+ * @param max_batch Maximum number of rows per batch
+ */
+static void serve_shm(ShmRing &ring, ModelRegistry &registry, int replica, int max_batch)
+{
+    uint32_t tail = 0;
+    Eigen::MatrixXd batch;
+
+    while (running)
+    {
+        uint32_t rows = ring.wait_batch(tail, max_batch, std::chrono::milliseconds(100));
+        if (rows == 0)
+        {
+            continue;
+        }
+
+        std::shared_ptr<ModelGeneration> generation = registry.acquire();
+        protocol::Status status = protocol::OK;
+
+        if (!generation)
+        {
+            status = protocol::UNAVAILABLE;
+        }
+        else if (generation->input_dim != static_cast<int>(ring.cols()) || generation->output_dim != static_cast<int>(ring.out_cols()))
+        {
+            // The ring layout is fixed at start-up, a reloaded model with other dimensions cannot be served through it
+            status = protocol::BAD_SHAPE;
+        }
+        else
+        {
+            batch = ring.inputs(tail, rows);
+            ring.outputs(tail, rows) = generation->replicas[replica]->predict(batch);
+        }
+
+        ring.complete(tail, rows, status);
+        tail += rows;
+    }
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " --model <path> [--socket <path>] [--workers <n>] [--max-batch <rows>]"
+              << " [--max-delay-us <us>] [--watch-ms <ms>] [--shm <name>] [--shm-slots <n>]"
+              << " [--cache <rows>]" << std::endl;
+}
+
+static bool parse_options(int argc, char *argv[], Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+
+        std::string value = argv[++i];
+        try
+        {
+            if (arg == "--model")
+                options.model = value;
+            else if (arg == "--socket")
+                options.socket_path = value;
+            else if (arg == "--workers")
+                options.workers = std::stoi(value);
+            else if (arg == "--max-batch")
+                options.max_batch = std::stoi(value);
+            else if (arg == "--max-delay-us")
+                options.max_delay_us = std::stoi(value);
+            else if (arg == "--watch-ms")
+                options.watch_ms = std::stoi(value);
+            else if (arg == "--shm")
+                options.shm_name = value;
+            else if (arg == "--shm-slots")
+                options.shm_slots = std::stoi(value);
+            else if (arg == "--cache")
+                options.cache_rows = std::stoi(value);
+            else
+                return false;
+        }
+        catch (const std::exception &)
+        {
+            // std::stoi throws on values that are not numbers or do not fit an int
+            return false;
+        }
+    }
+
+    return !options.model.empty() && options.workers > 0 && options.max_batch > 0 && options.shm_slots > 0 && options.cache_rows >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    // The shared-memory ring is served by its own thread, which needs a replica of its own
+    bool use_shm = !options.shm_name.empty();
+    ModelRegistry registry(options.model, options.workers + (use_shm ? 1 : 0), options.cache_rows);
+    if (!registry.reload())
+    {
+        return 1;
+    }
+
+    // Every early return happens before the shared-memory thread starts, a joinable thread must not be destroyed
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        LOG_ERROR("Failed to create socket: " << std::strerror(errno));
+        return 1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socket_path.size() >= sizeof(address.sun_path))
+    {
+        LOG_ERROR("Socket path " << options.socket_path << " is too long.");
+        ::close(listen_fd);
+        return 1;
+    }
+    std::strncpy(address.sun_path, options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    ::unlink(options.socket_path.c_str());
+    if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listen_fd, 128) != 0)
+    {
+        LOG_ERROR("Failed to listen on " << options.socket_path << ": " << std::strerror(errno));
+        ::close(listen_fd);
+        return 1;
+    }
+
+    ShmRing ring;
+    std::thread shm_thread;
+    if (use_shm)
+    {
+        std::shared_ptr<ModelGeneration> generation = registry.acquire();
+        if (!ring.create(options.shm_name, options.shm_slots, generation->input_dim, generation->output_dim))
+        {
+            LOG_ERROR("Failed to create shared-memory ring " << options.shm_name << ": " << std::strerror(errno));
+            ::close(listen_fd);
+            ::unlink(options.socket_path.c_str());
+            return 1;
+        }
+
+        LOG_INFO("Serving shared-memory ring " << options.shm_name << " with " << ring.capacity() << " slots");
+        shm_thread = std::thread(serve_shm, std::ref(ring), std::ref(registry), options.workers, options.max_batch);
+    }
+
+    LOG_INFO("Listening on " << options.socket_path << " with " << options.workers << " workers, batches of up to "
+                             << options.max_batch << " rows");
+
+    std::thread watcher([&]
+                        { registry.watch(std::chrono::milliseconds(options.watch_ms), running); });
+
+    {
+        Batcher batcher(registry, options.workers, options.max_batch, std::chrono::microseconds(options.max_delay_us));
+        std::list<Connection> connections;
+
+        while (running)
+        {
+            pollfd pfd{listen_fd, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) <= 0)
+            {
+                continue;
+            }
+
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0)
+            {
+                continue;
+            }
+
+            // Reap connections whose clients went away
+            for (auto it = connections.begin(); it != connections.end();)
+            {
+                if (it->done)
+                {
+                    it->thread.join();
+                    ::close(it->fd);
+                    it = connections.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            Connection &connection = connections.emplace_back();
+            connection.fd = fd;
+            connection.thread = std::thread(serve_connection, std::ref(connection), std::ref(batcher));
+        }
+
+        LOG_INFO("Shutting down");
+
+        for (auto &connection : connections)
+        {
+            ::shutdown(connection.fd, SHUT_RDWR);
+            connection.thread.join();
+            ::close(connection.fd);
+        }
+    }
+
+    if (shm_thread.joinable())
+    {
+        shm_thread.join();
+    }
+    watcher.join();
+    ::close(listen_fd);
+    ::unlink(options.socket_path.c_str());
+
+    return 0;
+}
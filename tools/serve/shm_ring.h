@@ -0,0 +1,430 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <Eigen/Core>
+
+#include "protocol.h"
+
+/**
+ * @brief Shared-memory request ring for clients running on the same host as the server.
+ *
+ * @details The segment holds a fixed number of slots. Each slot owns one input row and one
+ * output row inside two contiguous row-major blocks, so a run of consecutive slots is directly
+ * usable as a batch: the server maps the input rows with Eigen::Map, copies them once into the
+ * column-major input of the network and writes the probabilities back into the output rows of
+ * the same slots. No data goes through the kernel or a wire format.
+ *
+ * Producers (any number of client threads or processes) claim tickets with a fetch_add on
+ * the head counter. The state of slot (ticket % capacity) is a 32-bit sequence word:
+ *
+ * - ticket            the slot is free for this ticket
+ * - ticket + 1        the client has written its input row
+ * - ticket + 2        the server has written the output row
+ * - ticket + capacity the client has read its result, the slot is free for the next lap
+ *
+ * The single consumer (the server) processes slots strictly in ticket order. Waiting is done
+ * with a short spin followed by a futex sleep, and wake-ups are only issued when somebody is
+ * actually sleeping.
+ *
+ * @note A client that dies between claiming a ticket and publishing its row stalls the ring,
+ * since the server processes tickets in order. The server has to be restarted in that case.
+ */
+class ShmRing
+{
+public:
+    /**
+     * @brief Creates (or recreates) a named segment. Used by the server.
+     *
+     * @param name Name passed to shm_open, e.g. "/nnfs"
+     * @param capacity Number of slots, rounded up to a power of two (at least 4)
+     * @param cols Number of input features per row
+     * @param out_cols Number of output values per row
+     * @return True on success.
+     */
+    bool create(const std::string &name, uint32_t capacity, uint32_t cols, uint32_t out_cols)
+    {
+        uint32_t slots = 4;
+        while (slots < capacity)
+        {
+            slots <<= 1;
+        }
+
+        ::shm_unlink(name.c_str());
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        size_t size = layout(slots, cols, out_cols);
+        if (::ftruncate(fd, size) != 0 || !map(fd, size))
+        {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            return false;
+        }
+        ::close(fd);
+
+        _header = new (_base) Header();
+        _header->capacity = slots;
+        _header->cols = cols;
+        _header->out_cols = out_cols;
+        locate();
+
+        for (uint32_t i = 0; i < slots; ++i)
+        {
+            new (&_seq[i]) std::atomic<uint32_t>(i);
+        }
+
+        _name = name;
+        _owner = true;
+
+        // Publishing the magic last tells clients the segment is initialized
+        std::atomic_thread_fence(std::memory_order_release);
+        _header->magic = protocol::MAGIC;
+        return true;
+    }
+
+    /**
+     * @brief Opens a segment created by the server. Used by clients.
+     *
+     * @param name Name passed to shm_open
+     * @return True on success.
+     */
+    bool open(const std::string &name)
+    {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header) || !map(fd, st.st_size))
+        {
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+
+        _header = reinterpret_cast<Header *>(_base);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_header->magic != protocol::MAGIC || layout(_header->capacity, _header->cols, _header->out_cols) > _size)
+        {
+            return false;
+        }
+        locate();
+        return true;
+    }
+
+    ~ShmRing()
+    {
+        if (_base)
+        {
+            ::munmap(_base, _size);
+        }
+        if (_owner)
+        {
+            ::shm_unlink(_name.c_str());
+        }
+    }
+
+    uint32_t capacity() const { return _header->capacity; }
+    uint32_t cols() const { return _header->cols; }
+    uint32_t out_cols() const { return _header->out_cols; }
+
+    /**
+     * @brief Runs rows through the server. Used by clients.
+     *
+     * @param[in] input Row-major input, rows * cols() values
+     * @param[out] output Row-major output, rows * out_cols() values
+     * @param rows Number of rows, at most capacity()
+     * @return protocol::OK or the first error reported by the server.
+     */
+    protocol::Status infer(const double *input, double *output, uint32_t rows)
+    {
+        const uint32_t mask = _header->capacity - 1;
+        const uint32_t cols = _header->cols;
+        const uint32_t out_cols = _header->out_cols;
+
+        uint32_t ticket = _header->head.fetch_add(rows, std::memory_order_relaxed);
+
+        for (uint32_t i = 0; i < rows; ++i)
+        {
+            uint32_t t = ticket + i;
+            uint32_t slot = t & mask;
+
+            wait_for(_seq[slot], t);
+            std::memcpy(_input + static_cast<size_t>(slot) * cols, input + static_cast<size_t>(i) * cols, cols * sizeof(double));
+            _seq[slot].store(t + 1, std::memory_order_release);
+        }
+
+        _header->doorbell.fetch_add(1, std::memory_order_release);
+        if (_header->server_sleeping.load(std::memory_order_acquire))
+        {
+            futex_wake(_header->doorbell, 1);
+        }
+
+        protocol::Status status = protocol::OK;
+        for (uint32_t i = 0; i < rows; ++i)
+        {
+            uint32_t t = ticket + i;
+            uint32_t slot = t & mask;
+
+            wait_for(_seq[slot], t + 2);
+            if (_status[slot] != protocol::OK)
+            {
+                status = static_cast<protocol::Status>(_status[slot]);
+            }
+            std::memcpy(output + static_cast<size_t>(i) * out_cols, _output + static_cast<size_t>(slot) * out_cols, out_cols * sizeof(double));
+
+            // Hand the slot over to the ticket one lap ahead
+            _seq[slot].store(t + _header->capacity, std::memory_order_release);
+        }
+
+        // Pairs with the increment in wait_for(): either the sleeper sees the new value or we see the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_header->sleepers.load(std::memory_order_relaxed))
+        {
+            for (uint32_t i = 0; i < rows; ++i)
+            {
+                futex_wake(_seq[(ticket + i) & mask], INT_MAX);
+            }
+        }
+
+        return status;
+    }
+
+    /**
+     * @brief Waits for published rows starting at ticket tail. Used by the server.
+     *
+     * @param tail Next ticket to process
+     * @param max_rows Maximum number of rows to return
+     * @param timeout Maximum time to sleep when the ring is empty
+     * @return Number of consecutive published rows, never crossing the end of the ring.
+     */
+    uint32_t wait_batch(uint32_t tail, uint32_t max_rows, std::chrono::milliseconds timeout)
+    {
+        const uint32_t mask = _header->capacity - 1;
+
+        if (!published(tail))
+        {
+            for (int spin = 0; spin < SPIN_LIMIT && !published(tail); ++spin)
+            {
+                cpu_relax();
+            }
+
+            if (!published(tail))
+            {
+                uint32_t bell = _header->doorbell.load(std::memory_order_acquire);
+                _header->server_sleeping.store(1, std::memory_order_seq_cst);
+                if (!published(tail))
+                {
+                    timespec ts{static_cast<time_t>(timeout.count() / 1000), static_cast<long>(timeout.count() % 1000) * 1000000};
+                    futex_wait(_header->doorbell, bell, &ts);
+                }
+                _header->server_sleeping.store(0, std::memory_order_relaxed);
+
+                if (!published(tail))
+                {
+                    return 0;
+                }
+            }
+        }
+
+        uint32_t contiguous = _header->capacity - (tail & mask);
+        uint32_t limit = std::min(max_rows, contiguous);
+        uint32_t rows = 1;
+        while (rows < limit && published(tail + rows))
+        {
+            ++rows;
+        }
+        return rows;
+    }
+
+    /**
+     * @brief Maps the input rows of a batch. Used by the server.
+     *
+     * @param tail First ticket of the batch
+     * @param rows Number of rows returned by wait_batch()
+     */
+    Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> inputs(uint32_t tail, uint32_t rows) const
+    {
+        uint32_t slot = tail & (_header->capacity - 1);
+        return {_input + static_cast<size_t>(slot) * _header->cols, rows, _header->cols};
+    }
+
+    /**
+     * @brief Maps the output rows of a batch. Used by the server.
+     *
+     * @param tail First ticket of the batch
+     * @param rows Number of rows returned by wait_batch()
+     */
+    Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> outputs(uint32_t tail, uint32_t rows)
+    {
+        uint32_t slot = tail & (_header->capacity - 1);
+        return {_output + static_cast<size_t>(slot) * _header->out_cols, rows, _header->out_cols};
+    }
+
+    /**
+     * @brief Marks a batch as done and wakes its clients. Used by the server.
+     *
+     * @param tail First ticket of the batch
+     * @param rows Number of rows in the batch
+     * @param status Status reported to every row of the batch
+     */
+    void complete(uint32_t tail, uint32_t rows, protocol::Status status)
+    {
+        const uint32_t mask = _header->capacity - 1;
+        for (uint32_t i = 0; i < rows; ++i)
+        {
+            uint32_t slot = (tail + i) & mask;
+            _status[slot] = status;
+            _seq[slot].store(tail + i + 2, std::memory_order_release);
+        }
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_header->sleepers.load(std::memory_order_relaxed))
+        {
+            for (uint32_t i = 0; i < rows; ++i)
+            {
+                futex_wake(_seq[(tail + i) & mask], INT_MAX);
+            }
+        }
+    }
+
+private:
+    static constexpr int SPIN_LIMIT = 2000; // Spins before falling back to a futex sleep
+
+    /**
+     * @brief Fixed part of the segment, followed by the slot arrays.
+     */
+    struct Header
+    {
+        uint32_t magic = 0;
+        uint32_t capacity = 0;
+        uint32_t cols = 0;
+        uint32_t out_cols = 0;
+        alignas(64) std::atomic<uint32_t> head{0};     // Next ticket handed out to producers
+        alignas(64) std::atomic<uint32_t> doorbell{0}; // Bumped after publishing, the server sleeps on it
+        std::atomic<uint32_t> server_sleeping{0};      // Set while the server sleeps on the doorbell
+        alignas(64) std::atomic<uint32_t> sleepers{0}; // Number of clients sleeping on a slot
+    };
+
+    static size_t align(size_t offset)
+    {
+        return (offset + 63) & ~static_cast<size_t>(63);
+    }
+
+    static size_t layout(uint32_t capacity, uint32_t cols, uint32_t out_cols, size_t *offsets = nullptr)
+    {
+        size_t seq = align(sizeof(Header));
+        size_t status = align(seq + capacity * sizeof(uint32_t));
+        size_t input = align(status + capacity * sizeof(uint32_t));
+        size_t output = align(input + static_cast<size_t>(capacity) * cols * sizeof(double));
+        size_t end = align(output + static_cast<size_t>(capacity) * out_cols * sizeof(double));
+        if (offsets)
+        {
+            offsets[0] = seq;
+            offsets[1] = status;
+            offsets[2] = input;
+            offsets[3] = output;
+        }
+        return end;
+    }
+
+    bool map(int fd, size_t size)
+    {
+        void *base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            return false;
+        }
+        _base = static_cast<char *>(base);
+        _size = size;
+        return true;
+    }
+
+    void locate()
+    {
+        size_t offsets[4];
+        layout(_header->capacity, _header->cols, _header->out_cols, offsets);
+        _seq = reinterpret_cast<std::atomic<uint32_t> *>(_base + offsets[0]);
+        _status = reinterpret_cast<uint32_t *>(_base + offsets[1]);
+        _input = reinterpret_cast<double *>(_base + offsets[2]);
+        _output = reinterpret_cast<double *>(_base + offsets[3]);
+    }
+
+    bool published(uint32_t ticket) const
+    {
+        return _seq[ticket & (_header->capacity - 1)].load(std::memory_order_acquire) == ticket + 1;
+    }
+
+    /**
+     * @brief Waits until a slot's sequence word reaches the expected value.
+     */
+    void wait_for(std::atomic<uint32_t> &word, uint32_t expected)
+    {
+        for (int spin = 0; spin < SPIN_LIMIT; ++spin)
+        {
+            if (word.load(std::memory_order_acquire) == expected)
+            {
+                return;
+            }
+            cpu_relax();
+        }
+
+        _header->sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t current;
+        while ((current = word.load(std::memory_order_acquire)) != expected)
+        {
+            futex_wait(word, current, nullptr);
+        }
+        _header->sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void futex_wait(std::atomic<uint32_t> &word, uint32_t expected, const timespec *timeout)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+    }
+
+    static void futex_wake(std::atomic<uint32_t> &word, int count)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+    }
+
+    static void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    char *_base = nullptr;                 // Start of the mapping
+    size_t _size = 0;                      // Size of the mapping
+    Header *_header = nullptr;             // Segment header
+    std::atomic<uint32_t> *_seq = nullptr; // Per-slot sequence words
+    uint32_t *_status = nullptr;           // Per-slot status written by the server
+    double *_input = nullptr;              // Row-major input block, capacity x cols
+    double *_output = nullptr;             // Row-major output block, capacity x out_cols
+    std::string _name;                     // Segment name (server only)
+    bool _owner = false;                   // Whether this instance unlinks the segment
+};
+
+#endif // SHM_RING_H